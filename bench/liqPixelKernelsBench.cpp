@@ -0,0 +1,80 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the
+** "License"); you may not use this file except in compliance with the License. You may
+** obtain a copy of the License at http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific
+** language governing rights and limitations under the License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions created by
+** Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Pixel Kernels Bench
+**
+** Times the render view's old bucket loop against liqQuantizePixels on
+** 64x64 and 256x256 buckets of rgb and rgba floats, in Mpixels/s.
+** ______________________________________________________________________
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+#include "liqPixelKernelsReference.h"
+
+using namespace std;
+
+typedef void ( *bucketLoop )( const float*, unsigned, unsigned, unsigned, const float*, RV_PIXEL* );
+
+static double mpixels( bucketLoop loop, const vector< float > &data, unsigned size, unsigned channels, vector< RV_PIXEL > &image )
+{
+  const float q[ 4 ] = { 0, 255, 0, 255 };
+  unsigned runs( 0 );
+  const clock_t start( clock() );
+  clock_t end( start );
+  // at least half a second of buckets
+  while ( end - start < CLOCKS_PER_SEC / 2 ) 
+  {
+    for ( unsigned i = 0; i < 16; i++, runs++ ) 
+      loop( &data[ 0 ], size, size, channels, q, &image[ 0 ] );
+    end = clock();
+  }
+  return ( double )runs * size * size / ( ( double )( end - start ) / CLOCKS_PER_SEC ) / 1e6;
+}
+
+int main()
+{
+  srand( 1 );
+  printf( "bucket     channels   old loop   kernel\n" );
+  for ( unsigned size = 64; size <= 256; size *= 4 ) 
+  {
+    for ( unsigned channels = 3; channels <= 4; channels++ ) 
+    {
+      vector< float > data( size * size * channels );
+      for ( unsigned i = 0; i < data.size(); i++ ) data[ i ] = rand() / ( float )RAND_MAX;
+      vector< RV_PIXEL > image( size * size );
+      const double reference( mpixels( referenceBucket, data, size, channels, image ) );
+      const double kernel( mpixels( kernelBucket, data, size, channels, image ) );
+      printf( "%3ux%-3u    %u          %8.0f %8.0f  x%.1f\n", size, size, channels, reference, kernel, kernel / reference );
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the
+** "License"); you may not use this file except in compliance with the License. You may
+** obtain a copy of the License at http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific
+** language governing rights and limitations under the License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions created by
+** Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Pixel Kernels Check
+**
+** Compares liqQuantizePixels with the render view's old scalar quantize on
+** random rows of 1 to 5 channels, out of range values included. Exits 1 on
+** the first mismatching pixel.
+** ______________________________________________________________________
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "liqPixelKernelsReference.h"
+
+using namespace std;
+
+int main()
+{
+  const float q[ 4 ] = { 0, 255, 0, 255 };
+  unsigned checked( 0 );
+  srand( 1 );
+  for ( unsigned channels = 1; channels <= 5; channels++ ) 
+  {
+    for ( unsigned t = 0; t < 2000; t++ ) 
+    {
+      const unsigned n( t % 37 );
+      vector< float > src( n * channels + 1 );
+      for ( unsigned i = 0; i < src.size(); i++ ) 
+      {
+        const float r( rand() / ( float )RAND_MAX );
+        src[ i ] = ( t % 3 ) ? r : r * 3 - 1;
+      }
+      // alpha must be left alone when there is none
+      RV_PIXEL blank = { -1, -1, -1, 42 };
+      vector< RV_PIXEL > result( n + 1, blank );
+      liqQuantizePixels( &src[ 0 ], n, channels, q, 0.5, ( float* )&result[ 0 ] );
+      for ( unsigned i = 0; i <= n; i++, checked++ ) 
+      {
+        RV_PIXEL expected( blank );
+        if ( i < n ) 
+        {
+          const float *p = &src[ i * channels ];
+          if ( channels < 3 ) 
+            expected.r = expected.g = expected.b = quantize( p[ 0 ], q[ 0 ], q[ 1 ], q[ 2 ], q[ 3 ], 0.5 );
+          else 
+            referenceBucket( p, 1, 1, channels, q, &expected );
+          if ( channels == 3 ) expected.a = blank.a;
+        }
+        if ( memcmp( &expected, &result[ i ], sizeof( RV_PIXEL ) ) ) 
+        {
+          printf( "FAIL %u channels, pixel %u of %u: %g %g %g %g instead of %g %g %g %g\n", channels, i, n,
+                  result[ i ].r, result[ i ].g, result[ i ].b, result[ i ].a, expected.r, expected.g, expected.b, expected.a );
+          return 1;
+        }
+      }
+    }
+  }
+  // whole buckets, flipped in place
+  for ( unsigned size = 1; size <= 64; size *= 4 ) 
+  {
+    for ( unsigned channels = 3; channels <= 4; channels++ ) 
+    {
+      vector< float > data( size * size * channels );
+      for ( unsigned i = 0; i < data.size(); i++ ) data[ i ] = rand() / ( float )RAND_MAX * 1.2f - 0.1f;
+      vector< RV_PIXEL > expected( size * size ), result( size * size );
+      referenceBucket( &data[ 0 ], size, size, channels, q, &expected[ 0 ] );
+      kernelBucket( &data[ 0 ], size, size, channels, q, &result[ 0 ] );
+      for ( unsigned i = 0; i < expected.size(); i++, checked++ ) 
+      {
+        if ( channels == 3 ) result[ i ].a = expected[ i ].a;
+        if ( memcmp( &expected[ i ], &result[ i ], sizeof( RV_PIXEL ) ) ) 
+        {
+          printf( "FAIL %ux%u bucket of %u channels, pixel %u\n", size, size, channels, i );
+          return 1;
+        }
+      }
+    }
+  }
+  printf( "OK %u pixels\n", checked );
+  return 0;
+}
@@ -0,0 +1,90 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the
+** "License"); you may not use this file except in compliance with the License. You may
+** obtain a copy of the License at http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific
+** language governing rights and limitations under the License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions created by
+** Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqPixelKernelsReference_H
+#define liqPixelKernelsReference_H
+
+/* ______________________________________________________________________
+**
+** Liquid Pixel Kernels Reference Header File
+**
+** The render view's bucket loop as it was before liqQuantizePixels, the
+** reference bench/ checks and times the kernel against.
+** ______________________________________________________________________
+*/
+
+#include <cstring>
+
+#include <liqPixelKernels.h>
+
+struct RV_PIXEL
+{
+  float r, g, b, a;
+};
+
+inline int quantize( const float value, const float zero,const float one,const float min, const float max, const float dither )
+{
+  int result = ( int )( zero + value * ( one - zero ) + dither );
+  if ( result < min ) result = ( int )min;
+  if ( result > max ) result = ( int )max;
+  return result;
+}
+
+// One bucket of width x height pixels, as liqMayaRenderView::renderBucket
+// used to show it: a fresh bottom up RV_PIXEL buffer per bucket, quantized
+// a channel at a time and copied to the image.
+inline void referenceBucket( const float *data, unsigned width, unsigned height, unsigned channels, const float q[ 4 ], RV_PIXEL *image )
+{
+  const unsigned nPixels( width * height );
+  RV_PIXEL *pixels = new RV_PIXEL[ nPixels ];
+  memset( pixels, 0, nPixels * sizeof( RV_PIXEL ) );
+  for ( unsigned y = 0; y < height; y++ ) 
+  {
+    RV_PIXEL *pixel = pixels + ( height - 1 - y ) * width;
+    const float *row = data + y * width * channels;
+    for ( unsigned x = 0; x < width; x++ ) 
+    {
+      pixel->r = quantize( *( row ),     q[ 0 ], q[ 1 ], q[ 2 ], q[ 3 ], 0.5 );
+      pixel->g = quantize( *( row + 1 ), q[ 0 ], q[ 1 ], q[ 2 ], q[ 3 ], 0.5 );
+      pixel->b = quantize( *( row + 2 ), q[ 0 ], q[ 1 ], q[ 2 ], q[ 3 ], 0.5 );
+      if ( channels > 3 )
+        pixel->a = quantize( *( row + 3 ), q[ 0 ], q[ 1 ], q[ 2 ], q[ 3 ], 0.5 );
+      row += channels;
+      ++pixel;
+    }
+  }
+  memcpy( image, pixels, nPixels * sizeof( RV_PIXEL ) );
+  delete[] pixels;
+}
+
+// The same bucket through the kernel, straight into its rows of the image.
+inline void kernelBucket( const float *data, unsigned width, unsigned height, unsigned channels, const float q[ 4 ], RV_PIXEL *image )
+{
+  for ( unsigned y = 0; y < height; y++ ) 
+    liqQuantizePixels( data + y * width * channels, width, channels, q, 0.5, ( float* )( image + ( height - 1 - y ) * width ) );
+}
+
+#endif
@@ -43,6 +43,9 @@ typedef struct {
    int height;
    int xo, yo;
    int wo,ho;
+   int encoding; // liqBucketCodec::encoding requested by the display driver
+   char name[64]; // image and channel set, several images can be sent at once
+   char channelNames[64];
 } imageInfo;
 
 typedef float BUCKETDATATYPE;
@@ -68,6 +71,7 @@ class bucket{
 	unsigned int getSize() const {return (m_info.right-m_info.left)*(m_info.top-m_info.bottom)*m_info.channels*sizeof(BUCKETDATATYPE);}
 	BUCKETDATATYPE *getPixels() const{return m_pixels;}
 	const bucketInfo& getInfo() const {return m_info;}
+	void offset( int x, int y ) { m_info.left += x; m_info.right += x; m_info.bottom += y; m_info.top += y; }
 
 	private:
 		BUCKETDATATYPE *m_pixels;
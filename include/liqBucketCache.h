@@ -0,0 +1,298 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Tiled bucket cache files kept by the render view
+** ______________________________________________________________________
+*/
+
+#if !defined(__LIQBUCKETCACHE_H__)
+#define __LIQBUCKETCACHE_H__
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "liqBucket.h"
+#include "liqBucketCodec.h"
+
+/**
+ * The pixels of a render, cut in fixed size tiles that are encoded one by
+ * one with liqBucketCodec. The file starts with a header and a tile index,
+ * so a reader maps it and only decodes the tiles it needs. Tiles no bucket
+ * touched are not stored at all.
+ */
+class liqBucketCache
+{
+public:
+  enum { kMagic = 0x6c716263, kVersion = 1, kTileSize = 64 };
+
+  liqBucketCache() : m_data( 0 ), m_size( 0 )
+#ifdef _WIN32
+    , m_file( INVALID_HANDLE_VALUE ), m_mapping( NULL )
+#endif
+  {
+    memset( &m_header, 0, sizeof( m_header ) );
+  }
+  ~liqBucketCache() { close(); }
+
+  /**
+   * Write the buckets of an image, bucket coordinates being relative to
+   * its data window. encoding is a liqBucketCodec encoding.
+   */
+  static bool write( const char* file, const std::vector< bucket* >& buckets, const imageInfo& info, int encoding, std::string& error )
+  {
+    if ( info.width <= 0 || info.height <= 0 || info.channels <= 0 ) 
+    {
+      error = "empty image";
+      return false;
+    }
+    header h;
+    memset( &h, 0, sizeof( h ) );
+    h.magic    = kMagic;
+    h.version  = kVersion;
+    h.info     = info;
+    h.info.encoding = liqBucketCodec::accept( encoding );
+    h.tileSize = kTileSize;
+    h.tilesX   = ( info.width + kTileSize - 1 ) / kTileSize;
+    h.tilesY   = ( info.height + kTileSize - 1 ) / kTileSize;
+
+    // the buckets touching each tile
+    const unsigned channels( info.channels );
+    std::vector< std::vector< const bucket* > > touching( h.tilesX * h.tilesY );
+    for ( unsigned i( 0 ); i < buckets.size(); i++ ) 
+    {
+      const bucket* b( buckets[ i ] );
+      if ( !b || !b->getPixels() ) continue;
+      const bucket::bucketInfo& bi( b->getInfo() );
+      if ( bi.channels != channels || bi.left >= bi.right || bi.bottom >= bi.top || 
+           bi.right > ( unsigned )info.width || bi.top > ( unsigned )info.height ) 
+        continue;
+      for ( unsigned ty( bi.bottom / kTileSize ); ty <= ( bi.top - 1 ) / kTileSize; ty++ ) 
+        for ( unsigned tx( bi.left / kTileSize ); tx <= ( bi.right - 1 ) / kTileSize; tx++ ) 
+          touching[ ty * h.tilesX + tx ].push_back( b );
+    }
+
+    FILE* fh( fopen( file, "wb" ) );
+    if ( !fh ) 
+    {
+      error = std::string( "couldn't open " ) + file + " for writing";
+      return false;
+    }
+    std::vector< tile > index( touching.size() );
+    unsigned long long offset( sizeof( header ) + index.size() * sizeof( tile ) );
+    bool ok( fwrite( &h, sizeof( h ), 1, fh ) == 1 && fwrite( &index[ 0 ], sizeof( tile ), index.size(), fh ) == index.size() );
+
+    std::vector< BUCKETDATATYPE > pixels;
+    std::vector< unsigned char > encoded, scratch;
+    for ( unsigned t( 0 ); ok && t < touching.size(); t++ ) 
+    {
+      if ( touching[ t ].empty() ) continue;
+      const bucket::bucketInfo ti( tileInfo( h, t % h.tilesX, t / h.tilesX ) );
+      const unsigned width( ti.right - ti.left );
+      pixels.assign( width * ( ti.top - ti.bottom ) * channels, 0.0f );
+      for ( unsigned i( 0 ); i < touching[ t ].size(); i++ ) 
+      {
+        const bucket::bucketInfo& bi( touching[ t ][ i ]->getInfo() );
+        const unsigned x0( std::max( bi.left, ti.left ) ), x1( std::min( bi.right, ti.right ) );
+        const unsigned bucketWidth( bi.right - bi.left );
+        for ( unsigned y( std::max( bi.bottom, ti.bottom ) ); y < std::min( bi.top, ti.top ); y++ ) 
+          memcpy( &pixels[ ( ( y - ti.bottom ) * width + x0 - ti.left ) * channels ], 
+                  touching[ t ][ i ]->getPixels() + ( ( y - bi.bottom ) * bucketWidth + x0 - bi.left ) * channels, 
+                  ( x1 - x0 ) * channels * sizeof( BUCKETDATATYPE ) );
+      }
+      liqBucketCodec::payload payload;
+      liqBucketCodec::encode( h.info.encoding, width * ( ti.top - ti.bottom ), channels, &pixels[ 0 ], encoded, payload, scratch );
+      index[ t ].offset   = offset;
+      index[ t ].size     = payload.size;
+      index[ t ].encoding = payload.encoding;
+      offset += payload.size;
+      ok = !payload.size || fwrite( &encoded[ 0 ], payload.size, 1, fh ) == 1;
+    }
+    ok = ok && !fseek( fh, sizeof( header ), SEEK_SET ) && 
+         fwrite( &index[ 0 ], sizeof( tile ), index.size(), fh ) == index.size();
+    if ( fclose( fh ) ) ok = false;
+    if ( !ok ) error = std::string( "error writing " ) + file;
+    return ok;
+  }
+
+  /** Map a cache file and check its header and index. */
+  bool open( const char* file )
+  {
+    close();
+    if ( !map( file ) ) return false;
+    if ( m_size < sizeof( header ) ) return fail();
+    memcpy( &m_header, m_data, sizeof( header ) );
+    const header& h( m_header );
+    if ( h.magic != kMagic || h.version != kVersion || h.tileSize != kTileSize || 
+         h.info.width <= 0 || h.info.height <= 0 || h.info.channels <= 0 || 
+         h.tilesX != ( h.info.width + kTileSize - 1 ) / kTileSize || h.tilesY != ( h.info.height + kTileSize - 1 ) / kTileSize || 
+         ( m_size - sizeof( header ) ) / sizeof( tile ) < ( unsigned long long )h.tilesX * h.tilesY ) 
+      return fail();
+    m_index.resize( h.tilesX * h.tilesY );
+    memcpy( &m_index[ 0 ], m_data + sizeof( header ), m_index.size() * sizeof( tile ) );
+    for ( unsigned t( 0 ); t < m_index.size(); t++ ) 
+      if ( m_index[ t ].offset > m_size || m_index[ t ].size > m_size - m_index[ t ].offset ) return fail();
+    return true;
+  }
+
+  void close()
+  {
+    unmap();
+    m_index.clear();
+    memset( &m_header, 0, sizeof( m_header ) );
+  }
+
+  /** The image the buckets came from, its encoding is the one the tiles are stored with. */
+  const imageInfo& info() const { return m_header.info; }
+  unsigned tilesX() const { return m_header.tilesX; }
+  unsigned tilesY() const { return m_header.tilesY; }
+
+  /** The tile's pixel bounds, in the coordinates of the buckets it was made of. */
+  bucket::bucketInfo tileInfo( unsigned x, unsigned y ) const { return tileInfo( m_header, x, y ); }
+  bool isEmpty( unsigned x, unsigned y ) const { return !m_index[ y * m_header.tilesX + x ].size; }
+
+  /** Decode a tile to interleaved floats, laid out as a bucket of tileInfo( x, y ). */
+  bool readTile( unsigned x, unsigned y, std::vector< BUCKETDATATYPE >& data, std::vector< unsigned char >& scratch ) const
+  {
+    const bucket::bucketInfo ti( tileInfo( x, y ) );
+    const unsigned pixels( ( ti.right - ti.left ) * ( ti.top - ti.bottom ) );
+    const tile& t( m_index[ y * m_header.tilesX + x ] );
+    data.assign( pixels * ti.channels, 0.0f );
+    if ( !t.size ) return true;
+    liqBucketCodec::payload payload;
+    payload.encoding = t.encoding;
+    payload.size     = t.size;
+    return liqBucketCodec::decode( payload, pixels, ti.channels, m_data + t.offset, &data[ 0 ], scratch );
+  }
+
+private:
+  struct header
+  {
+    unsigned int magic;
+    unsigned int version;
+    imageInfo    info;
+    unsigned int tileSize;
+    unsigned int tilesX, tilesY;
+  };
+  struct tile
+  {
+    unsigned long long offset;
+    unsigned int size;     // 0 for tiles no bucket touched
+    unsigned int encoding; // liqBucketCodec drops compression on tiles it doesn't shrink
+  };
+
+  static bucket::bucketInfo tileInfo( const header& h, unsigned x, unsigned y )
+  {
+    bucket::bucketInfo info;
+    info.left     = x * kTileSize;
+    info.right    = std::min( info.left + kTileSize, ( unsigned )h.info.width );
+    info.bottom   = y * kTileSize;
+    info.top      = std::min( info.bottom + kTileSize, ( unsigned )h.info.height );
+    info.channels = h.info.channels;
+    return info;
+  }
+
+  bool fail()
+  {
+    close();
+    return false;
+  }
+
+  bool map( const char* file )
+  {
+#ifdef _WIN32
+    m_file = CreateFileA( file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    if ( m_file == INVALID_HANDLE_VALUE ) return false;
+    LARGE_INTEGER size;
+    if ( !GetFileSizeEx( m_file, &size ) || !size.QuadPart ) return fail();
+    m_mapping = CreateFileMappingA( m_file, NULL, PAGE_READONLY, 0, 0, NULL );
+    if ( !m_mapping ) return fail();
+    m_data = ( const unsigned char* )MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, 0 );
+    if ( !m_data ) return fail();
+    m_size = size.QuadPart;
+#else
+    int fd( ::open( file, O_RDONLY ) );
+    if ( fd == -1 ) return false;
+    struct stat st;
+    if ( fstat( fd, &st ) || !st.st_size ) 
+    {
+      ::close( fd );
+      return false;
+    }
+    void* p( mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 ) );
+    ::close( fd );
+    if ( p == MAP_FAILED ) return false;
+    m_data = ( const unsigned char* )p;
+    m_size = st.st_size;
+#endif
+    return true;
+  }
+
+  void unmap()
+  {
+#ifdef _WIN32
+    if ( m_data ) UnmapViewOfFile( m_data );
+    if ( m_mapping ) CloseHandle( m_mapping );
+    if ( m_file != INVALID_HANDLE_VALUE ) CloseHandle( m_file );
+    m_mapping = NULL;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if ( m_data ) munmap( ( void* )m_data, m_size );
+#endif
+    m_data = 0;
+    m_size = 0;
+  }
+
+  header                m_header;
+  std::vector< tile >   m_index;
+  const unsigned char*  m_data;
+  unsigned long long    m_size;
+#ifdef _WIN32
+  HANDLE                m_file;
+  HANDLE                m_mapping;
+#endif
+
+  liqBucketCache( const liqBucketCache& );
+  liqBucketCache& operator=( const liqBucketCache& );
+};
+
+#endif
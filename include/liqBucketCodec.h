@@ -0,0 +1,392 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Bucket encodings for the liqmaya display driver transport
+** ______________________________________________________________________
+*/
+
+#if !defined(__LIQBUCKETCODEC_H__)
+#define __LIQBUCKETCODEC_H__
+
+#include <vector>
+#include <cstring>
+#include <string>
+
+#include "liqBucket.h"
+
+/**
+ * Bucket encodings negotiated between the liqmaya display driver and its
+ * receivers. The driver asks for one in imageInfo::encoding, the receiver
+ * answers with the encoding it accepts, and every bucket is then sent as a
+ * payload header followed by the encoded samples.
+ *
+ * The lossy formats only apply to the first four (rgba) channels, anything
+ * after that (z) always travels as float. Samples are stored one channel
+ * plane after the other and byte-shuffled, which is what lets the LZ pass
+ * find matches in float data.
+ */
+class liqBucketCodec
+{
+public:
+  enum encoding
+  {
+    kFloat      = 0,
+    kHalf       = 1,
+    k16Bit      = 2,
+    k8Bit       = 3,
+    kFormatMask = 0x0f,
+    kLZ         = 0x10,
+    // transport rather than encoding: granted by receivers on the same machine
+    kSharedMemory = 0x20
+  };
+
+  /** Sent before every encoded bucket. */
+  struct payload
+  {
+    unsigned int encoding;
+    unsigned int size;
+  };
+
+  /**
+   * Parse an encoding name: float, half, 16bit or 8bit, optionally followed
+   * by +lz. A lone "lz" compresses float data.
+   */
+  static int parse( const char* name )
+  {
+    if ( !name ) return kFloat;
+    std::string s( name );
+    int result( kFloat );
+    std::string::size_type plus( s.find( '+' ) );
+    if ( s == "lz" || ( plus != std::string::npos && s.substr( plus + 1 ) == "lz" ) ) 
+      result |= kLZ;
+    s = s.substr( 0, plus );
+    if ( s == "half" ) result |= kHalf;
+    else if ( s == "16bit" ) result |= k16Bit;
+    else if ( s == "8bit" ) result |= k8Bit;
+    return result;
+  }
+
+  static std::string name( int encoding )
+  {
+    static const char* formats[] = { "float", "half", "16bit", "8bit" };
+    std::string result( formats[ accept( encoding ) & kFormatMask ] );
+    if ( encoding & kLZ ) result += "+lz";
+    return result;
+  }
+
+  /** The part of a requested encoding this build knows how to decode. */
+  static int accept( int requested )
+  {
+    int format( requested & kFormatMask );
+    if ( format > k8Bit ) format = kFloat;
+    return format | ( requested & kLZ );
+  }
+
+  static unsigned sampleSize( int encoding, unsigned channel )
+  {
+    if ( channel >= 4 ) return sizeof( float );
+    switch ( encoding & kFormatMask ) 
+    {
+      case kHalf:
+      case k16Bit: return 2;
+      case k8Bit:  return 1;
+      default:     return sizeof( float );
+    }
+  }
+
+  static unsigned rawSize( int encoding, unsigned pixels, unsigned channels )
+  {
+    unsigned size( 0 );
+    for ( unsigned c( 0 ); c < channels; c++ ) size += pixels * sampleSize( encoding, c );
+    return size;
+  }
+
+  /**
+   * Encode pixels*channels interleaved floats. The header gets the encoding
+   * actually used: compression is dropped for buckets it doesn't shrink.
+   */
+  static void encode( int encoding, unsigned pixels, unsigned channels, const BUCKETDATATYPE* data, 
+                      std::vector< unsigned char >& out, payload& header, 
+                      std::vector< unsigned char >& scratch )
+  {
+    encoding = accept( encoding );
+    std::vector< unsigned char >& planes( ( encoding & kLZ )? scratch : out );
+    planes.resize( rawSize( encoding, pixels, channels ) );
+    unsigned char* p( planes.empty()? 0 : &planes[ 0 ] );
+    for ( unsigned c( 0 ); c < channels; c++ ) 
+    {
+      unsigned size( sampleSize( encoding, c ) );
+      for ( unsigned i( 0 ); i < pixels; i++ ) 
+      {
+        unsigned char sample[ 4 ];
+        pack( encoding, c, data[ i * channels + c ], sample );
+        for ( unsigned b( 0 ); b < size; b++ ) p[ b * pixels + i ] = sample[ b ];
+      }
+      p += size * pixels;
+    }
+    header.encoding = encoding;
+    if ( encoding & kLZ ) 
+    {
+      compress( planes, out );
+      if ( out.size() >= planes.size() ) 
+      {
+        out.swap( planes );
+        header.encoding &= ~kLZ;
+      }
+    }
+    header.size = ( unsigned int )out.size();
+  }
+
+  /** Decode a payload back to pixels*channels interleaved floats. */
+  static bool decode( const payload& header, unsigned pixels, unsigned channels, const unsigned char* in, 
+                      BUCKETDATATYPE* data, std::vector< unsigned char >& scratch )
+  {
+    int encoding( header.encoding );
+    if ( accept( encoding ) != encoding ) return false;
+    unsigned size( rawSize( encoding, pixels, channels ) );
+    if ( encoding & kLZ ) 
+    {
+      scratch.resize( size );
+      if ( !decompress( in, header.size, scratch.empty()? 0 : &scratch[ 0 ], size ) ) return false;
+      in = scratch.empty()? 0 : &scratch[ 0 ];
+    }
+    else if ( header.size != size ) return false;
+
+    for ( unsigned c( 0 ); c < channels; c++ ) 
+    {
+      unsigned sampleBytes( sampleSize( encoding, c ) );
+      for ( unsigned i( 0 ); i < pixels; i++ ) 
+      {
+        unsigned char sample[ 4 ];
+        for ( unsigned b( 0 ); b < sampleBytes; b++ ) sample[ b ] = in[ b * pixels + i ];
+        data[ i * channels + c ] = unpack( encoding, c, sample );
+      }
+      in += sampleBytes * pixels;
+    }
+    return true;
+  }
+
+  static unsigned short floatToHalf( float f )
+  {
+    unsigned int x;
+    memcpy( &x, &f, sizeof( x ) );
+    unsigned int sign( ( x >> 16 ) & 0x8000 ), mantissa( x & 0x7fffff );
+    int exponent( ( int )( ( x >> 23 ) & 0xff ) );
+    if ( exponent == 255 ) return ( unsigned short )( sign | 0x7c00 | ( mantissa? 0x200 : 0 ) );
+    exponent += 15 - 127;
+    if ( exponent >= 31 ) return ( unsigned short )( sign | 0x7c00 );
+    if ( exponent <= 0 ) 
+    {
+      if ( exponent < -10 ) return ( unsigned short )sign;
+      mantissa |= 0x800000;
+      unsigned shift( 14 - exponent ), half( mantissa >> shift ), rest( mantissa & ( ( 1u << shift ) - 1 ) ), mid( 1u << ( shift - 1 ) );
+      if ( rest > mid || ( rest == mid && ( half & 1 ) ) ) half++;
+      return ( unsigned short )( sign | half );
+    }
+    unsigned half( ( exponent << 10 ) | ( mantissa >> 13 ) ), rest( mantissa & 0x1fff );
+    // round to nearest even, a carry into the exponent is still correct
+    if ( rest > 0x1000 || ( rest == 0x1000 && ( half & 1 ) ) ) half++;
+    return ( unsigned short )( sign | half );
+  }
+
+  static float halfToFloat( unsigned short h )
+  {
+    unsigned int sign( ( h & 0x8000 ) << 16 ), mantissa( h & 0x3ff ), x;
+    int exponent( ( h >> 10 ) & 0x1f );
+    if ( exponent == 31 ) x = sign | 0x7f800000 | ( mantissa << 13 );
+    else if ( exponent ) x = sign | ( ( exponent + 112 ) << 23 ) | ( mantissa << 13 );
+    else if ( !mantissa ) x = sign;
+    else 
+    {
+      exponent = 1;
+      while ( !( mantissa & 0x400 ) ) 
+      {
+        mantissa <<= 1;
+        exponent--;
+      }
+      x = sign | ( ( exponent + 112 ) << 23 ) | ( ( mantissa & 0x3ff ) << 13 );
+    }
+    float f;
+    memcpy( &f, &x, sizeof( f ) );
+    return f;
+  }
+
+  /**
+   * LZ77 compression in the LZ4 block layout: a token with the literal and
+   * match lengths, the literals, then a 16 bit little endian match offset.
+   */
+  static void compress( const std::vector< unsigned char >& in, std::vector< unsigned char >& out )
+  {
+    const unsigned hashBits( 12 );
+    unsigned table[ 1 << hashBits ];
+    memset( table, 0, sizeof( table ) );
+
+    out.clear();
+    out.reserve( in.size() + in.size() / 255 + 16 );
+    const unsigned char* src( in.empty()? 0 : &in[ 0 ] );
+    const unsigned n( ( unsigned )in.size() );
+    // as in LZ4, the last match starts 12 bytes before the end and the last 5 bytes are literals
+    const unsigned matchStart( n > 12 ? n - 12 : 0 ), matchEnd( n > 5 ? n - 5 : 0 );
+    unsigned ip( 0 ), anchor( 0 );
+    while ( ip < matchStart ) 
+    {
+      unsigned sequence( read32( src + ip ) ), h( ( sequence * 2654435761u ) >> ( 32 - hashBits ) );
+      unsigned ref( table[ h ] );
+      table[ h ] = ip + 1;
+      if ( !ref || ip + 1 - ref > 0xffff || read32( src + ref - 1 ) != sequence ) 
+      {
+        // skip faster through data that doesn't compress
+        ip += 1 + ( ( ip - anchor ) >> 6 );
+        continue;
+      }
+      ref--;
+      unsigned length( 4 );
+      while ( ip + length < matchEnd && src[ ref + length ] == src[ ip + length ] ) length++;
+      writeSequence( out, src + anchor, ip - anchor, ip - ref, length );
+      ip += length;
+      anchor = ip;
+    }
+    writeSequence( out, src + anchor, n - anchor, 0, 0 );
+  }
+
+  static bool decompress( const unsigned char* in, unsigned size, unsigned char* out, unsigned outSize )
+  {
+    const unsigned char* end( in + size );
+    unsigned op( 0 );
+    while ( in < end ) 
+    {
+      unsigned token( *in++ ), length( token >> 4 );
+      if ( !readLength( in, end, length ) || length > ( unsigned )( end - in ) || length > outSize - op ) return false;
+      memcpy( out + op, in, length );
+      in += length;
+      op += length;
+      if ( in == end ) break;
+
+      if ( end - in < 2 ) return false;
+      unsigned offset( in[ 0 ] | ( in[ 1 ] << 8 ) );
+      in += 2;
+      length = token & 0x0f;
+      if ( !readLength( in, end, length ) ) return false;
+      length += 4;
+      if ( !offset || offset > op || length > outSize - op ) return false;
+      // byte by byte: the match may overlap what it is copying
+      for ( unsigned i( 0 ); i < length; i++, op++ ) out[ op ] = out[ op - offset ];
+    }
+    return op == outSize;
+  }
+
+private:
+  static void pack( int encoding, unsigned channel, float value, unsigned char* sample )
+  {
+    int format( channel < 4 ? ( encoding & kFormatMask ) : kFloat );
+    if ( format == k8Bit || format == k16Bit ) 
+      value = value < 0.0f ? 0.0f : ( value > 1.0f ? 1.0f : value );
+    unsigned short s;
+    switch ( format ) 
+    {
+      case kHalf:
+        s = floatToHalf( value );
+        memcpy( sample, &s, 2 );
+        break;
+      case k16Bit:
+        s = ( unsigned short )( value * 65535.0f + 0.5f );
+        memcpy( sample, &s, 2 );
+        break;
+      case k8Bit:
+        sample[ 0 ] = ( unsigned char )( value * 255.0f + 0.5f );
+        break;
+      default:
+        memcpy( sample, &value, sizeof( float ) );
+    }
+  }
+
+  static float unpack( int encoding, unsigned channel, const unsigned char* sample )
+  {
+    int format( channel < 4 ? ( encoding & kFormatMask ) : kFloat );
+    unsigned short s;
+    float value;
+    switch ( format ) 
+    {
+      case kHalf:
+        memcpy( &s, sample, 2 );
+        return halfToFloat( s );
+      case k16Bit:
+        memcpy( &s, sample, 2 );
+        return s / 65535.0f;
+      case k8Bit:
+        return sample[ 0 ] / 255.0f;
+      default:
+        memcpy( &value, sample, sizeof( float ) );
+        return value;
+    }
+  }
+
+  static unsigned read32( const unsigned char* p )
+  {
+    unsigned v;
+    memcpy( &v, p, sizeof( v ) );
+    return v;
+  }
+
+  static void writeLength( std::vector< unsigned char >& out, unsigned length )
+  {
+    for ( ; length >= 255; length -= 255 ) out.push_back( 255 );
+    out.push_back( ( unsigned char )length );
+  }
+
+  static bool readLength( const unsigned char*& in, const unsigned char* end, unsigned& length )
+  {
+    if ( length != 15 ) return true;
+    unsigned char b;
+    do 
+    {
+      if ( in == end ) return false;
+      b = *in++;
+      length += b;
+    } 
+    while ( b == 255 );
+    return true;
+  }
+
+  static void writeSequence( std::vector< unsigned char >& out, const unsigned char* literals, unsigned literalLength, 
+                             unsigned offset, unsigned matchLength )
+  {
+    unsigned match( matchLength ? matchLength - 4 : 0 );
+    out.push_back( ( unsigned char )( ( ( literalLength < 15 ? literalLength : 15 ) << 4 ) | ( match < 15 ? match : 15 ) ) );
+    if ( literalLength >= 15 ) writeLength( out, literalLength - 15 );
+    out.insert( out.end(), literals, literals + literalLength );
+    if ( !matchLength ) return;
+    out.push_back( ( unsigned char )( offset & 0xff ) );
+    out.push_back( ( unsigned char )( offset >> 8 ) );
+    if ( match >= 15 ) writeLength( out, match - 15 );
+  }
+};
+
+#endif
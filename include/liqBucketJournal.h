@@ -0,0 +1,227 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Bucket journal: the buckets of a render view render, saved as they come
+** ______________________________________________________________________
+*/
+
+#if !defined(__LIQBUCKETJOURNAL_H__)
+#define __LIQBUCKETJOURNAL_H__
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+#include "liqBucket.h"
+#include "liqBucketCodec.h"
+
+/**
+ * An append only file of encoded buckets, flushed one by one so a render
+ * interrupted by a crash can be resumed. Bucket coordinates are in pixels
+ * of the whole image, rows from the top, so they survive a change of crop
+ * window. The header keeps the hash of the RIB the buckets came from.
+ */
+class liqBucketJournal
+{
+public:
+  enum { kMagic = 0x6c71626a, kVersion = 1, kHashSize = 32 };
+
+  liqBucketJournal() : m_file( NULL ), m_encoding( liqBucketCodec::kFloat ) {}
+  ~liqBucketJournal() { close(); }
+
+  /**
+   * Read a journal: the image it was made for, its hash and the areas that
+   * were done. A record cut short by a crash ends the journal.
+   */
+  static bool read( const char* file, imageInfo& info, std::string& hash, std::vector< bucket::bucketInfo >& areas )
+  {
+    FILE* fh( open( file, info, hash ) );
+    if ( !fh ) return false;
+    bucket::bucketInfo bi;
+    liqBucketCodec::payload payload;
+    std::vector< unsigned char > encoded;
+    while ( next( fh, info, bi, payload, encoded ) ) 
+      areas.push_back( bi );
+    fclose( fh );
+    return true;
+  }
+
+  /** Read a journal with the pixels of its buckets as well. */
+  static bool read( const char* file, imageInfo& info, std::string& hash, std::vector< bucket::bucketInfo >& areas, std::vector< bucket* >& buckets )
+  {
+    FILE* fh( open( file, info, hash ) );
+    if ( !fh ) return false;
+    std::vector< BUCKETDATATYPE > pixels;
+    std::vector< unsigned char > encoded, scratch;
+    bucket::bucketInfo bi;
+    liqBucketCodec::payload payload;
+    while ( next( fh, info, bi, payload, encoded ) ) 
+    {
+      const unsigned count( ( bi.right - bi.left ) * ( bi.top - bi.bottom ) );
+      pixels.resize( count * bi.channels );
+      if ( !liqBucketCodec::decode( payload, count, bi.channels, encoded.empty() ? NULL : &encoded[ 0 ], &pixels[ 0 ], scratch ) ) break;
+      bucket* b( new bucket );
+      if ( b->set( bi, &pixels[ 0 ] ) ) 
+      {
+        delete b;
+        break;
+      }
+      buckets.push_back( b );
+      areas.push_back( bi );
+    }
+    fclose( fh );
+    return true;
+  }
+
+  /** Which pixels of a width x height image the areas cover, rows from the top. */
+  static void coverage( const std::vector< bucket::bucketInfo >& areas, const int width, const int height, std::vector< unsigned char >& mask )
+  {
+    mask.assign( ( size_t )width * height, 0 );
+    for ( unsigned i( 0 ); i < areas.size(); i++ ) 
+      for ( unsigned y( areas[ i ].bottom ); y < areas[ i ].top && y < ( unsigned )height; y++ ) 
+        for ( unsigned x( areas[ i ].left ); x < areas[ i ].right && x < ( unsigned )width; x++ ) 
+          mask[ ( size_t )y * width + x ] = 1;
+  }
+
+  /**
+   * Start a journal for an image. The buckets kept from a previous journal
+   * go first: the new one replaces it in one rename, so a display driver
+   * reading it meanwhile sees either of them whole.
+   */
+  bool create( const char* file, const std::string& hash, const imageInfo& info, const int encoding, const std::vector< bucket* >& kept )
+  {
+    close();
+    m_name = file;
+    const std::string written( kept.empty() ? m_name : m_name + ".new" );
+    m_file = fopen( written.c_str(), "wb" );
+    if ( !m_file ) return false;
+    header h;
+    memset( &h, 0, sizeof( h ) );
+    h.magic   = kMagic;
+    h.version = kVersion;
+    strncpy( h.hash, hash.c_str(), kHashSize - 1 );
+    h.info    = info;
+    h.info.encoding = m_encoding = liqBucketCodec::accept( encoding );
+    bool ok( fwrite( &h, sizeof( h ), 1, m_file ) == 1 );
+    for ( unsigned i( 0 ); ok && i < kept.size(); i++ ) 
+      ok = append( kept[ i ]->getInfo(), kept[ i ]->getPixels() );
+    if ( ok && !kept.empty() ) 
+    {
+      fclose( m_file );
+#ifdef _WIN32
+      ::remove( m_name.c_str() );
+#endif
+      ok = !rename( written.c_str(), m_name.c_str() );
+      m_file = ok ? fopen( m_name.c_str(), "ab" ) : NULL;
+      ok = ok && m_file;
+    }
+    if ( !ok ) close();
+    return ok;
+  }
+
+  bool isOpen() const { return m_file != NULL; }
+
+  /** Save a bucket, in pixels of the whole image. */
+  bool append( const bucket::bucketInfo& info, const BUCKETDATATYPE* data )
+  {
+    if ( !m_file ) return false;
+    liqBucketCodec::payload payload;
+    liqBucketCodec::encode( m_encoding, ( info.right - info.left ) * ( info.top - info.bottom ), info.channels, data, m_encoded, payload, m_scratch );
+    const bool ok( fwrite( &info, sizeof( info ), 1, m_file ) == 1 && fwrite( &payload, sizeof( payload ), 1, m_file ) == 1 && 
+                   ( !payload.size || fwrite( &m_encoded[ 0 ], payload.size, 1, m_file ) == 1 ) );
+    // a crash of maya must not lose what was already received
+    return !fflush( m_file ) && ok;
+  }
+
+  void close()
+  {
+    if ( m_file ) fclose( m_file );
+    m_file = NULL;
+  }
+
+  /** The render is complete, there is nothing left to resume. */
+  void remove()
+  {
+    close();
+    if ( !m_name.empty() ) ::remove( m_name.c_str() );
+    m_name.clear();
+  }
+
+private:
+  // the display drivers only read areas: they do not link liqBucket.cpp
+  static FILE* open( const char* file, imageInfo& info, std::string& hash )
+  {
+    FILE* fh( fopen( file, "rb" ) );
+    if ( !fh ) return NULL;
+    header h;
+    if ( fread( &h, sizeof( h ), 1, fh ) != 1 || h.magic != kMagic || h.version != kVersion || 
+         h.info.wo <= 0 || h.info.ho <= 0 || h.info.channels <= 0 ) 
+    {
+      fclose( fh );
+      return NULL;
+    }
+    h.hash[ kHashSize - 1 ] = 0;
+    info = h.info;
+    hash = h.hash;
+    return fh;
+  }
+
+  static bool next( FILE* fh, const imageInfo& info, bucket::bucketInfo& bi, liqBucketCodec::payload& payload, std::vector< unsigned char >& encoded )
+  {
+    if ( fread( &bi, sizeof( bi ), 1, fh ) != 1 || fread( &payload, sizeof( payload ), 1, fh ) != 1 ) return false;
+    if ( bi.channels != ( unsigned )info.channels || bi.left >= bi.right || bi.bottom >= bi.top || 
+         bi.right > ( unsigned )info.wo || bi.top > ( unsigned )info.ho ) 
+      return false;
+    const unsigned size( ( bi.right - bi.left ) * ( bi.top - bi.bottom ) * bi.channels * sizeof( BUCKETDATATYPE ) );
+    if ( payload.size > size + size / 255 + 16 ) return false;
+    encoded.resize( payload.size );
+    return !payload.size || fread( &encoded[ 0 ], payload.size, 1, fh ) == 1;
+  }
+
+  struct header
+  {
+    unsigned int magic;
+    unsigned int version;
+    char         hash[ kHashSize ];
+    imageInfo    info;
+  };
+
+  FILE*                         m_file;
+  std::string                   m_name;
+  int                           m_encoding;
+  std::vector< unsigned char >  m_encoded;
+  std::vector< unsigned char >  m_scratch;
+
+  liqBucketJournal( const liqBucketJournal& );
+  liqBucketJournal& operator=( const liqBucketJournal& );
+};
+
+#endif
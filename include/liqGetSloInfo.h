@@ -119,6 +119,10 @@ public:
 
 	MStatus	    doIt(const MArgList& args );
 private:
+  void          setParams( const MStringArray &names, const MStringArray &details, const MStringArray &types,
+                           const MStringArray &defaults, const MStringArray &accept, const MIntArray &outputs,
+                           const MIntArray &arraySizes );
+
   unsigned numParam;
   SHADER_TYPE shaderType;
   MString shaderName;
@@ -126,6 +126,9 @@ class liqGlobalsNode : public MPxNode
     static MObject aPreframeMel;
     static MObject aPostframeMel;
     static MObject aUseRenderScript;
+    static MObject aRenderTiles;
+    static MObject aRenderSlots;
+    static MObject aRenderThreads;
     static MObject aRemoteRender;
     static MObject aNetRManRender;
     static MObject aMinCPU;
@@ -260,6 +263,10 @@ class liqGlobalsNode : public MPxNode
     static MObject aRenderViewLocal;
     static MObject aRenderViewPort;
     static MObject aRenderViewTimeOut;
+    static MObject aRenderViewEncoding;
+    static MObject aRenderViewAOVs;
+    static MObject aRenderViewStatsFile;
+    static MObject aRenderViewResume;
 
     static MObject aUseRayTracing;
     static MObject aTraceBreadthFactor;
@@ -285,6 +292,12 @@ class liqGlobalsNode : public MPxNode
     static MObject aPhotonEstimator;
 
     static MObject aUseMtorSubdiv;
+    static MObject aParticleChunkSize;
+    static MObject aUseInstancerObjects;
+    static MObject aInstanceDagObjects;
+    static MObject aPfxChunkSize;
+    static MObject aPfxDelayedArchives;
+    static MObject aShareMaterials;
     static MObject aRenderCmdFlags;
 
     static MObject aShaderInfo;
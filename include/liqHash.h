@@ -0,0 +1,89 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqHash_H
+#define liqHash_H
+
+/* ______________________________________________________________________
+**
+** Liquid Hash Header File
+** ______________________________________________________________________
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <string>
+
+#include <maya/MString.h>
+
+using namespace std;
+
+/**
+ * 64 bit FNV-1a hash, used to name things by their content.
+ */
+class liqHash
+{
+public:
+  liqHash() : m_hash( 14695981039346656037ULL ) {}
+
+  void add( const void* data, size_t size )
+  {
+    const unsigned char* p( ( const unsigned char* )data );
+    for ( size_t i( 0 ); i < size; i++ ) 
+    {
+      m_hash ^= p[ i ];
+      m_hash *= 1099511628211ULL;
+    }
+  }
+  void add( const string& s ) { add( s.c_str(), s.length() + 1 ); }
+  void add( float f )         { add( &f, sizeof( float ) ); }
+  void add( int i )           { add( &i, sizeof( int ) ); }
+
+  // a file is known by its name, date and size
+  void addFile( const string& file )
+  {
+    add( file );
+    struct stat sbuf;
+    if ( file.empty() || stat( file.c_str(), &sbuf ) ) return;
+    add( ( int )sbuf.st_mtime );
+    add( ( int )sbuf.st_size );
+  }
+
+  MString str() const
+  {
+    char buf[ 17 ];
+    sprintf( buf, "%08x%08x", ( unsigned )( m_hash >> 32 ), ( unsigned )( m_hash & 0xffffffff ) );
+    return MString( buf );
+  }
+
+private:
+  unsigned long long m_hash;
+};
+
+#endif // liqHash_H
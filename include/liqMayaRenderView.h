@@ -39,11 +39,20 @@
 #include <maya/MPxCommand.h>
 #include <maya/MSyntax.h>
 #include <maya/MObject.h>
+#include <maya/MRenderView.h>
+#include <maya/MMessage.h>
 #include "liqBucket.h"
+#include "liqRenderStats.h"
+#include "liqBucketJournal.h"
+#include "liqProcessLauncher.h"
 #include <vector>
 #include <deque>
+#include <string>
+#include "liqThread.h"
 using namespace std;
 
+class liqSharedFramebuffer;
+
 class liqMayaRenderCmd : public MPxCommand
 {
 
@@ -58,17 +67,61 @@ public:
 	static MSyntax newSyntax();
 	static		void* creator();
 	static std::deque<string> m_lastBucketFiles;
+	static std::deque<string> m_lastBucketImages;
+	static liqRenderStats m_lastStats;
+	static string m_lastStatsImage;
+	static vector<liqProcessLauncher::process> m_nextRenders; // started for the next render, the ones it stops when interrupted
+	static void stopRender();     // stop the render being shown and wait for its receiver
 
 private:
+	/** One display driver connection: an image, or a set of AOVs, of the render. */
+	struct connection
+	{
+		connection() : socket( -1 ), framebuffer( NULL ), done( false ), displayed( false ) {}
+		~connection();
+		void merge( connection &piece );
+
+		int socket;
+		imageInfo info;
+		liqSharedFramebuffer *framebuffer;
+		vector<bucket*> buckets;
+		bool done;
+		bool displayed;   // staged: the image selected with -image, or a piece of it
+	};
+
+	liqMayaRenderCmd* liveCopy() const;
+	MStatus start();
+	void stop();
+	void finish();
+	static void refresh( float elapsedTime, float lastTime, void *cmd );
+	static void* receive( void *cmd );
+	void receiveConnections();
+	void receiverError( const string &message );
+	void setStaging( const imageInfo &info );
+	connection* loadCheckpoint();
+	void startCheckpoint( const connection &shown );
+	void checkpoint( const connection &c, const bucket *b );
+	bool isComplete( const imageInfo &info ) const;
+	void flush();
+	connection* acceptConnection( const int socket );
+	static int waitConnections( const int socket, const vector<connection*> &connections, const int milliseconds );
+	bool stopped();
+	bool waitData( const int socket );
+	bool readData( const int socket, char *data, int size );
+	bool isSelected( const connection &c ) const;
+	static bool isSameImage( const imageInfo &a, const imageInfo &b );
 	MStatus renderBucket(const bucket* b, const imageInfo &info);
-	MStatus getBucket(const int socket,const unsigned int numChannels,bucket* b,bool &theEnd);
+	MStatus renderBucket(const bucket::bucketInfo &binfo, const BUCKETDATATYPE *data, const unsigned int stride, const imageInfo &info);
+	MStatus getSharedBuckets(connection &c, const bool render, bool &received);
+	MStatus getBucket(const int socket,const unsigned int numChannels,const int encoding,bucket* b,bool &theEnd);
 	MStatus writeBuckets(const char* file, const vector<bucket*> &buckets,const imageInfo &info) const;
-	MStatus readBuckets(const char* file,vector<bucket*> &buckets, imageInfo &info) const;
+	MStatus renderCache(const char* file);
 
 	int createSocket(const char *hostname,const unsigned int port);
 
 	MString m_camera;
 	MString m_bucketFile;
+	MString m_image;
 	bool m_bRenderFromFile;
 	bool m_bLocalhost;
 	bool m_bGetRenderRegion;
@@ -76,6 +129,42 @@ private:
 	unsigned int m_port;
 	double m_quantize[4];
 	unsigned int m_timeout;
+	unsigned int m_refreshRate;
+	unsigned int m_connectionCount; // the displayed image comes in that many crop windows
+	int m_cacheEncoding;          // liqBucketCodec encoding of the bucket cache files
+	MString m_statsFile;          // CSV trace the render stats are appended to
+	MString m_checkpoint;         // journal of the displayed image, to resume an interrupted render
+	MString m_checkpointHash;     // hash of the RIB the journal belongs to
+
+	// maya deletes the command once it returns: the render goes on in a copy,
+	// shown by a timer callback until its receiving thread is done
+	static liqMayaRenderCmd *m_liveRender;
+	liqThread m_receiver;
+	MCallbackId m_timer;
+
+	// shared by maya's main thread and the receiving thread
+	liqMutex m_mutex;             // guards the staging framebuffer, m_shown and the flags
+	int m_socket;
+	vector<connection*> m_connections;   // receiving thread, grown under m_mutex for stop()
+	vector<BUCKETDATATYPE> m_bucketData; // receiving thread buffers, reused from bucket to bucket
+	vector<unsigned char> m_encoded, m_decodeScratch;
+	connection *m_shown;
+	vector<RV_PIXEL> m_staging;   // the displayed image, rows bottom up as in maya
+	unsigned int m_stagingWidth, m_stagingHeight;
+	unsigned int m_region[4];     // what changed since the last flush: xmin, xmax, ymin, ymax
+	bool m_dirty;
+	bool m_started;
+	bool m_stop;
+	bool m_receiverDone;
+	vector<string> m_errors;
+	vector<RV_PIXEL> m_flushed;
+	liqRenderStats m_stats;       // receiving thread only, until it is joined: the buckets
+	liqRenderStats m_updateStats; // maya's main thread: the render view updates, added to m_stats once it is joined
+	liqBucketJournal m_journal;   // receiving thread only, until it is joined
+	connection *m_resumed;        // the buckets of the checkpoint, until the displayed image shows up
+	bool m_resuming;
+	vector<bucket::bucketInfo> m_journaled; // what the journal holds, in pixels of the whole image
+	vector<liqProcessLauncher::process> m_renders; // the renders that draw this image
 
 };
 
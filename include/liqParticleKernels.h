@@ -0,0 +1,87 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the
+** "License"); you may not use this file except in compliance with the License. You may
+** obtain a copy of the License at http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific
+** language governing rights and limitations under the License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions created by
+** Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqParticleKernels_H
+#define liqParticleKernels_H
+
+/* ______________________________________________________________________
+**
+** Liquid Particle Kernels Header File
+**
+** Columnar (structure of arrays) particle storage and the loops that turn
+** it into the interleaved arrays RiPoints/RiCurves/RiBlobby expect.
+** Uses SSE when the compiler targets it, plain loops otherwise.
+** ______________________________________________________________________
+*/
+
+#include <vector>
+
+using namespace std;
+
+// Three float columns, one per vector component
+struct liqVectorColumn {
+  vector< float > x;
+  vector< float > y;
+  vector< float > z;
+
+  void     resize( unsigned n ) { x.resize( n ); y.resize( n ); z.resize( n ); }
+  void     clear() { x.clear(); y.clear(); z.clear(); }
+  unsigned size() const { return x.size(); }
+  bool     empty() const { return x.empty(); }
+};
+
+// dst[ i ] = src[ index[ i ] ]
+void liqGatherColumn( const float *src, const int *index, unsigned n, float *dst );
+void liqGatherColumn( vector< float > &column, const vector< int > &index );
+void liqGatherColumn( liqVectorColumn &column, const vector< int > &index );
+
+// xyz[ 3 * i ] = x[ i ], xyz[ 3 * i + 1 ] = y[ i ], xyz[ 3 * i + 2 ] = z[ i ]
+void liqInterleave3( const float *x, const float *y, const float *z, unsigned n, float *xyz );
+
+// Repeat every value multi times, scaled: dst[ i * multi + k ] = src[ i ] * scale
+void liqExpandColumn( const float *src, unsigned n, unsigned multi, float scale, float *dst );
+
+// Same as liqExpandColumn, for a vector column into an interleaved array
+void liqExpandInterleave3( const float *x, const float *y, const float *z, unsigned n, unsigned multi, float *xyz );
+
+// Multi-point positions: multi points per particle, jittered in a sphere of
+// radius multiRadius / 2 seeded by the particle id (so they don't jump when
+// other particles die). With multi == 1 the points are copied as is.
+void liqJitterPoints( const float *x, const float *y, const float *z, const int *ids,
+                      unsigned n, unsigned multi, float multiRadius, float *xyz );
+
+// Streak (multi-streak) positions: multi tail/head pairs per particle, the
+// tail is pulled back along the velocity by tailScale.
+void liqStreakPoints( const float *x, const float *y, const float *z,
+                      const float *vx, const float *vy, const float *vz, const int *ids,
+                      unsigned n, unsigned multi, float multiRadius, float tailScale, float *xyz );
+
+// RiBlobby ellipsoid matrices: 16 floats per particle, scaled by 2 * radius.
+// radius may be NULL, in which case constantRadius is used.
+void liqBlobbyEllipsoids( const float *x, const float *y, const float *z, const float *radius,
+                          float constantRadius, unsigned n, float *floats );
+
+#endif
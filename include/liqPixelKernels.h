@@ -0,0 +1,45 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the
+** "License"); you may not use this file except in compliance with the License. You may
+** obtain a copy of the License at http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific
+** language governing rights and limitations under the License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions created by
+** Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqPixelKernels_H
+#define liqPixelKernels_H
+
+/* ______________________________________________________________________
+**
+** Liquid Pixel Kernels Header File
+**
+** The loops turning display driver buckets into Maya render view pixels.
+** Uses SSE when the compiler targets it, plain loops otherwise.
+** ______________________________________________________________________
+*/
+
+// Quantize n pixels of channels floats into rgba floats (Maya's RV_PIXEL):
+// rgba = clamp( int( zero + v * ( one - zero ) + dither ), min, max ), with
+// quantize = { zero, one, min, max }. Alpha is only written when there are more
+// than 3 channels, 1 or 2 channel images are shown grey.
+void liqQuantizePixels( const float *src, unsigned n, unsigned channels, const float quantize[ 4 ], float dither, float *rgba );
+
+#endif
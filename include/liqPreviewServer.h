@@ -0,0 +1,130 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqPreviewServer_H
+#define liqPreviewServer_H
+
+/* ______________________________________________________________________
+**
+** Liquid Preview Server Header File
+** ______________________________________________________________________
+*/
+
+#include <liqPreviewShader.h>
+
+#include <maya/MImage.h>
+
+#include <ctime>
+#include <string>
+#include <deque>
+#include <map>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <pthread.h>
+#endif
+
+using namespace std;
+
+/**
+ * Keeps a renderer running for shader swatches.
+ * The renderer reads its RIB from a FIFO that stays open, so every request
+ * is a new frame in the same stream. It renders to the liqmaya display
+ * driver, whose buckets come back on a local socket and are kept in memory
+ * for the swatch node. Requests wait in a queue and a new request for a node
+ * replaces the one already queued for it. A frame that doesn't come back
+ * within kFrameTimeout seconds fails and restarts the renderer, and only
+ * the last kMaxImages images are kept.
+ * Everything but the receiving thread runs in Maya's main thread.
+ * Not available on Windows, where submit() always fails.
+ */
+class liqPreviewServer
+{
+public:
+  enum Status 
+  {
+    kUnknown,   // never submitted
+    kPending,   // queued or rendering
+    kDone,
+    kFailed
+  };
+
+  enum { kFrameTimeout = 60, kMaxImages = 64 };
+
+  static liqPreviewServer& instance();
+
+  bool   submit( const liqPreviewShaderOptions& options );
+  Status fetch( const string& node, MImage& image );
+  void   forget( const string& node );
+  void   pump();
+  void   stop();
+
+private:
+  liqPreviewServer();
+  ~liqPreviewServer();
+
+  struct liqPreviewImage
+  {
+    int width, height, channels;
+    vector< float > pixels;
+    bool failed;
+  };
+
+  bool isQueued( const string& node ) const;
+  void store( const string& node, const liqPreviewImage& image );
+  void finish( const string& node, const liqPreviewImage& image );
+
+#ifndef _WIN32
+  bool startRenderer( const string& renderCommand );
+  void stopRenderer();
+  bool startReceiver();
+  bool receiveImage( int socket, liqPreviewImage& image );
+  static void* receive( void* server );
+  bool isRunning();
+  void setRunning( bool running );
+
+  pid_t           m_renderer;
+  string          m_renderCommand;
+  string          m_fifoName;
+  int             m_fifo;     // kept open so the renderer never reads an EOF
+  int             m_listen;
+  int             m_port;
+  bool            m_running;
+  pthread_t       m_thread;
+  pthread_mutex_t m_mutex;    // guards m_running, m_current, m_images and m_stored
+#endif
+
+  deque< liqPreviewShaderOptions > m_queue;
+  string                           m_current;  // node being rendered
+  time_t                           m_sent;     // when its frame went to the renderer, 0 once it connected
+  map< string, liqPreviewImage >   m_images;
+  deque< string >                  m_stored;   // the nodes of m_images, oldest first
+};
+
+#endif // liqPreviewServer_H
@@ -40,6 +40,10 @@
 #include <maya/MIntArray.h>
 #include <maya/MSyntax.h>
 
+#include <string>
+
+using namespace std;
+
 enum PrimitiveType {
   SPHERE       = 0,
   CYLINDER     = 1,
@@ -50,6 +54,30 @@ enum PrimitiveType {
   CUSTOM       = 6
 };
 
+typedef struct liqPreviewShaderOptions
+{
+  string  shaderNodeName;
+  string  displayDriver;
+  string  displayName;
+  string  renderCommand;
+  string  backPlaneShader;
+  bool    shortShaderName, backPlane, usePipe;
+  int     displaySize;
+  int     primitiveType;
+  float   pixelSamples;
+  float   objectScale;
+  float   shadingRate;
+  string  customRibFile;
+  bool    fullShaderPath;
+  string  type;
+  float   previewIntensity;
+  string  customBackplane;
+  bool    cleanRibs;
+  int     displayPort;      // liqmaya display port, 0 for none
+} liqPreviewShaderOptions;
+
+int liquidOutputPreviewShader( const string& fileName, const liqPreviewShaderOptions& options );
+
 class liqPreviewShader : public MPxCommand {
 public:
   liqPreviewShader() {};
@@ -19,8 +19,10 @@
 #ifndef liqProcessLauncher_H_
 #define liqProcessLauncher_H_
 
+#include <vector>
 
 class MString;
+class MStringArray;
 
 
 // class for spawning new processes from within Liquid (e.g. start the render 
@@ -29,7 +31,29 @@ class MString;
 class liqProcessLauncher
 {
 public:
+  // run command in path: when waiting, true if it exited with 0, otherwise if it started
   static bool execute(const MString &command, const MString &arguments, const MString &path, const bool wait );
+  // run command once per argument list, all at the same time, and return when they are all done
+  static bool executeAll(const MString &command, const MStringArray &arguments, const MString &path );
+
+  // a child process started without waiting for it, 0 if it couldn't be started.
+  // Nobody waits for a detached one, it is forgotten once it ended.
+#ifdef _WIN32
+  typedef void* process;
+#else
+  typedef int process;
+#endif
+  static process start(const MString &command, const MString &arguments, const MString &path, const bool detached = false );
+  // wait up to timeout milliseconds, for ever if negative, for the first of processes to end:
+  // its index, or -1 if none did, and its exit code in status
+  static int waitAny(const std::vector< process > &processes, int &status, int timeout = -1 );
+
+  // show what the processes printed since the last call, from maya's main thread only
+  static void flush();
+  // stop the processes that are still running, and their children
+  static void cancel(const std::vector< process > &processes );
+  // stop every process started here that is still running, and their children
+  static void cancel();
 };
 
 
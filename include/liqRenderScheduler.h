@@ -0,0 +1,74 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the 
+** "License"); you may not use this file except in compliance with the License. You may 
+** obtain a copy of the License at http://www.mozilla.org/MPL/ 
+** 
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT 
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific 
+** language governing rights and limitations under the License. 
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+#ifndef liqRenderScheduler_H
+#define liqRenderScheduler_H
+
+/* ______________________________________________________________________
+**
+** Liquid Render Scheduler Header File
+**
+** The texture, shadow and hero jobs of a direct local render, started as
+** soon as the jobs they depend on are done, a few at a time.
+** ______________________________________________________________________
+*/
+
+#include <maya/MString.h>
+#include <vector>
+
+#include <liqProcessLauncher.h>
+
+using namespace std;
+
+class liqRenderScheduler
+{
+public:
+  liqRenderScheduler( const MString &path, int slots );
+
+  // How many jobs run at once: slots when set, otherwise the cores divided by
+  // the threads each render uses, one if the renderer takes them all
+  static int slots( int slots, int threads );
+  static int cores();
+
+  // A job to run in path once the jobs in after have ended: its index
+  int add( const MString &name, const MString &command, const MString &arguments, const vector< int > &after = vector< int >() );
+
+  // Run every job and report its wall time. False if one couldn't be started
+  // or failed, the jobs depending on it are then skipped. Escape stops them all.
+  bool run();
+
+private:
+  enum jobState { kWaiting, kRunning, kDone, kFailed, kSkipped };
+  struct job {
+    MString       name;
+    MString       command;
+    MString       arguments;
+    vector< int > after;
+    jobState      state;
+    double        begin;
+  };
+
+  bool isReady( const job &j ) const;
+  bool isBlocked( const job &j ) const;
+  bool end( int i, int status );
+
+  MString         m_path;
+  int             m_slots;
+  vector< job >   m_jobs;
+};
+
+#endif // liqRenderScheduler_H
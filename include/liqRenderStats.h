@@ -0,0 +1,166 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Render view transport statistics, for the liqmaya display drivers and
+** liquidRenderView
+** ______________________________________________________________________
+*/
+
+#if !defined(__LIQRENDERSTATS_H__)
+#define __LIQRENDERSTATS_H__
+
+#include <string>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+/**
+ * What one side of a render view connection measured. The driver's time to
+ * first bucket is the renderer's, its wait is the time the receiver or the
+ * network kept it blocked; the receiver adds the time maya spent showing
+ * the buckets. Both sides append the same CSV columns to one trace.
+ */
+struct liqRenderStats
+{
+  double        begin;        // now() when the image was opened
+  double        seconds;      // open to close
+  double        firstBucket;  // open to the first bucket
+  double        lastBucket;   // open to the last bucket
+  unsigned      buckets;
+  double        bytes;        // as they went through the transport
+  double        wait;         // blocked on the socket or the shared framebuffer
+  double        codec;        // encoding, or decoding and quantizing
+  unsigned      updates;      // render view updates
+  double        update;       // spent in them
+
+  liqRenderStats() { reset(); }
+
+  void reset()
+  {
+    begin = now();
+    seconds = firstBucket = lastBucket = bytes = wait = codec = update = 0;
+    buckets = updates = 0;
+  }
+
+  /** Seconds, with a better resolution than clock() on every platform. */
+  static double now()
+  {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency( &frequency );
+    QueryPerformanceCounter( &counter );
+    return ( double )counter.QuadPart / ( double )frequency.QuadPart;
+#else
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+#endif
+  }
+
+  void addBucket( const double size, const double waited, const double coded )
+  {
+    lastBucket = now() - begin;
+    if ( !buckets ) firstBucket = lastBucket;
+    buckets++;
+    bytes += size;
+    wait += waited;
+    codec += coded;
+  }
+
+  void addUpdate( const double seconds )
+  {
+    updates++;
+    update += seconds;
+  }
+
+  void finish() { seconds = now() - begin; }
+
+  /** Buckets and bytes per second while the buckets were coming. */
+  double streaming() const
+  {
+    const double span( lastBucket - firstBucket );
+    return span > 0 && buckets > 1 ? span : seconds;
+  }
+  double bucketsPerSecond() const { return streaming() > 0 ? buckets / streaming() : 0; }
+  double bytesPerSecond() const { return streaming() > 0 ? bytes / streaming() : 0; }
+  double waitPerBucket() const { return buckets ? wait / buckets : 0; }
+  double codecPerBucket() const { return buckets ? codec / buckets : 0; }
+
+  static const char* columns()
+  {
+    return "source,image,seconds,firstBucket,buckets,bytes,bucketsPerSecond,bytesPerSecond,waitPerBucket,codecPerBucket,updates,updateSeconds";
+  }
+
+  std::string csv( const char *source, const char *image ) const
+  {
+    char line[ 512 ];
+    sprintf( line, "%s,\"%.256s\",%.6f,%.6f,%u,%.0f,%.2f,%.0f,%.6f,%.6f,%u,%.6f", 
+             source, image ? image : "", seconds, firstBucket, buckets, bytes, 
+             bucketsPerSecond(), bytesPerSecond(), waitPerBucket(), codecPerBucket(), updates, update );
+    return line;
+  }
+
+  std::string json( const char *source, const char *image ) const
+  {
+    std::string name;
+    for ( const char *c( image ? image : "" ); *c; c++ ) 
+    {
+      if ( *c == '"' || *c == '\\' ) name += '\\';
+      name += *c;
+    }
+    char fields[ 512 ];
+    sprintf( fields, "\"seconds\":%.6f,\"firstBucket\":%.6f,\"buckets\":%u,\"bytes\":%.0f,\"bucketsPerSecond\":%.2f,"
+                     "\"bytesPerSecond\":%.0f,\"waitPerBucket\":%.6f,\"codecPerBucket\":%.6f,\"updates\":%u,\"updateSeconds\":%.6f}", 
+             seconds, firstBucket, buckets, bytes, bucketsPerSecond(), bytesPerSecond(), 
+             waitPerBucket(), codecPerBucket(), updates, update );
+    return std::string( "{\"source\":\"" ) + source + "\",\"image\":\"" + name + "\"," + fields;
+  }
+
+  /** One CSV line per image, the columns go first in a new trace. */
+  bool append( const char *file, const char *source, const char *image ) const
+  {
+    if ( !file || !*file ) return false;
+    FILE *trace( fopen( file, "a" ) );
+    if ( !trace ) return false;
+    fseek( trace, 0, SEEK_END );
+    std::string text( ftell( trace ) > 0 ? "" : std::string( columns() ) + "\n" );
+    text += csv( source, image ) + "\n";
+    // a single write: tiles of a split frame share the trace
+    const bool written( fwrite( text.c_str(), 1, text.size(), trace ) == text.size() );
+    fclose( trace );
+    return written;
+  }
+};
+
+#endif
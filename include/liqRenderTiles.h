@@ -0,0 +1,66 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the 
+** "License"); you may not use this file except in compliance with the License. You may 
+** obtain a copy of the License at http://www.mozilla.org/MPL/ 
+** 
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT 
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific 
+** language governing rights and limitations under the License. 
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqRenderTiles_H
+#define liqRenderTiles_H
+
+/* ______________________________________________________________________
+**
+** Liquid Render Tiles Header File
+**
+** A frame split in crop windows rendered by several local renderer
+** processes, and the merge of their images once they are all done.
+** ______________________________________________________________________
+*/
+
+#include <maya/MString.h>
+#include <vector>
+
+using namespace std;
+
+// One crop window of a split frame
+struct liqRenderTile {
+  // pixels, rows counted from the top as RenderMan does, right and top excluded
+  int     left, right, bottom, top;
+  // the CropWindow ( xmin, xmax, ymin, ymax ) that renders exactly these pixels
+  double  crop[ 4 ];
+  MString ribName;
+};
+
+class liqRenderTiles
+{
+public:
+  // Cut the crop window of a width x height frame in count tiles, as square as possible
+  static vector< liqRenderTile > split( int width, int height, int count, const double crop[ 4 ] );
+
+  // The pixels ( left, right, bottom, top ) a CropWindow renders, and back
+  static void cropPixels( const double crop[ 4 ], int width, int height, int pixels[ 4 ] );
+  static void cropWindow( const int pixels[ 4 ], int width, int height, double crop[ 4 ] );
+
+  // file.tif -> file.tile3.tif
+  static MString tileName( const MString &file, unsigned tile );
+
+  // Whether merge() gives back a display's pixels as the renderer wrote them:
+  // rgb or rgba OpenEXR, MImage would turn anything else into 8 bit rgba
+  static bool isMergeable( const MString &type, const MString &mode );
+
+  // Paste the tile images of image, an exr, in a width x height image and remove them
+  static bool merge( const MString &image, const vector< liqRenderTile > &tiles, int width, int height, MString &error );
+};
+
+#endif // liqRenderTiles_H
@@ -0,0 +1,74 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqRibCurveBatch_H
+#define liqRibCurveBatch_H
+
+/* ______________________________________________________________________
+**
+** Liquid Rib Curve Batch Header File
+**
+** Paint Effects curves are converted and written a batch of lines at a
+** time. A batch is either kept until the RIB is written, or written right
+** away to its own archive and referenced with a DelayedReadArchive.
+** ______________________________________________________________________
+*/
+
+extern "C" {
+#include <ri.h>
+}
+
+#include <vector>
+
+#include <maya/MString.h>
+
+#include <liqTokenPointer.h>
+
+using namespace std;
+
+struct liqCurveBatch {
+  vector< RtInt >        nverts;
+  liqTokenPointer::array tokens;
+  MString                archive;   // set once the batch went to its own archive
+  RtBound                bound;
+};
+
+// Lines per batch (liquidGlobals.pfxChunkSize), 0 for a single batch
+unsigned liqCurveBatchSize( unsigned numLines );
+
+// Write the batch to its own RIB archive, compute its bound and free its
+// parameters. extraTokens are written with every batch. The archive is named
+// after the scene and the node's full DAG path, so that no other node or scene
+// sharing the RIB directory writes over it.
+void liqArchiveCurveBatch( liqCurveBatch &batch, RtToken degree, const liqTokenPointer::array &extraTokens,
+                           const MString &nodePath, unsigned batchNumber );
+
+// RiCurves call, or the DelayedReadArchive of an archived batch
+void liqWriteCurveBatch( const liqCurveBatch &batch, RtToken degree, const liqTokenPointer::array &extraTokens );
+
+#endif
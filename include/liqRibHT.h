@@ -75,6 +75,11 @@ public:
                           MMatrix *matrix = NULL,
                           const MString instanceStr = "",
                           int particleId = -1 );
+    // Particle instancer item: adds the instance to the prototype's
+    // instance list, the prototype node is only created once per instancer.
+    // False when the prototype can't be instanced, the item needs insert()
+    bool          insertInstance( MDagPath &path, const MDagPath &instancerPath, int instancerId,
+                                  int sample, bool useSamples, int CountID, int particleId, const MMatrix &matrix );
 	/*RibNode*	    find( const MObject &, ObjectType objType );*/
 	liqRibNodePtr find( MString nodeName, MDagPath  path, ObjectType objType);
 
@@ -82,6 +87,9 @@ private:
 	str_Vector RibHashVec;
 	type_Vector objTypeVec;
 	RNMAP	RibNodeMap;
+	map< string, liqRibNodePtr > InstancerMap; // prototype nodes of the particle instancers
+	liqRibNodePtr insertNode( MDagPath &, int, ObjectType objType, int CountID,
+	                          MMatrix *matrix, const MString instanceStr, int particleId );
 	ulong	hash( const char*, int ID );
 	friend class liqRibTranslator;
 };
@@ -0,0 +1,92 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqRibInstancer_H
+#define liqRibInstancer_H
+
+/* ______________________________________________________________________
+**
+** Liquid Rib Instancer Header File
+**
+** Compact list of the particle instances of one prototype. The prototype
+** is written once in an ObjectBegin block, the instances are only a
+** transform (per motion sample), a particle id and an optional color.
+** ______________________________________________________________________
+*/
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <maya/MMatrix.h>
+#include <maya/MDagPath.h>
+
+extern "C" {
+#include <ri.h>
+}
+
+using namespace std;
+using namespace boost;
+
+class liqRibInstancer;
+typedef boost::shared_ptr< liqRibInstancer > liqRibInstancerPtr;
+
+class liqRibInstancer {
+public:
+  liqRibInstancer( const MDagPath &instancerPath, bool useParticleColor );
+
+  // Record the instance of particleId at a motion sample. Instances are
+  // written for the particles present at sample 0.
+  void     add( int sample, int particleId, const MMatrix &matrix );
+
+  unsigned size() const;
+
+  // Write an ObjectInstance of handle for every particle. With
+  // transformation blur every instance gets its own motion block.
+  void     write( RtObjectHandle handle, bool motion ) const;
+
+private:
+  struct instanceSample {
+    vector< int >     ids;
+    vector< RtFloat > matrices;   // 16 floats per instance
+  };
+
+  void readParticleColors();
+
+  MDagPath                 m_instancerPath;
+  bool                     m_useParticleColor;
+  vector< instanceSample > m_samples;
+  vector< RtFloat >        m_colors;       // 3 floats per instance at sample 0, r < 0 for no color
+
+  // rgbPP of the instanced particle system, sorted by particle id
+  vector< pair< int, unsigned > > m_colorIds;
+  vector< RtFloat >               m_particleColors;
+  bool                            m_colorsRead;
+};
+
+#endif
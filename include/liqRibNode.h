@@ -51,6 +51,7 @@
 // Liquid headers
 #include <liqRibData.h>
 #include <liqRibObj.h>
+#include <liqRibInstancer.h>
 #include <liqTokenPointer.h>
 
 
@@ -77,6 +78,7 @@ class liqRibNode {
 
     liqRibNodePtr      next;
     MString            name;
+    liqRibInstancerPtr instancer;  // particle instances of this prototype, if any
 
     AnimType           matXForm;
     AnimType           bodyXForm;
@@ -121,6 +123,8 @@ class liqRibNode {
 
     MString  getInstanceStr() { return instanceStr; };
     bool     hasNObjects( unsigned n );
+    void     resolveParticleSamples();
+    liqRibObjPtr instanceObject();
     bool     colorOverridden() { return overrideColor; };
 
 
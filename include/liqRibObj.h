@@ -53,6 +53,7 @@ public:
     unsigned granularity() const; // get granularity
     bool     writeNextObjectGrain() const; // write next geometry grain directly
     bool     isNextObjectGrainAnimated() const; // whether the next grain needs to be in a motion block
+    static bool isInstanceable( int type );     // plain geometry, that can go in an ObjectBegin block
 
     int      type;
     int      written;
@@ -67,6 +68,7 @@ public:
     void     unref();
 
     void     setHandle( RtObjectHandle handle );
+    liqRibDataPtr getDataPtr() const { return data; }
 
     RtObjectHandle handle() const;
     RtLightHandle  lightHandle() const;
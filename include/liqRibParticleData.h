@@ -35,6 +35,7 @@
 
 #include <liqRibData.h>
 #include <maya/MIntArray.h>
+#include <liqParticleKernels.h>
 
 class liqRibParticleData : public liqRibData {
 public:
@@ -54,6 +55,17 @@ public:
   void addAdditionalVectorParameters( MFnDependencyNode &nodeFn, const string& prefix, ParameterType type );
   //void addAdditionalColorParameters ( MFnDependencyNode nodeFn);
 
+  // Ids of the particles alive at this sample, in increasing order
+  const vector< int >& particleIds() const { return m_particleIds; }
+
+  // Build the parameter lists for the particles whose ids are in validIds
+  // (sorted). With motion blur this is called by the translator once all
+  // motion samples are scanned, with the ids common to every sample.
+  void resolveParticles( const vector< int > &validIds );
+  bool isResolved() const { return m_resolved; }
+
+  static void intersectParticleIds( const vector< int > &a, const vector< int > &b, vector< int > &result );
+
   // pType data type, these values corrospond to the types of
   // particleRenderType in maya!
   enum pType {
@@ -72,18 +84,68 @@ public:
   pType particleType;
 
 private:
+  // Per particle float attribute with an optional scalar fallback
+  struct particleChannel {
+    bool            present;
+    bool            perParticle;
+    vector< float > values;
+    float           value;
+  };
+
+  // User rman* attribute captured at scan time
+  struct particleAttribute {
+    string          name;
+    ParameterType   type;
+    bool            perParticle;
+    vector< float > floats;
+    liqVectorColumn vectors;
+    float           value[ 3 ];
+  };
+
+  void readChannel( MFnDependencyNode &nodeFn, const char *ppName, const char *name, particleChannel &channel );
+  void buildParameters( unsigned first, unsigned count );
+  bool isChunked() const;
+  unsigned numChunks() const;
+  void writeChunk( unsigned chunk );
+
   unsigned grain;
+  bool     m_resolved;
 
   // Data storage for blobby particles
   vector< RtInt > m_codeArray;
   vector< RtFloat > m_floatArray;
   vector< string > m_stringArray;
 
-  MIntArray m_validParticles;
+  // Particle ids at this sample and, for each of them, the index into the
+  // captured columns. Both are sorted by id.
+  vector< int > m_particleIds;
+  vector< int > m_particleOrder;
+
+  // Ids of the exported particles. Once resolved, the columns below hold
+  // these particles only, in the same order.
+  vector< int > m_validIds;
+
+  // Attribute values captured at the sample time, one float column per
+  // component
+  liqVectorColumn m_positions;
+  liqVectorColumn m_velocities;
+  liqVectorColumn m_rgb;
+  liqVectorColumn m_rotations;
+  vector< float > m_opacities;
+  particleChannel m_radius;
+  particleChannel m_spriteNum;
+  particleChannel m_spriteTwist;
+  particleChannel m_spriteScaleX;
+  particleChannel m_spriteScaleY;
+  vector< particleAttribute > m_additionalAttributes;
+  float     m_multiRadius;
+  float     m_tailSize;
+  float     m_tailFade;
 
   unsigned  m_numParticles;
   unsigned  m_numValidParticles;
-  short     m_multiCount;  // Support for multi-point and multi-streak.
+  unsigned  m_chunkSize;   // max particles per RiPoints/RiCurves call, 0 for no limit
+  short     m_multiCount;  // Support for multi-point and multi-streak (vertices per particle).
 };
 
 #endif
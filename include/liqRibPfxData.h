@@ -36,7 +36,7 @@
 
 #include <maya/MPlug.h>
 
-#include <boost/shared_array.hpp>
+#include <liqRibCurveBatch.h>
 
 class liqRibPfxData : public liqRibData {
 public: // Methods
@@ -46,17 +46,16 @@ public: // Methods
   virtual void            write();
   virtual unsigned        granularity() const;
   virtual bool            writeNextGrain();
+  virtual bool            isNextGrainAnimated() const;
   virtual bool            compare( const liqRibData& other ) const;
   virtual ObjectType      type() const;
 
 private: // Data
 
   unsigned                grain;
-  bool                    hasFeature[ 3 ];
   ObjectType			  pfxtype;
-  vector< RtInt >         nverts[ 3 ];
-  shared_array< RtFloat > CVs;
-  liqTokenPointer::array pfxTokenPointerArrays[ 3 ];
+  vector< liqCurveBatch > batches;
+  vector< RtFloat >       firstCurve;  // CVs of the first curve, to compare samples
 };
 
 #endif // liqRibPfxData_H
@@ -36,7 +36,7 @@
 ** ______________________________________________________________________
 */
 
-#include <boost/shared_array.hpp>
+#include <liqRibCurveBatch.h>
 
 class liqRibPfxHairData : public liqRibData {
 public: // Methods
@@ -44,18 +44,18 @@ public: // Methods
     liqRibPfxHairData( MObject curve );
 
     virtual void       write();
+    virtual unsigned   granularity() const;
+    virtual bool       writeNextGrain();
+    virtual bool       isNextGrainAnimated() const;
     virtual bool       compare( const liqRibData& other ) const;
     virtual ObjectType type() const;
 
 private: // Data
 
-    RtInt ncurves;
-    shared_array< RtInt >   nverts;
-    shared_array< RtFloat > CVs;
-    shared_array< RtFloat > normals;
-    shared_array< RtFloat > curveWidth;
-    shared_array< RtFloat > cvColor;
-    shared_array< RtFloat > cvOpacity;
+    RtInt                   ncurves;
+    unsigned                grain;
+    vector< liqCurveBatch > batches;
+    vector< RtFloat >       firstCurve;  // CVs of the first curve, to compare samples
 };
 
 #endif
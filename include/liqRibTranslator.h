@@ -40,6 +40,7 @@
 #include <liqRibHT.h>
 #include <liqGenericShader.h>
 #include <liqRenderScript.h>
+#include <liqRenderTiles.h>
 #include <liqRibLightData.h>
 #include <liqExpression.h>
 
@@ -50,6 +51,7 @@
 #include <maya/MFloatArray.h>
 
 #include <map>
+#include <set>
 #include <boost/shared_ptr.hpp>
 
 
@@ -92,6 +94,14 @@ private: // Methods
   MString getHiderOptions( MString rendername, MString hidername );
 
   MStatus ribOutput( long scanTime, MString ribName, bool world_only, bool out_lightBlock, MString archiveName );
+  MString renderFlags() const;
+  bool    isTiled( const structJob &job ) const;
+  MStatus tileOutput( long scanTime, bool out_lightBlock );
+  void    renderTiles();
+  MString renderViewStatsParameter() const;
+  bool    isResumable( const structJob &job ) const;
+  MString resumeFileName( const structJob &job, const MString &suffix ) const;
+  void    prepareResume();
 
   MStatus buildJobs();
   MStatus ribPrologue();
@@ -101,6 +111,8 @@ private: // Methods
   MStatus lightBlock();
   MStatus coordSysBlock();
   MStatus objectBlock();
+  void writeMaterial( liqGenericShader &shader );
+  void writeWorldCoShaders();
   MStatus worldEpilogue();
   MStatus frameEpilogue( long );
   void doAttributeBlocking( const MDagPath & newPath,  const MDagPath & previousPath );
@@ -163,6 +175,7 @@ public: // Data
   bool m_shaderDebug;
   bool m_illuminateByDefault;
   bool m_liquidSetLightLinking;
+  set< string > m_writtenMaterials; // inline material archives already in the current RIB
 
   bool m_ignoreLights;
   bool m_ignoreSurfaces;
@@ -456,6 +469,22 @@ private :
   bool          m_renderViewLocal;
   liquidlong    m_renderViewPort;
   liquidlong    m_renderViewTimeOut;
+  MString       m_renderViewEncoding;
+  bool          m_renderViewAOVs;
+  MString       m_renderViewStatsFile;  // CSV trace of the render view transport
+  bool          m_renderViewResume;     // resume interrupted render view renders of the same RIB
+  MString       m_resumeHash;           // of the hero RIB, what its checkpoint must match
+
+  // split frames: the hero pass in crop windows rendered at once by local processes
+  int           m_renderTiles;
+  int           m_renderTile;       // the tile being written, -1 for whole frames
+  vector< liqRenderTile > m_tiles;
+  MStringArray  m_tiledImages;      // merged from the tile images once they are done
+
+  // direct local renders: texture and shadow jobs run in parallel slots
+  int           m_renderSlots;      // 0: the cores divided by m_renderThreads
+  int           m_renderThreads;    // per render, 0 when the renderer takes every core,
+                                    // passed to PRMan, 3Delight and Pixie, the others need it in renderCmdFlags
 
   int           m_statistics;
   MString       m_statisticsFile;
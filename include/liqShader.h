@@ -35,10 +35,12 @@
 #include <liqTokenPointer.h>
 #include <liqGetSloInfo.h>
 #include <liqGenericShader.h>
+#include <boost/shared_ptr.hpp>
 #define MR_SURFPARAMSIZE 1024
 
 #include <string>
 #include <vector>
+#include <set>
 
 class liqSwitcher;
 
@@ -58,7 +60,9 @@ public :
 
 	void appendCoShader ( MObject coshader, MPlug plug );
 	void *write ( bool shortShaderNames, unsigned int indentLevel, SHADER_TYPE forceAs=SHADER_TYPE_UNKNOWN );
-	void *write ( bool shortShaderNames, unsigned int indentLevel, vector<MString> &yetExportedShaders, SHADER_TYPE forceAs=SHADER_TYPE_UNKNOWN );
+	void *write ( bool shortShaderNames, unsigned int indentLevel, set<string> &yetExportedShaders, SHADER_TYPE forceAs=SHADER_TYPE_UNKNOWN );
+	void writeCoShaders ( bool shortShaderNames, unsigned int indentLevel, set<string> &yetExportedShaders );
+	bool refreshParameters ();
 	void writeRibAttributes ( MFnDependencyNode &node, SHADER_TYPE shaderType );
 
 	//void writeAsCoShader(bool shortShaderNames, unsigned int indentLevel);
@@ -93,6 +97,24 @@ public :
     
     vector< liqTokenPointer	> tokenPointerArray;
     vector< MObject > m_coShaderArray;
+
+private :
+    bool readParameter ( MFnDependencyNode &shaderNode, liqGetSloInfo &shaderInfo, unsigned int i, bool outputAllParameters );
+    bool readColor ( MFnDependencyNode &shaderNode );
+    bool isCoShaderParameter ( liqGetSloInfo &shaderInfo, unsigned int i );
+    bool isAnimatedParameter ( MFnDependencyNode &shaderNode, liqGetSloInfo &shaderInfo, unsigned int i );
+    void setContentHandler ();
+
+    vector< unsigned int > m_tokenArgs;       // shader argument of each token
+    vector< unsigned int > m_animatedArgs;    // arguments read again by refreshParameters()
+    vector< unsigned int > m_coShaderArgs;
+    vector< MString >      m_coShaderHandles; // handle of each co-shader when it was read
+    bool                   m_animatedColor;
+    boost::shared_ptr< liqGetSloInfo > m_shaderInfo; // kept while there are arguments to read again
+
+    // tokenPointerArray packed for the Ri calls, filled by the first write()
+    vector< RtToken >   m_tokenArray;
+    vector< RtPointer > m_pointerArray;
 };
 
 
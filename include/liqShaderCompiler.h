@@ -0,0 +1,122 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqShaderCompiler_H
+#define liqShaderCompiler_H
+
+/* ______________________________________________________________________
+**
+** Liquid Shader Compiler Header File
+** ______________________________________________________________________
+*/
+
+#include <maya/MPxCommand.h>
+#include <maya/MStringArray.h>
+
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+/** Outcome of one source file.
+ */
+struct liqShaderCompileResult
+{
+  enum Status { kUpToDate, kCompiled, kFailed };
+
+  string source;
+  string output;
+  Status status;
+  double seconds;
+};
+
+/**
+ * Rebuilds out of date shaders.
+ * A source is compiled when its compiled shader is missing or older than
+ * the source or any file it includes, directly or not. Out of date sources
+ * are compiled by several compiler processes at once, one per processor
+ * unless told otherwise. It does not need Maya so liquidBin can use it
+ * to rebuild a shader library before a farm job.
+ */
+class liqShaderCompiler
+{
+public:
+  liqShaderCompiler();
+
+  void setCompiler( const string& compiler, const string& extension );
+  void setOutputDir( const string& dir );  // empty : next to the source
+  void addIncludePath( const string& path );
+  void setJobs( unsigned jobs );           // 0 : one per processor
+  void setForce( bool force );
+
+  unsigned addSources( const string& path ); // a .sl file or a directory of them
+  bool     run();                            // false if a shader failed
+
+  const vector< liqShaderCompileResult >& results() const { return m_results; }
+
+  static unsigned processorCount();
+  static void     defaultCompiler( string& compiler, string& extension );
+
+private:
+  time_t dependencyTime( const string& file );
+  string findInclude( const string& name, const string& fromDir ) const;
+  string outputFile( const string& source ) const;
+  string commandLine( const string& source ) const;
+
+  string                  m_compiler;
+  string                  m_extension;
+  string                  m_outputDir;
+  vector< string >        m_includePaths;
+  vector< string >        m_sources;
+  unsigned                m_jobs;
+  bool                    m_force;
+  map< string, time_t >   m_times;  // newest date of a file and its includes
+  vector< liqShaderCompileResult > m_results;
+};
+
+/**
+ * liquidCompileShaders command.
+ * Compiles the given .sl files, or the .sl files in the given directories,
+ * with the current renderer's shader compiler and returns one
+ * "source status seconds" string per file.
+ */
+class liqCompileShaders : public MPxCommand
+{
+public:
+  liqCompileShaders() {}
+  virtual ~liqCompileShaders() {}
+
+  static void*   creator();
+  static MSyntax syntax();
+
+  MStatus doIt( const MArgList& args );
+};
+
+#endif // liqShaderCompiler_H
@@ -32,6 +32,12 @@
 //#include <liqShader.h>
 #include <liqGenericShader.h>
 #include <maya/MString.h>
+#include <maya/MObjectHandle.h>
+#include <maya/MMessage.h>
+#include <maya/MNodeMessage.h>
+
+#include <map>
+#include <set>
 
 
 class liqShaderFactory
@@ -57,13 +63,39 @@ public:
 	MString getUniqueShaderHandler();
 
 	void clearShaders();
+	// called at the start of each frame : shaders are kept from frame to frame,
+	// the ones whose node was edited are rebuilt on their first request in the
+	// frame, the others only read their animated parameters again
+	void refreshShaders();
+
+	// handles of the co-shaders declared at world level for the current
+	// object block : shaders reference them instead of declaring them again
+	set<string> &worldCoShaders() { return m_worldCoShaders; }
 
 	//inline void setBuildShadersWithAllParameters(bool b){buildShadersWithAllParameters = b;}
 private:
+	struct liqShaderEntry
+	{
+		MObjectHandle node;
+		liqGenericShader *shader;
+		MCallbackId dirtyCallbackId;
+		bool dirty;
+		unsigned int frame;   // frame the shader was built in
+	};
+	// keyed by MObjectHandle::hashCode(), collisions are resolved on the MObject
+	typedef multimap< unsigned int, liqShaderEntry > liqShaderMap;
+
 	liqShaderFactory();
+	liqGenericShader *newShader( MObject shaderObj, bool withAllParameters );
+	void removeShader( liqShaderMap::iterator entry );
+	static void shaderChangedCallback( MNodeMessage::AttributeMessage msg, MPlug &plug, MPlug &otherPlug, void *clientData );
+
 	static liqShaderFactory *_instance;
 	int shaderHandlerId;
-	vector<liqGenericShader*> m_shaders;
+	unsigned int m_frame;
+	liqShaderMap m_shaders;
+	vector<liqGenericShader*> m_oldShaders;   // rebuilt this frame, may still be referenced
+	set<string> m_worldCoShaders;
 	//bool buildShadersWithAllParameters;
 };
 
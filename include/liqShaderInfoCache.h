@@ -0,0 +1,106 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqShaderInfoCache_H
+#define liqShaderInfoCache_H
+
+/* ______________________________________________________________________
+**
+** Liquid Shader Info Cache Header File
+**
+** Compiled shader metadata, in the form the liquidSl* mel procedures
+** use. It is read in-process when the renderer's shader query library
+** is linked in, through the liquidSlParse* mel procedures otherwise,
+** and kept in an index in the project directory keyed by the shader's
+** path, modification time and size.
+** ______________________________________________________________________
+*/
+
+#include <maya/MString.h>
+#include <maya/MStringArray.h>
+#include <maya/MIntArray.h>
+#include <maya/MMessage.h>
+
+#include <map>
+#include <string>
+
+struct liqShaderInfo {
+  MString      expectedType;    // liquid node type the info was parsed for (co-shaders)
+  double       mtime;
+  double       size;
+
+  MString      name;
+  MString      type;
+  MStringArray methods;
+  MStringArray paramNames;
+  MStringArray paramDetails;
+  MStringArray paramTypes;
+  MStringArray paramDefaults;   // mel notation : "0.5", "<<1, 1, 1>>", {...} for arrays
+  MStringArray paramAccept;
+  MIntArray    paramIsOutput;
+  MIntArray    paramArraySizes; // -1 : not an array, 0 : resizable
+};
+
+class liqShaderInfoCache {
+public:
+  static liqShaderInfoCache &instance();
+
+  // Cached info, or read in-process. False if the shader has to go through the mel parsers.
+  bool find( const MString &shaderFile, const MString &expectedType, liqShaderInfo &info );
+  void store( const MString &shaderFile, const MString &expectedType, liqShaderInfo &info );
+
+  // Write the index if store() changed it. Done once Maya is idle again after
+  // a scan, when the project changes, and on plugin unload (shutdown)
+  void flush();
+  static void shutdown();
+
+  // mel side : fill the $gLiquidSl* globals from the info, or the info from them
+  static MStatus setMelGlobals( const liqShaderInfo &info );
+  static MStatus getMelGlobals( liqShaderInfo &info );
+
+private:
+  liqShaderInfoCache();
+
+  bool stamp( const MString &shaderFile, double &mtime, double &size ) const;
+  bool readNative( const MString &shaderFile, const MString &expectedType, liqShaderInfo &info ) const;
+  void load();
+  void save() const;
+
+  static void idle( void *cache );
+  static void workspaceChanged( void *cache );
+
+  static liqShaderInfoCache *_instance;
+  MString projectDir;             // workspace -q -rd, until the workspace changes
+  MString indexFile;
+  std::map< std::string, liqShaderInfo > infos;
+  bool        dirty;              // infos has shaders the index file hasn't
+  MCallbackId idleCallback;       // set while a save is pending
+  MCallbackId workspaceCallback;
+};
+
+#endif
@@ -0,0 +1,320 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Shared memory framebuffer for local liqmaya display driver renders
+** ______________________________________________________________________
+*/
+
+#if !defined(__LIQSHAREDFRAMEBUFFER_H__)
+#define __LIQSHAREDFRAMEBUFFER_H__
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "liqBucket.h"
+
+/**
+ * A full resolution float framebuffer mapped by both the display driver
+ * and the receiver when they run on the same machine. The driver copies
+ * buckets straight into it and publishes their bucketInfo on a single
+ * producer, single consumer ring; the socket is only kept to notice a
+ * renderer that went away.
+ */
+class liqSharedFramebuffer
+{
+public:
+  enum { kNameSize = 256, kRingSize = 512, kMagic = 0x6c716662 };
+  // the header keeps the size in 32 bits, larger images go on the socket
+  static const unsigned int kMaxSize = 0xffffffffu;
+
+  liqSharedFramebuffer() : m_header( 0 ), m_size( 0 ), m_owner( false )
+#ifdef _WIN32
+    , m_mapping( NULL )
+#endif
+  {}
+  ~liqSharedFramebuffer() { close(); }
+
+  /** A name no other render on this machine is using. */
+  static std::string uniqueName()
+  {
+    static unsigned counter( 0 );
+    char name[ kNameSize ];
+#ifdef _WIN32
+    sprintf( name, "Local\\liqfb%lu_%u", GetCurrentProcessId(), ++counter );
+#else
+    struct stat st;
+    const char* dir( "/dev/shm" );
+    if ( stat( dir, &st ) || !S_ISDIR( st.st_mode ) ) 
+    {
+      dir = getenv( "TMPDIR" );
+      if ( !dir ) dir = "/tmp";
+    }
+    sprintf( name, "%.200s/liqfb%d_%u", dir, ( int )getpid(), ++counter );
+#endif
+    return name;
+  }
+
+  /** True when both ends of a connected socket are on this machine. */
+  static bool isLocalConnection( int socket )
+  {
+    struct sockaddr_in local, peer;
+#ifdef _WIN32
+    int length( sizeof( local ) );
+#else
+    socklen_t length( sizeof( local ) );
+#endif
+    if ( getsockname( socket, ( struct sockaddr* )&local, &length ) ) return false;
+    length = sizeof( peer );
+    if ( getpeername( socket, ( struct sockaddr* )&peer, &length ) ) return false;
+    return local.sin_family == AF_INET && peer.sin_family == AF_INET && 
+           !memcmp( &local.sin_addr, &peer.sin_addr, sizeof( local.sin_addr ) );
+  }
+
+  /** Receiver side: create and map a new framebuffer. */
+  bool create( const std::string& name, int width, int height, int channels )
+  {
+    close();
+    if ( width <= 0 || height <= 0 || channels <= 0 ) return false;
+    if ( imageSize( width, height, channels ) > kMaxSize ) return false;
+    m_name = name;
+    m_owner = true;
+    size_t size( ( size_t )imageSize( width, height, channels ) );
+    if ( !map( size, true ) ) 
+    {
+      close();
+      return false;
+    }
+    memset( m_header, 0, sizeof( header ) );
+    m_header->width    = width;
+    m_header->height   = height;
+    m_header->channels = channels;
+    m_header->size     = ( unsigned int )size;
+    barrier();
+    m_header->magic    = kMagic;
+    return true;
+  }
+
+  /** Display driver side: map a framebuffer created by the receiver. */
+  bool open( const std::string& name )
+  {
+    close();
+    m_name = name;
+    m_owner = false;
+    if ( !map( sizeof( header ), false ) ) 
+    {
+      close();
+      return false;
+    }
+    size_t size( m_header->magic == kMagic ? m_header->size : 0 );
+    if ( size && imageSize( m_header->width, m_header->height, m_header->channels ) != size ) size = 0;
+    unmap();
+    if ( !size || !map( size, false ) ) 
+    {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close()
+  {
+    unmap();
+#ifndef _WIN32
+    if ( m_owner && !m_name.empty() ) unlink( m_name.c_str() );
+#endif
+    m_name.clear();
+    m_owner = false;
+  }
+
+  bool isOpen() const { return m_header != 0; }
+  const std::string& name() const { return m_name; }
+  int width() const { return m_header->width; }
+  int height() const { return m_header->height; }
+  int channels() const { return m_header->channels; }
+  const BUCKETDATATYPE* pixels() const { return ( const BUCKETDATATYPE* )( m_header + 1 ); }
+  const BUCKETDATATYPE* pixels( unsigned x, unsigned y ) const { return pixels() + ( ( size_t )y * width() + x ) * channels(); }
+
+  /**
+   * Producer: copy a bucket into the framebuffer and publish it. Waits for
+   * room on the ring for at most timeout seconds.
+   */
+  bool write( const bucket::bucketInfo& info, const BUCKETDATATYPE* data, int timeout )
+  {
+    if ( info.right <= info.left || info.top <= info.bottom || 
+         info.right > ( unsigned )width() || info.top > ( unsigned )height() || info.channels != ( unsigned )channels() ) 
+      return false;
+    size_t row( ( info.right - info.left ) * info.channels );
+    for ( unsigned y( info.bottom ); y < info.top; y++, data += row ) 
+      memcpy( ( BUCKETDATATYPE* )pixels( info.left, y ), data, row * sizeof( BUCKETDATATYPE ) );
+
+    unsigned head( m_header->head );
+    time_t start( time( NULL ) );
+    while ( head - m_header->tail >= kRingSize ) 
+    {
+      if ( time( NULL ) - start > timeout ) return false;
+      sleep( 1 );
+    }
+    m_header->ring[ head % kRingSize ] = info;
+    barrier();
+    m_header->head = head + 1;
+    return true;
+  }
+
+  /** Producer: no more buckets. */
+  void finish()
+  {
+    barrier();
+    m_header->done = 1;
+  }
+
+  /** Consumer: pop the next published bucket, false if there is none yet. */
+  bool read( bucket::bucketInfo& info )
+  {
+    unsigned tail( m_header->tail );
+    if ( tail == m_header->head ) return false;
+    barrier();
+    info = m_header->ring[ tail % kRingSize ];
+    barrier();
+    m_header->tail = tail + 1;
+    return true;
+  }
+
+  /** Consumer: the producer is done and every bucket was read. */
+  bool finished() const
+  {
+    if ( !m_header->done ) return false;
+    barrier();
+    return m_header->tail == m_header->head;
+  }
+
+  static void sleep( int milliseconds )
+  {
+#ifdef _WIN32
+    Sleep( milliseconds );
+#else
+    usleep( milliseconds * 1000 );
+#endif
+  }
+
+private:
+  struct header
+  {
+    volatile unsigned int magic;
+    unsigned int size;
+    int width, height, channels;
+    volatile unsigned int done;
+    volatile unsigned int head;
+    volatile unsigned int tail;
+    bucket::bucketInfo ring[ kRingSize ];
+  };
+
+  // in doubles: the product overflows size_t in 32 bit processes
+  static double imageSize( int width, int height, int channels )
+  {
+    return sizeof( header ) + ( double )width * height * channels * sizeof( BUCKETDATATYPE );
+  }
+
+  static void barrier()
+  {
+#ifdef _WIN32
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+  }
+
+  bool map( size_t size, bool create )
+  {
+#ifdef _WIN32
+    if ( create ) 
+      m_mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, ( DWORD )size, m_name.c_str() );
+    else 
+      m_mapping = OpenFileMappingA( FILE_MAP_ALL_ACCESS, FALSE, m_name.c_str() );
+    if ( !m_mapping ) return false;
+    void* p( MapViewOfFile( m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size ) );
+    if ( !p ) return false;
+#else
+    int fd( ::open( m_name.c_str(), create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600 ) );
+    if ( fd == -1 ) return false;
+    if ( create && ftruncate( fd, size ) ) 
+    {
+      ::close( fd );
+      return false;
+    }
+    void* p( mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) );
+    ::close( fd );
+    if ( p == MAP_FAILED ) return false;
+#endif
+    m_header = ( header* )p;
+    m_size = size;
+    return true;
+  }
+
+  void unmap()
+  {
+#ifdef _WIN32
+    if ( m_header ) UnmapViewOfFile( m_header );
+    if ( m_mapping ) CloseHandle( m_mapping );
+    m_mapping = NULL;
+#else
+    if ( m_header ) munmap( m_header, m_size );
+#endif
+    m_header = 0;
+    m_size = 0;
+  }
+
+  header*     m_header;
+  size_t      m_size;
+  bool        m_owner;
+  std::string m_name;
+#ifdef _WIN32
+  HANDLE      m_mapping;
+#endif
+
+  liqSharedFramebuffer( const liqSharedFramebuffer& );
+  liqSharedFramebuffer& operator=( const liqSharedFramebuffer& );
+};
+
+#endif
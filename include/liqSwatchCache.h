@@ -0,0 +1,82 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqSwatchCache_H
+#define liqSwatchCache_H
+
+/* ______________________________________________________________________
+**
+** Liquid Swatch Cache Header File
+** ______________________________________________________________________
+*/
+
+#include <liqPreviewShader.h>
+
+#include <maya/MString.h>
+#include <maya/MImage.h>
+
+#include <string>
+#include <map>
+
+using namespace std;
+
+/**
+ * Swatch images stored by content.
+ * The key is a hash of the shader file and its date, the shader parameter
+ * values (and the dates of the files they name) and the preview settings,
+ * so nodes with the same settings share one image, across scenes and
+ * sessions. Images are kept as raw RGBA bytes in $LIQUIDSWATCHCACHE, or
+ * ~/.liquid/swatches, and the least recently used are removed when the
+ * directory grows over $LIQUIDSWATCHCACHESIZE megabytes (256 by default).
+ */
+class liqSwatchCache
+{
+public:
+  static liqSwatchCache& instance();
+
+  MString key( const liqPreviewShaderOptions& options );
+  bool    keyOf( const MString& node, MString& key ) const;
+  void    setKeyOf( const MString& node, const MString& key );
+
+  bool find( const MString& key, MImage& image );
+  bool contains( const MString& key ) const;
+  void store( const MString& key, MImage& image );
+
+private:
+  liqSwatchCache();
+
+  string path( const MString& key ) const;
+  void   evict();
+
+  string                m_directory;
+  double                m_limit;     // bytes
+  double                m_size;      // bytes, -1 until the directory was scanned
+  map< string, MString > m_nodeKeys; // last key computed for each node
+};
+
+#endif // liqSwatchCache_H
@@ -0,0 +1,92 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the
+** "License"); you may not use this file except in compliance with the License. You may
+** obtain a copy of the License at http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific
+** language governing rights and limitations under the License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions created by
+** Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+#ifndef liqThread_H
+#define liqThread_H
+
+/* ______________________________________________________________________
+**
+** Liquid Thread Header File
+**
+** A mutex and a joinable thread on pthreads, or on the Win32 calls.
+** ______________________________________________________________________
+*/
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+class liqMutex
+{
+public:
+  liqMutex();
+  ~liqMutex();
+
+  void lock();
+  void unlock();
+
+private:
+  liqMutex( const liqMutex& );
+  liqMutex& operator=( const liqMutex& );
+
+#ifdef _WIN32
+  CRITICAL_SECTION m_section;
+#else
+  pthread_mutex_t  m_mutex;
+#endif
+};
+
+class liqThread
+{
+public:
+  typedef void* ( *function )( void* );
+
+  liqThread();
+  ~liqThread();                              // joins it
+
+  bool start( function run, void *data );    // false if it couldn't be created
+  void join();                               // nothing if it isn't running
+  bool isRunning() const { return m_running; }
+
+private:
+  liqThread( const liqThread& );
+  liqThread& operator=( const liqThread& );
+
+#ifdef _WIN32
+  static DWORD WINAPI run( LPVOID thread );
+
+  HANDLE    m_handle;
+  function  m_run;
+  void     *m_data;
+#else
+  pthread_t m_thread;
+#endif
+  bool      m_running;
+};
+
+#endif
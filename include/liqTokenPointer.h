@@ -89,6 +89,8 @@ class liqTokenPointer
     DetailType     getDetailType() const;
     const RtFloat* getTokenFloatArray() const;
     const shared_array< RtFloat > getTokenFloatSharedArray() const;
+    unsigned       getTokenFloatArraySize() const;
+    const vector< string >& getTokenStringArray() const;
     string         getTokenString() const;
     ParameterType  getParameterType() const;
     const RtPointer getRtPointer();
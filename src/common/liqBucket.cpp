@@ -59,7 +59,8 @@ int bucket::set(const bucketInfo &info, const BUCKETDATATYPE *pixels )
 	m_info.channels	= info.channels;
 	m_info.channels	= info.channels;
 	unsigned size = ( info.right - info.left ) * abs( (long double)(info.top - info.bottom) ) * info.channels * sizeof( BUCKETDATATYPE );
-	m_pixels		= new BUCKETDATATYPE[size];
+	free();
+	m_pixels		= new BUCKETDATATYPE[ size / sizeof( BUCKETDATATYPE ) ];
   if ( !m_pixels ) return 1;
 	memcpy( (void *)m_pixels, (const void *)pixels, (size_t)size );
   return 0;
@@ -71,6 +71,7 @@
 #include <liquid.h>
 #include <liqGlobalHelpers.h>
 #include <liqGetSloInfo.h>
+#include <liqShaderInfoCache.h>
 
 #include <sstream>
 #include <fstream>
@@ -259,6 +260,24 @@ void liqGetSloInfo::resetIt()
     for ( k = 0; k < argDefault.size(); k++ ) lfree( argDefault[k] );
 }
 
+// liquidSlAllParamDefaultsRaw() : mel notation to the rmanDefaults one
+static MString rawDefault( const MString &melDefault )
+{
+  string raw;
+  const char *c( melDefault.asChar() );
+  for ( ; *c; c++ ) 
+  {
+    if ( c[ 0 ] == ',' && c[ 1 ] == ' ' ) 
+    {
+      raw += ':';
+      c++;
+    } 
+    else if ( !strchr( "<>{},\"", *c ) ) 
+      raw += *c;
+  }
+  return raw.c_str();
+}
+
 int liqGetSloInfo::setShader( MString shaderFileName )
 {
   int rstatus = 0;
@@ -273,34 +292,32 @@ int liqGetSloInfo::setShader( MString shaderFileName )
   else 
   {
     MStatus cmdStat;
+    MString expectedType;
+    MGlobal::executeCommand( "liquidSlExpectedType();", expectedType );
 
-    MString cmd = "liquidSlInfoReset();";
-    cmdStat = MGlobal::executeCommand( cmd );
-    LIQCHECKSTATUS( cmdStat, "liqGetSloInfo::setShader -> liquidSlInfoReset failed !" );
-
-    cmd = "liquidSlSetShader \"" + shaderFileName + "\";";
-    cmdStat = MGlobal::executeCommand( cmd );
-    LIQCHECKSTATUS( cmdStat, "liqGetSloInfo::setShader -> " + cmd + " failed !" );
+    // cached or read in-process, the mel parsers are the fallback
+    liqShaderInfo info;
+    if ( !liqShaderInfoCache::instance().find( shaderFileName, expectedType, info ) ) 
+    {
+      MString cmd = "liquidSlInfoReset();";
+      cmdStat = MGlobal::executeCommand( cmd );
+      LIQCHECKSTATUS( cmdStat, "liqGetSloInfo::setShader -> liquidSlInfoReset failed !" );
 
-    // get the shader name
-    cmdStat = MGlobal::executeCommand( "liquidSlShaderName();", shaderName );
-    LIQCHECKSTATUS( cmdStat, "liqGetSloInfo::setShader -> liquidSlShaderName failed !" );
-    //cout <<"setShader:  shaderName = "<<shaderName<<endl;
+      cmd = "liquidSlSetShader \"" + shaderFileName + "\";";
+      cmdStat = MGlobal::executeCommand( cmd );
+      LIQCHECKSTATUS( cmdStat, "liqGetSloInfo::setShader -> " + cmd + " failed !" );
 
-    // get the shader type  : seems to be obsolete, value is overrided after....
-    //cmdStat = MGlobal::executeCommand( "liquidSlShaderType();", shaderType );
-    //LIQCHECKSTATUS( cmdStat, "liqGetSloInfo::setShader -> liquidSlShaderType failed !" );
+      cmdStat = liqShaderInfoCache::getMelGlobals( info );
+      LIQCHECKSTATUS( cmdStat, "liqGetSloInfo::setShader -> could not get the shader info !" );
+    }
 
-    // get the number of params
-    cmdStat = MGlobal::executeCommand( "liquidSlNumParams();", numParam );
-    LIQCHECKSTATUS( cmdStat, "liqGetSloInfo::setShader -> liquidSlnumParams failed !" );
+    shaderName = info.name;
+    shaderType = shaderTypeMap[ info.type ];
 
-    // get the data from the arrays
-    MStringArray shaderParams, shaderDetails, shaderTypes, shaderDefaults;
-    MIntArray shaderArraySizes;
-    cmdStat = MGlobal::executeCommand( "liquidSlAllParamNames();", shaderParams );
-    LIQCHECKSTATUS( cmdStat, "liqGetSloInfo::setShader -> liquidSlAllParamNames failed !" );
+    MStringArray shaderDefaults;
+    for ( unsigned k = 0; k < info.paramDefaults.length(); k++ ) shaderDefaults.append( rawDefault( info.paramDefaults[k] ) );
 
+    setParams( info.paramNames, info.paramDetails, info.paramTypes, shaderDefaults, info.paramAccept, info.paramIsOutput, info.paramArraySizes );
   } // file exists
 
   rstatus = 1;
@@ -469,20 +486,34 @@ int liqGetSloInfo::setShaderNode( MFnDependencyNode &shaderNode )
       throw error;
     }
 
+    setParams( shaderParams, shaderDetails, shaderTypes, shaderDefaults, shaderAccept, shaderOutputs, shaderArraySizes );
+  }
+  rstatus = 1;
+  return rstatus;
+}
+
+/** Fill the parameter arrays. Defaults are in the ':' separated form of
+ *  the rmanDefaults attribute.
+ */
+void liqGetSloInfo::setParams( const MStringArray &shaderParams, const MStringArray &shaderDetails, const MStringArray &shaderTypes,
+                               const MStringArray &shaderDefaults, const MStringArray &shaderAccept, const MIntArray &shaderOutputs,
+                               const MIntArray &shaderArraySizes )
+{
+  numParam = shaderParams.length();
+  // the cache and the node attributes should both give one entry per parameter
+  if ( shaderDetails.length() == numParam && shaderTypes.length() == numParam &&
+       shaderDefaults.length() == numParam && shaderArraySizes.length() == numParam ) 
+  {
     for ( unsigned k = 0; k < numParam; k++ ) 
     {
-      //cout <<"setShaderNode:     + shaderParams["<<k<<"] = "<<shaderParams[k]<<endl;
       argName.push_back( shaderParams[k] );
 
       SHADER_TYPE theParamType = shaderTypeMap[ shaderTypes[k] ];
-      //cout <<"setShaderNode:       - shaderTypes["<<k<<"] = "<<shaderTypes[k]<<" -> "<<theParamType<<endl;
       argType.push_back( theParamType );
 
-      //cout <<"setShaderNode:       - shaderArraySizes["<<k<<"] = "<<shaderArraySizes[k]<<endl;
       argArraySize.push_back( shaderArraySizes[k] );
 
       SHADER_DETAIL theParamDetail = shaderDetailMap[ shaderDetails[k] ];
-      //cout <<"setShaderNode:       - shaderDetails["<<k<<"] = "<<shaderDetails[k]<<" -> "<<theParamDetail<<endl;
       argDetail.push_back( theParamDetail );
 
       if ( shaderAccept.length() == numParam ) argAccept.push_back( shaderAccept[k] );
@@ -524,13 +555,11 @@ int liqGetSloInfo::setShaderNode( MFnDependencyNode &shaderNode )
 				{
           if ( shaderArraySizes[k] > 0  ) 
 					{
-            //cout<<"setShaderNode:         - array size : "<<shaderArraySizes[k]<<endl;
             float *floats = ( float *)lmalloc( sizeof( float ) * 3 * shaderArraySizes[k] );
             MStringArray tmp;
             shaderDefaults[k].split( ':', tmp );
             for ( unsigned int kk = 0; kk < tmp.length()/3; kk++ ) 
 						{
-              //cout<<"setShaderNode:           [ "<<tmp[3*kk].asFloat()<<" "<<tmp[3*kk+1].asFloat()<<" "<<tmp[3*kk+2].asFloat()<<" ]   kk="<<kk<<endl;
               floats[3*kk  ] = tmp[3*kk  ].asFloat();
               floats[3*kk+1] = tmp[3*kk+1].asFloat();
               floats[3*kk+2] = tmp[3*kk+2].asFloat();
@@ -554,13 +583,11 @@ int liqGetSloInfo::setShaderNode( MFnDependencyNode &shaderNode )
 				{
           if ( shaderArraySizes[k] > 0  ) 
 					{
-            //cout<<"setShaderNode:         - array size : "<<shaderArraySizes[k]<<endl;
             float *floats = ( float *)lmalloc( sizeof( float ) * 16 * shaderArraySizes[k] );
             MStringArray tmp;
             shaderDefaults[k].split( ':', tmp );
             for ( unsigned int kk = 0; kk < tmp.length()/16; kk++ ) 
 						{
-              //cout<<"setShaderNode:           [ "<<tmp[3*kk].asFloat()<<" "<<tmp[3*kk+1].asFloat()<<" "<<tmp[3*kk+2].asFloat()<<" ]   kk="<<kk<<endl;
               floats[16*kk   ] = tmp[16*kk   ].asFloat();
               floats[16*kk+1 ] = tmp[16*kk+1 ].asFloat();
               floats[16*kk+2 ] = tmp[16*kk+2 ].asFloat();
@@ -609,7 +636,6 @@ int liqGetSloInfo::setShaderNode( MFnDependencyNode &shaderNode )
         case SHADER_TYPE_SHADER:
         default: 
         {
-          //cout <<"setShaderNode:     + DEFAULT CASE REACHED !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!"<<endl;
           argDefault.push_back( NULL );
           break;
         }
@@ -617,8 +643,8 @@ int liqGetSloInfo::setShaderNode( MFnDependencyNode &shaderNode )
       }
     }
   }
-  rstatus = 1;
-  return rstatus;
+  else
+    numParam = 0;
 }
 
 MStatus liqGetSloInfo::doIt( const MArgList& args )
@@ -630,6 +656,24 @@ MStatus liqGetSloInfo::doIt( const MArgList& args )
 	{
     if ( args.length() < 2 ) throw( "Not enough arguments specified for liquidGetSloInfo!\n" );
     MString shaderFileName = args.asString( args.length() - 1, &status );
+
+    // liquidSlSetShader : fill the mel globals from the cache, or store what the parsers found
+    if ( MString( "-load" ) == args.asString( 0, &status ) || MString( "-store" ) == args.asString( 0, &status ) ) 
+    {
+      MString expectedType;
+      MGlobal::executeCommand( "liquidSlExpectedType();", expectedType );
+      liqShaderInfo info;
+      if ( MString( "-load" ) == args.asString( 0, &status ) ) 
+      {
+        bool found( liqShaderInfoCache::instance().find( shaderFileName, expectedType, info ) );
+        if ( found ) found = ( liqShaderInfoCache::setMelGlobals( info ) == MS::kSuccess );
+        setResult( found );
+      } 
+      else if ( liqShaderInfoCache::getMelGlobals( info ) == MS::kSuccess ) 
+        liqShaderInfoCache::instance().store( shaderFileName, expectedType, info );
+      return MS::kSuccess;
+    }
+
     int success = setShader( shaderFileName );
     if ( !success ) throw( "Error loading shader specified for liquidGetSloInfo!\n" );
     for ( i = 0; i < args.length() - 1; i++ ) 
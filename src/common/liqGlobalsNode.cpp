@@ -123,6 +123,9 @@ MObject liqGlobalsNode::aDeferredBlock;
 MObject liqGlobalsNode::aPreframeMel;
 MObject liqGlobalsNode::aPostframeMel;
 MObject liqGlobalsNode::aUseRenderScript;
+MObject liqGlobalsNode::aRenderTiles;
+MObject liqGlobalsNode::aRenderSlots;
+MObject liqGlobalsNode::aRenderThreads;
 MObject liqGlobalsNode::aRemoteRender;
 MObject liqGlobalsNode::aNetRManRender;
 MObject liqGlobalsNode::aMinCPU;
@@ -255,6 +258,10 @@ MObject liqGlobalsNode::aPreviewConnectionType;
 MObject liqGlobalsNode::aRenderViewLocal;
 MObject liqGlobalsNode::aRenderViewPort;
 MObject liqGlobalsNode::aRenderViewTimeOut;
+MObject liqGlobalsNode::aRenderViewEncoding;
+MObject liqGlobalsNode::aRenderViewAOVs;
+MObject liqGlobalsNode::aRenderViewStatsFile;
+MObject liqGlobalsNode::aRenderViewResume;
 
 MObject liqGlobalsNode::aUseRayTracing;
 MObject liqGlobalsNode::aTraceBreadthFactor;
@@ -280,6 +287,12 @@ MObject liqGlobalsNode::aPhotonShadingModel;
 MObject liqGlobalsNode::aPhotonEstimator;
 
 MObject liqGlobalsNode::aUseMtorSubdiv;
+MObject liqGlobalsNode::aParticleChunkSize;
+MObject liqGlobalsNode::aUseInstancerObjects;
+MObject liqGlobalsNode::aInstanceDagObjects;
+MObject liqGlobalsNode::aPfxChunkSize;
+MObject liqGlobalsNode::aPfxDelayedArchives;
+MObject liqGlobalsNode::aShareMaterials;
 
 MObject liqGlobalsNode::aHider;
 MObject liqGlobalsNode::aJitter;
@@ -594,6 +607,9 @@ MStatus liqGlobalsNode::initialize()
 	CREATE_STRING( tAttr,aPreframeMel,                "preframeMel",                  "prfm",   ""    );
 	CREATE_STRING( tAttr,aPostframeMel,               "postframeMel",                 "pofm",   ""    );
 	CREATE_BOOL( nAttr,  aUseRenderScript,            "useRenderScript",              "urs",    false );
+	CREATE_INT( nAttr,   aRenderTiles,                "renderTiles",                  "rtl",    1     );
+	CREATE_INT( nAttr,   aRenderSlots,                "renderSlots",                  "rsl",    0     );
+	CREATE_INT( nAttr,   aRenderThreads,              "renderThreads",                "rth",    0     );
 	CREATE_BOOL( nAttr,  aRemoteRender,               "remoteRender",                 "rr",     false );
 	CREATE_BOOL( nAttr,  aNetRManRender,              "netRManRender",                "nrr",    false );
 	CREATE_INT( nAttr,   aMinCPU,                     "minCPU",                       "min",    1     );
@@ -728,6 +744,10 @@ MStatus liqGlobalsNode::initialize()
 	CREATE_BOOL( nAttr,    aRenderViewLocal,            "renderViewLocal",              "rvl",    1     );
 	CREATE_LONG( nAttr,    aRenderViewPort,             "renderViewPort",               "rvp",    6667  );
 	CREATE_INT( nAttr,     aRenderViewTimeOut,          "renderViewTimeOut",            "rvto",   20    );
+	CREATE_STRING( tAttr,  aRenderViewEncoding,         "renderViewEncoding",           "rven",   ""    );
+	CREATE_BOOL( nAttr,    aRenderViewAOVs,             "renderViewAOVs",               "rvao",   0     );
+	CREATE_STRING( tAttr,  aRenderViewStatsFile,        "renderViewStatsFile",          "rvsf",   ""    );
+	CREATE_BOOL( nAttr,    aRenderViewResume,           "renderViewResume",             "rvrs",   0     );
 
 	CREATE_BOOL( nAttr,    aUseRayTracing,              "useRayTracing",                "ray",    false );
 	CREATE_FLOAT( nAttr,   aTraceBreadthFactor,         "traceBreadthFactor",           "trbf",   1.0   );
@@ -876,6 +896,12 @@ MStatus liqGlobalsNode::initialize()
 	CREATE_STRING( tAttr,  aShotVersion,                "shotVersion",                  "sv",     ""    );
 	
 	CREATE_BOOL( nAttr,    aUseMtorSubdiv,              "useMtorSubdiv",                "ums",    false );
+	CREATE_INT( nAttr,     aParticleChunkSize,          "particleChunkSize",            "pcs",    1000000 );
+	CREATE_BOOL( nAttr,    aUseInstancerObjects,        "useInstancerObjects",          "uio",    true );
+	CREATE_BOOL( nAttr,    aInstanceDagObjects,         "instanceDagObjects",           "ido",    true );
+	CREATE_INT( nAttr,     aPfxChunkSize,               "pfxChunkSize",                 "pfcs",   0 );
+	CREATE_BOOL( nAttr,    aPfxDelayedArchives,         "pfxDelayedArchives",           "pfda",   false );
+	CREATE_BOOL( nAttr,    aShareMaterials,             "shareMaterials",               "shm",    false );
 
 
 	return MS::kSuccess;
@@ -38,7 +38,7 @@
 #include <maya/MGlobal.h>
 #include <maya/MRenderView.h>
 #include <maya/MSelectionList.h>
-#include <maya/MComputation.h>
+#include <maya/MTimerMessage.h>
 #include <maya/M3dView.h>
 #include <stdio.h>
 #include <errno.h>
@@ -46,6 +46,10 @@
 //#pragma pack(2)
 #include "liqMayaRenderView.h"
 //#pragma options align=reset
+#include "liqBucketCodec.h"
+#include "liqBucketCache.h"
+#include "liqSharedFramebuffer.h"
+#include "liqPixelKernels.h"
 
 
 
@@ -68,19 +72,23 @@
 #include <winsock.h>
 #include <io.h>
 typedef int socklen_t;
+#define SHUT_RDWR 2
 #endif
 
 #include <vector>
 #include <string>
 #include <iostream>
+#include <algorithm>
 
 using namespace std;
 
-int	readSockData(int s,char *data,int n);
-
 std::deque<string> liqMayaRenderCmd::m_lastBucketFiles;
+std::deque<string> liqMayaRenderCmd::m_lastBucketImages;
+liqRenderStats liqMayaRenderCmd::m_lastStats;
+string liqMayaRenderCmd::m_lastStatsImage;
+vector<liqProcessLauncher::process> liqMayaRenderCmd::m_nextRenders;
+liqMayaRenderCmd *liqMayaRenderCmd::m_liveRender = NULL;
 
-inline int quantize( const float value, const float zero,const float one,const float min, const float max, const float dither );
 int waitSocket( const int fd,const int seconds, const bool check_readable = true );
 
 liqMayaRenderCmd::liqMayaRenderCmd()
@@ -94,7 +102,17 @@ liqMayaRenderCmd::liqMayaRenderCmd()
 	m_quantize[2] = 0.0;
 	m_quantize[3] = 255.0;
 	m_timeout = 50;
+	m_refreshRate = 25;
+	m_connectionCount = 1;
+	m_cacheEncoding = liqBucketCodec::kHalf | liqBucketCodec::kLZ;
 	m_bGetRenderRegion = false;
+	m_socket = -1;
+	m_timer = 0;
+	m_shown = NULL;
+	m_resumed = NULL;
+	m_resuming = false;
+	m_started = m_stop = m_receiverDone = m_dirty = false;
+	m_stagingWidth = m_stagingHeight = 0;
 #ifdef _WIN32
 	WSADATA wsaData;
 	// Init the winsock
@@ -108,6 +126,9 @@ liqMayaRenderCmd::liqMayaRenderCmd()
 
 liqMayaRenderCmd::~liqMayaRenderCmd()
 {
+	// what a render that couldn't start had
+	delete m_resumed;
+	for ( unsigned int i(0); i < m_connections.size(); i++ ) delete m_connections[ i ];
 #ifdef _WIN32
 	WSACleanup();
 #endif
@@ -127,7 +148,25 @@ MStatus liqMayaRenderCmd::doIt( const MArgList& args)
 			
 		return MS::kSuccess;
 	}
+	if ( argData.isFlagSet( "-lastRenderImages" ) )
+  {
+		MStringArray res;
+		for ( unsigned int i(0); i < m_lastBucketImages.size(); i++ ) res.append( m_lastBucketImages[ i ].c_str() );
+		setResult( res );
+		return MS::kSuccess;
+	}
+	if ( argData.isFlagSet( "-stats" ) )
+  {
+		setResult( MString( m_lastStats.json( "renderView", m_lastStatsImage.c_str() ).c_str() ) );
+		return MS::kSuccess;
+	}
+	if ( argData.isFlagSet( "-stop" ) )
+	{
+		stopRender();
+		return MS::kSuccess;
+	}
 	if ( argData.isFlagSet( "-camera") ) argData.getFlagArgument( "-camera", 0, m_camera );
+	if ( argData.isFlagSet( "-image") ) argData.getFlagArgument( "-image", 0, m_image );
 
   m_bDoRegionRender = (argData.isFlagSet( "-doRegion"));
 
@@ -148,6 +187,17 @@ MStatus liqMayaRenderCmd::doIt( const MArgList& args)
 		for ( int i(0) ; i< 4 ; i++ ) argData.getFlagArgument( "-quantize", i, m_quantize[i] );
 	}
 	if( argData.isFlagSet( "-timeout") ) argData.getFlagArgument( "-timeout", 0, m_timeout );
+	if( argData.isFlagSet( "-refreshRate") ) argData.getFlagArgument( "-refreshRate", 0, m_refreshRate );
+	if( argData.isFlagSet( "-connections") ) argData.getFlagArgument( "-connections", 0, m_connectionCount );
+	if( argData.isFlagSet( "-statsFile") ) argData.getFlagArgument( "-statsFile", 0, m_statsFile );
+	if( argData.isFlagSet( "-checkpoint") ) argData.getFlagArgument( "-checkpoint", 0, m_checkpoint );
+	if( argData.isFlagSet( "-checkpointHash") ) argData.getFlagArgument( "-checkpointHash", 0, m_checkpointHash );
+	if( argData.isFlagSet( "-cacheEncoding") ) 
+	{
+		MString encoding;
+		argData.getFlagArgument( "-cacheEncoding", 0, encoding );
+		m_cacheEncoding = liqBucketCodec::parse( encoding.asChar() );
+	}
 	m_bGetRenderRegion = argData.isFlagSet( "-renderRegion" );
   return redoIt();
 }
@@ -175,12 +225,8 @@ MStatus liqMayaRenderCmd::redoIt()
 	CHECKERR( retStatus,"MRenderView::setCurrentCamera ( camera )" );
 	if ( m_bRenderFromFile )
   {
-		vector<bucket*> buckets;
-		imageInfo imgInfo;
-		retStatus = readBuckets ( m_bucketFile.asChar(), buckets,imgInfo );
-		CHECKERR( retStatus, "readBuckets " << m_bucketFile.asChar() );
-		MRenderView::startRender ( imgInfo.width, imgInfo.height, false, false );
-		for( unsigned int i(0); i< buckets.size(); i++ ) renderBucket ( buckets[i], imgInfo );
+		retStatus = renderCache( m_bucketFile.asChar() );
+		CHECKERR( retStatus, "renderCache " << m_bucketFile.asChar() );
 	}
 	else
 	if ( m_bGetRenderRegion )
@@ -191,136 +237,302 @@ MStatus liqMayaRenderCmd::redoIt()
 		return MS::kSuccess;
 	}
 	else
-  {
-		int s ,slaveSocket,status = 0;
-		//get the hostname
-		int hostlen=32;
-		char hostname[32] = "localhost";
-		if( !m_bLocalhost )
-    {
-			status = gethostname(hostname,hostlen);
-			CHECKERRNO( status, "[liqMayaRenderView] gethostname(hostname)", );
-		}
-		//create socket, bound to address and port
-		s = createSocket(hostname,m_port);
+	{
+		// one render at a time is shown, on one port
+		stopRender();
+		liqMayaRenderCmd *render = liveCopy();
+		retStatus = render->start();
+		if ( retStatus != MS::kSuccess ) delete render;
+		return retStatus;
+	}
+	MRenderView::endRender();
+  return MS::kSuccess;
+}
 
-		if ( s == -1 ) return MS::kFailure;
-		//at this stage, I'm ready to receive data from the display driver...
+//the flags of the command, for the render that goes on once it returned
+liqMayaRenderCmd* liqMayaRenderCmd::liveCopy() const
+{
+	liqMayaRenderCmd *render = new liqMayaRenderCmd;
+	render->m_camera = m_camera;
+	render->m_bucketFile = m_bucketFile;
+	render->m_image = m_image;
+	render->m_bLocalhost = m_bLocalhost;
+	render->m_bDoRegionRender = m_bDoRegionRender;
+	render->m_port = m_port;
+	for ( int i(0); i < 4; i++ ) render->m_quantize[i] = m_quantize[i];
+	render->m_timeout = m_timeout;
+	render->m_refreshRate = m_refreshRate;
+	render->m_connectionCount = m_connectionCount;
+	render->m_cacheEncoding = m_cacheEncoding;
+	render->m_statsFile = m_statsFile;
+	render->m_checkpoint = m_checkpoint;
+	render->m_checkpointHash = m_checkpointHash;
+	return render;
+}
 
-		//check if displayDriver is ready
-		if( !waitSocket( s, m_timeout, true ) )
-    {
-			ERROR("[liqMayaRenderView] timeout reached, display driver didn't respond in time. Aborting");
-			closesocket(s);
-			return MS::kFailure;
-		}
+//listen to the display drivers: a receiving thread reads and decodes the buckets
+//into the staging framebuffer, a timer callback shows what changed at m_refreshRate
+MStatus liqMayaRenderCmd::start()
+{
+	int s ,status = 0;
+	m_stats.reset();
+	m_updateStats.reset();
+	m_renders.swap( m_nextRenders );
+	m_nextRenders.clear();
+	//get the hostname
+	int hostlen=32;
+	char hostname[32] = "localhost";
+	if( !m_bLocalhost )
+	{
+		status = gethostname(hostname,hostlen);
+		CHECKERRNO( status, "[liqMayaRenderView] gethostname(hostname)", );
+	}
+	//create socket, bound to address and port
+	s = createSocket(hostname,m_port);
+	if ( s == -1 ) return MS::kFailure;
 
-		struct sockaddr_in clientName;
-		int clientLength = sizeof(clientName);
-		memset( &clientName, 0, sizeof( clientName ) );
+	// what an interrupted render of the same RIB already received
+	m_resumed = loadCheckpoint();
+	m_resuming = m_resumed != NULL;
 
-		slaveSocket = accept( s,(struct sockaddr *) &clientName,(socklen_t*)(&clientLength));
-		if ( -1 == slaveSocket ) 
-    {
-			perror( "[liqMayaRenderView] accept()" );
-			closesocket(s);
-			return MS::kFailure;
-		}
-		int val = 1;
-		setsockopt( slaveSocket, IPPROTO_TCP, TCP_NODELAY, (const char *) &val, sizeof( int ) );
-		#ifdef SO_NOSIGPIPE
-		setsockopt( slaveSocket, SOL_SOCKET, SO_NOSIGPIPE, (const char *) &val, sizeof( int ) );
-		#endif
+	m_socket = s;
+	if ( !m_receiver.start( receive, this ) )
+	{
+		ERROR( "[liqMayaRenderView] cannot start the receiving thread" );
+		closesocket( s );
+		return MS::kFailure;
+	}
+	MStatus timerStatus;
+	m_timer = MTimerMessage::addTimerCallback( 1.0f / ( m_refreshRate ? m_refreshRate : 1 ), refresh, this, &timerStatus );
+	if ( timerStatus != MS::kSuccess )
+	{
+		ERROR( "[liqMayaRenderView] cannot add the refresh callback" );
+		m_mutex.lock();
+		m_stop = true;
+		m_mutex.unlock();
+		m_receiver.join();
+		closesocket( s );
+		return MS::kFailure;
+	}
+	m_liveRender = this;
+	return MS::kSuccess;
+}
 
-		//get image name
-		char imagename[128];
-#ifdef _WIN32    
-		memset( imagename, 0, 128*sizeof( char ) );
-#else
-	  bzero( imagename, 128*sizeof( char ) );
-#endif    
-		// get width/height/num channels
-		// imageInfo imgInfo;
-		imageInfo imgInfo;
-#ifndef _WIN32
-//		sleep(1);
-#else
-//		Sleep(1000);
-#endif
-		status = readSockData(slaveSocket, (char*)&imgInfo, sizeof(imageInfo));
-		if ( -1 == status ) 
-    {
-			perror( "[liqMayaRenderView] read()" );
-			closesocket(s);
-			return MS::kFailure;
+//maya's main thread, m_refreshRate times a second: show what the receiver staged
+void liqMayaRenderCmd::refresh( float elapsedTime, float lastTime, void *cmd )
+{
+	liqMayaRenderCmd *self = (liqMayaRenderCmd*)cmd;
+	self->m_mutex.lock();
+	const bool done( self->m_receiverDone );
+	self->m_mutex.unlock();
+	self->flush();
+	liqProcessLauncher::flush();
+	if ( done ) self->finish();
+}
+
+//interrupt the render, and the renders liquid launched for it but not the other ones still running
+void liqMayaRenderCmd::stop()
+{
+	ERROR( "[liqMayaRenderView] render aborted" );
+	m_mutex.lock();
+	m_stop = true;
+	// a receiver blocked on a display driver returns at once
+	for ( unsigned int i(0); i < m_connections.size(); i++ )
+		if ( m_connections[ i ]->socket != -1 ) shutdown( m_connections[ i ]->socket, SHUT_RDWR );
+	m_mutex.unlock();
+	liqProcessLauncher::cancel( m_renders );
+}
+
+void liqMayaRenderCmd::stopRender()
+{
+	if ( !m_liveRender ) return;
+	m_liveRender->stop();
+	m_liveRender->finish();
+}
+
+//the receiver is done: the stats, the checkpoint and the bucket files of the render
+void liqMayaRenderCmd::finish()
+{
+	m_receiver.join();
+	MMessage::removeCallback( m_timer );
+	closesocket( m_socket );
+	m_socket = -1;
+	// the last buckets and errors
+	flush();
+	liqProcessLauncher::flush();
+
+	// buckets/s, bytes/s and waits tell whether the renderer, the network or maya holds the render
+	m_stats.updates = m_updateStats.updates;
+	m_stats.update = m_updateStats.update;
+	m_stats.finish();
+	m_lastStats = m_stats;
+	m_lastStatsImage = m_shown ? m_shown->info.name : m_image.asChar();
+	if ( m_statsFile != "" && !m_stats.append( m_statsFile.asChar(), "renderView", m_lastStatsImage.c_str() ) )
+		ERROR( "[liqMayaRenderView] cannot write the stats to " + m_statsFile );
+
+	// a finished render leaves nothing to resume
+	if ( m_journal.isOpen() )
+	{
+		if ( !m_stop && m_shown && isComplete( m_shown->info ) ) m_journal.remove();
+		else m_journal.close();
+	}
+	delete m_resumed;
+	m_resumed = NULL;
+	m_journaled.clear();
+
+	// the crop windows of a split frame, and the buckets of a resumed render, go in one bucket file
+	vector<connection*> &connections = m_connections;
+	for ( unsigned int i(0); i < connections.size(); i++ )
+		for ( unsigned int j( i + 1 ); j < connections.size(); )
+			if ( isSameImage( connections[ i ]->info, connections[ j ]->info ) )
+			{
+				connections[ i ]->merge( *connections[ j ] );
+				delete connections[ j ];
+				connections.erase( connections.begin() + j );
+			}
+			else j++;
+
+	// the displayed image goes last: it is the one -lastRenderFiles ends with
+	connection *shown = m_shown;
+	for ( unsigned int i(0); i + 1 < connections.size(); i++ )
+		if ( connections[ i ] == shown ) std::swap( connections[ i ], connections[ i + 1 ] );
+	for ( unsigned int i(0); i < connections.size(); i++ )
+	{
+		connection *c = connections[ i ];
+		MString file( c == shown ? m_bucketFile : MString( "" ) );
+		if ( file == "" )
+		{
+			char* tmp = getenv( "TEMP" );
+			if ( tmp )
+			{
+				string tmpname( tmp );
+				tmpname += "/liqRVXXXXXX";
+				if ( mktemp( (char *)tmpname.c_str()) ) file = tmpname.c_str();
+			}
+			if ( c == shown ) m_bucketFile = file;
 		}
-    
-		// printf("[liqMayaRenderView] imgInfo: %d %d %d %d %d %d (%d)\n", imgInfo.width, imgInfo.height, imgInfo.xo, imgInfo.yo, imgInfo.wo, imgInfo.ho, imgInfo.channels ); 
+		if ( file != "" && ( c == shown || !c->buckets.empty() ) ) writeBuckets( file.asChar(), c->buckets, c->info );
+		delete c;
+	}
+	connections.clear();
+	m_shown = NULL;
+	MRenderView::endRender();
+	m_liveRender = NULL;
+	// liquid saves the image of each render
+	MGlobal::executeCommandOnIdle( "liquidSaveRenderViewImage()" );
+	delete this;
+}
+void* liqMayaRenderCmd::receive( void *cmd )
+{
+	liqMayaRenderCmd *self = (liqMayaRenderCmd*)cmd;
+	self->receiveConnections();
+	self->m_mutex.lock();
+	self->m_receiverDone = true;
+	self->m_mutex.unlock();
+	return NULL;
+}
 
-		if ( !m_bDoRegionRender ) 
-      MRenderView::startRender ( imgInfo.wo, imgInfo.ho, false, true );
-		else 
-      MRenderView::startRegionRender ( imgInfo.wo, imgInfo.ho, 
-																			 imgInfo.xo, imgInfo.yo, 
-																			 imgInfo.xo + imgInfo.width,
-																			 imgInfo.yo + imgInfo.height, false, true );
-		vector<bucket*> buckets;
-		bool bTestEnd;
-		MComputation renderComputation;
-		renderComputation.beginComputation();
-
-		while ( true ) 
-    {
-			if ( renderComputation.isInterruptRequested() )
-      {
-				ERROR( "[liqMayaRenderView] render aborted" );
-				break;
+//receiving thread: every image and AOV of the render comes through its own connection,
+//the first one matching -image is staged for display, all of them are kept for the bucket files.
+//a split frame sends each of its crop windows through a connection of its own.
+void liqMayaRenderCmd::receiveConnections()
+{
+	vector<connection*> &connections = m_connections;
+	unsigned int displayed = 0;
+	time_t lastActivity = time( NULL );
+	while ( true ) 
+	{
+		if ( stopped() ) break;
+
+		bool received = false;
+		while ( waitSocket( m_socket, 0, true ) > 0 )
+		{
+			connection *c = acceptConnection( m_socket );
+			if ( !c ) break;
+			m_mutex.lock();
+			connections.push_back( c );
+			m_mutex.unlock();
+			received = true;
+			if ( m_shown ? !isSameImage( c->info, m_shown->info ) : !isSelected( *c ) ) continue;
+			c->displayed = true;
+			displayed++;
+			if ( m_shown ) continue;
+			// printf("[liqMayaRenderView] imgInfo: %d %d %d %d %d %d (%d)\n", c->info.width, c->info.height, c->info.xo, c->info.yo, c->info.wo, c->info.ho, c->info.channels ); 
+			setStaging( c->info );
+			m_mutex.lock();
+			m_shown = c;
+			m_mutex.unlock();
+			startCheckpoint( *c );
+		}
+		bool pending = false, shared = false;
+		for ( unsigned int i(0); i < connections.size(); i++ )
+		{
+			connection &c = *connections[ i ];
+			if ( c.done ) continue;
+			pending = true;
+			if ( c.framebuffer ) 
+			{
+				shared = true;
+				bool got = false;
+				if ( getSharedBuckets( c, c.displayed, got ) != MS::kSuccess ) c.done = true;
+				received = received || got;
+				continue;
 			}
+			if ( waitSocket( c.socket, 0, true ) <= 0 ) continue;
 			try
-      {
+			{
+				bool bTestEnd;
 				bucket *b = new bucket;
-        retStatus = getBucket( slaveSocket, imgInfo.channels, b, bTestEnd );
-				if ( retStatus != MS::kSuccess )
-        {
+				MStatus status = getBucket( c.socket, c.info.channels, c.info.encoding, b, bTestEnd );
+				received = true;
+				if ( status != MS::kSuccess )
+				{
 					delete b;
-					if ( bTestEnd ) break;
-					else continue;
+					c.done = bTestEnd;
+					continue;
 				}
-				renderBucket( b, imgInfo );
-				buckets.push_back( b );
+				if ( c.displayed ) 
+				{
+					renderBucket( b, c.info );
+					checkpoint( c, b );
+				}
+				c.buckets.push_back( b );
 			}
 			catch(...)
 			{
-				ERROR( "[liqMayaRenderView] exception caught" );
-				break;
+				receiverError( "[liqMayaRenderView] exception caught" );
+				c.done = true;
 			}
 		}
-		renderComputation.endComputation();
-		closesocket( slaveSocket );
-		closesocket( s );
-
-		if ( m_bucketFile == "" )
-    {
-			char* tmp = getenv( "TEMP" );
-			if ( tmp )
-      {
-				string tmpname( tmp );
-				tmpname += "/liqRVXXXXXX";
-        if ( mktemp( (char *)tmpname.c_str()) ) m_bucketFile = tmpname.c_str();
-			}
+		if ( !pending && displayed >= m_connectionCount && waitSocket( m_socket, 0, true ) <= 0 ) break;
+		if ( received ) 
+		{
+			lastActivity = time( NULL );
+			continue;
+		}
+		if ( time( NULL ) - lastActivity > (time_t)m_timeout )
+		{
+			if ( connections.empty() ) receiverError( "[liqMayaRenderView] timeout reached, display driver didn't respond in time. Aborting" );
+			else receiverError( "[liqMayaRenderView] timeout reached, aborting" );
+			break;
 		}
-		if ( m_bucketFile != "" ) writeBuckets( m_bucketFile.asChar(), buckets, imgInfo );
-		 
-		// delete the buckets
-		for ( unsigned int i(0); i< buckets.size(); i++ ) if ( buckets[ i ] ) delete buckets[ i ];
-	  buckets.clear();
+		// shared framebuffers are polled, sockets wake us up as soon as data arrives
+		waitConnections( m_socket, connections, shared ? 2 : 100 );
 	}
-	MRenderView::endRender();
-  return MS::kSuccess;
 }
+
+//errors of the receiving thread are shown by the main thread
+void liqMayaRenderCmd::receiverError( const string &message )
+{
+	m_mutex.lock();
+	m_errors.push_back( message );
+	m_mutex.unlock();
+}
+
 //read a bucket from the connection, bucket should have been allocated before.
 MStatus liqMayaRenderCmd::getBucket( const int socket, 
 																		 const unsigned int numChannels,
+																		 const int encoding,
 																		 bucket* b,
 																		 bool &theEnd )
 {
@@ -328,9 +540,11 @@ MStatus liqMayaRenderCmd::getBucket( const int socket,
 	MStatus status = MS::kSuccess;
 	theEnd = false;
 	errno =0;
-	if ( !waitSocket( socket, m_timeout, true ) )
+	const double start( liqRenderStats::now() );
+	double decoding( 0 ), received( 5 * sizeof( int ) );
+	if ( !waitData( socket ) )
   {
-		ERROR( "[liqMayaRenderView] timeout reached, aborting" );
+		if ( !stopped() ) receiverError( "[liqMayaRenderView] timeout reached, aborting" );
 		return MS::kFailure;
 	}
 
@@ -338,7 +552,7 @@ MStatus liqMayaRenderCmd::getBucket( const int socket,
 	int bucketInfo[5];
 
 	//stat = read(socket, bucketInfo, 5*sizeof(int));
-  stat = readSockData( socket, (char*) bucketInfo, 5 * sizeof( int ) );
+  stat = readData( socket, (char*) bucketInfo, 5 * sizeof( int ) );
   
 //	if (stat < 0) {
 //		perror("[liqMayaRenderView] recv(slaveSocket)");
@@ -346,7 +560,7 @@ MStatus liqMayaRenderCmd::getBucket( const int socket,
 //	}
 	if ( !stat )
   {
-		perror( "[liqMayaRenderView] read(slaveSocket, bucketInfo)" );
+		if ( !stopped() ) perror( "[liqMayaRenderView] read(slaveSocket, bucketInfo)" );
 		theEnd = true;
 		return MS::kFailure;
 	}
@@ -390,19 +604,40 @@ MStatus liqMayaRenderCmd::getBucket( const int socket,
 		theEnd = true;
 		return MS::kFailure;
 	}
-	//get the data
-	BUCKETDATATYPE *data =  new BUCKETDATATYPE[ size ];
-	if ( !data ) 
+	//get the data, in buffers kept from one bucket to the next
+	m_bucketData.resize( size / sizeof( BUCKETDATATYPE ) );
+	BUCKETDATATYPE *data = &m_bucketData[0];
+	
+  if ( encoding != liqBucketCodec::kFloat )
   {
-		perror( "[liqMayaRenderView] cannot allocate memory for data" );
-		return MS::kInsufficientMemory;
+		liqBucketCodec::payload header;
+		stat = readData( socket, (char*)&header, sizeof( liqBucketCodec::payload ) );
+		if ( stat && header.size > size + size / 255 + 16 ) 
+		{
+			receiverError( "[liqMayaRenderView] bad bucket payload size" );
+			stat = false;
+		}
+		m_encoded.resize( stat ? header.size : 0 );
+		if ( stat && header.size ) stat = readData( socket, (char*)&m_encoded[0], header.size );
+		received += sizeof( liqBucketCodec::payload ) + m_encoded.size();
+		decoding = liqRenderStats::now();
+		if ( stat && !liqBucketCodec::decode( header, size / ( numChannels * sizeof( BUCKETDATATYPE ) ), numChannels, 
+		                                      m_encoded.empty() ? NULL : &m_encoded[0], data, m_decodeScratch ) ) 
+		{
+			receiverError( "[liqMayaRenderView] cannot decode " + liqBucketCodec::name( header.encoding ) + " bucket" );
+			stat = false;
+		}
+		decoding = liqRenderStats::now() - decoding;
+	}
+	else
+	{
+		stat = readData( socket, (char*)data, size );
+		received += size;
 	}
-	
-  stat = readSockData( socket, (char*)data, size );
 	if ( !stat )
   {
-		perror( "[liqMayaRenderView] read()" );
-		 return MS::kFailure;
+		if ( !stopped() ) perror( "[liqMayaRenderView] read()" );
+		return MS::kFailure;
 	}
 	else
 	{
@@ -411,73 +646,369 @@ MStatus liqMayaRenderCmd::getBucket( const int socket,
 			perror( "[liqMayaRenderView] Error b->set(info,data" );
 			status = MS::kFailure;
 		}
-		delete[] data;
+		m_stats.addBucket( received, liqRenderStats::now() - start - decoding, decoding );
 	}
 	return status;
 }
 
+//accept a display driver connection and answer its handshake: the bucket
+//encoding we can decode, or a shared framebuffer for a driver on this machine.
+liqMayaRenderCmd::connection* liqMayaRenderCmd::acceptConnection( const int s )
+{
+	struct sockaddr_in clientName;
+	int clientLength = sizeof(clientName);
+	memset( &clientName, 0, sizeof( clientName ) );
+
+	connection *c = new connection;
+	c->socket = accept( s,(struct sockaddr *) &clientName,(socklen_t*)(&clientLength));
+	if ( -1 == c->socket ) 
+  {
+		perror( "[liqMayaRenderView] accept()" );
+		delete c;
+		return NULL;
+	}
+	int val = 1;
+	setsockopt( c->socket, IPPROTO_TCP, TCP_NODELAY, (const char *) &val, sizeof( int ) );
+	#ifdef SO_NOSIGPIPE
+	setsockopt( c->socket, SOL_SOCKET, SO_NOSIGPIPE, (const char *) &val, sizeof( int ) );
+	#endif
+
+	// get width/height/num channels and the image name
+	imageInfo &imgInfo = c->info;
+	if ( !readData( c->socket, (char*)&imgInfo, sizeof(imageInfo) ) ) 
+  {
+		if ( !stopped() ) perror( "[liqMayaRenderView] read()" );
+		delete c;
+		return NULL;
+	}
+	imgInfo.name[ sizeof( imgInfo.name ) - 1 ] = 0;
+	imgInfo.channelNames[ sizeof( imgInfo.channelNames ) - 1 ] = 0;
+
+	const int requested( imgInfo.encoding );
+	imgInfo.encoding = liqBucketCodec::accept( requested );
+	if ( ( requested & liqBucketCodec::kSharedMemory ) && liqSharedFramebuffer::isLocalConnection( c->socket ) )
+	{
+		c->framebuffer = new liqSharedFramebuffer;
+		if ( c->framebuffer->create( liqSharedFramebuffer::uniqueName(), imgInfo.width, imgInfo.height, imgInfo.channels ) )
+			imgInfo.encoding = liqBucketCodec::kSharedMemory;
+	}
+	if ( send( c->socket, (const char*)&imgInfo.encoding, sizeof( int ), 0 ) != sizeof( int ) ) 
+  {
+		perror( "[liqMayaRenderView] send(encoding)" );
+		delete c;
+		return NULL;
+	}
+	if ( imgInfo.encoding == liqBucketCodec::kSharedMemory )
+	{
+		char name[ liqSharedFramebuffer::kNameSize ];
+		memset( name, 0, sizeof( name ) );
+		strncpy( name, c->framebuffer->name().c_str(), sizeof( name ) - 1 );
+		int mapped( 0 );
+		if ( send( c->socket, name, sizeof( name ), 0 ) != sizeof( name ) || 
+				 !readData( c->socket, (char*)&mapped, sizeof( int ) ) || !mapped )
+		{
+			// the driver falls back to raw buckets on the socket
+			imgInfo.encoding = liqBucketCodec::kFloat;
+		}
+	}
+	if ( imgInfo.encoding != liqBucketCodec::kSharedMemory )
+	{
+		delete c->framebuffer;
+		c->framebuffer = NULL;
+	}
+	return c;
+}
+
+//the image to display: the first one whose name or channels contain -image.
+bool liqMayaRenderCmd::isSelected( const connection &c ) const
+{
+	if ( m_image == "" ) return true;
+	return strstr( c.info.name, m_image.asChar() ) || strstr( c.info.channelNames, m_image.asChar() );
+}
+
+//connections of one image: the crop windows of a split frame
+bool liqMayaRenderCmd::isSameImage( const imageInfo &a, const imageInfo &b )
+{
+	return !strcmp( a.name, b.name ) && !strcmp( a.channelNames, b.channelNames ) && 
+	       a.wo == b.wo && a.ho == b.ho && a.channels == b.channels;
+}
+
+//take the buckets of another crop window of the image, the data window grows to hold both
+void liqMayaRenderCmd::connection::merge( connection &piece )
+{
+	const int xo = std::min( info.xo, piece.info.xo );
+	const int yo = std::min( info.yo, piece.info.yo );
+	const int width = std::max( info.xo + info.width, piece.info.xo + piece.info.width ) - xo;
+	const int height = std::max( info.yo + info.height, piece.info.yo + piece.info.height ) - yo;
+	for ( unsigned int i(0); i < buckets.size(); i++ ) buckets[ i ]->offset( info.xo - xo, info.yo - yo );
+	for ( unsigned int i(0); i < piece.buckets.size(); i++ ) 
+	{
+		piece.buckets[ i ]->offset( piece.info.xo - xo, piece.info.yo - yo );
+		buckets.push_back( piece.buckets[ i ] );
+	}
+	piece.buckets.clear();
+	info.xo = xo;
+	info.yo = yo;
+	info.width = width;
+	info.height = height;
+}
+
+liqMayaRenderCmd::connection::~connection()
+{
+	for ( unsigned int i(0); i< buckets.size(); i++ ) if ( buckets[ i ] ) delete buckets[ i ];
+	delete framebuffer;
+	if ( socket != -1 ) closesocket( socket );
+}
+
+//get the buckets a local display driver published in its shared framebuffer
+//since the last call, done is set once it finished or went away.
+MStatus liqMayaRenderCmd::getSharedBuckets( connection &c, const bool render, bool &received )
+{
+	liqSharedFramebuffer &framebuffer = *c.framebuffer;
+	vector<BUCKETDATATYPE> &data = m_bucketData;
+	bucket::bucketInfo info;
+	received = false;
+	while ( framebuffer.read( info ) )
+	{
+		if ( render ) renderBucket( info, framebuffer.pixels( info.left, info.bottom ), framebuffer.width(), c.info );
+		//keep a copy for the bucket file
+		const unsigned int row = ( info.right - info.left ) * info.channels;
+		data.resize( row * ( info.top - info.bottom ) );
+		for ( unsigned int y = info.bottom; y < info.top; y++ )
+			memcpy( &data[ ( y - info.bottom ) * row ], framebuffer.pixels( info.left, y ), row * sizeof( BUCKETDATATYPE ) );
+		bucket *b = new bucket;
+		if ( b->set( info, &data[0] ) ) delete b;
+		else 
+		{
+			if ( render ) checkpoint( c, b );
+			c.buckets.push_back( b );
+		}
+		m_stats.addBucket( data.size() * sizeof( BUCKETDATATYPE ), 0, 0 );
+		received = true;
+	}
+	if ( framebuffer.finished() ) 
+	{
+		c.done = true;
+		return MS::kSuccess;
+	}
+	//the socket only becomes readable when the display driver goes away
+	char ch;
+	if ( waitSocket( c.socket, 0, true ) && recv( c.socket, &ch, 1, 0 ) <= 0 && !stopped() )
+	{
+		receiverError( "[liqMayaRenderView] display driver connection lost" );
+		return MS::kFailure;
+	}
+	return MS::kSuccess;
+}
+
 MStatus liqMayaRenderCmd::renderBucket( const bucket* b, const imageInfo &imgInfo )
 {
-	MStatus status;
-	unsigned int nPixels, lineSize, n, x, y;
+  if ( !b ) return MS::kFailure;
+	const bucket::bucketInfo &binfo = b->getInfo();
+	return renderBucket( binfo, b->getPixels(), binfo.right - binfo.left, imgInfo );
+}
+
+//quantize a bucket whose rows are stride pixels apart into the staging framebuffer
+MStatus liqMayaRenderCmd::renderBucket( const bucket::bucketInfo &binfo, 
+																				const BUCKETDATATYPE *data, 
+																				const unsigned int stride,
+																				const imageInfo &imgInfo )
+{
+	unsigned int y;
 
 	// printf("[liqMayaRenderView] renderBucket...\n");
   
-  if ( !b ) return MS::kFailure;
-	const bucket::bucketInfo &binfo = b->getInfo();
 	const unsigned int &left	  = binfo.left;
 	const unsigned int &right	  = binfo.right	;
 	const unsigned int &bottom	= binfo.bottom;
 	const unsigned int &top		  = binfo.top;
 	const unsigned int &channels = binfo.channels;
 
-	const BUCKETDATATYPE *data =  b->getPixels();
-	
+	const unsigned int &Xo = imgInfo.xo;
+	const unsigned int &Yo = imgInfo.yo;
+	const unsigned int &height = imgInfo.ho;
+
 	if ( !data ) return MS::kFailure;
-	
-	nPixels = ( right - left ) * ( top - bottom );
-	RV_PIXEL *pixels = new RV_PIXEL[ nPixels ];
-	if ( !pixels ) 
-  {
-		ERROR( "[liqMayaRenderView] cannot allocate memory for pixels" );
-		return  MS::kInsufficientMemory;
+	if ( left >= right || bottom >= top || Xo + right > m_stagingWidth || Yo + top > height || height > m_stagingHeight ) return MS::kFailure;
+
+	const float quantize[4] = { (float)m_quantize[0], (float)m_quantize[1], (float)m_quantize[2], (float)m_quantize[3] };
+	const double start( liqRenderStats::now() );
+	m_mutex.lock();
+	// maya's rows go bottom up, each bucket row is flipped straight into place
+	for ( y = bottom ; y < top ;  y++ ) 
+		liqQuantizePixels( data + ( y - bottom ) * stride * channels, right - left, channels, quantize, 0.5, 
+		                   (float*)&m_staging[ ( height - 1 - Yo - y ) * m_stagingWidth + Xo + left ] );
+	// grow the region the next flush shows
+	const unsigned int region[4] = { Xo + left, Xo + right - 1, height - Yo - top, height - Yo - bottom - 1 };
+	if ( !m_dirty ) 
+		memcpy( m_region, region, sizeof( region ) );
+	else
+	{
+		m_region[0] = std::min( m_region[0], region[0] );
+		m_region[1] = std::max( m_region[1], region[1] );
+		m_region[2] = std::min( m_region[2], region[2] );
+		m_region[3] = std::max( m_region[3], region[3] );
 	}
-#ifdef _WIN32	
-  memset( pixels, 0, nPixels * sizeof( RV_PIXEL ) );
-#else
-	bzero( pixels, nPixels * sizeof( RV_PIXEL ) );
-#endif  
-	RV_PIXEL* img_ptr = pixels;
-	lineSize = right - left;
-	pixels = img_ptr + nPixels;
-	
-	for ( y = bottom, n = 1 ; y < top ;  y++, n++ ) 
-  {
-		pixels = img_ptr + nPixels - n * lineSize;
-		for ( x = left ; x < right ; x++ ) 
-    {
-			(*pixels).r = quantize( *( data ),   m_quantize[0], m_quantize[1], m_quantize[2], m_quantize[3], 0.5 );
-			(*pixels).g = quantize( *( data + 1),m_quantize[0], m_quantize[1], m_quantize[2], m_quantize[3], 0.5 );
-			(*pixels).b = quantize( *( data + 2),m_quantize[0], m_quantize[1], m_quantize[2], m_quantize[3], 0.5 );
-			
-			if( imgInfo.channels > 3 )
-				(*pixels).a = quantize( *( data + 3), m_quantize[0], m_quantize[1], m_quantize[2], m_quantize[3], 0.5 );
-      data += channels;
-      ++pixels;
+	m_dirty = true;
+	m_mutex.unlock();
+	// quantizing counts with decoding
+	m_stats.codec += liqRenderStats::now() - start;
+	return MS::kSuccess;
+}
+
+//the buckets a previous render of the same RIB saved in the checkpoint journal,
+//as a connection whose data window is their bounding box
+liqMayaRenderCmd::connection* liqMayaRenderCmd::loadCheckpoint()
+{
+	if ( m_checkpoint == "" ) return NULL;
+	connection *c = new connection;
+	vector<bucket::bucketInfo> areas;
+	string hash;
+	if ( !liqBucketJournal::read( m_checkpoint.asChar(), c->info, hash, areas, c->buckets ) || 
+	     hash != m_checkpointHash.asChar() || c->buckets.empty() )
+	{
+		delete c;
+		return NULL;
+	}
+	unsigned int bounds[4] = { areas[0].left, areas[0].right, areas[0].bottom, areas[0].top };
+	for ( unsigned int i(1); i < areas.size(); i++ )
+	{
+		bounds[0] = std::min( bounds[0], areas[ i ].left );
+		bounds[1] = std::max( bounds[1], areas[ i ].right );
+		bounds[2] = std::min( bounds[2], areas[ i ].bottom );
+		bounds[3] = std::max( bounds[3], areas[ i ].top );
+	}
+	for ( unsigned int i(0); i < c->buckets.size(); i++ ) c->buckets[ i ]->offset( -(int)bounds[0], -(int)bounds[2] );
+	c->info.xo = bounds[0];
+	c->info.yo = bounds[2];
+	c->info.width = bounds[1] - bounds[0];
+	c->info.height = bounds[3] - bounds[2];
+	c->done = c->displayed = true;
+	return c;
+}
+
+//receiving thread: journal the displayed image, starting with what a resumed
+//render already had, which is shown right away and kept for the bucket file
+void liqMayaRenderCmd::startCheckpoint( const connection &shown )
+{
+	if ( m_checkpoint == "" ) return;
+	if ( m_resumed && !isSameImage( m_resumed->info, shown.info ) )
+	{
+		delete m_resumed;
+		m_resumed = NULL;
+	}
+	vector<bucket*> kept;
+	if ( m_resumed )
+		for ( unsigned int i(0); i < m_resumed->buckets.size(); i++ )
+		{
+			bucket *b = m_resumed->buckets[ i ];
+			renderBucket( b, m_resumed->info );
+			b->offset( m_resumed->info.xo, m_resumed->info.yo );
+			kept.push_back( b );
+			m_journaled.push_back( b->getInfo() );
 		}
+	imageInfo whole = shown.info;
+	whole.xo = whole.yo = 0;
+	whole.width = whole.wo;
+	whole.height = whole.ho;
+	if ( !m_journal.create( m_checkpoint.asChar(), m_checkpointHash.asChar(), whole, m_cacheEncoding, kept ) )
+		receiverError( string( "[liqMayaRenderView] cannot write the checkpoint " ) + m_checkpoint.asChar() );
+	if ( !m_resumed ) return;
+	for ( unsigned int i(0); i < kept.size(); i++ ) kept[ i ]->offset( -m_resumed->info.xo, -m_resumed->info.yo );
+	m_mutex.lock();
+	m_connections.push_back( m_resumed );
+	m_mutex.unlock();
+	m_resumed = NULL;
+}
+
+//receiving thread: save a bucket of the displayed image as soon as it arrives
+void liqMayaRenderCmd::checkpoint( const connection &c, const bucket *b )
+{
+	if ( !m_journal.isOpen() ) return;
+	bucket::bucketInfo info = b->getInfo();
+	info.left += c.info.xo;
+	info.right += c.info.xo;
+	info.bottom += c.info.yo;
+	info.top += c.info.yo;
+	if ( !m_journal.append( info, b->getPixels() ) ) 
+	{
+		receiverError( string( "[liqMayaRenderView] cannot write the checkpoint " ) + m_checkpoint.asChar() );
+		m_journal.close();
+		return;
 	}
-	pixels = img_ptr;
+	m_journaled.push_back( info );
+}
 
-	const unsigned int &Xo = imgInfo.xo;
-	const unsigned int &Yo = imgInfo.yo;
-	const unsigned int &height = imgInfo.ho;
-	
-	MRenderView::updatePixels ( Xo + left , Xo + right - 1, height -Yo -top, height - bottom - Yo - 1 , pixels );
-	MRenderView::refresh ( Xo + left, Xo + right - 1, height - Yo - top, height - Yo -bottom - 1 );
+//the journal covers the whole data window of the image
+bool liqMayaRenderCmd::isComplete( const imageInfo &imgInfo ) const
+{
+	vector<unsigned char> mask;
+	liqBucketJournal::coverage( m_journaled, imgInfo.wo, imgInfo.ho, mask );
+	for ( int y = imgInfo.yo; y < imgInfo.yo + imgInfo.height; y++ )
+		for ( int x = imgInfo.xo; x < imgInfo.xo + imgInfo.width; x++ )
+			if ( x < 0 || y < 0 || x >= imgInfo.wo || y >= imgInfo.ho || !mask[ (size_t)y * imgInfo.wo + x ] ) return false;
+	return true;
+}
 
-	delete[] pixels;
+//clear the staging framebuffer for an image
+void liqMayaRenderCmd::setStaging( const imageInfo &imgInfo )
+{
+	RV_PIXEL black;
+	black.r = black.g = black.b = black.a = 0;
+	m_mutex.lock();
+	m_stagingWidth = imgInfo.wo;
+	m_stagingHeight = imgInfo.ho;
+	m_staging.assign( (size_t)m_stagingWidth * m_stagingHeight, black );
+	m_dirty = false;
+	m_mutex.unlock();
+}
 
-	return status;
+//show the staged pixels that changed since the last call, from maya's main thread:
+//one update for all the buckets that arrived in between.
+void liqMayaRenderCmd::flush()
+{
+	m_mutex.lock();
+	vector<string> errors;
+	errors.swap( m_errors );
+	imageInfo info;
+	const bool start( m_shown && !m_started );
+	if ( start ) info = m_shown->info;
+	unsigned int region[4];
+	const bool dirty( m_dirty && ( m_started || start ) );
+	if ( dirty )
+	{
+		memcpy( region, m_region, sizeof( region ) );
+		const unsigned int width( region[1] - region[0] + 1 );
+		m_flushed.resize( width * ( region[3] - region[2] + 1 ) );
+		for ( unsigned int y = region[2]; y <= region[3]; y++ )
+			memcpy( &m_flushed[ ( y - region[2] ) * width ], &m_staging[ y * m_stagingWidth + region[0] ], width * sizeof( RV_PIXEL ) );
+		m_dirty = false;
+	}
+	m_mutex.unlock();
+
+	for ( unsigned int i(0); i < errors.size(); i++ ) ERROR( errors[ i ].c_str() );
+	if ( start )
+	{
+		unsigned int left, right, bottom, top;
+		if ( !m_bDoRegionRender ) 
+			MRenderView::startRender ( info.wo, info.ho, false, true );
+		else if ( ( m_connectionCount > 1 || m_resuming ) && MRenderView::getRenderRegion( left, right, bottom, top ) == MS::kSuccess )
+			// a split frame, or a resumed one: the image only covers part of the render region
+			MRenderView::startRegionRender ( info.wo, info.ho, left, right, bottom, top, false, true );
+		else 
+			MRenderView::startRegionRender ( info.wo, info.ho, 
+																			 info.xo, info.yo, 
+																			 info.xo + info.width,
+																			 info.yo + info.height, false, true );
+		m_started = true;
+	}
+	if ( dirty )
+	{
+		const double start( liqRenderStats::now() );
+		MRenderView::updatePixels ( region[0], region[1], region[2], region[3], &m_flushed[0] );
+		MRenderView::refresh ( region[0], region[1], region[2], region[3] );
+		m_updateStats.addUpdate( liqRenderStats::now() - start );
+	}
 }
 
 MStatus liqMayaRenderCmd::undoIt()
@@ -504,11 +1035,21 @@ MSyntax liqMayaRenderCmd::newSyntax()
 	syntax.addFlag( "-l", "-localhost", MSyntax::kBoolean );
 	syntax.addFlag( "-qz", "-quantize", MSyntax::kDouble, MSyntax::kDouble, MSyntax::kDouble, MSyntax::kDouble );
 	syntax.addFlag( "-t", "-timeout", MSyntax::kLong );
+	syntax.addFlag( "-rr", "-refreshRate", MSyntax::kLong );
+	syntax.addFlag( "-cn", "-connections", MSyntax::kLong );
 	syntax.addFlag( "-rff", "-renderFromFile", MSyntax::kBoolean );
 	syntax.addFlag( "-bf", "-bucketFile", MSyntax::kString );
+	syntax.addFlag( "-ce", "-cacheEncoding", MSyntax::kString );
 	syntax.addFlag( "-lr", "-lastRenderFiles");
+	syntax.addFlag( "-li", "-lastRenderImages");
+	syntax.addFlag( "-st", "-stats");
+	syntax.addFlag( "-sf", "-statsFile", MSyntax::kString );
+	syntax.addFlag( "-ck", "-checkpoint", MSyntax::kString );
+	syntax.addFlag( "-ckh", "-checkpointHash", MSyntax::kString );
+	syntax.addFlag( "-im", "-image", MSyntax::kString );
 	syntax.addFlag( "-rg", "-renderRegion");
 	syntax.addFlag( "-drg", "-doRegion");
+	syntax.addFlag( "-sp", "-stop");
   syntax.useSelectionAsDefault( false );
   return syntax;
 }
@@ -601,119 +1142,74 @@ MObject getNode( MString name, MStatus *returnStatus )
 }
 
 
+//keep the buckets of an image in a tiled bucket cache file
 MStatus liqMayaRenderCmd::writeBuckets( const char* file, const vector<bucket*> &buckets, const imageInfo &info ) const
 {
-	MStatus status;
-	unsigned int i;
-	FILE *fh = fopen ( file, "wb" );
-	if( !fh )
+	string error;
+	if ( !liqBucketCache::write( file, buckets, info, m_cacheEncoding, error ) )
 	{
-		ERROR( "[liqMayaRenderCmd] couldn't open " + file + " for writing" );
+		ERROR( "[liqMayaRenderCmd] " + error.c_str() );
 		return MS::kFailure;
 	}
-	fwrite ( &info, sizeof( imageInfo ), 1, fh );
-	if ( ferror( fh ) )
-  { 
-    ERROR( "[liqMayaRenderCmd] error writing imageInfo" ); 
-    fclose ( fh ); 
-    return MS::kFailure;
-  }
-
-	unsigned int numBuckets = buckets.size();
-	fwrite ( &numBuckets, sizeof( unsigned int ), 1, fh );
-	if ( ferror(fh) )
-  { 
-    fclose ( fh ); 
-    return MS::kFailure;
-  }
-
-	for(i = 0 ; i< buckets.size() ; i++ )
-  {
-		const bucket *b = buckets[i];
-		if ( !b ) continue;
-		fwrite ( &b->getInfo(), sizeof( bucket::bucketInfo ), 1, fh );
-		if ( ferror( fh ) )
-		{
-			ERROR( "[liqMayaRenderCmd] error writing bucketInfo" );
-			status = MS::kFailure;
-			break;
-		}
-		unsigned int size = b->getSize();
-		fwrite ( b->getPixels(), size, 1, fh );
-		if ( ferror( fh ) )
-		{
-			status = MS::kFailure;
-			break;
-		}
-	}
 	if ( m_lastBucketFiles.size() == 15 ) //remember the last 15 files.
+	{
 		m_lastBucketFiles.pop_front();
+		m_lastBucketImages.pop_front();
+	}
 	m_lastBucketFiles.push_back( file );
-
-	fclose ( fh );
+	m_lastBucketImages.push_back( string( info.name ) + ":" + info.channelNames );
 	return MS::kSuccess;
 }
 
-MStatus liqMayaRenderCmd::readBuckets( const char* file, vector<bucket*> &buckets, imageInfo &imgInfo ) const
+//show a bucket cache file, only the tiles in the render region are decoded with -doRegion
+MStatus liqMayaRenderCmd::renderCache( const char* file )
 {
-	MStatus status;
-	
-	FILE *fh = fopen ( file,"rb" );
-	if ( !fh ) 
-  {
-		ERROR( "[liqMayaRenderCmd] Error: couldn't open " + file + " for reading" );
+	liqBucketCache cache;
+	if ( !cache.open( file ) )
+	{
+		ERROR( "[liqMayaRenderCmd] Error: couldn't read bucket cache " + file );
 		return MS::kFailure;
 	}
-	fread ( &imgInfo, sizeof( imageInfo ), 1, fh );
-	unsigned int size;
-	fread ( &size, sizeof( unsigned int ), 1, fh );
-	if ( ferror( fh ) )
-  {
-		ERROR( "[liqMayaRenderCmd] Error: failed reading data from " + file );
-		fclose ( fh );
-		return MS::kFailure;
+	const imageInfo &imgInfo = cache.info();
+	// the region in bucket coordinates: maya's rows go bottom up
+	unsigned int region[4] = { 0, imgInfo.width, 0, imgInfo.height };
+	if ( m_bDoRegionRender )
+	{
+		unsigned int left, right, bottom, top;
+		MRenderView::getRenderRegion( left, right, bottom, top );
+		MRenderView::startRegionRender( imgInfo.wo, imgInfo.ho, left, right, bottom, top, false, false );
+		const int bounds[4] = { (int)left - imgInfo.xo, (int)right + 1 - imgInfo.xo, 
+		                        imgInfo.ho - imgInfo.yo - (int)top - 1, imgInfo.ho - imgInfo.yo - (int)bottom };
+		for ( unsigned int i(0); i < 4; i++ ) 
+			region[i] = std::max( 0, std::min( bounds[i], i < 2 ? imgInfo.width : imgInfo.height ) );
 	}
-	buckets.clear();
-	for ( unsigned int i(0) ; i < size ; i++ )
-  {
-		bucket::bucketInfo info;
-		
-		fread ( &info, sizeof( bucket::bucketInfo ), 1, fh );
-		if ( ferror( fh ) ) 
-    {
-			ERROR( "[liqMayaRenderCmd] Error: failed reading data from " + file );
-			status = MS::kFailure;
-			break;
-		}
-		unsigned int datasize = ( info.right - info.left ) * ( info.top - info.bottom ) * imgInfo.channels * sizeof( BUCKETDATATYPE );
-		BUCKETDATATYPE *data = new BUCKETDATATYPE[ datasize ];
-		if ( !data )
-    {
-			ERROR( "[liqMayaRenderCmd] Error: failed reading data from " + file );
-			status = MS::kInsufficientMemory;
-			break;
-		}
-		fread ( data, datasize, 1, fh );
-		if ( ferror( fh ) ) 
-    {
-			ERROR( "[liqMayaRenderCmd] Error: failed reading data from " + file );
-			status = MS::kFailure;
-			break;
+	else 
+		MRenderView::startRender( imgInfo.wo, imgInfo.ho, false, false );
+	m_started = true;
+	setStaging( imgInfo );
+
+	vector<unsigned char> &scratch = m_decodeScratch;
+	vector<BUCKETDATATYPE> &data = m_bucketData;
+	for ( unsigned int ty(0); ty < cache.tilesY(); ty++ )
+		for ( unsigned int tx(0); tx < cache.tilesX(); tx++ )
+		{
+			const bucket::bucketInfo tile = cache.tileInfo( tx, ty );
+			bucket::bucketInfo info = tile;
+			info.left   = std::max( tile.left, region[0] );
+			info.right  = std::min( tile.right, region[1] );
+			info.bottom = std::max( tile.bottom, region[2] );
+			info.top    = std::min( tile.top, region[3] );
+			if ( info.left >= info.right || info.bottom >= info.top || cache.isEmpty( tx, ty ) ) continue;
+			if ( !cache.readTile( tx, ty, data, scratch ) )
+			{
+				ERROR( "[liqMayaRenderCmd] Error: bad tile in bucket cache " + file );
+				return MS::kFailure;
+			}
+			const unsigned int width = tile.right - tile.left;
+			renderBucket( info, &data[ ( ( info.bottom - tile.bottom ) * width + info.left - tile.left ) * info.channels ], width, imgInfo );
 		}
-		bucket* b = new bucket;
-		if ( !b->set( info, data ) ) buckets.push_back( b );
-		delete[] data;
-	}
-	fclose ( fh );
-	return status;
-}
-
-inline int quantize( const float value, const float zero,const float one,const float min, const float max, const float dither )
-{
-	int result = ( int )( zero + value * ( one - zero ) + dither );
-	if ( result < min ) result = ( int )min;
-	if ( result > max ) result = ( int )max;
-	return result;
+	flush();
+	return MS::kSuccess;
 }
 
 int waitSocket ( const int fd, const int seconds, const bool check_readable )
@@ -738,39 +1234,73 @@ int waitSocket ( const int fd, const int seconds, const bool check_readable )
   return FD_ISSET( fd, &fds ) ? 1 : 0;
 }
 
-int readSockData ( int s, char *data, int n ) 
+//wait until the listening socket or one of the connections is readable
+int liqMayaRenderCmd::waitConnections ( const int s, const vector<connection*> &connections, const int milliseconds )
 {
-	int	i,j;
+  fd_set fds;
+  struct timeval tv;
+  FD_ZERO( &fds );
+  FD_SET( s, &fds );
+  int maxfd = s;
+  for ( unsigned int i(0); i < connections.size(); i++ )
+  {
+    if ( connections[ i ]->done ) continue;
+    FD_SET( connections[ i ]->socket, &fds );
+    if ( connections[ i ]->socket > maxfd ) maxfd = connections[ i ]->socket;
+  }
+  tv.tv_sec = milliseconds / 1000;
+  tv.tv_usec = ( milliseconds % 1000 ) * 1000;
+  return select( maxfd + 1, &fds, NULL, NULL, &tv );
+}
 
-	j	= n;
-	#ifdef MSG_NOSIGNAL
-		i	= recv ( s, data, j, MSG_NOSIGNAL );
-	#else
-		i	= recv ( s, data, j, 0 );
-	#endif
+//stop() was called
+bool liqMayaRenderCmd::stopped()
+{
+	m_mutex.lock();
+	const bool stop( m_stop );
+	m_mutex.unlock();
+	return stop;
+}
 
-	if ( i <= 0 ) 
-  {
-		perror( "[liqMayaRenderCmd] Connection broken (1)" );
-		return false;
+//receiving thread: wait up to m_timeout for data on the socket, in short slices to notice stop()
+bool liqMayaRenderCmd::waitData( const int socket )
+{
+	const time_t start( time( NULL ) );
+	do
+	{
+		if ( stopped() ) return false;
+		fd_set fds;
+		struct timeval tv;
+		FD_ZERO( &fds );
+		FD_SET( socket, &fds );
+		tv.tv_sec = 0;
+		tv.tv_usec = 100000;
+		const int rc( select( socket + 1, &fds, NULL, NULL, &tv ) );
+		if ( rc < 0 ) return false;
+		if ( rc > 0 ) return true;
 	}
+	while ( time( NULL ) - start < (time_t)m_timeout );
+	return false;
+}
 
-	while ( i < j ) 
-  {
-		data	+=	i;
-		j	-=	i;
-
+//receiving thread: read size bytes, none of the recv calls blocks past a waitData()
+bool liqMayaRenderCmd::readData( const int socket, char *data, int size )
+{
+	while ( size > 0 )
+	{
+		if ( !waitData( socket ) ) return false;
 		#ifdef MSG_NOSIGNAL
-			i		=	recv ( s, data, j, MSG_NOSIGNAL );
+			const int n( recv( socket, data, size, MSG_NOSIGNAL ) );
 		#else
-			i		=	recv ( s, data, j, 0 );
+			const int n( recv( socket, data, size, 0 ) );
 		#endif
-
-		if (i <= 0 ) 
-    {
-			perror( "[liqMayaRenderCmd] Connection broken (2)" );
+		if ( n <= 0 ) 
+		{
+			if ( !stopped() ) perror( "[liqMayaRenderCmd] Connection broken" );
 			return false;
 		}
+		data += n;
+		size -= n;
 	}
 	return true;
 }
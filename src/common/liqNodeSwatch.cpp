@@ -55,6 +55,8 @@
 #include <maya/MFileObject.h>
 
 #include <liqIOStream.h>
+#include <liqPreviewServer.h>
+#include <liqSwatchCache.h>
 
 bool liqNodeSwatch::doIteration () 
 {
@@ -87,6 +89,47 @@ bool liqNodeSwatch::doIteration ()
   
   status.clear();
 
+  // previews with the same settings share one cached image
+  liqSwatchCache& cache( liqSwatchCache::instance() );
+  MString cacheKey;
+  if ( nodeType != "liquidRibBox" && nodeType != "liquidLight" && nodeType != "liquidVolume" 
+    && nodeType != "liquidSurfaceSwitcher" && nodeType != "liquidDisplacementSwitcher" ) 
+  {
+    if ( !cache.keyOf( nodename, cacheKey ) ) 
+    {
+      // not previewed in this session : get the key of the current settings,
+      // kept even when there is none until the next preview computes it again
+      MString previewCmd;
+      MGlobal::executeCommand( "liquidShaderNodePreviewArgs(\"" + nodename + "\");", previewCmd, false, false );
+      if ( previewCmd != "" ) MGlobal::executeCommand( previewCmd + " -cacheKey", cacheKey, false, false );
+      cache.setKeyOf( nodename, cacheKey );
+    }
+  }
+  if ( cache.find( cacheKey, img ) ) 
+  {
+    if ( refresh ) refreshPlug.setValue( false );
+    return true;
+  }
+
+  // swatches rendered by the preview server never go through a file
+  liqPreviewServer::Status served( liqPreviewServer::instance().fetch( nodename.asChar(), img ) );
+  if ( served == liqPreviewServer::kPending ) return false;
+  if ( served == liqPreviewServer::kDone ) 
+  {
+    if ( refresh ) 
+    {
+      cache.store( cacheKey, img );
+      refreshPlug.setValue( false );
+    }
+    return true;
+  }
+  if ( served == liqPreviewServer::kFailed && refresh ) 
+  {
+    MGlobal::displayError( "Liquid Preview Swatch : preview render of " + nodename + " failed" );
+    refreshPlug.setValue( false );
+    return true;
+  }
+
   if ( refresh ) 
   {
     //cout <<"refresh !"<<endl;
@@ -103,6 +146,7 @@ bool liqNodeSwatch::doIteration ()
       if ( status == MS::kSuccess ) 
       {
         img.verticalFlip();
+        cache.store( cacheKey, img );
         refreshPlug.setValue( false );
         result = true;
       } 
@@ -0,0 +1,224 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the
+** "License"); you may not use this file except in compliance with the License. You may
+** obtain a copy of the License at http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific
+** language governing rights and limitations under the License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions created by
+** Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Particle Kernels Source
+** ______________________________________________________________________
+*/
+
+#include <stdlib.h>
+#include <math.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#  define LIQ_USE_SSE
+#  include <xmmintrin.h>
+#endif
+
+#include <liqParticleKernels.h>
+
+
+void liqGatherColumn( const float *src, const int *index, unsigned n, float *dst )
+{
+  for ( unsigned i( 0 ); i < n; i++ ) dst[ i ] = src[ index[ i ] ];
+}
+
+void liqGatherColumn( vector< float > &column, const vector< int > &index )
+{
+  if ( column.empty() ) return;
+  vector< float > gathered( index.size() );
+  if ( !index.empty() ) liqGatherColumn( &column[ 0 ], &index[ 0 ], index.size(), &gathered[ 0 ] );
+  column.swap( gathered );
+}
+
+void liqGatherColumn( liqVectorColumn &column, const vector< int > &index )
+{
+  liqGatherColumn( column.x, index );
+  liqGatherColumn( column.y, index );
+  liqGatherColumn( column.z, index );
+}
+
+void liqInterleave3( const float *x, const float *y, const float *z, unsigned n, float *xyz )
+{
+  unsigned i( 0 );
+#ifdef LIQ_USE_SSE
+  // 4 particles at a time: x0..3, y0..3, z0..3 -> x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+  for ( ; i + 4 <= n; i += 4, xyz += 12 ) 
+  {
+    __m128 vx( _mm_loadu_ps( x + i ) );
+    __m128 vy( _mm_loadu_ps( y + i ) );
+    __m128 vz( _mm_loadu_ps( z + i ) );
+
+    __m128 xy01( _mm_unpacklo_ps( vx, vy ) );                              // x0 y0 x1 y1
+    __m128 xy23( _mm_unpackhi_ps( vx, vy ) );                              // x2 y2 x3 y3
+    __m128 z0x1( _mm_shuffle_ps( vz, vx, _MM_SHUFFLE( 1, 1, 0, 0 ) ) );    // z0 z0 x1 x1
+    __m128 y1z1( _mm_shuffle_ps( vy, vz, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );    // y1 y1 z1 z1
+    __m128 z2z3( _mm_shuffle_ps( vz, xy23, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );  // z2 z3 x3 y3
+
+    _mm_storeu_ps( xyz,     _mm_shuffle_ps( xy01, z0x1, _MM_SHUFFLE( 2, 0, 1, 0 ) ) );
+    _mm_storeu_ps( xyz + 4, _mm_shuffle_ps( y1z1, xy23, _MM_SHUFFLE( 1, 0, 2, 0 ) ) );
+    _mm_storeu_ps( xyz + 8, _mm_shuffle_ps( z2z3, z2z3, _MM_SHUFFLE( 1, 3, 2, 0 ) ) );
+  }
+#endif
+  for ( ; i < n; i++, xyz += 3 ) 
+  {
+    xyz[ 0 ] = x[ i ];
+    xyz[ 1 ] = y[ i ];
+    xyz[ 2 ] = z[ i ];
+  }
+}
+
+void liqExpandColumn( const float *src, unsigned n, unsigned multi, float scale, float *dst )
+{
+  if ( multi == 1 ) 
+  {
+    unsigned i( 0 );
+#ifdef LIQ_USE_SSE
+    __m128 vs( _mm_set1_ps( scale ) );
+    for ( ; i + 4 <= n; i += 4 ) _mm_storeu_ps( dst + i, _mm_mul_ps( _mm_loadu_ps( src + i ), vs ) );
+#endif
+    for ( ; i < n; i++ ) dst[ i ] = src[ i ] * scale;
+    return;
+  }
+  for ( unsigned i( 0 ); i < n; i++ ) 
+  {
+    const float v( src[ i ] * scale );
+    for ( unsigned k( 0 ); k < multi; k++ ) *dst++ = v;
+  }
+}
+
+void liqExpandInterleave3( const float *x, const float *y, const float *z, unsigned n, unsigned multi, float *xyz )
+{
+  if ( multi == 1 ) 
+  {
+    liqInterleave3( x, y, z, n, xyz );
+    return;
+  }
+  for ( unsigned i( 0 ); i < n; i++ ) 
+  {
+    for ( unsigned k( 0 ); k < multi; k++, xyz += 3 ) 
+    {
+      xyz[ 0 ] = x[ i ];
+      xyz[ 1 ] = y[ i ];
+      xyz[ 2 ] = z[ i ];
+    }
+  }
+}
+
+// Random unit direction and distance for one multi-point, in the same
+// sequence of rand() calls the exporter has always used.
+static inline void liqJitterOffset( float multiRadius, float &dx, float &dy, float &dz )
+{
+  float xDir( 0 ), yDir( 0 ), zDir( 0 ), vLen( 0 );
+  do 
+  {
+    xDir = rand() / ( float )RAND_MAX - 0.5f;
+    yDir = rand() / ( float )RAND_MAX - 0.5f;
+    zDir = rand() / ( float )RAND_MAX - 0.5f;
+    vLen = sqrt( xDir * xDir + yDir * yDir + zDir * zDir );
+  } while ( vLen == 0.0 );
+
+  float rad( rand() / ( float )RAND_MAX * multiRadius / 2.0f );
+  dx = rad * xDir / vLen;
+  dy = rad * yDir / vLen;
+  dz = rad * zDir / vLen;
+}
+
+void liqJitterPoints( const float *x, const float *y, const float *z, const int *ids,
+                      unsigned n, unsigned multi, float multiRadius, float *xyz )
+{
+  if ( multi <= 1 ) 
+  {
+    liqInterleave3( x, y, z, n, xyz );
+    return;
+  }
+  // The offsets come from a sequential generator, so they are produced first
+  // and the positions added afterwards in a tight loop.
+  const unsigned count( n * multi );
+  vector< float > offsets( count * 3 );
+  float *o( &offsets[ 0 ] );
+  for ( unsigned i( 0 ); i < n; i++ ) 
+  {
+    srand( ids[ i ] );
+    for ( unsigned k( 0 ); k < multi; k++, o += 3 ) liqJitterOffset( multiRadius, o[ 0 ], o[ 1 ], o[ 2 ] );
+  }
+  liqExpandInterleave3( x, y, z, n, multi, xyz );
+
+  unsigned j( 0 );
+  const float *off( &offsets[ 0 ] );
+#ifdef LIQ_USE_SSE
+  for ( ; j + 4 <= count * 3; j += 4 ) 
+    _mm_storeu_ps( xyz + j, _mm_add_ps( _mm_loadu_ps( xyz + j ), _mm_loadu_ps( off + j ) ) );
+#endif
+  for ( ; j < count * 3; j++ ) xyz[ j ] += off[ j ];
+}
+
+void liqStreakPoints( const float *x, const float *y, const float *z,
+                      const float *vx, const float *vy, const float *vz, const int *ids,
+                      unsigned n, unsigned multi, float multiRadius, float tailScale, float *xyz )
+{
+  for ( unsigned i( 0 ); i < n; i++ ) 
+  {
+    srand( ids[ i ] );
+    const float tx( vx[ i ] * tailScale );
+    const float ty( vy[ i ] * tailScale );
+    const float tz( vz[ i ] * tailScale );
+    for ( unsigned k( 0 ); k < multi; k++, xyz += 6 ) 
+    {
+      float dx( 0 ), dy( 0 ), dz( 0 );
+      liqJitterOffset( multiRadius, dx, dy, dz );
+
+      // Tail (the formula is a bit of a guess as to how Maya places the tail).
+      xyz[ 0 ] = x[ i ] + dx - tx;
+      xyz[ 1 ] = y[ i ] + dy - ty;
+      xyz[ 2 ] = z[ i ] + dz - tz;
+      // Head
+      xyz[ 3 ] = x[ i ] + dx;
+      xyz[ 4 ] = y[ i ] + dy;
+      xyz[ 5 ] = z[ i ] + dz;
+    }
+  }
+}
+
+void liqBlobbyEllipsoids( const float *x, const float *y, const float *z, const float *radius,
+                          float constantRadius, unsigned n, float *floats )
+{
+  for ( unsigned i( 0 ); i < n; i++, floats += 16 ) 
+  {
+    const float d( 2.0f * ( radius ? radius[ i ] : constantRadius ) );
+#ifdef LIQ_USE_SSE
+    _mm_storeu_ps( floats,      _mm_set_ps( 0.0f, 0.0f, 0.0f, d ) );
+    _mm_storeu_ps( floats + 4,  _mm_set_ps( 0.0f, 0.0f, d, 0.0f ) );
+    _mm_storeu_ps( floats + 8,  _mm_set_ps( 0.0f, d, 0.0f, 0.0f ) );
+    _mm_storeu_ps( floats + 12, _mm_set_ps( 1.0f, z[ i ], y[ i ], x[ i ] ) );
+#else
+    floats[ 0 ]  = d;    floats[ 1 ]  = 0.0f; floats[ 2 ]  = 0.0f; floats[ 3 ]  = 0.0f;
+    floats[ 4 ]  = 0.0f; floats[ 5 ]  = d;    floats[ 6 ]  = 0.0f; floats[ 7 ]  = 0.0f;
+    floats[ 8 ]  = 0.0f; floats[ 9 ]  = 0.0f; floats[ 10 ] = d;    floats[ 11 ] = 0.0f;
+    floats[ 12 ] = x[ i ]; floats[ 13 ] = y[ i ]; floats[ 14 ] = z[ i ]; floats[ 15 ] = 1.0f;
+#endif
+  }
+}
@@ -0,0 +1,90 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the
+** "License"); you may not use this file except in compliance with the License. You may
+** obtain a copy of the License at http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific
+** language governing rights and limitations under the License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions created by
+** Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Pixel Kernels Source
+** ______________________________________________________________________
+*/
+
+// LIQ_NO_SSE builds the plain loops only, so bench/ can check them too
+#if !defined( LIQ_NO_SSE ) && ( defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) )
+#  define LIQ_USE_SSE
+#  include <emmintrin.h>
+#endif
+
+#include <liqPixelKernels.h>
+
+
+// Clamping before the conversion gives the same result as clamping the
+// integer, and keeps out of range values (and NaNs) defined.
+static inline float liqQuantize( float v, float zero, float scale, float dither, float low, float high )
+{
+  float q( zero + v * scale );
+  q = q + dither;
+  if ( !( q > low ) ) q = low;
+  if ( q > high ) q = high;
+  return ( float )( int )q;
+}
+
+void liqQuantizePixels( const float *src, unsigned n, unsigned channels, const float quantize[ 4 ], float dither, float *rgba )
+{
+  const float zero( quantize[ 0 ] ), scale( quantize[ 1 ] - quantize[ 0 ] ), low( quantize[ 2 ] ), high( quantize[ 3 ] );
+  const bool alpha( channels > 3 );
+  unsigned i( 0 );
+  if ( channels < 3 ) 
+  {
+    for ( ; i < n; i++, src += channels, rgba += 4 ) 
+      rgba[ 0 ] = rgba[ 1 ] = rgba[ 2 ] = liqQuantize( src[ 0 ], zero, scale, dither, low, high );
+    return;
+  }
+#ifdef LIQ_USE_SSE
+  // one pixel per register, rgb pixels read one float past their end: the
+  // last one goes through the plain loop
+  const unsigned count( alpha ? n : ( n ? n - 1 : 0 ) );
+  const __m128 vzero( _mm_set1_ps( zero ) );
+  const __m128 vscale( _mm_set1_ps( scale ) );
+  const __m128 vdither( _mm_set1_ps( dither ) );
+  const __m128 vlow( _mm_set1_ps( low ) );
+  const __m128 vhigh( _mm_set1_ps( high ) );
+  const __m128 keep( _mm_castsi128_ps( _mm_set_epi32( alpha ? 0 : -1, 0, 0, 0 ) ) );  // alpha lane left as is
+  for ( ; i < count; i++, src += channels, rgba += 4 ) 
+  {
+    __m128 q( _mm_add_ps( _mm_add_ps( vzero, _mm_mul_ps( _mm_loadu_ps( src ), vscale ) ), vdither ) );
+    q = _mm_min_ps( _mm_max_ps( q, vlow ), vhigh );
+    q = _mm_cvtepi32_ps( _mm_cvttps_epi32( q ) );
+    if ( !alpha ) q = _mm_or_ps( _mm_andnot_ps( keep, q ), _mm_and_ps( keep, _mm_loadu_ps( rgba ) ) );
+    _mm_storeu_ps( rgba, q );
+  }
+#endif
+  for ( ; i < n; i++, src += channels, rgba += 4 ) 
+  {
+    rgba[ 0 ] = liqQuantize( src[ 0 ], zero, scale, dither, low, high );
+    rgba[ 1 ] = liqQuantize( src[ 1 ], zero, scale, dither, low, high );
+    rgba[ 2 ] = liqQuantize( src[ 2 ], zero, scale, dither, low, high );
+    if ( alpha ) rgba[ 3 ] = liqQuantize( src[ 3 ], zero, scale, dither, low, high );
+  }
+}
@@ -0,0 +1,517 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Preview Server Source
+** ______________________________________________________________________
+*/
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+#include <cstdio>
+#include <cstring>
+
+#include <liquid.h>
+#include <liqGlobalHelpers.h>
+#include <liqBucket.h>
+#include <liqBucketCodec.h>
+#include <liqPreviewServer.h>
+
+extern int debugMode;
+
+liqPreviewServer& liqPreviewServer::instance()
+{
+  static liqPreviewServer server;
+  return server;
+}
+
+liqPreviewServer::liqPreviewServer()
+{
+  m_sent = 0;
+#ifndef _WIN32
+  m_renderer = 0;
+  m_fifo     = -1;
+  m_listen   = -1;
+  m_port     = 0;
+  m_running  = false;
+  pthread_mutex_init( &m_mutex, NULL );
+#endif
+}
+
+liqPreviewServer::~liqPreviewServer()
+{
+  stop();
+#ifndef _WIN32
+  pthread_mutex_destroy( &m_mutex );
+#endif
+}
+
+bool liqPreviewServer::isQueued( const string& node ) const
+{
+  for ( deque< liqPreviewShaderOptions >::const_iterator it( m_queue.begin() ); it != m_queue.end(); it++ ) 
+    if ( it->shaderNodeName == node ) return true;
+  return false;
+}
+
+/**
+ * Queue a swatch render.
+ * A request still waiting for the same node is dropped, the new one takes
+ * its place at the end of the queue.
+ */
+bool liqPreviewServer::submit( const liqPreviewShaderOptions& options )
+{
+#ifdef _WIN32
+  return false;
+#else
+  if ( options.renderCommand.empty() || options.fullShaderPath ) return false;
+
+  for ( deque< liqPreviewShaderOptions >::iterator it( m_queue.begin() ); it != m_queue.end(); ) 
+  {
+    if ( it->shaderNodeName == options.shaderNodeName ) it = m_queue.erase( it );
+    else it++;
+  }
+  m_queue.push_back( options );
+  LIQDEBUGPRINTF( "-> preview server: queued %s (%u waiting)\n", options.shaderNodeName.c_str(), ( unsigned )m_queue.size() );
+  pump();
+  return true;
+#endif
+}
+
+/**
+ * Copy the last image rendered for a node into a swatch image.
+ */
+liqPreviewServer::Status liqPreviewServer::fetch( const string& node, MImage& image )
+{
+  pump();
+  if ( isQueued( node ) ) return kPending;
+#ifndef _WIN32
+  pthread_mutex_lock( &m_mutex );
+#endif
+  Status status( kUnknown );
+  if ( m_current == node ) status = kPending;
+  else 
+  {
+    map< string, liqPreviewImage >::const_iterator found( m_images.find( node ) );
+    if ( found != m_images.end() ) 
+    {
+      const liqPreviewImage& img( found->second );
+      if ( img.failed ) status = kFailed;
+      else 
+      {
+        image.create( img.width, img.height, 4, MImage::kByte );
+        unsigned char* p( image.pixels() );
+        const float* src( &img.pixels[ 0 ] );
+        for ( int i( 0 ); i < img.width * img.height; i++, src += img.channels ) 
+        {
+          for ( int c( 0 ); c < 4; c++ ) 
+          {
+            float v( c < img.channels ? src[ c ] : 1.f );
+            *p++ = ( unsigned char )( v <= 0.f ? 0 : v >= 1.f ? 255 : v * 255.f + .5f );
+          }
+        }
+        status = kDone;
+      }
+    }
+  }
+#ifndef _WIN32
+  pthread_mutex_unlock( &m_mutex );
+#endif
+  return status;
+}
+
+/**
+ * Drop what the server has for a node, when its swatch is rendered some
+ * other way.
+ */
+void liqPreviewServer::forget( const string& node )
+{
+  for ( deque< liqPreviewShaderOptions >::iterator it( m_queue.begin() ); it != m_queue.end(); ) 
+  {
+    if ( it->shaderNodeName == node ) it = m_queue.erase( it );
+    else it++;
+  }
+#ifndef _WIN32
+  pthread_mutex_lock( &m_mutex );
+#endif
+  m_images.erase( node );
+  for ( deque< string >::iterator it( m_stored.begin() ); it != m_stored.end(); ) 
+  {
+    if ( *it == node ) it = m_stored.erase( it );
+    else it++;
+  }
+#ifndef _WIN32
+  pthread_mutex_unlock( &m_mutex );
+#endif
+}
+
+/**
+ * Keep the image of a node, the oldest one goes past kMaxImages. Called
+ * with the mutex held.
+ */
+void liqPreviewServer::store( const string& node, const liqPreviewImage& image )
+{
+  if ( m_images.find( node ) == m_images.end() ) m_stored.push_back( node );
+  m_images[ node ] = image;
+  while ( m_stored.size() > kMaxImages ) 
+  {
+    m_images.erase( m_stored.front() );
+    m_stored.pop_front();
+  }
+}
+
+/**
+ * Store the image of the current request, called with the mutex held.
+ * A frame for a request that was given up on is dropped.
+ */
+void liqPreviewServer::finish( const string& node, const liqPreviewImage& image )
+{
+  if ( m_current.empty() || m_current != node ) return;
+  store( m_current, image );
+  m_current.clear();
+}
+
+/**
+ * Send the next request to the renderer once the previous frame is back.
+ * Called whenever a swatch asks for its image.
+ */
+void liqPreviewServer::pump()
+{
+#ifndef _WIN32
+  pthread_mutex_lock( &m_mutex );
+  bool busy( !m_current.empty() ), restart( false );
+  liqPreviewImage failed;
+  failed.failed = true;
+  if ( busy && m_renderer > 0 && waitpid( m_renderer, NULL, WNOHANG ) == m_renderer ) 
+  {
+    // the renderer died on this frame, the next request gets a new one
+    liquidMessage( "Preview renderer exited while rendering " + m_current, messageWarning );
+    m_renderer = 0;
+    finish( m_current, failed );
+    busy = false;
+  }
+  else if ( busy && m_sent && time( NULL ) - m_sent > kFrameTimeout ) 
+  {
+    // alive but it never opened the display: a RIB or shader error
+    liquidMessage( "Preview renderer timed out rendering " + m_current, messageWarning );
+    finish( m_current, failed );
+    busy = false;
+    restart = true;
+  }
+  pthread_mutex_unlock( &m_mutex );
+  if ( restart ) stopRenderer();
+  if ( busy || m_queue.empty() ) return;
+
+  liqPreviewShaderOptions options( m_queue.front() );
+  m_queue.pop_front();
+
+  if ( !startReceiver() || !startRenderer( options.renderCommand ) ) 
+  {
+    pthread_mutex_lock( &m_mutex );
+    store( options.shaderNodeName, failed );
+    pthread_mutex_unlock( &m_mutex );
+    return;
+  }
+  options.displayDriver = "liqmaya";
+  options.displayName   = options.shaderNodeName;
+  options.displayPort   = m_port;
+  options.usePipe       = false;
+
+  pthread_mutex_lock( &m_mutex );
+  m_current = options.shaderNodeName;
+  m_sent    = time( NULL );
+  pthread_mutex_unlock( &m_mutex );
+
+  if ( !liquidOutputPreviewShader( m_fifoName, options ) ) 
+  {
+    pthread_mutex_lock( &m_mutex );
+    finish( m_current, failed );
+    pthread_mutex_unlock( &m_mutex );
+  }
+#endif
+}
+
+void liqPreviewServer::stop()
+{
+#ifndef _WIN32
+  stopRenderer();
+  if ( m_running ) 
+  {
+    setRunning( false );
+    pthread_join( m_thread, NULL );
+  }
+  if ( m_listen != -1 ) close( m_listen );
+  m_listen = -1;
+  m_port = 0;
+#endif
+  m_queue.clear();
+  m_current.clear();
+  m_images.clear();
+  m_stored.clear();
+}
+
+#ifndef _WIN32
+
+/**
+ * Start the renderer on the FIFO, unless it already runs this command.
+ */
+bool liqPreviewServer::startRenderer( const string& renderCommand )
+{
+  if ( m_renderer > 0 && renderCommand == m_renderCommand && waitpid( m_renderer, NULL, WNOHANG ) == 0 ) 
+    return true;
+  stopRenderer();
+
+  string tmpDir( getEnvironment( "TMPDIR" ) );
+  if ( tmpDir.empty() ) tmpDir = "/tmp";
+  char name[ 64 ];
+  sprintf( name, "/liqPreview%d.fifo", ( int )getpid() );
+  m_fifoName = tmpDir + name;
+  unlink( m_fifoName.c_str() );
+  if ( mkfifo( m_fifoName.c_str(), 0600 ) == -1 ) 
+  {
+    perror( "[liqPreviewServer] mkfifo" );
+    return false;
+  }
+  // opened for both ends so that it neither blocks nor ends between frames
+  m_fifo = open( m_fifoName.c_str(), O_RDWR );
+  if ( m_fifo == -1 ) 
+  {
+    perror( "[liqPreviewServer] open fifo" );
+    unlink( m_fifoName.c_str() );
+    return false;
+  }
+  fcntl( m_fifo, F_SETFD, FD_CLOEXEC );
+
+  string command( renderCommand + " " + m_fifoName );
+  fflush( NULL );
+  m_renderer = fork();
+  if ( m_renderer == -1 ) 
+  {
+    perror( "[liqPreviewServer] fork" );
+    m_renderer = 0;
+    stopRenderer();
+    return false;
+  }
+  if ( m_renderer == 0 ) 
+  {
+    execl( "/bin/sh", "sh", "-c", command.c_str(), ( char* )NULL );
+    _exit( 127 );
+  }
+  m_renderCommand = renderCommand;
+  liquidMessage( "Started preview renderer: " + command, messageInfo );
+  return true;
+}
+
+void liqPreviewServer::stopRenderer()
+{
+  if ( m_fifo != -1 ) close( m_fifo );
+  m_fifo = -1;
+  if ( m_renderer > 0 ) 
+  {
+    kill( m_renderer, SIGTERM );
+    waitpid( m_renderer, NULL, 0 );
+  }
+  m_renderer = 0;
+  if ( !m_fifoName.empty() ) unlink( m_fifoName.c_str() );
+  m_fifoName.clear();
+  m_renderCommand.clear();
+}
+
+/**
+ * Listen on a free local port and start the receiving thread.
+ */
+bool liqPreviewServer::startReceiver()
+{
+  if ( m_running ) return true;
+
+  m_listen = socket( PF_INET, SOCK_STREAM, IPPROTO_TCP );
+  if ( m_listen == -1 ) 
+  {
+    perror( "[liqPreviewServer] socket" );
+    return false;
+  }
+  fcntl( m_listen, F_SETFD, FD_CLOEXEC );
+  int val( 1 );
+  setsockopt( m_listen, SOL_SOCKET, SO_REUSEADDR, ( const char* )&val, sizeof( int ) );
+
+  struct sockaddr_in address;
+  memset( &address, 0, sizeof( address ) );
+  address.sin_family      = AF_INET;
+  address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+  address.sin_port        = 0;
+  socklen_t length( sizeof( address ) );
+  if ( bind( m_listen, ( struct sockaddr* )&address, sizeof( address ) ) == -1 
+    || listen( m_listen, 4 ) == -1 
+    || getsockname( m_listen, ( struct sockaddr* )&address, &length ) == -1 ) 
+  {
+    perror( "[liqPreviewServer] bind" );
+    close( m_listen );
+    m_listen = -1;
+    return false;
+  }
+  m_port = ntohs( address.sin_port );
+
+  setRunning( true );
+  if ( pthread_create( &m_thread, NULL, receive, this ) ) 
+  {
+    perror( "[liqPreviewServer] pthread_create" );
+    setRunning( false );
+    close( m_listen );
+    m_listen = -1;
+    return false;
+  }
+  LIQDEBUGPRINTF( "-> preview server: listening on port %d\n", m_port );
+  return true;
+}
+
+static bool readAll( int socket, void* data, size_t size )
+{
+  char* p( ( char* )data );
+  while ( size ) 
+  {
+    ssize_t n( recv( socket, p, size, 0 ) );
+    if ( n <= 0 ) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+/**
+ * Read one image in the liqmaya display driver protocol: the image info,
+ * our answer to the bucket encoding it asks for, then buckets until an
+ * empty one.
+ */
+bool liqPreviewServer::receiveImage( int socket, liqPreviewImage& image )
+{
+  imageInfo info;
+  if ( !readAll( socket, &info, sizeof( imageInfo ) ) ) return false;
+  if ( info.width <= 0 || info.height <= 0 || info.channels <= 0 ) return false;
+  const int encoding( liqBucketCodec::accept( info.encoding ) );
+  if ( send( socket, ( const char* )&encoding, sizeof( int ), 0 ) != sizeof( int ) ) return false;
+
+  image.width    = info.width;
+  image.height   = info.height;
+  image.channels = info.channels;
+  image.pixels.assign( image.width * image.height * image.channels, 0.f );
+
+  vector< BUCKETDATATYPE > data;
+  vector< unsigned char > encoded, scratch;
+  while ( true ) 
+  {
+    bucket::bucketInfo b;
+    if ( !readAll( socket, &b, sizeof( bucket::bucketInfo ) ) ) return false;
+    if ( b.right <= b.left || b.top <= b.bottom ) return true;
+
+    unsigned width( b.right - b.left ), channels( b.channels );
+    data.resize( width * ( b.top - b.bottom ) * channels );
+    if ( encoding != liqBucketCodec::kFloat ) 
+    {
+      liqBucketCodec::payload header;
+      if ( !readAll( socket, &header, sizeof( liqBucketCodec::payload ) ) ) return false;
+      if ( header.size > data.size() * sizeof( BUCKETDATATYPE ) + data.size() / 64 + 16 ) return false;
+      encoded.resize( header.size );
+      if ( header.size && !readAll( socket, &encoded[ 0 ], header.size ) ) return false;
+      if ( !liqBucketCodec::decode( header, width * ( b.top - b.bottom ), channels, 
+                                    encoded.empty()? 0 : &encoded[ 0 ], &data[ 0 ], scratch ) ) return false;
+    }
+    else if ( !readAll( socket, &data[ 0 ], data.size() * sizeof( BUCKETDATATYPE ) ) ) return false;
+    if ( b.right > ( unsigned )image.width || b.top > ( unsigned )image.height || channels != ( unsigned )image.channels ) continue;
+
+    for ( unsigned y( b.bottom ); y < b.top; y++ ) 
+      memcpy( &image.pixels[ ( y * image.width + b.left ) * channels ], 
+              &data[ ( y - b.bottom ) * width * channels ], 
+              width * channels * sizeof( float ) );
+  }
+}
+
+/**
+ * m_running is written by the main thread and polled by the receiving one.
+ */
+bool liqPreviewServer::isRunning()
+{
+  pthread_mutex_lock( &m_mutex );
+  const bool running( m_running );
+  pthread_mutex_unlock( &m_mutex );
+  return running;
+}
+
+void liqPreviewServer::setRunning( bool running )
+{
+  pthread_mutex_lock( &m_mutex );
+  m_running = running;
+  pthread_mutex_unlock( &m_mutex );
+}
+
+/**
+ * Receiving thread: one display driver connection per frame.
+ */
+void* liqPreviewServer::receive( void* data )
+{
+  liqPreviewServer* server( ( liqPreviewServer* )data );
+  while ( server->isRunning() ) 
+  {
+    fd_set fds;
+    FD_ZERO( &fds );
+    FD_SET( server->m_listen, &fds );
+    struct timeval tv = { 1, 0 };
+    if ( select( server->m_listen + 1, &fds, NULL, NULL, &tv ) <= 0 ) continue;
+
+    int connection( accept( server->m_listen, NULL, NULL ) );
+    if ( connection == -1 ) continue;
+    // the frame belongs to the request being rendered when it started
+    pthread_mutex_lock( &server->m_mutex );
+    const string node( server->m_current );
+    server->m_sent = 0;   // the receive timeout takes over
+    pthread_mutex_unlock( &server->m_mutex );
+    // don't hang on a renderer that stopped halfway through a frame
+    struct timeval timeout = { 60, 0 };
+    setsockopt( connection, SOL_SOCKET, SO_RCVTIMEO, ( const char* )&timeout, sizeof( timeout ) );
+
+    liqPreviewImage image;
+    image.failed = !server->receiveImage( connection, image );
+    close( connection );
+
+    pthread_mutex_lock( &server->m_mutex );
+    server->finish( node, image );
+    pthread_mutex_unlock( &server->m_mutex );
+  }
+  return NULL;
+}
+
+#endif // _WIN32
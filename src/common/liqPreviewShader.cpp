@@ -46,6 +46,8 @@ extern "C" {
 #include <liqRenderer.h>
 #include <liqProcessLauncher.h>
 #include <liqPreviewShader.h>
+#include <liqPreviewServer.h>
+#include <liqSwatchCache.h>
 #include <liqGlobalHelpers.h>
 #include <liqShaderFactory.h>
 
@@ -98,6 +100,9 @@ MSyntax liqPreviewShader::syntax()
   syn.addFlag( "sr",   "shadingRate",      MSyntax::kDouble );
   syn.addFlag( "pxs",  "pixelSamples",     MSyntax::kLong );
   syn.addFlag( "p",    "pipe");
+  syn.addFlag( "srv",  "server");
+  syn.addFlag( "uc",   "useCache");
+  syn.addFlag( "ck",   "cacheKey");
   syn.addFlag( "t",    "type");
   syn.addFlag( "pi",   "previewIntensity", MSyntax::kDouble );
 
@@ -116,29 +121,6 @@ MSyntax liqPreviewShader::syntax()
 }
 
 
-typedef struct liqPreviewShaderOptions
-{
-  string  shaderNodeName;
-  string  displayDriver;
-  string  displayName;
-  string  renderCommand;
-  string  backPlaneShader;
-  bool    shortShaderName, backPlane, usePipe;
-  int     displaySize;
-  int     primitiveType;
-  float   pixelSamples;
-  float   objectScale;
-  float   shadingRate;
-  string  customRibFile;
-  bool    fullShaderPath;
-  string  type;
-  float   previewIntensity;
-  string  customBackplane;
-  bool    cleanRibs;
-} liqPreviewShaderOptions;
-
-int liquidOutputPreviewShader( const string& fileName, const liqPreviewShaderOptions& options );
-
 #ifndef _WIN32
 void liquidNewPreview( const liqPreviewShaderOptions& options )
 {
@@ -212,6 +194,9 @@ MStatus	liqPreviewShader::doIt( const MArgList& args )
   preview.previewIntensity = 1.;
   preview.customBackplane.clear();
   preview.cleanRibs = 1;
+  preview.displayPort = 0;
+  bool useServer( false );
+  bool useCache( false ), queryCacheKey( false );
 
   string displayDriver( "framebuffer" );
   string displayName( "liqPreviewShader" );
@@ -286,6 +271,18 @@ MStatus	liqPreviewShader::doIt( const MArgList& args )
 		else if ( ( arg == "-p" ) || ( arg == "-pipe" ) ) 
 		{
       preview.usePipe = true;
+    } 
+		else if ( ( arg == "-srv" ) || ( arg == "-server" ) ) 
+		{
+      useServer = true;
+    } 
+		else if ( ( arg == "-uc" ) || ( arg == "-useCache" ) ) 
+		{
+      useCache = true;
+    } 
+		else if ( ( arg == "-ck" ) || ( arg == "-cacheKey" ) ) 
+		{
+      queryCacheKey = true;
     } 
 		else if ( ( arg == "-nbp" ) || ( arg == "-noBackPlane" ) ) 
 		{
@@ -354,9 +351,31 @@ MStatus	liqPreviewShader::doIt( const MArgList& args )
   if ( tempString.empty() ) preview.backPlaneShader = "null";
   else                      preview.backPlaneShader = "liquidchecker"; // tempString + "/shaders/liquidchecker";
   
+  // swatches are cached by content, the same settings are never rendered twice
+  if ( useCache || queryCacheKey ) 
+  {
+    MString cacheKey( liqSwatchCache::instance().key( preview ) );
+    if ( queryCacheKey ) 
+    {
+      setResult( cacheKey );
+      return MS::kSuccess;
+    }
+    if ( liqSwatchCache::instance().contains( cacheKey ) ) 
+    {
+      LIQDEBUGPRINTF( "-> preview of %s is cached as %s\n", shaderNodeName.c_str(), cacheKey.asChar() );
+      return MS::kSuccess;
+    }
+  }
+
 
 #ifdef DELIGHT
   liquidOutputPreviewShader( string(), preview ); // 3Delight doesn't need a RIB
+#else
+  // hand the swatch to the preview server, the swatch node picks up the pixels
+  if ( useServer && liqPreviewServer::instance().submit( preview ) ) 
+    return MS::kSuccess;
+  // the swatch reads the file render, not an older image of the server
+  liqPreviewServer::instance().forget( shaderNodeName );
 #endif
 
 #ifndef DELIGHT
@@ -551,17 +570,21 @@ int liquidOutputPreviewShader( const string& fileName, const liqPreviewShaderOpt
   RiPixelFilter( RiCatmullRomFilter, 4., 4. );
 #endif
 
+  // the preview server sends several frames down the same stream
+  if ( options.displayPort ) RiFrameBegin( 0 );
+
   RiFormat( ( RtInt )options.displaySize, ( RtInt )options.displaySize, 1.0 );
-  if ( options.backPlane ) 
+  RtToken mode( options.backPlane ? RI_RGB : RI_RGBA ); // Alpha might be useful
+  if ( options.displayPort ) 
 	{
+    RtInt port( options.displayPort );
     RiDisplay( const_cast< RtString >( options.displayName.c_str() ),
-               const_cast< RtString >( options.displayDriver.c_str() ), RI_RGB, RI_NULL );
+               const_cast< RtString >( options.displayDriver.c_str() ), mode, 
+               ( RtToken )"int mayaDisplayPort", &port, RI_NULL );
   } 
 	else 
-	{ // Alpha might be useful
     RiDisplay( const_cast< RtString >( options.displayName.c_str() ),
-               const_cast< RtString >( options.displayDriver.c_str() ), RI_RGBA, RI_NULL );
-  }
+               const_cast< RtString >( options.displayDriver.c_str() ), mode, RI_NULL );
   RtFloat fov( 22.5 );
   RiProjection( "perspective", "fov", &fov, RI_NULL );
   RiTranslate( 0, 0, 2.75 );
@@ -965,6 +988,7 @@ int liquidOutputPreviewShader( const string& fileName, const liqPreviewShaderOpt
   }
 
   RiWorldEnd();
+  if ( options.displayPort ) RiFrameEnd();
 
 /* this caused maya to hang up under windoof - Alf
 #ifdef _WIN32
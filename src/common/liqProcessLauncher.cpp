@@ -19,28 +19,423 @@
 #include "liqProcessLauncher.h"
 
 #include <maya/MString.h>
+#include <maya/MStringArray.h>
 
 #include <sstream>
+#include <vector>
 using namespace std;
 
 
 /* ______________________________________________________________________
 **
-** Linux implementation of liqProcessLauncher::execute()
+** Linux implementation of liqProcessLauncher
 ** ______________________________________________________________________
 */
 #if defined(LINUX) || defined(OSX)
 
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
-#include <stdlib.h>
+#include <spawn.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <deque>
+#include <map>
+#include <string>
+
+#ifdef OSX
+#include <crt_externs.h>
+#define environ (*_NSGetEnviron())
+#else
+extern char **environ;
+#endif
+
+// glibc 2.29 can change the child's directory itself, otherwise its shell does
+#if defined(__GLIBC__) && ( __GLIBC__ > 2 || ( __GLIBC__ == 2 && __GLIBC_MINOR__ >= 29 ) )
+#define LIQ_SPAWN_CHDIR
+#endif
+
+extern bool liquidBin;
+
+// A child started here, from its spawn until it is waited for. Its reader
+// thread streams its output and reaps it.
+struct liqChild {
+  pid_t   pid;
+  string  name;       // the command, for its messages
+  int     out, err;   // read ends of its stdout and stderr, -1 if not captured
+  bool    detached;   // nobody waits for it, its reader forgets it
+  bool    ended;
+  int     status;
+};
+
+static pthread_mutex_t                               s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static map< pid_t, liqChild* >                       s_children;
+static deque< pair< liquidVerbosityType, string > >  s_lines;      // what flush() shows
+static unsigned                                      s_dropped = 0;
+static unsigned                                      s_readers = 0;
+static const unsigned                                kMaxLines = 1000;
+
+static void queueLine( liquidVerbosityType type, const string &line )
+{
+  pthread_mutex_lock( &s_mutex );
+  // nobody flushes while a background render runs outside the render view
+  if ( s_lines.size() >= kMaxLines ) 
+  {
+    s_lines.pop_front();
+    s_dropped++;
+  }
+  s_lines.push_back( make_pair( type, line ) );
+  pthread_mutex_unlock( &s_mutex );
+}
+
+static int exitStatus( int wstatus )
+{
+  return WIFEXITED( wstatus )? WEXITSTATUS( wstatus ) : WIFSIGNALED( wstatus )? 128 + WTERMSIG( wstatus ) : -1;
+}
+
+static void* readOutput( void *data )
+{
+  liqChild *c = ( liqChild* )data;
+  struct pollfd fds[ 2 ] = { { c->out, POLLIN, 0 }, { c->err, POLLIN, 0 } };
+  const liquidVerbosityType types[ 2 ] = { messageInfo, messageWarning };
+  string pending[ 2 ];
+  char buffer[ 4096 ];
+  int wstatus( 0 );
+  bool exited( false );
+  while ( fds[ 0 ].fd >= 0 || fds[ 1 ].fd >= 0 ) 
+  {
+    // a background process of the child may keep the pipes open after it exited
+    const int ready = poll( fds, 2, exited ? 0 : 200 );
+    if ( !ready && !exited ) 
+    {
+      pid_t pid = waitpid( c->pid, &wstatus, WNOHANG );
+      exited = ( pid != 0 );
+      if ( pid < 0 ) wstatus = -1;
+      continue;
+    }
+    if ( ready <= 0 ) break;
+    for ( int i( 0 ); i < 2; i++ ) 
+    {
+      if ( fds[ i ].fd < 0 || !fds[ i ].revents ) continue;
+      const ssize_t size = read( fds[ i ].fd, buffer, sizeof( buffer ) );
+      if ( size <= 0 ) 
+      {
+        close( fds[ i ].fd );
+        fds[ i ].fd = -1;
+        continue;
+      }
+      pending[ i ].append( buffer, size );
+      size_t end;
+      while ( ( end = pending[ i ].find( '\n' ) ) != string::npos ) 
+      {
+        queueLine( types[ i ], c->name + ": " + pending[ i ].substr( 0, end ) );
+        pending[ i ].erase( 0, end + 1 );
+      }
+    }
+  }
+  for ( int i( 0 ); i < 2; i++ ) 
+  {
+    if ( fds[ i ].fd >= 0 ) close( fds[ i ].fd );
+    if ( !pending[ i ].empty() ) queueLine( types[ i ], c->name + ": " + pending[ i ] );
+  }
+  if ( !exited && waitpid( c->pid, &wstatus, 0 ) < 0 ) wstatus = -1;
+
+  pthread_mutex_lock( &s_mutex );
+  c->ended  = true;
+  c->status = ( wstatus == -1 )? -1 : exitStatus( wstatus );
+  if ( c->detached ) 
+  {
+    if ( c->status ) 
+    {
+      char message[ 64 ];
+      sprintf( message, " exited with %d", c->status );
+      s_lines.push_back( make_pair( messageError, c->name + message ) );
+    }
+    s_children.erase( c->pid );
+    delete c;
+  }
+  s_readers--;
+  pthread_mutex_unlock( &s_mutex );
+  return NULL;
+}
+
+// Cut command and arguments in words the way the shell does, false if they
+// use more of it than quotes and escapes: the shell runs them then.
+static bool splitWords( const string &line, vector< string > &words )
+{
+  string word;
+  bool inWord( false );
+  char quote( 0 );
+  for ( size_t i( 0 ); i < line.size(); i++ ) 
+  {
+    const char c( line[ i ] );
+    if ( quote == '\'' ) 
+    {
+      if ( c == '\'' ) quote = 0;
+      else word += c;
+    }
+    else if ( quote == '"' ) 
+    {
+      if ( c == '"' ) quote = 0;
+      else if ( c == '$' || c == '`' ) return false;
+      else if ( c == '\\' && i + 1 < line.size() && strchr( "\"\\", line[ i + 1 ] ) ) word += line[ ++i ];
+      else word += c;
+    }
+    else if ( c == '\'' || c == '"' ) 
+    {
+      quote = c;
+      inWord = true;
+    }
+    else if ( c == '\\' && i + 1 < line.size() ) 
+    {
+      word += line[ ++i ];
+      inWord = true;
+    }
+    else if ( c == ' ' || c == '\t' ) 
+    {
+      if ( inWord ) words.push_back( word );
+      word.clear();
+      inWord = false;
+    }
+    else if ( strchr( "|&;<>()$`*?[]{}~#!\n", c ) ) return false;
+    else 
+    {
+      word += c;
+      inWord = true;
+    }
+  }
+  if ( quote ) return false;
+  if ( inWord ) words.push_back( word );
+  return !words.empty();
+}
+
+// Start command in path, in its own process group so cancel() gets its
+// children too. With capture, its output goes to liquidMessage.
+static pid_t spawn( const MString &command, const MString &arguments, const MString &path, bool capture, bool detached )
+{
+  const string line( ( command + " " + arguments ).asChar() );
+  const string dir( path.asChar() );
+  vector< string > words;
+  if ( !splitWords( line, words ) ) 
+  {
+    words.clear();
+    words.push_back( "/bin/sh" );
+    words.push_back( "-c" );
+    words.push_back( line );
+  }
+#ifndef LIQ_SPAWN_CHDIR
+  if ( !dir.empty() ) 
+  {
+    // "$0" and "$@" keep the directory and the words as they are
+    words.insert( words.begin(), dir );
+    words.insert( words.begin(), "cd \"$0\" && exec \"$@\"" );
+    words.insert( words.begin(), "-c" );
+    words.insert( words.begin(), "/bin/sh" );
+  }
+#endif
+  vector< char* > argv;
+  for ( unsigned i( 0 ); i < words.size(); i++ ) argv.push_back( const_cast< char* >( words[ i ].c_str() ) );
+  argv.push_back( NULL );
+
+  int out[ 2 ] = { -1, -1 }, err[ 2 ] = { -1, -1 };
+  if ( capture && ( pipe( out ) || pipe( err ) ) ) 
+  {
+    if ( out[ 0 ] >= 0 ) 
+    {
+      close( out[ 0 ] );
+      close( out[ 1 ] );
+    }
+    return 0;
+  }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init( &actions );
+  if ( capture ) 
+  {
+    // only the child's stdout and stderr stay open in it
+    for ( int i( 0 ); i < 2; i++ ) 
+    {
+      fcntl( out[ i ], F_SETFD, FD_CLOEXEC );
+      fcntl( err[ i ], F_SETFD, FD_CLOEXEC );
+    }
+    posix_spawn_file_actions_adddup2( &actions, out[ 1 ], 1 );
+    posix_spawn_file_actions_adddup2( &actions, err[ 1 ], 2 );
+  }
+#ifdef LIQ_SPAWN_CHDIR
+  if ( !dir.empty() ) posix_spawn_file_actions_addchdir_np( &actions, dir.c_str() );
+#endif
+  posix_spawnattr_t attributes;
+  posix_spawnattr_init( &attributes );
+  posix_spawnattr_setflags( &attributes, POSIX_SPAWN_SETPGROUP );
+  posix_spawnattr_setpgroup( &attributes, 0 );
+
+  pid_t pid;
+  const int error = posix_spawnp( &pid, argv[ 0 ], &actions, &attributes, &argv[ 0 ], environ );
+  posix_spawn_file_actions_destroy( &actions );
+  posix_spawnattr_destroy( &attributes );
+  if ( capture ) 
+  {
+    close( out[ 1 ] );
+    close( err[ 1 ] );
+  }
+  if ( error ) 
+  {
+    if ( capture ) 
+    {
+      close( out[ 0 ] );
+      close( err[ 0 ] );
+    }
+    liquidMessage( "Couldn't start " + command + ": " + strerror( error ), messageError );
+    return 0;
+  }
+
+  liqChild *c = new liqChild;
+  c->pid      = pid;
+  c->name     = command.asChar();
+  c->name     = c->name.substr( c->name.find_last_of( '/' ) + 1 );
+  c->out      = out[ 0 ];
+  c->err      = err[ 0 ];
+  c->detached = detached;
+  c->ended    = false;
+  c->status   = -1;
+  if ( !capture && detached ) 
+  {
+    // a background render of liquidBin keeps its terminal, and outlives it
+    delete c;
+    return pid;
+  }
+  pthread_mutex_lock( &s_mutex );
+  s_children[ pid ] = c;
+  pthread_mutex_unlock( &s_mutex );
+  pthread_t reader;
+  pthread_attr_t attr;
+  pthread_attr_init( &attr );
+  pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+  pthread_mutex_lock( &s_mutex );
+  s_readers++;
+  pthread_mutex_unlock( &s_mutex );
+  // without a thread, read its output until it ends
+  if ( pthread_create( &reader, &attr, readOutput, c ) ) readOutput( c );
+  pthread_attr_destroy( &attr );
+  return pid;
+}
 
 bool liqProcessLauncher::execute( const MString &command, const MString &arguments, const MString &path, const bool wait )
 {
-  chdir( path.asChar() );
-  MString cmd = command + " " + arguments + ( wait ? "" : "&" );
-  int returnCode = system( cmd.asChar() );
-  return ( returnCode != -1 );
+  flush();
+  if ( !wait ) 
+    return start( command, arguments, path, true ) != 0;
+  vector< process > processes( 1, start( command, arguments, path ) );
+  if ( !processes[ 0 ] ) return false;
+  int status;
+  waitAny( processes, status );
+  return !status;
+}
+
+bool liqProcessLauncher::executeAll( const MString &command, const MStringArray &arguments, const MString &path )
+{
+  vector< process > processes;
+  for ( unsigned i( 0 ); i < arguments.length(); i++ ) 
+  {
+    process p( start( command, arguments[ i ], path ) );
+    if ( p ) processes.push_back( p );
+  }
+  bool ok( processes.size() == arguments.length() );
+  while ( !processes.empty() ) 
+  {
+    int status;
+    const int i( waitAny( processes, status ) );
+    ok = ok && !status;
+    processes.erase( processes.begin() + i );
+  }
+  return ok;
+}
+
+liqProcessLauncher::process liqProcessLauncher::start( const MString &command, const MString &arguments, const MString &path, const bool detached )
+{
+  // liquidBin leaves the detached ones running with its own output
+  return spawn( command, arguments, path, !detached || !liquidBin, detached );
+}
+
+int liqProcessLauncher::waitAny( const vector< process > &processes, int &status, int timeout )
+{
+  for ( int waited( 0 ); ; waited += 20 ) 
+  {
+    int found( -1 );
+    pthread_mutex_lock( &s_mutex );
+    for ( unsigned i( 0 ); i < processes.size() && found < 0; i++ ) 
+    {
+      map< pid_t, liqChild* >::iterator c( s_children.find( processes[ i ] ) );
+      if ( c == s_children.end() ) 
+      {
+        // unknown to us, or already waited for
+        status = -1;
+        found = i;
+      }
+      else if ( c->second->ended ) 
+      {
+        status = c->second->status;
+        delete c->second;
+        s_children.erase( c );
+        found = i;
+      }
+    }
+    pthread_mutex_unlock( &s_mutex );
+    flush();
+    if ( found >= 0 || processes.empty() ) return found;
+    if ( timeout >= 0 && waited >= timeout ) return -1;
+    usleep( 20000 );
+  }
+}
+
+void liqProcessLauncher::flush()
+{
+  pthread_mutex_lock( &s_mutex );
+  deque< pair< liquidVerbosityType, string > > lines;
+  lines.swap( s_lines );
+  const unsigned dropped( s_dropped );
+  s_dropped = 0;
+  pthread_mutex_unlock( &s_mutex );
+  if ( dropped ) 
+  {
+    MString message( "    ... " );
+    message += ( int )dropped;
+    liquidMessage( message + " lines of render output", messageInfo );
+  }
+  for ( unsigned i( 0 ); i < lines.size(); i++ ) 
+    liquidMessage( lines[ i ].second.c_str(), lines[ i ].first );
+}
+
+void liqProcessLauncher::cancel( const vector< process > &processes )
+{
+  pthread_mutex_lock( &s_mutex );
+  for ( unsigned i( 0 ); i < processes.size(); i++ ) 
+  {
+    // an ended detached child is forgotten, its pid may be another process's by now
+    map< pid_t, liqChild* >::iterator c( s_children.find( processes[ i ] ) );
+    if ( c != s_children.end() && !c->second->ended ) kill( -c->first, SIGTERM );
+  }
+  pthread_mutex_unlock( &s_mutex );
+}
+
+void liqProcessLauncher::cancel()
+{
+  pthread_mutex_lock( &s_mutex );
+  for ( map< pid_t, liqChild* >::iterator c( s_children.begin() ); c != s_children.end(); ++c ) 
+    if ( !c->second->ended ) kill( -c->first, SIGTERM );
+  pthread_mutex_unlock( &s_mutex );
+  // the readers run plugin code: they must be done before it is unloaded
+  for ( int i( 0 ); i < 100; i++ ) 
+  {
+    pthread_mutex_lock( &s_mutex );
+    const unsigned readers( s_readers );
+    pthread_mutex_unlock( &s_mutex );
+    if ( !readers ) break;
+    usleep( 20000 );
+  }
+  flush();
 }
 #endif // LINUX
 
@@ -51,7 +446,10 @@ bool liqProcessLauncher::execute( const MString &command, const MString &argumen
 */
 #if defined(IRIX)
 
+#include <algorithm>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
 #include <unistd.h>
 
 bool liqProcessLauncher::execute( const MString &command, const MString &arguments, const MString &path, const bool wait )
@@ -60,6 +458,64 @@ bool liqProcessLauncher::execute( const MString &command, const MString &argumen
   pcreatelp( command.asChar(), command.asChar(), arguments.asChar(), NULL );
   return true;
 }
+
+bool liqProcessLauncher::executeAll( const MString &command, const MStringArray &arguments, const MString &path )
+{
+  // pcreatelp doesn't wait, there's nothing to wait for here either
+  for ( unsigned i( 0 ); i < arguments.length(); i++ ) execute( command, arguments[ i ], path, false );
+  return true;
+}
+
+static vector< pid_t > s_started;
+
+liqProcessLauncher::process liqProcessLauncher::start( const MString &command, const MString &arguments, const MString &path, const bool detached )
+{
+  MString cmd = command + " " + arguments;
+  pid_t pid = fork();
+  if ( pid == 0 ) 
+  {
+    // the child changes directory, maya stays where it is
+    if ( chdir( path.asChar() ) ) _exit( 127 );
+    execl( "/bin/sh", "sh", "-c", cmd.asChar(), (char*)NULL );
+    _exit( 127 );
+  }
+  if ( pid > 0 ) s_started.push_back( pid );
+  return ( pid > 0 )? pid : 0;
+}
+
+int liqProcessLauncher::waitAny( const vector< process > &processes, int &status, int timeout )
+{
+  for ( int waited( 0 ); !processes.empty(); waited += 20 ) 
+  {
+    for ( unsigned i( 0 ); i < processes.size(); i++ ) 
+    {
+      int wstatus;
+      pid_t pid = waitpid( processes[ i ], &wstatus, WNOHANG );
+      if ( pid == 0 ) continue;
+      status = ( pid < 0 )? -1 : WIFEXITED( wstatus )? WEXITSTATUS( wstatus ) : 128 + WTERMSIG( wstatus );
+      s_started.erase( find( s_started.begin(), s_started.end(), processes[ i ] ) );
+      return i;
+    }
+    if ( timeout >= 0 && waited >= timeout ) break;
+    usleep( 20000 );
+  }
+  return -1;
+}
+
+void liqProcessLauncher::flush()
+{
+}
+
+void liqProcessLauncher::cancel( const vector< process > &processes )
+{
+  for ( unsigned i( 0 ); i < processes.size(); i++ ) 
+    if ( find( s_started.begin(), s_started.end(), processes[ i ] ) != s_started.end() ) kill( processes[ i ], SIGTERM );
+}
+
+void liqProcessLauncher::cancel()
+{
+  for ( unsigned i( 0 ); i < s_started.size(); i++ ) kill( s_started[ i ], SIGTERM );
+}
 #endif // IRIX
 
 
@@ -69,6 +525,7 @@ bool liqProcessLauncher::execute( const MString &command, const MString &argumen
 ** ______________________________________________________________________
 */
 #if defined(_WIN32)
+#include <algorithm>
 #include <stdio.h>
 #include <direct.h>
 #include <process.h>
@@ -190,6 +647,98 @@ bool liqProcessLauncher::execute( const MString &command, const MString &argumen
     return ( ret )? true : false ;
   }
 }
-#endif // _WIN32
 
+bool liqProcessLauncher::executeAll( const MString &command, const MStringArray &arguments, const MString &path )
+{
+  vector< HANDLE > processes;
+  for ( unsigned i( 0 ); i < arguments.length(); i++ ) 
+  {
+    PROCESS_INFORMATION pinfo;
+    STARTUPINFO sinfo;
+    ZeroMemory( &pinfo, sizeof( PROCESS_INFORMATION ) );
+    ZeroMemory( &sinfo, sizeof( STARTUPINFO ) );
+    sinfo.cb = sizeof( STARTUPINFO );
+
+    MString cmdline = command + " " + arguments[ i ];
+    liquidMessage( "Render (wait) " + cmdline, messageInfo );
+    if ( !CreateProcess( NULL, (char *)cmdline.asChar(), NULL, NULL, false, CREATE_NO_WINDOW, NULL, path.asChar(), &sinfo, &pinfo ) ) 
+      continue;
+    CloseHandle( pinfo.hThread );
+    processes.push_back( pinfo.hProcess );
+  }
+  for ( unsigned i( 0 ); i < processes.size(); i++ ) 
+  {
+    WaitForSingleObject( processes[ i ], INFINITE );
+    CloseHandle( processes[ i ] );
+  }
+  return processes.size() == arguments.length();
+}
+
+static vector< HANDLE > s_started;
+static vector< HANDLE > s_detached;  // kept open so they can still be cancelled
 
+liqProcessLauncher::process liqProcessLauncher::start( const MString &command, const MString &arguments, const MString &path, const bool detached )
+{
+  PROCESS_INFORMATION pinfo;
+  STARTUPINFO sinfo;
+  ZeroMemory( &pinfo, sizeof( PROCESS_INFORMATION ) );
+  ZeroMemory( &sinfo, sizeof( STARTUPINFO ) );
+  sinfo.cb = sizeof( STARTUPINFO );
+
+  MString cmdline = command + " " + arguments;
+  if ( !CreateProcess( NULL, (char *)cmdline.asChar(), NULL, NULL, false, CREATE_NO_WINDOW, NULL, path.asChar(), &sinfo, &pinfo ) ) 
+    return 0;
+  CloseHandle( pinfo.hThread );
+  ( detached ? s_detached : s_started ).push_back( pinfo.hProcess );
+  return pinfo.hProcess;
+}
+
+int liqProcessLauncher::waitAny( const vector< process > &processes, int &status, int timeout )
+{
+  if ( processes.empty() ) return -1;
+  // WaitForMultipleObjects takes at most MAXIMUM_WAIT_OBJECTS handles at once
+  const bool poll( timeout >= 0 || processes.size() > MAXIMUM_WAIT_OBJECTS );
+  for ( int waited( 0 ); ; waited += 20 ) 
+  {
+    for ( unsigned first( 0 ); first < processes.size(); first += MAXIMUM_WAIT_OBJECTS ) 
+    {
+      DWORD count = (DWORD)( processes.size() - first );
+      if ( count > MAXIMUM_WAIT_OBJECTS ) count = MAXIMUM_WAIT_OBJECTS;
+      DWORD ret = WaitForMultipleObjects( count, &processes[ first ], false, poll ? 20 : INFINITE );
+      if ( ret == WAIT_TIMEOUT ) continue;
+      int i = first;
+      status = -1;
+      if ( ret < WAIT_OBJECT_0 + count ) 
+      {
+        DWORD code;
+        i += ret - WAIT_OBJECT_0;
+        if ( GetExitCodeProcess( processes[ i ], &code ) ) status = (int)code;
+      }
+      vector< HANDLE >::iterator started( find( s_started.begin(), s_started.end(), processes[ i ] ) );
+      if ( started != s_started.end() ) s_started.erase( started );
+      CloseHandle( processes[ i ] );
+      return i;
+    }
+    if ( timeout >= 0 && waited >= timeout ) return -1;
+  }
+}
+
+void liqProcessLauncher::flush()
+{
+  // execute() copies the output of the renders it waits for to maya's
+}
+
+void liqProcessLauncher::cancel( const vector< process > &processes )
+{
+  // the handles of the ones waited for are closed
+  for ( unsigned i( 0 ); i < processes.size(); i++ ) 
+    if ( find( s_started.begin(), s_started.end(), processes[ i ] ) != s_started.end() || 
+         find( s_detached.begin(), s_detached.end(), processes[ i ] ) != s_detached.end() ) 
+      TerminateProcess( processes[ i ], 1 );
+}
+
+void liqProcessLauncher::cancel()
+{
+  for ( unsigned i( 0 ); i < s_started.size(); i++ ) TerminateProcess( s_started[ i ], 1 );
+}
+#endif // _WIN32
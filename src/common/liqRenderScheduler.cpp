@@ -0,0 +1,188 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the 
+** "License"); you may not use this file except in compliance with the License. You may 
+** obtain a copy of the License at http://www.mozilla.org/MPL/ 
+** 
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT 
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific 
+** language governing rights and limitations under the License. 
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Render Scheduler Source
+** ______________________________________________________________________
+*/
+
+#include <liqGlobalHelpers.h>
+#include <liqRenderScheduler.h>
+#include <liqRenderStats.h>
+
+#include <maya/MComputation.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+
+liqRenderScheduler::liqRenderScheduler( const MString &path, int slots ) : m_path( path ), m_slots( ( slots > 0 )? slots : 1 )
+{
+}
+
+int liqRenderScheduler::cores()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo( &info );
+  return info.dwNumberOfProcessors;
+#else
+  const long count = sysconf( _SC_NPROCESSORS_ONLN );
+  return ( count > 0 )? count : 1;
+#endif
+}
+
+int liqRenderScheduler::slots( int slots, int threads )
+{
+  if ( slots > 0 ) return slots;
+  if ( threads <= 0 ) return 1;
+  const int count = cores() / threads;
+  return ( count > 0 )? count : 1;
+}
+
+int liqRenderScheduler::add( const MString &name, const MString &command, const MString &arguments, const vector< int > &after )
+{
+  job j;
+  j.name      = name;
+  j.command   = command;
+  j.arguments = arguments;
+  j.after     = after;
+  j.state     = kWaiting;
+  j.begin     = 0;
+  m_jobs.push_back( j );
+  return m_jobs.size() - 1;
+}
+
+bool liqRenderScheduler::isReady( const job &j ) const
+{
+  for ( unsigned i( 0 ); i < j.after.size(); i++ ) 
+    if ( m_jobs[ j.after[ i ] ].state != kDone ) return false;
+  return true;
+}
+
+// one of the jobs it needs didn't render
+bool liqRenderScheduler::isBlocked( const job &j ) const
+{
+  for ( unsigned i( 0 ); i < j.after.size(); i++ ) 
+    if ( m_jobs[ j.after[ i ] ].state == kFailed || m_jobs[ j.after[ i ] ].state == kSkipped ) return true;
+  return false;
+}
+
+bool liqRenderScheduler::end( int i, int status )
+{
+  job &j( m_jobs[ i ] );
+  j.state = status ? kFailed : kDone;
+  char seconds[ 32 ];
+  sprintf( seconds, "%.2fs", liqRenderStats::now() - j.begin );
+  if ( status ) 
+  {
+    MString message( "    failed '" + j.name + "' in " + seconds + ", exit code " );
+    message += status;
+    liquidMessage( message, messageError );
+    return false;
+  }
+  liquidMessage( "    done '" + j.name + "' in " + seconds, messageInfo );
+  return true;
+}
+
+bool liqRenderScheduler::run()
+{
+  const double begin( liqRenderStats::now() );
+  bool ok( true );
+  vector< liqProcessLauncher::process > processes;
+  vector< int > running;
+  unsigned done( 0 );
+  bool cancelled( false );
+  MComputation computation;
+  computation.beginComputation();
+  while ( done < m_jobs.size() && !( cancelled && running.empty() ) ) 
+  {
+    // the jobs added after the one they need, one pass skips whole chains
+    for ( unsigned i( 0 ); !cancelled && i < m_jobs.size(); i++ ) 
+    {
+      job &j( m_jobs[ i ] );
+      if ( j.state != kWaiting || !isBlocked( j ) ) continue;
+      liquidMessage( "    skipped '" + j.name + "', a job it needs failed", messageError );
+      j.state = kSkipped;
+      ok = false;
+      done++;
+    }
+    // in the order they were added
+    for ( unsigned i( 0 ); !cancelled && i < m_jobs.size() && running.size() < ( unsigned )m_slots; i++ ) 
+    {
+      job &j( m_jobs[ i ] );
+      if ( j.state != kWaiting || !isReady( j ) ) continue;
+      liquidMessage( "    + '" + j.name + "'", messageInfo );
+      j.state = kRunning;
+      j.begin = liqRenderStats::now();
+      liqProcessLauncher::process process( liqProcessLauncher::start( j.command, j.arguments, m_path ) );
+      if ( !process ) 
+      {
+        liquidMessage( "Couldn't start " + j.command + " " + j.arguments, messageError );
+        j.state = kFailed;
+        ok = false;
+        done++;
+        continue;
+      }
+      processes.push_back( process );
+      running.push_back( i );
+    }
+    if ( running.empty() && !cancelled ) 
+    {
+      // whatever is left waits on itself
+      if ( done < m_jobs.size() ) 
+      {
+        liquidMessage( "Couldn't order the render jobs, some depend on each other", messageError );
+        ok = false;
+      }
+      break;
+    }
+
+    if ( !cancelled && computation.isInterruptRequested() ) 
+    {
+      liquidMessage( "Render jobs cancelled", messageWarning );
+      liqProcessLauncher::cancel( processes );
+      cancelled = true;
+      ok = false;
+    }
+    int status;
+    const int i( liqProcessLauncher::waitAny( processes, status, 100 ) );
+    if ( i < 0 ) continue;
+    ok = end( running[ i ], status ) && ok;
+    processes.erase( processes.begin() + i );
+    running.erase( running.begin() + i );
+    done++;
+  }
+  computation.endComputation();
+  if ( m_jobs.size() ) 
+  {
+    char seconds[ 32 ];
+    sprintf( seconds, "%.2fs", liqRenderStats::now() - begin );
+    MString message( "    " );
+    message += ( int )m_jobs.size();
+    message += " jobs in ";
+    message += MString( seconds ) + " on ";
+    message += m_slots;
+    liquidMessage( message + " slots", messageInfo );
+  }
+  return ok;
+}
@@ -0,0 +1,170 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the 
+** "License"); you may not use this file except in compliance with the License. You may 
+** obtain a copy of the License at http://www.mozilla.org/MPL/ 
+** 
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT 
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific 
+** language governing rights and limitations under the License. 
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Render Tiles Source
+** ______________________________________________________________________
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <maya/MImage.h>
+
+#include <liqRenderTiles.h>
+
+
+// the CropWindow edge of a pixel boundary: renderers take the pixels whose
+// ceil( size * edge ) falls inside, half a pixel keeps rounding errors out
+static double cropEdge( int pixel, int size )
+{
+  if ( pixel <= 0 ) return 0.0;
+  if ( pixel >= size ) return 1.0;
+  return ( pixel - 0.5 ) / size;
+}
+
+static int cropPixel( double edge, int size )
+{
+  int pixel( ( int )ceil( edge * size ) );
+  return pixel < 0 ? 0 : ( pixel > size ? size : pixel );
+}
+
+void liqRenderTiles::cropPixels( const double crop[ 4 ], int width, int height, int pixels[ 4 ] )
+{
+  pixels[ 0 ] = cropPixel( crop[ 0 ], width );
+  pixels[ 1 ] = cropPixel( crop[ 1 ], width );
+  pixels[ 2 ] = cropPixel( crop[ 2 ], height );
+  pixels[ 3 ] = cropPixel( crop[ 3 ], height );
+}
+
+void liqRenderTiles::cropWindow( const int pixels[ 4 ], int width, int height, double crop[ 4 ] )
+{
+  crop[ 0 ] = cropEdge( pixels[ 0 ], width );
+  crop[ 1 ] = cropEdge( pixels[ 1 ], width );
+  crop[ 2 ] = cropEdge( pixels[ 2 ], height );
+  crop[ 3 ] = cropEdge( pixels[ 3 ], height );
+}
+
+vector< liqRenderTile > liqRenderTiles::split( int width, int height, int count, const double crop[ 4 ] )
+{
+  int pixels[ 4 ];
+  cropPixels( crop, width, height, pixels );
+  const int x0( pixels[ 0 ] ), x1( pixels[ 1 ] ), y0( pixels[ 2 ] ), y1( pixels[ 3 ] );
+
+  // the columns x rows grid whose tiles are the closest to squares
+  int columns( 1 ), rows( 1 );
+  double best( -1 );
+  for ( int c( 1 ); c <= count; c++ ) 
+  {
+    if ( count % c || c > x1 - x0 || count / c > y1 - y0 ) continue;
+    double aspect( fabs( log( ( double )( x1 - x0 ) / c * ( count / c ) / ( y1 - y0 ) ) ) );
+    if ( best < 0 || aspect < best ) 
+    {
+      best = aspect;
+      columns = c;
+      rows = count / c;
+    }
+  }
+
+  vector< liqRenderTile > tiles;
+  for ( int r( 0 ); r < rows; r++ ) 
+    for ( int c( 0 ); c < columns; c++ ) 
+    {
+      liqRenderTile tile;
+      tile.left   = x0 + ( x1 - x0 ) * c / columns;
+      tile.right  = x0 + ( x1 - x0 ) * ( c + 1 ) / columns;
+      tile.bottom = y0 + ( y1 - y0 ) * r / rows;
+      tile.top    = y0 + ( y1 - y0 ) * ( r + 1 ) / rows;
+      const int bounds[ 4 ] = { tile.left, tile.right, tile.bottom, tile.top };
+      cropWindow( bounds, width, height, tile.crop );
+      tiles.push_back( tile );
+    }
+  return tiles;
+}
+
+MString liqRenderTiles::tileName( const MString &file, unsigned tile )
+{
+  MString suffix( ".tile" );
+  suffix += ( int )tile;
+  int dot( file.rindex( '.' ) ), slash( file.rindex( '/' ) );
+  if ( dot <= slash || dot <= file.rindex( '\\' ) ) return file + suffix;
+  return file.substring( 0, dot - 1 ) + suffix + file.substring( dot, file.length() - 1 );
+}
+
+bool liqRenderTiles::isMergeable( const MString &type, const MString &mode )
+{
+  return ( type == "openexr" || type == "exr" ) && ( mode == "" || mode == "rgb" || mode == "rgba" );
+}
+
+bool liqRenderTiles::merge( const MString &image, const vector< liqRenderTile > &tiles, int width, int height, MString &error )
+{
+  MString format( image.substring( image.rindex( '.' ) + 1, image.length() - 1 ) );
+  if ( format != "exr" ) 
+  {
+    error = "Can't merge the tiles of " + image + " without losing precision, only exr tiles are merged";
+    return false;
+  }
+  const MImage::MPixelType type( MImage::kFloat );
+  const size_t pixelSize( 4 * sizeof( float ) );
+  vector< unsigned char > pixels( ( size_t )width * height * pixelSize, 0 );
+
+  for ( unsigned i( 0 ); i < tiles.size(); i++ ) 
+  {
+    const liqRenderTile &tile( tiles[ i ] );
+    const MString name( tileName( image, i ) );
+    MImage tileImage;
+    if ( tileImage.readFromFile( name, type ) != MS::kSuccess ) 
+    {
+      error = "Couldn't read tile image " + name;
+      return false;
+    }
+    unsigned w, h;
+    tileImage.getSize( w, h );
+    const int tileWidth( tile.right - tile.left ), tileHeight( tile.top - tile.bottom );
+    // renderers write either the crop window alone or the whole frame
+    int x( 0 ), y( 0 );
+    if ( ( int )w == width && ( int )h == height ) 
+    {
+      x = tile.left;
+      y = tile.bottom;
+    }
+    else if ( ( int )w != tileWidth || ( int )h != tileHeight ) 
+    {
+      error = "Unexpected size for tile image " + name;
+      return false;
+    }
+    const unsigned char *src( ( const unsigned char* )tileImage.floatPixels() );
+    // MImage rows go bottom up
+    for ( int row( 0 ); row < tileHeight; row++ ) 
+      memcpy( &pixels[ ( ( size_t )( height - 1 - tile.bottom - row ) * width + tile.left ) * pixelSize ], 
+              src + ( ( size_t )( h - 1 - y - row ) * w + x ) * pixelSize, tileWidth * pixelSize );
+  }
+
+  MImage result;
+  result.create( width, height, 4, type );
+  result.setFloatPixels( ( float* )&pixels[ 0 ], width, height );
+  if ( result.writeToFile( image, format ) != MS::kSuccess ) 
+  {
+    error = "Couldn't write merged image " + image;
+    return false;
+  }
+  for ( unsigned i( 0 ); i < tiles.size(); i++ ) remove( tileName( image, i ).asChar() );
+  return true;
+}
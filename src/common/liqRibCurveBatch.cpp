@@ -0,0 +1,160 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Rib Curve Batch Source
+** ______________________________________________________________________
+*/
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+
+// Maya's Headers
+#include <maya/MAnimControl.h>
+#include <maya/MTime.h>
+
+#include <liquid.h>
+#include <liqGlobalHelpers.h>
+#include <liqRibCurveBatch.h>
+
+#include <boost/scoped_array.hpp>
+
+using namespace boost;
+
+extern int debugMode;
+extern MString liqglo_ribDir;
+extern MString liqglo_sceneName;
+extern int liqglo_pfxChunkSize;
+
+
+unsigned liqCurveBatchSize( unsigned numLines )
+{
+  if ( liqglo_pfxChunkSize <= 0 ) return numLines;
+  return min( numLines, ( unsigned )liqglo_pfxChunkSize );
+}
+
+/** Bound of the batch: its CVs, grown by half the widest width.
+ */
+static void liqCurveBatchBound( const liqCurveBatch &batch, RtBound bound )
+{
+  unsigned numVertices( 0 );
+  for ( unsigned i( 0 ); i < batch.nverts.size(); i++ ) numVertices += batch.nverts[ i ];
+
+  bound[ 0 ] = bound[ 2 ] = bound[ 4 ] = FLT_MAX;
+  bound[ 1 ] = bound[ 3 ] = bound[ 5 ] = -FLT_MAX;
+
+  // RenderMan's default curve width
+  RtFloat maxWidth( 1.0 );
+
+  for ( unsigned t( 0 ); t < batch.tokens.size(); t++ ) 
+  {
+    const liqTokenPointer &token( batch.tokens[ t ] );
+    const RtFloat *values( token.getTokenFloatArray() );
+    if ( !values ) continue;
+
+    if ( token.getTokenName() == "P" ) 
+    {
+      for ( unsigned v( 0 ); v < numVertices; v++ ) 
+      {
+        bound[ 0 ] = min( bound[ 0 ], values[ v * 3 ] );
+        bound[ 1 ] = max( bound[ 1 ], values[ v * 3 ] );
+        bound[ 2 ] = min( bound[ 2 ], values[ v * 3 + 1 ] );
+        bound[ 3 ] = max( bound[ 3 ], values[ v * 3 + 1 ] );
+        bound[ 4 ] = min( bound[ 4 ], values[ v * 3 + 2 ] );
+        bound[ 5 ] = max( bound[ 5 ], values[ v * 3 + 2 ] );
+      }
+    } 
+    else if ( token.getTokenName() == "width" ) 
+    {
+      // varying: one value per span end, uniform: one per curve
+      unsigned numValues( 0 );
+      for ( unsigned i( 0 ); i < batch.nverts.size(); i++ ) 
+        numValues += ( token.getDetailType() == rUniform )? 1 : batch.nverts[ i ] - 2;
+
+      maxWidth = 0;
+      for ( unsigned v( 0 ); v < numValues; v++ ) maxWidth = max( maxWidth, values[ v ] );
+    }
+  }
+  if ( !numVertices ) 
+  {
+    for ( unsigned i( 0 ); i < 6; i++ ) bound[ i ] = 0;
+    return;
+  }
+  for ( unsigned i( 0 ); i < 3; i++ ) 
+  {
+    bound[ i * 2 ]     -= maxWidth * 0.5f;
+    bound[ i * 2 + 1 ] += maxWidth * 0.5f;
+  }
+}
+
+static void liqCurveBatchCurves( const liqCurveBatch &batch, RtToken degree, const liqTokenPointer::array &extraTokens )
+{
+  liqTokenPointer::array tokens( batch.tokens );
+  tokens.insert( tokens.end(), extraTokens.begin(), extraTokens.end() );
+
+  unsigned numTokens( tokens.size() );
+  scoped_array< RtToken > tokenArray( new RtToken[ numTokens ] );
+  scoped_array< RtPointer > pointerArray( new RtPointer[ numTokens ] );
+  assignTokenArraysV( tokens, tokenArray.get(), pointerArray.get() );
+
+  RiCurvesV( degree, batch.nverts.size(), const_cast< RtInt* >( &batch.nverts[ 0 ] ),
+             "nonperiodic", numTokens, tokenArray.get(), pointerArray.get() );
+}
+
+void liqArchiveCurveBatch( liqCurveBatch &batch, RtToken degree, const liqTokenPointer::array &extraTokens,
+                           const MString &nodePath, unsigned batchNumber )
+{
+  if ( batch.nverts.empty() ) return;
+
+  liqCurveBatchBound( batch, batch.bound );
+
+  // the time keeps the motion samples apart
+  char time[ 32 ];
+  sprintf( time, "%.4f", MAnimControl::currentTime().as( MTime::uiUnit() ) );
+  batch.archive = liqglo_ribDir + "/" + liqglo_sceneName + "." + sanitizeNodeName( nodePath ) + "." + time + ".";
+  batch.archive += ( int )batchNumber;
+  batch.archive += ".rib";
+
+  LIQDEBUGPRINTF( "-> writing curve batch to %s\n", batch.archive.asChar() );
+  RiBegin( const_cast< RtToken >( batch.archive.asChar() ) );
+  liqCurveBatchCurves( batch, degree, extraTokens );
+  RiEnd();
+
+  batch.tokens.clear();
+}
+
+void liqWriteCurveBatch( const liqCurveBatch &batch, RtToken degree, const liqTokenPointer::array &extraTokens )
+{
+  if ( batch.archive != "" ) 
+    RiArchiveRecord( RI_VERBATIM, "Procedural \"DelayedReadArchive\" [ \"%s\" ] [ %f %f %f %f %f %f ]\n", batch.archive.asChar(),
+                     batch.bound[ 0 ], batch.bound[ 1 ], batch.bound[ 2 ], batch.bound[ 3 ], batch.bound[ 4 ], batch.bound[ 5 ] );
+  else if ( !batch.nverts.empty() ) 
+    liqCurveBatchCurves( batch, degree, extraTokens );
+}
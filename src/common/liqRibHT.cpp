@@ -111,6 +111,67 @@ int liqRibHT::insert( MDagPath &path, double /*lframe*/, int sample,
                       MMatrix *matrix,
                       const MString instanceStr,
                       int particleId )
+{
+  insertNode( path, sample, objType, CountID, matrix, instanceStr, particleId );
+  return 0;
+}
+
+/**
+ * Insert a particle instancer item.
+ *
+ * Rather than a node per particle, there is one node per instancer and
+ * prototype, holding the transforms of all its instances. Prototypes that
+ * can't go in an object definition (lights, particles, NURBS...) are left
+ * out, and false tells the caller to insert a node per particle instead.
+ */
+bool liqRibHT::insertInstance( MDagPath &path, const MDagPath &instancerPath, int instancerId,
+                               int sample, bool useSamples, int CountID, int particleId, const MMatrix &matrix )
+{
+  MString instanceStr( MString( "|INSTANCER_" ) + instancerId + MString( "_" ) + path.fullPathName() );
+  liqRibNodePtr node;
+
+  map< string, liqRibNodePtr >::iterator found( InstancerMap.find( instanceStr.asChar() ) );
+  if ( found == InstancerMap.end() ) 
+  {
+    // the instances are the particles present at the first sample
+    if ( sample > 0 ) return true;
+
+    node = insertNode( path, 0, MRT_Unknown, CountID, NULL, instanceStr, -1 );
+    InstancerMap[ instanceStr.asChar() ] = node;
+    if ( !liqRibObj::isInstanceable( node->object( 0 )->type ) ) 
+    {
+      // never written, without an instancer it only marks the prototype
+      node->object( 0 )->ignore = node->object( 0 )->ignoreShadow = true;
+      return false;
+    }
+
+    // the instances carry the whole transform
+    node->object( 0 )->setMatrix( 0, MMatrix::identity );
+    node->object( 0 )->setMatrix( path.instanceNumber(), MMatrix::identity );
+
+    MStatus status;
+    MFnDagNode fnNode( path );
+    bool useParticleColor( false );
+    liquidGetPlugValue( fnNode, "useParticleColorWhenInstanced", useParticleColor, status );
+
+    node->instancer = liqRibInstancerPtr( new liqRibInstancer( instancerPath, useParticleColor ) );
+  } 
+  else 
+    node = found->second;
+
+  if ( !node->instancer ) return false;
+  if ( sample > 0 && !useSamples ) return true;
+  // see insert() for the inclusive matrix
+  node->instancer->add( sample, particleId, path.exclusiveMatrix() * matrix );
+  return true;
+}
+
+liqRibNodePtr liqRibHT::insertNode( MDagPath &path, int sample,
+                                    ObjectType objType,
+                                    int CountID,
+                                    MMatrix *matrix,
+                                    const MString instanceStr,
+                                    int particleId )
 {
   LIQDEBUGPRINTF( "-> inserting node into hash table\n" );
   MFnDagNode  fnDagNode( path );
@@ -225,7 +286,7 @@ int liqRibHT::insert( MDagPath &path, double /*lframe*/, int sample,
   if ( instanceStr != "" ) node->motion.deformationBlur = false;
 
   LIQDEBUGPRINTF( "-> finished inserting node into hash table\n" );
-  return 0;
+  return node;
 }
 
 /**
@@ -0,0 +1,208 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Rib Instancer Source
+** ______________________________________________________________________
+*/
+
+#include <algorithm>
+
+// Maya's Headers
+#include <maya/MFnDagNode.h>
+#include <maya/MFnParticleSystem.h>
+#include <maya/MFnDoubleArrayData.h>
+#include <maya/MVectorArray.h>
+#include <maya/MPlug.h>
+#include <maya/MPlugArray.h>
+
+#include <liquid.h>
+#include <liqGlobalHelpers.h>
+#include <liqRibInstancer.h>
+
+extern int debugMode;
+extern bool liqglo_relativeMotion;
+extern liquidlong liqglo_motionSamples;
+extern RtFloat liqglo_sampleTimes[ LIQMAXMOTIONSAMPLES ];
+extern RtFloat liqglo_sampleTimesOffsets[ LIQMAXMOTIONSAMPLES ];
+
+
+liqRibInstancer::liqRibInstancer( const MDagPath &instancerPath, bool useParticleColor )
+  : m_instancerPath( instancerPath ),
+    m_useParticleColor( useParticleColor ),
+    m_colorsRead( false )
+{
+}
+
+/** Record one instance at the given motion sample.
+ */
+void liqRibInstancer::add( int sample, int particleId, const MMatrix &matrix )
+{
+  if ( sample < 0 || sample >= LIQMAXMOTIONSAMPLES ) return;
+  if ( m_samples.size() <= ( unsigned )sample ) m_samples.resize( sample + 1 );
+
+  instanceSample &instances( m_samples[ sample ] );
+  instances.ids.push_back( particleId );
+
+  RtMatrix ribMatrix;
+  matrix.get( ribMatrix );
+  instances.matrices.insert( instances.matrices.end(), &ribMatrix[ 0 ][ 0 ], &ribMatrix[ 0 ][ 0 ] + 16 );
+
+  if ( sample == 0 && m_useParticleColor ) 
+  {
+    if ( !m_colorsRead ) readParticleColors();
+
+    vector< pair< int, unsigned > >::const_iterator found( lower_bound( m_colorIds.begin(), m_colorIds.end(), make_pair( particleId, 0u ) ) );
+    if ( found != m_colorIds.end() && found->first == particleId ) 
+      m_colors.insert( m_colors.end(), &m_particleColors[ found->second * 3 ], &m_particleColors[ found->second * 3 ] + 3 );
+    else 
+    {
+      m_colors.push_back( -1.0 );
+      m_colors.push_back( -1.0 );
+      m_colors.push_back( -1.0 );
+    }
+  }
+}
+
+unsigned liqRibInstancer::size() const
+{
+  return m_samples.empty()? 0 : m_samples[ 0 ].ids.size();
+}
+
+/** Read the particle colors once, instead of once per instance.
+ *
+ *  The instancer's inputPoints are connected to the particle system.
+ */
+void liqRibInstancer::readParticleColors()
+{
+  MStatus status;
+  m_colorsRead = true;
+
+  MFnDagNode instancerFn( m_instancerPath, &status );
+  if ( status != MS::kSuccess ) return;
+
+  MPlug inputPointsPlug( instancerFn.findPlug( "inputPoints", &status ) );
+  if ( status != MS::kSuccess ) return;
+
+  MPlugArray sourcePlugArray;
+  inputPointsPlug.connectedTo( sourcePlugArray, true, false, &status );
+  if ( sourcePlugArray.length() == 0 ) return;
+
+  MObject sourceObject( sourcePlugArray[ 0 ].node() );
+  if ( !sourceObject.hasFn( MFn::kParticle ) && !sourceObject.hasFn( MFn::kNParticle ) ) return;
+
+  MFnParticleSystem particles( sourceObject );
+  if ( !particles.hasRgb() ) return;
+
+  MVectorArray rgbPP;
+  particles.rgb( rgbPP );
+
+  MPlug idPlug( particles.findPlug( "id", &status ) );
+  if ( status != MS::kSuccess ) return;
+  MObject idObject;
+  idPlug.getValue( idObject );
+  MFnDoubleArrayData idArray( idObject, &status );
+  if ( status != MS::kSuccess ) return;
+
+  unsigned numParticles( min( idArray.length(), rgbPP.length() ) );
+  m_colorIds.resize( numParticles );
+  m_particleColors.resize( numParticles * 3 );
+  for ( unsigned i( 0 ); i < numParticles; i++ ) 
+  {
+    m_colorIds[ i ] = make_pair( static_cast< int >( idArray[ i ] ), i );
+    m_particleColors[ i * 3 ]     = rgbPP[ i ].x;
+    m_particleColors[ i * 3 + 1 ] = rgbPP[ i ].y;
+    m_particleColors[ i * 3 + 2 ] = rgbPP[ i ].z;
+  }
+  sort( m_colorIds.begin(), m_colorIds.end() );
+}
+
+/** Write the instances of the object defined as handle.
+ *
+ *  Particles that died before the end of the shutter keep their last
+ *  known transform.
+ */
+void liqRibInstancer::write( RtObjectHandle handle, bool motion ) const
+{
+  if ( m_samples.empty() ) return;
+
+  const instanceSample &first( m_samples[ 0 ] );
+  unsigned numSamples( motion ? min( ( unsigned )m_samples.size(), ( unsigned )liqglo_motionSamples ) : 1 );
+  if ( numSamples < 2 ) numSamples = 1;
+
+  // index of every particle at the later samples, sorted by id
+  vector< vector< pair< int, unsigned > > > sampleIndex( numSamples );
+  for ( unsigned s( 1 ); s < numSamples; s++ ) 
+  {
+    const vector< int > &ids( m_samples[ s ].ids );
+    sampleIndex[ s ].resize( ids.size() );
+    for ( unsigned i( 0 ); i < ids.size(); i++ ) sampleIndex[ s ][ i ] = make_pair( ids[ i ], i );
+    sort( sampleIndex[ s ].begin(), sampleIndex[ s ].end() );
+  }
+
+  const bool useColors( !m_colors.empty() );
+
+  for ( unsigned i( 0 ); i < first.ids.size(); i++ ) 
+  {
+    const RtFloat *color( useColors ? &m_colors[ i * 3 ] : NULL );
+    if ( color && color[ 0 ] < 0 ) color = NULL;
+
+    // the color is an attribute, the transform alone only needs a transform block
+    if ( color ) 
+    {
+      RiAttributeBegin();
+      RiColor( const_cast< RtFloat* >( color ) );
+    }
+    else 
+      RiTransformBegin();
+
+    if ( numSamples > 1 ) 
+    {
+      RiMotionBeginV( numSamples, ( liqglo_relativeMotion )? liqglo_sampleTimesOffsets : liqglo_sampleTimes );
+
+      const RtFloat *matrix( &first.matrices[ i * 16 ] );
+      RiConcatTransform( *( RtMatrix* )matrix );
+      for ( unsigned s( 1 ); s < numSamples; s++ ) 
+      {
+        vector< pair< int, unsigned > >::const_iterator found( lower_bound( sampleIndex[ s ].begin(), sampleIndex[ s ].end(), make_pair( first.ids[ i ], 0u ) ) );
+        if ( found != sampleIndex[ s ].end() && found->first == first.ids[ i ] ) 
+          matrix = &m_samples[ s ].matrices[ found->second * 16 ];
+        RiConcatTransform( *( RtMatrix* )matrix );
+      }
+      RiMotionEnd();
+    } 
+    else 
+      RiConcatTransform( *( RtMatrix* )&first.matrices[ i * 16 ] );
+
+    RiObjectInstance( handle );
+
+    if ( color ) RiAttributeEnd();
+    else         RiTransformEnd();
+  }
+}
@@ -62,6 +62,7 @@ extern "C" {
 #include <liquid.h>
 #include <liqGlobalHelpers.h>
 #include <liqRibNode.h>
+#include <liqRibParticleData.h>
 
 // Standard/Boost headers
 #include <list>
@@ -1295,6 +1296,44 @@ bool liqRibNode::hasNObjects( unsigned n )
   return true;
 }
 
+/**
+ * Return the object that holds the ObjectBegin handle for the shape of this
+ * node: all the DAG instances of a shape share the one of the first instance
+ * found.
+ */
+liqRibObjPtr liqRibNode::instanceObject()
+{
+  liqRibNode *node( this );
+  while ( node->instance ) node = node->instance.get();
+  return node->object( 0 );
+}
+
+/**
+ * Particle systems only export the particles alive at every motion sample.
+ * The ids read at each sample are intersected here, once the whole motion
+ * sample scan is done, and every sample then builds its parameter lists.
+ */
+void liqRibNode::resolveParticleSamples()
+{
+  vector< liqRibParticleData* > samples;
+  for ( unsigned i( 0 ); i < objects.size(); i++ ) 
+  {
+    if ( !objects[ i ] || objects[ i ]->type != MRT_Particles ) continue;
+    liqRibDataPtr data( objects[ i ]->getDataPtr() );
+    if ( data && data->type() == MRT_Particles ) samples.push_back( ( liqRibParticleData* )data.get() );
+  }
+  if ( samples.empty() ) return;
+
+  vector< int > validIds( samples[ 0 ]->particleIds() );
+  for ( unsigned i( 1 ); i < samples.size(); i++ ) 
+  {
+    vector< int > common;
+    liqRibParticleData::intersectParticleIds( validIds, samples[ i ]->particleIds(), common );
+    validIds.swap( common );
+  }
+  for ( unsigned i( 0 ); i < samples.size(); i++ ) samples[ i ]->resolveParticles( validIds );
+}
+
 void liqRibNode::parseVectorAttributes( const MFnDependencyNode& nodeFn, 
 																				const MStringArray& strArray, const ParameterType& pType ) 
 {
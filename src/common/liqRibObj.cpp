@@ -298,18 +298,39 @@ liqRibObj::liqRibObj( const MDagPath &path, ObjectType objType )
   LIQDEBUGPRINTF( "==> done creating rep %s\n", path.fullPathName().asChar() );
 }
 
+/** Whether objects of this type can be written once inside ObjectBegin.
+ *
+ *  Only plain geometry is legal in an object definition: no trim curves
+ *  (NURBS), no lights, no attributes or RIB boxes (particles, ribgens, pfx).
+ */
+bool liqRibObj::isInstanceable( int type )
+{
+  switch ( type ) 
+  {
+    case MRT_Mesh:
+    case MRT_Subdivision:
+    case MRT_MayaSubdivision:
+    case MRT_NuCurve:
+    case MRT_Curves:
+    case MRT_ImplicitSphere:
+      return true;
+    default:
+      return false;
+  }
+}
+
 /** Return the RenderMan instance handle.
  *
  *  This is used to refer to RIB data that was previously written in the frame prologue.
  */
-inline RtObjectHandle liqRibObj::handle() const
+RtObjectHandle liqRibObj::handle() const
 {
   return objectHandle;
 }
 
 /** Set the RenderMan instance handle.
  */
-inline void liqRibObj::setHandle( RtObjectHandle handle )
+void liqRibObj::setHandle( RtObjectHandle handle )
 {
   objectHandle = handle;
 }
@@ -35,18 +35,7 @@ extern "C" {
 #include <ri.h>
 }
 
-#ifdef _WIN32
-#ifdef MSVC6
-#  include <map>
-#  include <algorithm>
-#else
-#  include <hash_map>
-#  include <algorithm>
-#endif
-#else
-#  include <ext/hash_map>
-using namespace __gnu_cxx;
-#endif
+#include <algorithm>
 
 // Maya's Headers
 #include <maya/MFnVectorArrayData.h>
@@ -65,45 +54,44 @@ using namespace __gnu_cxx;
 #include <liqRibParticleData.h>
 #include <liqGlobalHelpers.h>
 
-#include <boost/shared_ptr.hpp>
 #include <boost/scoped_array.hpp>
 
 using namespace boost;
 
 extern int debugMode;
 
-extern RtFloat liqglo_sampleTimes[5];
+extern RtFloat liqglo_sampleTimes[LIQMAXMOTIONSAMPLES];
 extern liquidlong liqglo_motionSamples;
 extern bool liqglo_doDef;
 extern bool liqglo_doMotion;
 extern structJob liqglo_currentJob;
+extern double liqglo_FPS;
+extern int liqglo_particleChunkSize;
 
 
-// these classes are needed to produce a list of particles sorted by their ids
-class liq_particleInfo
+// Copy Maya arrays into float columns
+static void liqToColumn( const MVectorArray &array, liqVectorColumn &column )
 {
-public:
-  liq_particleInfo( int num, int id )
-    : m_particleNum( num ), m_particleId( id )
-    {
-      // nothing else needed
-    }
-
-  int m_particleNum; // index into the per particle attribute arrays
-  int m_particleId; // global particle id
-};
+  column.resize( array.length() );
+  for ( unsigned i( 0 ); i < array.length(); i++ ) 
+  {
+    column.x[ i ] = array[ i ].x;
+    column.y[ i ] = array[ i ].y;
+    column.z[ i ] = array[ i ].z;
+  }
+}
 
-typedef boost::shared_ptr< liq_particleInfo > liq_particleInfoPtr;
-typedef vector< liq_particleInfoPtr > liq_particleInfoVector ;
+static void liqToColumn( const MDoubleArray &array, vector< float > &column )
+{
+  column.resize( array.length() );
+  for ( unsigned i( 0 ); i < array.length(); i++ ) column[ i ] = array[ i ];
+}
 
-class liq_particleIdSort
+// Pointer to the first element of a column range, NULL if empty
+static inline const float *liqColumnPtr( const vector< float > &column, unsigned first )
 {
-public:
-  bool operator()(liq_particleInfoPtr const & a, liq_particleInfoPtr const & b)
-    {
-      return a.get()->m_particleId < b.get()->m_particleId;
-    }
-};
+  return ( first < column.size() )? &column[ first ] : NULL;
+}
 
 
 
@@ -111,7 +99,7 @@ public:
 /** Create a RIB compatible representation of a Maya particles/
  */
 liqRibParticleData::liqRibParticleData( MObject partobj )
-  : grain( 0 )
+  : grain( 0 ), m_resolved( false ), m_numValidParticles( 0 ), m_chunkSize( ( liqglo_particleChunkSize > 0 )? liqglo_particleChunkSize : 0 )
 {
   LIQDEBUGPRINTF( "-> creating particles\n");
   MStatus status( MS::kSuccess );
@@ -132,117 +120,55 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
   posPlug.getValue( posObject );
 
   MFnVectorArrayData posArray( posObject, &status );
+  liqToColumn( posArray.array(), m_positions );
   status.clear();
 
-  m_numParticles = posArray.length();
+  m_numParticles = m_positions.size();
 
   // we need to sort the particles by id. The position array doesn't keep
   // things in particle id order so things can get pretty screwed up when
-  // we're motion blurring
-  MPlug idPlug;
+  // we're motion blurring.
+  //
+  // If we're motion blurring, we need to deal with only the particles that existed
+  // at every motion sample. You cannot ask a particle when it will die by polling
+  // its lifespan (particles can die in collisions), so the ids are read here, at
+  // the sample time the translator already moved to, and the ids common to all
+  // samples are worked out in resolveParticles() once every sample is scanned.
+  // This avoids evaluating the scene at shutter open/close for each particle system.
+  //
+  MPlug idPlug( fnNode.findPlug( "id", &status ) );
   MObject idObject;
+  idPlug.getValue( idObject );
+  const MFnDoubleArrayData idArray( idObject, &status );
+  status.clear();
 
-  liq_particleInfoVector particlesForSorting;;
+  vector< pair< int, int > > idIndex( idArray.length() );
+  for ( unsigned i( 0 ); i < idArray.length(); i++ ) 
+    idIndex[ i ] = pair< int, int >( ( int )idArray[ i ], i );
+
+  // sort in increasing id order
+  sort( idIndex.begin(), idIndex.end() );
+
+  m_particleIds.resize( idIndex.size() );
+  m_particleOrder.resize( idIndex.size() );
+  for ( unsigned i( 0 ); i < idIndex.size(); i++ ) 
+  {
+    m_particleIds[ i ]   = idIndex[ i ].first;
+    m_particleOrder[ i ] = idIndex[ i ].second;
+  }
 
-  // If we're motion blurring, we need to deal with only the particles that existed
-  // both at the shutterOpen timepoint and at the shutterClose timepoint. This is
-  // actually a bit more complicated than one would think. You cannot ask a particle
-  // when it will die by polling its lifespan. The particle cache contains the
-  // expected lifespan, but does not take into account that particle lifespans can be
-  // overriden (for example, particles can die in collisions). As such, we actually
-  // need to go to the shutterOpen and shutterClose timepoints, find the particles
-  // common to both, and then use the position for those particles.
-  //
   if ( liqglo_doMotion || liqglo_doDef )
   {
     MTime shutterOpen ( (double)liqglo_sampleTimes[0], MTime::uiUnit() );
-    MTime shutterClose ( (double)liqglo_sampleTimes[liqglo_motionSamples - 1], MTime::uiUnit() );
     MTime exportTime = MAnimControl::currentTime();
 
-
-#ifdef _WIN32
-	#ifdef MSVC6
-	  std::map<int, int> soParticles;
-	  std::map<int, int> scParticles;
-	#else
-	  stdext::hash_map<int, int> soParticles;
-	  stdext::hash_map<int, int> scParticles;
-	#endif
-#else
-    hash_map<int, int> soParticles;
-    hash_map<int, int> scParticles;
-#endif
-
     bool isCaching;
     MPlug cachePlug( fnNode.findPlug( "cacheData", &status ) );
     cachePlug.getValue( isCaching );
     status.clear();
     if ( !isCaching && ( exportTime == shutterOpen ) ) 
       liquidMessage( fnNode.particleName() + " has Cache Data switched off! Exported motion blur information will likely be wrong.", messageWarning );
-    
-    // Shutter open
-    //
-    {
-      if ( exportTime != shutterOpen ) MGlobal::viewFrame( shutterOpen );
-      
-      fnNode.setObject(partobj);
-      idPlug = fnNode.findPlug( "id", &status );
-      idPlug.getValue( idObject );
-      const MFnDoubleArrayData idArray( idObject, &status );
-      for ( unsigned i( 0 ); i < idArray.length(); i++ ) soParticles[ ( int )idArray[ i ] ] = 1;
-    }
-    // Shutter close
-    //
-    {
-      MGlobal::viewFrame( shutterClose );
-      fnNode.setObject(partobj);
-      idPlug = fnNode.findPlug( "id", &status );
-      idPlug.getValue( idObject );
-      const MFnDoubleArrayData idArray( idObject, &status );
-      for ( unsigned i( 0 ); i < idArray.length(); i++ ) scParticles[ ( int )idArray[ i ] ] = 1;
-    }
-    // Export time
-    //
-    {
-      if ( exportTime != shutterClose ) MGlobal::viewFrame( exportTime );
-      
-      fnNode.setObject(partobj);
-      idPlug = fnNode.findPlug( "id", &status );
-      idPlug.getValue( idObject );
-      const MFnDoubleArrayData idArray( idObject, &status );
-      for ( unsigned i( 0 ); i < idArray.length(); i++ ) 
-      {
-        if ( soParticles[ ( int )idArray[ i ] ] == 1 &&
-             scParticles[ ( int )idArray[ i ] ] == 1 ) 
-        {
-          particlesForSorting.push_back( liq_particleInfoPtr( new liq_particleInfo( i, ( int )idArray[ i ] ) ) );
-        }
-      }
-    }
   }
-  else
-  {
-    fnNode.setObject(partobj);
-    idPlug = fnNode.findPlug( "id", &status );
-    idPlug.getValue( idObject );
-    const MFnDoubleArrayData idArray( idObject, &status );
-    for ( unsigned i( 0 ); i < idArray.length(); i++ ) 
-      particlesForSorting.push_back( liq_particleInfoPtr( new liq_particleInfo( i, ( int )idArray[ i ] ) ) );
-  }
-
-  status.clear();
-
-  // sort in increasing id order
-  sort( particlesForSorting.begin(),
-        particlesForSorting.end(),
-        liq_particleIdSort());
-
-  // lastly.. we get all of the particle numbers into our m_validParticles
-  // array for use later (we don't need the ids any more)
-  for ( unsigned i( 0 ); i < particlesForSorting.size(); ++i ) 
-    m_validParticles.append( particlesForSorting[ i ]->m_particleNum );
-
-  m_numValidParticles = m_validParticles.length();
 
   // Check for a multi-count parameter (set if using multi-point
   // or multi-streak particles). Default to 1, otherwise.
@@ -257,16 +183,20 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
   {
     m_multiCount = 1;
   }
+  // Streak particles have a head and a tail, so double the vertex count.
+  //
+  if ( particleType == MPTStreak || particleType == MPTMultiStreak ) m_multiCount *= 2;
+  if ( m_multiCount < 1 ) m_multiCount = 1;
 
   // Check for a multi-count radius parameter (again, only for
   // multi-point or multi-streak particles).
   //
-  float multiRadius = 0;
+  m_multiRadius = 0;
   MPlug multiRadiusPlug( fnNode.findPlug( "multiRadius", &status ) );
   if ( MS::kSuccess == status  &&
      (particleType == MPTMultiPoint || particleType == MPTMultiStreak ) )
   {
-    multiRadiusPlug.getValue( multiRadius );
+    multiRadiusPlug.getValue( m_multiRadius );
   }
 
   // Get the velocity information (used for streak, multi-streak).
@@ -275,34 +205,35 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
   MObject velObject;
   velPlug.getValue( velObject );
   MFnVectorArrayData velArray( velObject, &status );
+  liqToColumn( velArray.array(), m_velocities );
 
   // Check for the tail size parameter (only for streak, multi-streak).
   //
-  float tailSize = 0;
+  m_tailSize = 0;
   MPlug tailSizePlug( fnNode.findPlug( "tailSize", &status ) );
   if ( MS::kSuccess == status  &&
      (particleType == MPTStreak || particleType == MPTMultiStreak ) )
   {
-    tailSizePlug.getValue( tailSize );
+    tailSizePlug.getValue( m_tailSize );
   }
 
   // Check for the tail fade parameter (only for streak, multi-streak).
   //
-  float tailFade = 1;
+  m_tailFade = 1;
   MPlug tailFadePlug( fnNode.findPlug( "tailFade", &status ) );
   if ( MS::kSuccess == status  &&
      (particleType == MPTStreak || particleType == MPTMultiStreak ) )
   {
-    tailFadePlug.getValue( tailFade );
+    tailFadePlug.getValue( m_tailFade );
   }
 
   // then we get the particle radius data
   LIQDEBUGPRINTF( "-> Reading Particle Radius\n");
 
-  MDoubleArray radiusArray;
+  m_radius.present     = true;
+  m_radius.perParticle = false;
+  m_radius.value       = 1.0;
   MPlug radiusPPPlug( fnNode.findPlug( "radiusPP", &status ) );
-  bool haveRadiusArray = false;
-  float radius = 1.0;
 
   // check if there's a per-particle radius attribute
   if ( MS::kSuccess == status ) 
@@ -311,141 +242,327 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
 
     radiusPPPlug.getValue( radiusPPObject );
     MFnDoubleArrayData radiusArrayData( radiusPPObject, &status );
-    radiusArray = radiusArrayData.array();
-    haveRadiusArray = true;
+    liqToColumn( radiusArrayData.array(), m_radius.values );
+    m_radius.perParticle = true;
   } 
   else 
   {
     // no per-particle radius. Try for a global radius
     MPlug radiusPlug( fnNode.findPlug( "radius", &status ) );
 
-    if ( MS::kSuccess == status ) radiusPlug.getValue( radius );
+    if ( MS::kSuccess == status ) radiusPlug.getValue( m_radius.value );
     else 
     {
       // no radius attribute.. try pointSize
       MPlug pointSizePlug = fnNode.findPlug( "pointSize", &status );
 
-      if ( MS::kSuccess == status ) pointSizePlug.getValue( radius );
+      if ( MS::kSuccess == status ) pointSizePlug.getValue( m_radius.value );
       else
       {
         // Try lineWidth (used by streak and multi-streak).
         //
         MPlug lineWidthPlug = fnNode.findPlug( "lineWidth", &status );
-        if ( MS::kSuccess == status ) lineWidthPlug.getValue( radius );
+        if ( MS::kSuccess == status ) lineWidthPlug.getValue( m_radius.value );
         
       }
     }
   }
   status.clear();
 
-  MVectorArray rotationArray;
   MPlug rotationPPPlug( fnNode.findPlug( "rotationPP", &status ) );
-  bool haveRotationArray = false;
-  // check if there's a per-particle radius attribute
+  // check if there's a per-particle rotation attribute
   if ( MS::kSuccess == status ) 
 	{
     MObject rotationPPObject;
     rotationPPPlug.getValue( rotationPPObject );
     MFnVectorArrayData rotationArrayData( rotationPPObject, &status );
-    rotationArray = rotationArrayData.array();
-    haveRotationArray = true;
+    liqToColumn( rotationArrayData.array(), m_rotations );
   }
   status.clear();
 
   // then we get the particle color info
   LIQDEBUGPRINTF( "-> Reading Particle Color\n");
 
-  MVectorArray rgbArray;
   MPlug rgbPPPlug( fnNode.findPlug( "rgbPP", &status ) );
-  bool haveRgbArray( false );
-
   if ( MS::kSuccess == status ) 
   {
     MObject rgbPPObject;
 
     rgbPPPlug.getValue( rgbPPObject );
     MFnVectorArrayData rgbArrayData( rgbPPObject, &status );
-    rgbArray = rgbArrayData.array();
-    haveRgbArray = true;
+    liqToColumn( rgbArrayData.array(), m_rgb );
   }
   status.clear();
   // Then we get the per-particle opacity info
   //
   LIQDEBUGPRINTF( "-> Reading Particle Opacity\n");
 
-  MDoubleArray opacityArray;
   MPlug opacityPPPlug( fnNode.findPlug( "opacityPP", &status ) );
-  bool haveOpacityArray( false );
-
   if ( MS::kSuccess == status ) 
   {
     MObject opacityPPObject;
     opacityPPPlug.getValue( opacityPPObject );
     MFnDoubleArrayData opacityArrayData( opacityPPObject, &status );
 
-    opacityArray = opacityArrayData.array();
-    haveOpacityArray = true;
+    liqToColumn( opacityArrayData.array(), m_opacities );
   }
-
   status.clear();
-  // and then we do any particle type specific work
-  switch ( particleType ) 
+
+  // Sprite attributes
+  //
+  m_spriteNum.present = m_spriteTwist.present = m_spriteScaleX.present = m_spriteScaleY.present = false;
+  if ( particleType == MPTSprites )
   {
-    case MPTBlobbies: 
+    readChannel( fnNode, "spriteNumPP", "spriteNum", m_spriteNum );
+    readChannel( fnNode, "spriteTwistPP", "spriteTwist", m_spriteTwist );
+    readChannel( fnNode, "spriteScaleXPP", "spriteScaleX", m_spriteScaleX );
+    readChannel( fnNode, "spriteScaleYPP", "spriteScaleY", m_spriteScaleY );
+  }
+
+  m_codeArray.clear();
+  m_floatArray.clear();
+  m_stringArray.clear();
+
+  if ( particleType == MPTCloudy )
+  {
+    LIQDEBUGPRINTF( "-> Reading Cloudy Particles\n");
+
+	  // Assume same DSO call for all blobbies
+	  MPlug blobbyCodePlug = fnNode.findPlug( "liqCloudyCodes", &status );
+		if ( status == MS::kSuccess ) 
+		{
+		  MObject blobbyCodeObject;
+		  blobbyCodePlug.getValue( blobbyCodeObject );
+		  const MFnIntArrayData  blobbyCodeArrayData( blobbyCodeObject, &status );
+		  for ( unsigned i( 0 ); i < blobbyCodeArrayData.length(); i++ ) 
+      	m_codeArray.push_back( blobbyCodeArrayData[ i ] );
+		  
+		  MPlug blobbyFloatsPlug = fnNode.findPlug( "liqCloudyFloats", &status );
+		  MObject blobbyFloatsObject;
+		  blobbyFloatsPlug.getValue( blobbyFloatsObject );
+		  const MFnDoubleArrayData  blobbyFloatsArrayData( blobbyFloatsObject, &status );
+		  for ( unsigned i( 0 ); i < blobbyFloatsArrayData.length(); i++ ) 
+      	m_floatArray.push_back( blobbyFloatsArrayData[ i ] );
+		  
+		  MPlug blobbyStringsPlug = fnNode.findPlug( "liqCloudyStrings", &status );
+		  MObject blobbyStringsObject;
+		  blobbyStringsPlug.getValue( blobbyStringsObject );
+		  const MFnStringArrayData  blobbyStringsArrayData( blobbyStringsObject, &status );
+		  for ( unsigned i( 0 ); i < blobbyStringsArrayData.length(); i++ ) 
+      	m_stringArray.push_back( blobbyStringsArrayData[ i ].asChar() );
+	  } 
+		else 
+		{
+	    // Default to plain spheres
+	    m_codeArray.push_back( 1005 );
+	    m_codeArray.push_back( 0 );
+			m_floatArray.push_back( 1.0 );
+			m_floatArray.push_back( 0.0 );
+			m_floatArray.push_back( 0.0 );
+			m_floatArray.push_back( 0.0 );
+	  }
+    status.clear();
+  }
+
+  addAdditionalParticleParameters( partobj );
+
+  // Without motion blur there is nothing to intersect with, so the parameter
+  // lists are built right away. Otherwise the translator resolves all the
+  // samples of this particle system once the motion-sample scan is done.
+  if ( !( liqglo_doMotion || liqglo_doDef ) ) resolveParticles( m_particleIds );
+}
+
+/** Read a per particle attribute, falling back on its scalar version.
+ */
+void liqRibParticleData::readChannel( MFnDependencyNode &nodeFn, const char *ppName, const char *name, particleChannel &channel )
+{
+  MStatus status;
+  channel.present     = false;
+  channel.perParticle = false;
+  channel.value       = 0.0;
+
+  MPlug ppPlug( nodeFn.findPlug( ppName, &status ) );
+  if ( MS::kSuccess == status ) 
+  {
+    MObject ppObject;
+    ppPlug.getValue( ppObject );
+    MFnDoubleArrayData ppArray( ppObject, &status );
+    liqToColumn( ppArray.array(), channel.values );
+    channel.present     = true;
+    channel.perParticle = true;
+  } 
+  else 
+  {
+    MPlug plug( nodeFn.findPlug( name, &status ) );
+    if ( MS::kSuccess == status ) 
     {
-      LIQDEBUGPRINTF( "-> Reading Blobby Particles\n");
+      plug.getValue( channel.value );
+      channel.present = true;
+    }
+  }
+}
 
-      // setup the arrays to store the data to pass the correct codes to the
-      // implicit surface command
-      m_codeArray.clear();
-      m_floatArray.clear();
-      m_stringArray.clear();
+/** Intersect two increasing id lists with a single merge pass.
+ */
+void liqRibParticleData::intersectParticleIds( const vector< int > &a, const vector< int > &b, vector< int > &result )
+{
+  result.clear();
+  result.reserve( min( a.size(), b.size() ) );
+  set_intersection( a.begin(), a.end(), b.begin(), b.end(), back_inserter( result ) );
+}
+
+/** Select the particles to export and gather their attributes.
+ *
+ *  validIds must be sorted. Ids this sample doesn't know about are ignored.
+ *  After this the columns only hold the exported particles, in id order.
+ */
+void liqRibParticleData::resolveParticles( const vector< int > &validIds )
+{
+  if ( m_resolved ) return;
 
-      LIQDEBUGPRINTF( "-> Reading Particle Data\n");
+  vector< int > index;
+  m_validIds.clear();
+  index.reserve( min( validIds.size(), m_particleIds.size() ) );
+  m_validIds.reserve( min( validIds.size(), m_particleIds.size() ) );
 
-      RtInt floatOn( 0 );
+  vector< int >::const_iterator v( validIds.begin() );
+  for ( unsigned i( 0 ); i < m_particleIds.size() && v != validIds.end(); i++ ) 
+  {
+    while ( v != validIds.end() && *v < m_particleIds[ i ] ) ++v;
+    if ( v != validIds.end() && *v == m_particleIds[ i ] ) 
+    {
+      index.push_back( m_particleOrder[ i ] );
+      m_validIds.push_back( m_particleIds[ i ] );
+    }
+  }
+  m_numValidParticles = index.size();
+
+  liqGatherColumn( m_positions, index );
+  liqGatherColumn( m_velocities, index );
+  liqGatherColumn( m_rgb, index );
+  liqGatherColumn( m_rotations, index );
+  liqGatherColumn( m_opacities, index );
+  liqGatherColumn( m_radius.values, index );
+  liqGatherColumn( m_spriteNum.values, index );
+  liqGatherColumn( m_spriteTwist.values, index );
+  liqGatherColumn( m_spriteScaleX.values, index );
+  liqGatherColumn( m_spriteScaleY.values, index );
+  for ( unsigned i( 0 ); i < m_additionalAttributes.size(); i++ ) 
+  {
+    liqGatherColumn( m_additionalAttributes[ i ].floats, index );
+    liqGatherColumn( m_additionalAttributes[ i ].vectors, index );
+  }
 
-      for ( unsigned part_num( 0 ); part_num < m_numValidParticles; part_num++ ) 
-      {
+  // Points and streaks build their parameter lists one chunk at a time when
+  // they get written, everything else is built in one go.
+  tokenPointerArray.clear();
+  if ( !isChunked() ) buildParameters( 0, m_numValidParticles );
+  m_resolved = true;
+}
+
+/** Types written as RiPoints/RiCurves calls, which can be split in chunks.
+ */
+bool liqRibParticleData::isChunked() const
+{
+  switch ( particleType ) 
+  {
+    case MPTMultiPoint:
+    case MPTPoints:
+    case MPTMultiStreak:
+    case MPTStreak:
+#ifdef DELIGHT
+    case MPTSpheres:
+    case MPTSprites:
+#endif
+      return true;
+    default:
+      break;
+  }
+  return false;
+}
+
+unsigned liqRibParticleData::numChunks() const
+{
+  if ( !m_chunkSize || m_numValidParticles <= m_chunkSize ) return 1;
+  return ( m_numValidParticles + m_chunkSize - 1 ) / m_chunkSize;
+}
+
+/** Build and write the RiPoints/RiCurves call for one chunk of particles.
+ */
+void liqRibParticleData::writeChunk( unsigned chunk )
+{
+  unsigned first( 0 ), count( m_numValidParticles );
+  if ( m_chunkSize ) 
+  {
+    first = min( chunk * m_chunkSize, m_numValidParticles );
+    count = min( m_chunkSize, m_numValidParticles - first );
+  }
+  buildParameters( first, count );
+
+  unsigned numTokens( tokenPointerArray.size() );
+  scoped_array< RtToken > tokenArray( new RtToken[ numTokens ] );
+  scoped_array< RtPointer > pointerArray( new RtPointer[ numTokens ] );
+  assignTokenArraysV( tokenPointerArray, tokenArray.get(), pointerArray.get() );
+
+  if ( particleType == MPTStreak || particleType == MPTMultiStreak ) 
+  {
+    unsigned nStreaks( count * m_multiCount / 2 );
+    vector< RtInt > verts( nStreaks, 2 );
+
+    RiCurvesV( "linear", nStreaks, &verts[ 0 ], "nonperiodic", numTokens, tokenArray.get(), pointerArray.get() );
+  } 
+  else 
+    RiPointsV( count * m_multiCount, numTokens, tokenArray.get(), pointerArray.get() );
 
-        // add the particle to the list
-        m_codeArray.push_back( 1001 );
-        m_codeArray.push_back( floatOn );
+  // the chunk is written, don't keep its arrays around
+  tokenPointerArray.clear();
+}
 
-        if ( haveRadiusArray )
-          radius = ( float )radiusArray[ m_validParticles[ part_num ] ];
-        // else radius was set to either a scalar attribute or 1.0
-        // above
+/** Fill tokenPointerArray (and the blobby arrays) for the particles
+ *  [first, first + count) from the resolved columns.
+ */
+void liqRibParticleData::buildParameters( unsigned first, unsigned count )
+{
+  tokenPointerArray.clear();
 
-        m_floatArray.push_back( radius * 2.0f );
-        m_floatArray.push_back( 0.0f );
-        m_floatArray.push_back( 0.0f );
-        m_floatArray.push_back( 0.0f );
+  // vertices per particle
+  const unsigned multi( m_multiCount );
+  const unsigned numVerts( count * multi );
 
-        m_floatArray.push_back( 0.0f );
-        m_floatArray.push_back( radius * 2.0f );
-        m_floatArray.push_back( 0.0 );
-        m_floatArray.push_back( 0.0 );
+  const float *px( liqColumnPtr( m_positions.x, first ) );
+  const float *py( liqColumnPtr( m_positions.y, first ) );
+  const float *pz( liqColumnPtr( m_positions.z, first ) );
+  const float *radius( m_radius.perParticle ? liqColumnPtr( m_radius.values, first ) : NULL );
+  const int *ids( ( first < m_validIds.size() )? &m_validIds[ first ] : NULL );
 
-        m_floatArray.push_back( 0.0f );
-        m_floatArray.push_back( 0.0f );
-        m_floatArray.push_back( radius * 2.0f );
-        m_floatArray.push_back( 0.0f );
+  if ( !count ) px = py = pz = radius = NULL;
 
-        m_floatArray.push_back( posArray[ m_validParticles[ part_num ] ].x );
-        m_floatArray.push_back( posArray[ m_validParticles[ part_num ] ].y );
-        m_floatArray.push_back( posArray[ m_validParticles[ part_num ] ].z );
-        m_floatArray.push_back( 1.0f );
+  // and then we do any particle type specific work
+  switch ( particleType ) 
+  {
+    case MPTBlobbies: 
+    {
+      LIQDEBUGPRINTF( "-> Reading Blobby Particles\n");
 
-        floatOn += 16;
-      }
+      // Blobbies only blend within one RiBlobby, so they are never chunked:
+      // setup the arrays to store the data to pass the correct codes to the
+      // implicit surface command
+      m_codeArray.resize( count ? count * 3 + 2 : 0 );
+      m_floatArray.resize( count * 16 );
+      m_stringArray.clear();
 
-      if ( m_numValidParticles > 0 ) 
+      if ( count ) 
       {
-        m_codeArray.push_back( 0 );
-        m_codeArray.push_back( m_numValidParticles );
+        for ( unsigned part_num( 0 ); part_num < count; part_num++ ) 
+        {
+          m_codeArray[ part_num * 2 ]     = 1001;
+          m_codeArray[ part_num * 2 + 1 ] = part_num * 16;
+          m_codeArray[ count * 2 + 2 + part_num ] = part_num;
+        }
+        m_codeArray[ count * 2 ]     = 0;
+        m_codeArray[ count * 2 + 1 ] = count;
 
-        for ( unsigned k( 0 ); k < m_numValidParticles; k++ ) m_codeArray.push_back( k );
+        liqBlobbyEllipsoids( px, py, pz, radius, m_radius.value, count, &m_floatArray[ 0 ] );
       }
       LIQDEBUGPRINTF( "-> Setting up implicit data\n");
       m_stringArray.push_back( "" );
@@ -468,23 +585,19 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
       liqTokenPointer Pparameter;
       liqTokenPointer radiusParameter;
 
-      Pparameter.set( "P", rPoint, true, false, m_numValidParticles );
+      shared_array< RtFloat > P( new RtFloat[ count * 3 ] );
+      if ( count ) liqInterleave3( px, py, pz, count, P.get() );
+      Pparameter.set( "P", rPoint, count );
       Pparameter.setDetailType( rVertex );
+      Pparameter.setTokenFloats( P );
 
-      radiusParameter.set( "radius", rFloat, true, false, m_numValidParticles );
+      shared_array< RtFloat > radii( new RtFloat[ count ] );
+      if ( radius ) liqExpandColumn( radius, count, 1, 1.0f, radii.get() );
+      else          fill( radii.get(), radii.get() + count, m_radius.value );
+      radiusParameter.set( "radius", rFloat, count );
       radiusParameter.setDetailType( rVertex );
+      radiusParameter.setTokenFloats( radii );
 
-      for ( unsigned part_num( 0 ); part_num < m_numValidParticles; part_num++ ) 
-      {
-        Pparameter.setTokenFloat( part_num,
-                                  posArray[m_validParticles[part_num]].x,
-                                  posArray[m_validParticles[part_num]].y,
-                                  posArray[m_validParticles[part_num]].z );
-        if ( haveRadiusArray ) 
-          radiusParameter.setTokenFloat( part_num, radiusArray[ m_validParticles[ part_num ] ] );
-        else
-          radiusParameter.setTokenFloat(part_num, radius);
-      }
       tokenPointerArray.push_back( Pparameter );
       tokenPointerArray.push_back( radiusParameter );
       break;
@@ -496,66 +609,28 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
     case MPTPoints:
     {
       liqTokenPointer Pparameter;
-      Pparameter.set( "P", rPoint, true, false, m_numValidParticles*m_multiCount );
-      Pparameter.setDetailType( rVertex );
-
-      for ( unsigned part_num( 0 ); part_num < m_numValidParticles; part_num++ ) 
-      {
-        // Seed the random number generator using the particle ID
-        // (this ensures that the multi-points won't jump during animations,
-        //  and won't jump when other particles die)
-        //
-        srand( particlesForSorting[ part_num ]->m_particleId );
-        for ( unsigned multiNum( 0 ); multiNum < m_multiCount; multiNum++ )
-        {
-          float xDir( 0 ), yDir( 0 ), zDir( 0 ), vLen( 0 ), rad( 0 );
-
-          // Only do the random placement if we're dealing with
-          // multi-point or multi-streak particles.
-          //
-          if ( m_multiCount > 1 ) 
-          {
-            do 
-            {
-              xDir = rand() / ( float )RAND_MAX - 0.5f;
-              yDir = rand() / ( float )RAND_MAX - 0.5f;
-              zDir = rand() / ( float )RAND_MAX - 0.5f;
-              vLen = sqrt( pow( xDir, 2 ) + pow( yDir, 2 ) + pow( zDir, 2 ) );
-            } while ( vLen == 0.0 );
-
-            xDir /= vLen;
-            yDir /= vLen;
-            zDir /= vLen;
-            rad = rand() / ( float )RAND_MAX * multiRadius / 2.0f;
-          }
 
-          Pparameter.setTokenFloat( part_num * m_multiCount + multiNum,
-                                    RtFloat(posArray[ m_validParticles[ part_num ] ].x + rad * xDir),
-                                    RtFloat(posArray[ m_validParticles[ part_num ] ].y + rad * yDir),
-                                    RtFloat(posArray[ m_validParticles[ part_num ] ].z + rad * zDir) );
-        }
-      }
+      // multi-points are jittered around the particle, seeded by the
+      // particle id so they won't jump during animations
+      shared_array< RtFloat > P( new RtFloat[ numVerts * 3 ] );
+      if ( count ) liqJitterPoints( px, py, pz, ids, count, multi, m_multiRadius, P.get() );
+      Pparameter.set( "P", rPoint, numVerts );
+      Pparameter.setDetailType( rVertex );
+      Pparameter.setTokenFloats( P );
 
       tokenPointerArray.push_back( Pparameter );
 
-
       // TODO: have we got to do some unit conversion here? what units
       // are the radii in?  What unit is Maya in?
-      if ( haveRadiusArray ) 
+      if ( m_radius.perParticle ) 
       {
         liqTokenPointer widthParameter;
 
-        widthParameter.set( "width",
-                            rFloat,
-                            true,
-                            false,
-                            m_numValidParticles*m_multiCount );
-
+        shared_array< RtFloat > width( new RtFloat[ numVerts ] );
+        if ( count ) liqExpandColumn( radius, count, multi, 2.0f, width.get() );
+        widthParameter.set( "width", rFloat, numVerts );
         widthParameter.setDetailType( rVertex );
-
-        for ( unsigned part_num( 0 ); part_num < m_numValidParticles*m_multiCount; part_num++ ) 
-          widthParameter.setTokenFloat( part_num, 
-																				radiusArray[ m_validParticles[ part_num / m_multiCount ] ] * 2 );
+        widthParameter.setTokenFloats( width );
 
         tokenPointerArray.push_back( widthParameter );
       } 
@@ -568,7 +643,7 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
                                     false,
                                     0);
         constantwidthParameter.setDetailType( rConstant );
-        constantwidthParameter.setTokenFloat( 0, radius * 2 );
+        constantwidthParameter.setTokenFloat( 0, m_radius.value * 2 );
 
         tokenPointerArray.push_back( constantwidthParameter );
       }
@@ -578,85 +653,35 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
     case MPTMultiStreak:
     case MPTStreak:
     {
-      // Streak particles have a head and a tail, so double the vertex count.
-      //
-      m_multiCount *= 2;
-
       liqTokenPointer Pparameter;
-      Pparameter.set( "P", rPoint, true, false, m_numValidParticles*m_multiCount );
 
+      // tail/head pairs, multi-streaks jittered like multi-points
+      shared_array< RtFloat > P( new RtFloat[ numVerts * 3 ] );
+      if ( count ) 
+        liqStreakPoints( px, py, pz,
+                         &m_velocities.x[ first ], &m_velocities.y[ first ], &m_velocities.z[ first ],
+                         ids, count, multi / 2, m_multiRadius, m_tailSize / liqglo_FPS, P.get() );
+      Pparameter.set( "P", rPoint, numVerts );
       Pparameter.setDetailType( rVertex );
+      Pparameter.setTokenFloats( P );
 
-      for ( unsigned part_num( 0 ); part_num < m_numValidParticles; part_num++ ) 
-      {
-        // Seed the random number generator using the particle ID
-        // (this ensures that the multi-points won't jump during animations,
-        //  and won't jump when other particles die)
-        //
-        srand( particlesForSorting[ part_num ]->m_particleId );
-        for ( unsigned multiNum( 0 ); multiNum < m_multiCount; multiNum += 2 ) 
-        {
-          float xDir( 0 ), yDir( 0 ), zDir( 0 ), vLen=( 0 ), rad( 0 );
-
-          // Only do the random placement if we're dealing with
-          // multi-point or multi-streak particles.
-          //
-          if ( m_multiCount > 1 ) 
-          {
-            do 
-            {
-              xDir = rand() / (float)RAND_MAX - 0.5;
-              yDir = rand() / (float)RAND_MAX - 0.5;
-              zDir = rand() / (float)RAND_MAX - 0.5;
-              vLen = sqrt( pow( xDir, 2 ) + pow( yDir, 2 ) + pow( zDir, 2 ) );
-            } while ( vLen == 0.0 );
-
-            xDir /= vLen;
-            yDir /= vLen;
-            zDir /= vLen;
-            rad = rand() / (float) RAND_MAX * multiRadius / 2.0;
-          }
-          extern double liqglo_FPS;
-          // Tail (the formula below is a bit of a guess as to how Maya places the tail).
-          //
-          Pparameter.setTokenFloat( part_num*m_multiCount + multiNum,
-                        posArray[ m_validParticles[ part_num ] ].x + rad * xDir -
-                        velArray[ m_validParticles[ part_num ] ].x * tailSize / liqglo_FPS,
-                        posArray[ m_validParticles[ part_num ] ].y + rad * yDir -
-                        velArray[ m_validParticles[ part_num ] ].y * tailSize / liqglo_FPS,
-                        posArray[ m_validParticles[ part_num ] ].z + rad * zDir -
-                        velArray[ m_validParticles[ part_num ] ].z * tailSize / liqglo_FPS );
-
-          // Head
-          //
-          Pparameter.setTokenFloat( part_num * m_multiCount + multiNum + 1,
-                        posArray[ m_validParticles[ part_num ] ].x + rad * xDir,
-                        posArray[ m_validParticles[ part_num ] ].y + rad * yDir,
-                        posArray[ m_validParticles[ part_num ] ].z + rad * zDir );
-        }
-      }
       tokenPointerArray.push_back( Pparameter );
 
       // TODO: have we got to do some unit conversion here? what units
       // are the radii in?  What unit is Maya in?
-      if (haveRadiusArray) 
+      if ( m_radius.perParticle ) 
       {
         liqTokenPointer widthParameter;
 
-        widthParameter.set( "width",
-                            rFloat,
-                            true,
-                            false,
-                            m_numValidParticles * m_multiCount );
+        shared_array< RtFloat > width( new RtFloat[ numVerts ] );
+        if ( count ) liqExpandColumn( radius, count, multi, 2.0f, width.get() );
+        widthParameter.set( "width", rFloat, numVerts );
 
         // Since we're specifying the width at both ends of the streak, we must
         // use "varying" instead of "vertex" to describe streak particle width.
         //
         widthParameter.setDetailType( rVarying );
-
-        for ( unsigned part_num( 0 ); part_num < m_numValidParticles * m_multiCount; part_num++ ) 
-          widthParameter.setTokenFloat( part_num, 
-																				radiusArray[m_validParticles[part_num/m_multiCount]]*2);
+        widthParameter.setTokenFloats( width );
 
         tokenPointerArray.push_back( widthParameter );
       } 
@@ -670,7 +695,7 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
                                     false,
                                     0);
         constantwidthParameter.setDetailType( rConstant );
-        constantwidthParameter.setTokenFloat( 0, radius * 2 );
+        constantwidthParameter.setTokenFloat( 0, m_radius.value * 2 );
 
         tokenPointerArray.push_back( constantwidthParameter );
       }
@@ -692,153 +717,56 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
       liqTokenPointer spriteWidthParameter;
       liqTokenPointer spriteAspectParameter;
 
-      Pparameter.set( "P", rPoint, m_numValidParticles );
+      shared_array< RtFloat > P( new RtFloat[ count * 3 ] );
+      if ( count ) liqInterleave3( px, py, pz, count, P.get() );
+      Pparameter.set( "P", rPoint, count );
       Pparameter.setDetailType( rVertex );
+      Pparameter.setTokenFloats( P );
 
-      spriteNumParameter.set( "spriteNum", rFloat, m_numValidParticles );
-
-      spriteTwistParameter.set( "patchrotation", rFloat,  m_numValidParticles );
-
-      spriteWidthParameter.set( "width", rFloat, m_numValidParticles );
-
-      spriteAspectParameter.set( "patchaspectratio", rFloat, m_numValidParticles );
-
-      bool haveSpriteNums( false );
-      bool haveSpriteNumsArray( false );
-      MObject spriteNumObject;
-      MFnDoubleArrayData spriteNumArray;
-      float spriteNum;
-      MPlug spriteNumPlug( fnNode.findPlug( "spriteNumPP", &status ) );
-      if ( MS::kSuccess == status ) {
-        haveSpriteNumsArray = true;
-        spriteNumPlug.getValue( spriteNumObject );
-        spriteNumArray.setObject( spriteNumObject );
-        spriteNumParameter.setDetailType( rVarying );
-      } else {
-        spriteNumPlug = fnNode.findPlug( "spriteNum", &status );
-        if ( MS::kSuccess == status ) {
-          haveSpriteNums = true;
-          spriteNumPlug.getValue( spriteNum );
-          spriteNumParameter.setDetailType( rUniform );
-        }
-      }
+      spriteNumParameter.set( "spriteNum", rFloat, count );
+      spriteNumParameter.setDetailType( m_spriteNum.perParticle ? rVarying : rUniform );
 
-      bool haveSpriteTwist( false );
-      bool haveSpriteTwistArray( false );
-      MObject spriteTwistObject;
-      MFnDoubleArrayData spriteTwistArray;
-      float spriteTwist;
-      MPlug spriteTwistPlug( fnNode.findPlug( "spriteTwistPP", &status ) );
-      if ( MS::kSuccess == status ) {
-        haveSpriteTwistArray = true;
-        spriteTwistPlug.getValue( spriteTwistObject );
-        spriteTwistArray.setObject( spriteTwistObject );
-        spriteTwistParameter.setDetailType( rVarying );
-      } else {
-        spriteTwistPlug = fnNode.findPlug( "spriteTwist", &status );
-        if ( MS::kSuccess == status ) {
-          haveSpriteTwist = true;
-          spriteTwistPlug.getValue( spriteTwist );
-          spriteTwistParameter.setDetailType( rUniform );
-        }
-      }
+      spriteTwistParameter.set( "patchrotation", rFloat,  count );
+      spriteTwistParameter.setDetailType( m_spriteTwist.perParticle ? rVarying : rUniform );
 
-      bool haveSpriteScaleX( false );
-      bool haveSpriteScaleXArray( false );
-      MObject spriteScaleXObject;
-      MFnDoubleArrayData spriteScaleXArray;
-      float spriteScaleX;
-      MPlug spriteScaleXPlug( fnNode.findPlug( "spriteScaleXPP", &status ) );
-      if ( MS::kSuccess == status ) {
-        haveSpriteScaleXArray = true;
-        spriteScaleXPlug.getValue( spriteScaleXObject );
-        spriteScaleXArray.setObject( spriteScaleXObject );
-        spriteWidthParameter.setDetailType( rVarying );
-      } else {
-        spriteScaleXPlug = fnNode.findPlug( "spriteScaleX", &status );
-        if ( MS::kSuccess == status ) {
-          haveSpriteScaleX = true;
-          spriteScaleXPlug.getValue( spriteScaleX );
-          spriteWidthParameter.setDetailType( rUniform );
-        }
-      }
+      spriteWidthParameter.set( "width", rFloat, count );
+      spriteWidthParameter.setDetailType( m_spriteScaleX.perParticle ? rVarying : rUniform );
 
-      bool haveSpriteScaleY( false );
-      bool haveSpriteScaleYArray( false );
-      MObject spriteScaleYObject;
-      MFnDoubleArrayData spriteScaleYArray;
-      float spriteScaleY;
-      MPlug spriteScaleYPlug( fnNode.findPlug( "spriteScaleYPP", &status ) );
-      if ( MS::kSuccess == status ) {
-        haveSpriteScaleYArray = true;
-        spriteScaleYPlug.getValue( spriteScaleYObject );
-        spriteScaleYArray.setObject( spriteScaleYObject );
-        spriteAspectParameter.setDetailType( rVarying );
-      } else {
-        spriteScaleYPlug = fnNode.findPlug( "spriteScaleY", &status );
-        if ( MS::kSuccess == status ) {
-          haveSpriteScaleY = true;
-          spriteScaleYPlug.getValue( spriteScaleY );
-          spriteAspectParameter.setDetailType( rUniform );
-        }
-      }
+      spriteAspectParameter.set( "patchaspectratio", rFloat, count );
+      spriteAspectParameter.setDetailType( m_spriteScaleY.perParticle ? rVarying : rUniform );
 
-      for ( unsigned part_num( 0 ); part_num < m_numValidParticles; part_num++ ) {
+      for ( unsigned part_num( 0 ); part_num < count; part_num++ ) {
+        unsigned index( first + part_num );
 
-        Pparameter.setTokenFloat( part_num,
-                                  posArray[m_validParticles[part_num]].x,
-                                  posArray[m_validParticles[part_num]].y,
-                                  posArray[m_validParticles[part_num]].z );
-        if ( haveSpriteNumsArray ) {
-          spriteNumParameter.setTokenFloat( part_num, spriteNumArray[m_validParticles[part_num]] );
-        } else if ( haveSpriteNums ) {
-          spriteNumParameter.setTokenFloat( part_num, spriteNum );
-        }
+        if ( m_spriteNum.present )
+          spriteNumParameter.setTokenFloat( part_num, m_spriteNum.perParticle ? m_spriteNum.values[ index ] : m_spriteNum.value );
 
-        if ( haveSpriteTwistArray ) {
-          spriteTwistParameter.setTokenFloat( part_num, -spriteTwistArray[m_validParticles[part_num]] );
-        }
-        else if ( haveSpriteTwist ) {
-          spriteTwistParameter.setTokenFloat( part_num, -spriteTwist);
-        }
+        if ( m_spriteTwist.present )
+          spriteTwistParameter.setTokenFloat( part_num, -( m_spriteTwist.perParticle ? m_spriteTwist.values[ index ] : m_spriteTwist.value ) );
 
-        if ( haveSpriteScaleXArray ) {
-          spriteWidthParameter.setTokenFloat( part_num, spriteScaleXArray[m_validParticles[part_num]] );
-        }
-        else if ( haveSpriteScaleX ) {
-          spriteWidthParameter.setTokenFloat( part_num, spriteScaleX);
+        float scaleX( 1. );
+        if ( m_spriteScaleX.present ) {
+          scaleX = m_spriteScaleX.perParticle ? m_spriteScaleX.values[ index ] : m_spriteScaleX.value;
+          spriteWidthParameter.setTokenFloat( part_num, scaleX );
         }
 
-        if ( haveSpriteScaleYArray ) {
-          if ( haveSpriteScaleXArray ) {
-            spriteAspectParameter.setTokenFloat( part_num, spriteScaleXArray[m_validParticles[part_num]] / spriteScaleYArray[m_validParticles[part_num]] );
-          } else if ( haveSpriteScaleX ) {
-            spriteAspectParameter.setTokenFloat( part_num, spriteScaleX / spriteScaleYArray[m_validParticles[part_num]] );
-          } else {
-            spriteAspectParameter.setTokenFloat( part_num, 1. / spriteScaleYArray[m_validParticles[part_num]] );
-          }
-        } else if ( haveSpriteScaleY ) {
-          if ( haveSpriteScaleXArray ) {
-            spriteAspectParameter.setTokenFloat( part_num, spriteScaleXArray[m_validParticles[part_num]] / spriteScaleY );
-          } else if ( haveSpriteScaleX ) {
-            spriteAspectParameter.setTokenFloat( part_num, spriteScaleX / spriteScaleY );
-          } else {
-            spriteAspectParameter.setTokenFloat( part_num, 1. / spriteScaleY );
-          }
+        if ( m_spriteScaleY.present ) {
+          float scaleY( m_spriteScaleY.perParticle ? m_spriteScaleY.values[ index ] : m_spriteScaleY.value );
+          spriteAspectParameter.setTokenFloat( part_num, scaleX / scaleY );
         }
       }
 
       tokenPointerArray.push_back( Pparameter );
-      if ( haveSpriteNumsArray || haveSpriteNums ) {
+      if ( m_spriteNum.present ) {
         tokenPointerArray.push_back( spriteNumParameter );
       }
-      if ( haveSpriteTwistArray || haveSpriteTwist ) {
+      if ( m_spriteTwist.present ) {
         tokenPointerArray.push_back( spriteTwistParameter );
       }
-      if ( haveSpriteScaleXArray || haveSpriteScaleX ) {
+      if ( m_spriteScaleX.present ) {
         tokenPointerArray.push_back( spriteWidthParameter );
       }
-      if ( haveSpriteScaleYArray || haveSpriteScaleY ) {
+      if ( m_spriteScaleY.present ) {
         tokenPointerArray.push_back( spriteAspectParameter );
       }
 
@@ -850,167 +778,51 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
       liqTokenPointer spriteScaleXParameter;
       liqTokenPointer spriteScaleYParameter;
 
-      Pparameter.set( "P", rPoint, true, false, m_numValidParticles );
+      shared_array< RtFloat > P( new RtFloat[ count * 3 ] );
+      if ( count ) liqInterleave3( px, py, pz, count, P.get() );
+      Pparameter.set( "P", rPoint, count );
       Pparameter.setDetailType( rVertex );
+      Pparameter.setTokenFloats( P );
 
-      spriteNumParameter.set( "spriteNum", rFloat, true, false, m_numValidParticles );
+      spriteNumParameter.set( "spriteNum", rFloat, count );
       spriteNumParameter.setDetailType( rUniform );
 
-      spriteTwistParameter.set( "spriteTwist", rFloat, true, false, m_numValidParticles );
+      spriteTwistParameter.set( "spriteTwist", rFloat, count );
       spriteTwistParameter.setDetailType( rUniform );
 
-      spriteScaleXParameter.set( "spriteScaleX", rFloat, true, false, m_numValidParticles );
+      spriteScaleXParameter.set( "spriteScaleX", rFloat, count );
       spriteScaleXParameter.setDetailType( rUniform );
 
-      spriteScaleYParameter.set( "spriteScaleY", rFloat, true, false, m_numValidParticles );
+      spriteScaleYParameter.set( "spriteScaleY", rFloat, count );
       spriteScaleYParameter.setDetailType( rUniform );
 
-      bool haveSpriteNums( false );
-      bool haveSpriteNumsArray( false );
-      MObject spriteNumObject;
-      MFnDoubleArrayData spriteNumArray;
-      float spriteNum;
-      MPlug spriteNumPlug( fnNode.findPlug( "spriteNumPP", &status ) );
-      if ( MS::kSuccess == status ) 
-      {
-        haveSpriteNumsArray = true;
-        spriteNumPlug.getValue( spriteNumObject );
-        spriteNumArray.setObject( spriteNumObject );
-        cout << "DBG> spriteNumPP found length = " << spriteNumArray.length() << endl;
-      } 
-      else 
-      {
-        spriteNumPlug = fnNode.findPlug( "spriteNum", &status );
-        if ( MS::kSuccess == status ) 
-        {
-          haveSpriteNums = true;
-          spriteNumPlug.getValue( spriteNum );
-          cout << "DBG> spriteNum found spriteNum = " << spriteNum << endl;
-        }
-      }
-
-      bool haveSpriteTwist( false );
-      bool haveSpriteTwistArray( false );
-      MObject spriteTwistObject;
-      MFnDoubleArrayData spriteTwistArray;
-      float spriteTwist;
-      MPlug spriteTwistPlug( fnNode.findPlug( "spriteTwistPP", &status ) );
-      if ( MS::kSuccess == status ) 
-      {
-        haveSpriteTwistArray = true;
-        spriteTwistPlug.getValue( spriteTwistObject );
-        spriteTwistArray.setObject( spriteTwistObject );
-      } 
-      else 
-      {
-        spriteTwistPlug = fnNode.findPlug( "spriteTwist", &status );
-        if ( MS::kSuccess == status ) 
-        {
-          haveSpriteTwist = true;
-          spriteTwistPlug.getValue( spriteTwist );
-        }
-      }
-
-      bool haveSpriteScaleX( false );
-      bool haveSpriteScaleXArray( false );
-      MObject spriteScaleXObject;
-      MFnDoubleArrayData spriteScaleXArray;
-      float spriteScaleX;
-      MPlug spriteScaleXPlug( fnNode.findPlug( "spriteScaleXPP", &status ) );
-      if ( MS::kSuccess == status ) 
-      {
-        haveSpriteScaleXArray = true;
-        spriteScaleXPlug.getValue( spriteScaleXObject );
-        spriteScaleXArray.setObject( spriteScaleXObject );
-      } 
-      else 
-      {
-        spriteScaleXPlug = fnNode.findPlug( "spriteScaleX", &status );
-        if ( MS::kSuccess == status ) 
-        {
-          haveSpriteScaleX = true;
-          spriteScaleXPlug.getValue( spriteScaleX );
-        }
-      }
-
-      bool haveSpriteScaleY( false );
-      bool haveSpriteScaleYArray( false );
-      MObject spriteScaleYObject;
-      MFnDoubleArrayData spriteScaleYArray;
-      float spriteScaleY;
-      MPlug spriteScaleYPlug( fnNode.findPlug( "spriteScaleYPP", &status ) );
-      if ( MS::kSuccess == status ) 
-      {
-        haveSpriteScaleYArray = true;
-        spriteScaleYPlug.getValue( spriteScaleYObject );
-        spriteScaleYArray.setObject( spriteScaleYObject );
-      } 
-      else 
-      {
-        spriteScaleYPlug = fnNode.findPlug( "spriteScaleY", &status );
-        if ( MS::kSuccess == status ) 
-        {
-          haveSpriteScaleY = true;
-          spriteScaleYPlug.getValue( spriteScaleY );
-        }
-      }
-
-      for ( unsigned part_num( 0 ); part_num < m_numValidParticles; part_num++ ) 
+      for ( unsigned part_num( 0 ); part_num < count; part_num++ ) 
       {
-        Pparameter.setTokenFloat( part_num,
-                                  posArray[m_validParticles[part_num]].x,
-                                  posArray[m_validParticles[part_num]].y,
-                                  posArray[m_validParticles[part_num]].z );
-        if ( haveSpriteNumsArray )
-        {   
-          float spriteNumPP = spriteNumArray[ m_validParticles[ part_num ] ];
-          spriteNumParameter.setTokenFloat( part_num, spriteNumPP );
-          cout << "DBG> part_num = " << part_num << " spriteNumArray[ m_validParticles[ part_num ] ] = " << spriteNumArray[ m_validParticles[ part_num ] ] << endl;
-          
-        }
-        else if ( haveSpriteNums ) 
-        {  
-          spriteNumParameter.setTokenFloat( part_num, spriteNum );
-        }
-        if ( haveSpriteTwistArray ) 
-        {  
-          spriteTwistParameter.setTokenFloat( part_num, spriteTwistArray[m_validParticles[part_num]] );
-        }
-        else if ( haveSpriteTwist ) 
-        {  
-          spriteTwistParameter.setTokenFloat( part_num, spriteTwist);
-        }
-        if ( haveSpriteScaleXArray ) 
-        {  
-          spriteScaleXParameter.setTokenFloat(part_num, spriteScaleXArray[m_validParticles[part_num]] );
-        }
-        else if ( haveSpriteScaleX )
-        {   
-          spriteScaleXParameter.setTokenFloat( part_num, spriteScaleX);
-        }
-        if ( haveSpriteScaleYArray ) 
-        {  
-          spriteScaleYParameter.setTokenFloat( part_num, spriteScaleYArray[m_validParticles[part_num]] );
-        }  
-        else if ( haveSpriteScaleY ) 
-        {  
-          spriteScaleYParameter.setTokenFloat( part_num, spriteScaleY);
-        }  
+        unsigned index( first + part_num );
+
+        if ( m_spriteNum.present )
+          spriteNumParameter.setTokenFloat( part_num, m_spriteNum.perParticle ? m_spriteNum.values[ index ] : m_spriteNum.value );
+        if ( m_spriteTwist.present )
+          spriteTwistParameter.setTokenFloat( part_num, m_spriteTwist.perParticle ? m_spriteTwist.values[ index ] : m_spriteTwist.value );
+        if ( m_spriteScaleX.present )
+          spriteScaleXParameter.setTokenFloat( part_num, m_spriteScaleX.perParticle ? m_spriteScaleX.values[ index ] : m_spriteScaleX.value );
+        if ( m_spriteScaleY.present )
+          spriteScaleYParameter.setTokenFloat( part_num, m_spriteScaleY.perParticle ? m_spriteScaleY.values[ index ] : m_spriteScaleY.value );
       }
       tokenPointerArray.push_back( Pparameter );
-      if ( haveSpriteNumsArray || haveSpriteNums )
+      if ( m_spriteNum.present )
       {   
         tokenPointerArray.push_back( spriteNumParameter );
       }
-      if ( haveSpriteTwistArray || haveSpriteTwist )
+      if ( m_spriteTwist.present )
       {   
         tokenPointerArray.push_back( spriteTwistParameter );
       }
-      if ( haveSpriteScaleXArray || haveSpriteScaleX ) 
+      if ( m_spriteScaleX.present ) 
       {  
         tokenPointerArray.push_back( spriteScaleXParameter );
       }
-      if ( haveSpriteScaleYArray || haveSpriteScaleY ) 
+      if ( m_spriteScaleY.present ) 
       {  
         tokenPointerArray.push_back( spriteScaleYParameter );
       }  
@@ -1021,76 +833,23 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
 		
 		case MPTCloudy:
 		{
-      LIQDEBUGPRINTF( "-> Reading Cloudy Particles\n");
-
-      // setup the arrays to store the data to pass the correct codes to the
-      // implicit surface command
-      m_codeArray.clear();
-      m_floatArray.clear();
-      m_stringArray.clear();
-
-      LIQDEBUGPRINTF( "-> Reading Particle Data\n");
-
-	  	// Assume same DSO call for all blobbies
-	 		MPlug blobbyCodePlug = fnNode.findPlug( "liqCloudyCodes", &status );
-			if ( status == MS::kSuccess ) 
-			{
-		  	MObject blobbyCodeObject;
-		  	blobbyCodePlug.getValue( blobbyCodeObject );
-		  	const MFnIntArrayData  blobbyCodeArrayData( blobbyCodeObject, &status );
-		  	for ( unsigned i( 0 ); i < blobbyCodeArrayData.length(); i++ ) 
-      		m_codeArray.push_back( blobbyCodeArrayData[ i ] );
-		  
-		  	MPlug blobbyFloatsPlug = fnNode.findPlug( "liqCloudyFloats", &status );
-		  	MObject blobbyFloatsObject;
-		  	blobbyFloatsPlug.getValue( blobbyFloatsObject );
-		  	const MFnDoubleArrayData  blobbyFloatsArrayData( blobbyFloatsObject, &status );
-		  	for ( unsigned i( 0 ); i < blobbyFloatsArrayData.length(); i++ ) 
-      		m_floatArray.push_back( blobbyFloatsArrayData[ i ] );
-		  
-		  	MPlug blobbyStringsPlug = fnNode.findPlug( "liqCloudyStrings", &status );
-		  	MObject blobbyStringsObject;
-		  	blobbyStringsPlug.getValue( blobbyStringsObject );
-		  	const MFnStringArrayData  blobbyStringsArrayData( blobbyStringsObject, &status );
-		  	for ( unsigned i( 0 ); i < blobbyStringsArrayData.length(); i++ ) 
-      		m_stringArray.push_back( blobbyStringsArrayData[ i ].asChar() );
-		  
-	  	} 
-			else 
-		{
-	  	// Default to plain spheres
-	  	m_codeArray.push_back( 1005 );
-	  	m_codeArray.push_back( 0 );
-			m_floatArray.push_back( 1.0 );
-			m_floatArray.push_back( 0.0 );
-			m_floatArray.push_back( 0.0 );
-			m_floatArray.push_back( 0.0 );
-	  }
-
+      // the blobby codes were read with the other attributes
       liqTokenPointer Pparameter;
       liqTokenPointer radiusParameter;
 
-      Pparameter.set( "P", rPoint, true, false, m_numValidParticles );
+      shared_array< RtFloat > P( new RtFloat[ count * 3 ] );
+      if ( count ) liqInterleave3( px, py, pz, count, P.get() );
+      Pparameter.set( "P", rPoint, count );
       Pparameter.setDetailType( rVertex );
-    
-      radiusParameter.set( "radius", rFloat, true, false, m_numValidParticles );
+      Pparameter.setTokenFloats( P );
+
+      shared_array< RtFloat > radii( new RtFloat[ count ] );
+      if ( radius ) liqExpandColumn( radius, count, 1, 1.0f, radii.get() );
+      else          fill( radii.get(), radii.get() + count, m_radius.value );
+      radiusParameter.set( "radius", rFloat, count );
       radiusParameter.setDetailType( rVertex );
+      radiusParameter.setTokenFloats( radii );
 
-      for ( unsigned part_num( 0 ); part_num < m_numValidParticles; part_num++ ) 
-			{
-		
-        Pparameter.setTokenFloat( part_num,
-                                  posArray[m_validParticles[part_num]].x,
-                                  posArray[m_validParticles[part_num]].y,
-                                  posArray[m_validParticles[part_num]].z );
-        if ( haveRadiusArray ) 
-          radiusParameter.setTokenFloat( part_num,
-                                         radiusArray[m_validParticles[part_num]] );
-        
-        else 
-          radiusParameter.setTokenFloat(part_num, radius);
-        
-      }
       tokenPointerArray.push_back( Pparameter );
       tokenPointerArray.push_back( radiusParameter );
 		}
@@ -1103,115 +862,119 @@ liqRibParticleData::liqRibParticleData( MObject partobj )
       break;
   } // switch ( particleType )
 
+  // blobbies carry everything in their codes
+  if ( particleType == MPTBlobbies || !count ) return;
+
   // and we add the Cs Parameter (if needed) after we've done everything
-  // else
-  if ( haveRgbArray ) 
+  // else. For most of our parameters, we only have values for each particle,
+  // so they get repeated for all the vertices in its multi block.
+  if ( !m_rgb.empty() ) 
   {
     liqTokenPointer CsParameter;
 
-    CsParameter.set( "Cs", rColor, m_numValidParticles * m_multiCount );
+    shared_array< RtFloat > Cs( new RtFloat[ numVerts * 3 ] );
+    liqExpandInterleave3( &m_rgb.x[ first ], &m_rgb.y[ first ], &m_rgb.z[ first ], count, multi, Cs.get() );
+    CsParameter.set( "Cs", rColor, numVerts );
     CsParameter.setDetailType( rVertex );
+    CsParameter.setTokenFloats( Cs );
 
-    for ( unsigned part_num( 0 ); part_num < m_numValidParticles * m_multiCount; part_num++ ) 
-    {
-      // For most of our parameters, we only have values for each "chunk"
-      // (where a "chunk" is all the particles in a multi block)
-      //
-      unsigned part_chunk( part_num / m_multiCount );
-
-      CsParameter.setTokenFloat( part_num,
-                                 rgbArray[ m_validParticles[ part_chunk ] ].x,
-                                 rgbArray[ m_validParticles[ part_chunk ] ].y,
-                                 rgbArray[ m_validParticles[ part_chunk ] ].z );
-    }
     tokenPointerArray.push_back( CsParameter );
   }
   // Handle per particle rotation if any
-  if ( haveRotationArray ) 
+  if ( !m_rotations.empty() ) 
 	{
     liqTokenPointer rotationParameter;
-    rotationParameter.set( "rotation", rColor, m_numValidParticles * m_multiCount );
+
+    shared_array< RtFloat > rotation( new RtFloat[ numVerts * 3 ] );
+    liqExpandInterleave3( &m_rotations.x[ first ], &m_rotations.y[ first ], &m_rotations.z[ first ], count, multi, rotation.get() );
+    rotationParameter.set( "rotation", rColor, numVerts );
     rotationParameter.setDetailType( rVertex );
-    for ( unsigned part_num( 0 ); part_num < m_numValidParticles * m_multiCount; part_num++ ) 
-		{
-      // For most of our parameters, we only have values for each "chunk"
-      // (where a "chunk" is all the particles in a multi block)
-      //
-      unsigned part_chunk( part_num / m_multiCount );
-      rotationParameter.setTokenFloat( part_num,
-                                 rotationArray[ m_validParticles[ part_chunk ] ].x,
-                                 rotationArray[ m_validParticles[ part_chunk ] ].y,
-                                 rotationArray[ m_validParticles[ part_chunk ] ].z );
-    }
+    rotationParameter.setTokenFloats( rotation );
+
     tokenPointerArray.push_back( rotationParameter );
   }
   // And we add the Os Parameter (if needed).
   //
-  if( haveOpacityArray ) 
+  if ( !m_opacities.empty() ) 
   {
     liqTokenPointer OsParameter;
 
-    OsParameter.set( "Os", rColor, m_numValidParticles * m_multiCount );
-    OsParameter.setDetailType( rVarying );
+    shared_array< RtFloat > Os( new RtFloat[ numVerts * 3 ] );
+    const float *opacity( &m_opacities[ first ] );
+    liqExpandInterleave3( opacity, opacity, opacity, count, multi, Os.get() );
 
-    for ( unsigned part_num( 0 ); part_num < m_numValidParticles * m_multiCount; part_num++ ) 
-    {
-      // For most of our parameters, we only have values for each "chunk"
-      // (where a "chunk" is all the particles in a multi block)
-      //
-      unsigned part_chunk( part_num / m_multiCount );
-
-      // Fade out the even particles (the tails) if streaks.
-      //
-      if ( ( particleType == MPTStreak || particleType == MPTMultiStreak ) &&
-           ( ( part_num & 0x01 ) == 0) )
-      {
-        OsParameter.setTokenFloat( part_num,
-                                   opacityArray[ m_validParticles[ part_chunk ] ] * tailFade,
-                                   opacityArray[ m_validParticles[ part_chunk ] ] * tailFade,
-                                   opacityArray[ m_validParticles[ part_chunk ] ] * tailFade);
-      } 
-      else 
+    // Fade out the even particles (the tails) if streaks.
+    //
+    if ( particleType == MPTStreak || particleType == MPTMultiStreak ) 
+      for ( unsigned part_num( 0 ); part_num < numVerts; part_num += 2 ) 
       {
-        OsParameter.setTokenFloat( part_num,
-                                   opacityArray[ m_validParticles[ part_chunk ] ],
-                                   opacityArray[ m_validParticles[ part_chunk ] ],
-                                   opacityArray[ m_validParticles[ part_chunk ] ]);
+        Os[ part_num * 3 ]     *= m_tailFade;
+        Os[ part_num * 3 + 1 ] *= m_tailFade;
+        Os[ part_num * 3 + 2 ] *= m_tailFade;
       }
-    }
+    OsParameter.set( "Os", rColor, numVerts );
+    OsParameter.setDetailType( rVarying );
+    OsParameter.setTokenFloats( Os );
+
     tokenPointerArray.push_back( OsParameter );
   }
 
   liqTokenPointer idParameter;
 
-  idParameter.set( "id", rFloat, m_numValidParticles * m_multiCount );
+  shared_array< RtFloat > id( new RtFloat[ numVerts ] );
+  for ( unsigned part_num( 0 ); part_num < numVerts; part_num++ ) 
+    id[ part_num ] = ids[ part_num / multi ];
+  idParameter.set( "id", rFloat, numVerts );
   idParameter.setDetailType( rVertex );
+  idParameter.setTokenFloats( id );
 
-  for ( unsigned part_num( 0 ); part_num < m_numValidParticles * m_multiCount; part_num++ ) 
+  tokenPointerArray.push_back( idParameter );
+
+  if ( !m_velocities.empty() ) 
   {
-    // For most of our parameters, we only have values for each "chunk"
-    // (where a "chunk" is all the particles in a multi block)
-    //
-    unsigned part_chunk( part_num / m_multiCount );
-    idParameter.setTokenFloat( part_num, particlesForSorting[ part_chunk ]->m_particleId );
+    liqTokenPointer velocityParameter;
+
+    shared_array< RtFloat > velocity( new RtFloat[ numVerts * 3 ] );
+    liqExpandInterleave3( &m_velocities.x[ first ], &m_velocities.y[ first ], &m_velocities.z[ first ], count, multi, velocity.get() );
+    velocityParameter.set( "velocity", rVector, numVerts );
+    velocityParameter.setDetailType( rVertex );
+    velocityParameter.setTokenFloats( velocity );
+
+    tokenPointerArray.push_back( velocityParameter );
   }
-  tokenPointerArray.push_back( idParameter );
-  liqTokenPointer velocityParameter;
-  velocityParameter.set( "velocity", rVector, m_numValidParticles * m_multiCount );
-  velocityParameter.setDetailType( rVertex );
-  for ( unsigned part_num( 0 ); part_num < m_numValidParticles * m_multiCount; part_num++ ) 
-	{
-    // For most of our parameters, we only have values for each "chunk"
-    // (where a "chunk" is all the particles in a multi block)
-    //
-    unsigned part_chunk( part_num / m_multiCount );
-    velocityParameter.setTokenFloat( part_num, 
-								velArray[ m_validParticles[ part_chunk ] ].x,
-								velArray[ m_validParticles[ part_chunk ] ].y,
-								velArray[ m_validParticles[ part_chunk ] ].z );
+
+  // user rman* attributes
+  for ( unsigned i( 0 ); i < m_additionalAttributes.size(); i++ ) 
+  {
+    const particleAttribute &attr( m_additionalAttributes[ i ] );
+    liqTokenPointer parameter;
+
+    if ( attr.perParticle ) 
+    {
+      shared_array< RtFloat > values;
+      if ( attr.type == rFloat ) 
+      {
+        values.reset( new RtFloat[ numVerts ] );
+        liqExpandColumn( &attr.floats[ first ], count, multi, 1.0f, values.get() );
+      }
+      else 
+      {
+        values.reset( new RtFloat[ numVerts * 3 ] );
+        liqExpandInterleave3( &attr.vectors.x[ first ], &attr.vectors.y[ first ], &attr.vectors.z[ first ], count, multi, values.get() );
+      }
+      parameter.set( attr.name, attr.type, numVerts );
+      parameter.setDetailType( rVertex );
+      parameter.setTokenFloats( values );
+    } 
+    else 
+    {
+      parameter.set( attr.name, attr.type );
+      parameter.setDetailType( rConstant );
+      if ( attr.type == rFloat ) parameter.setTokenFloat( 0, attr.value[ 0 ] );
+      else                       parameter.setTokenFloat( 0, attr.value[ 0 ], attr.value[ 1 ], attr.value[ 2 ] );
+    }
+    tokenPointerArray.push_back( parameter );
   }
-  tokenPointerArray.push_back( velocityParameter );
-  addAdditionalParticleParameters( partobj );
 }
 
 /** Write the RIB for this surface.
@@ -1220,11 +983,20 @@ void liqRibParticleData::write()
 {
   LIQDEBUGPRINTF( "-> writing particles\n");
 
+  if ( !m_resolved ) resolveParticles( m_particleIds );
+
 #ifdef DEBUG
   RiArchiveRecord( RI_COMMENT, "Number of Particles: %d", m_numValidParticles );
   RiArchiveRecord( RI_COMMENT, "Number of Discarded Particles: %d", m_numParticles - m_numValidParticles );
 #endif
 
+  // points and streaks go out in chunks of at most m_chunkSize particles
+  if ( isChunked() ) 
+  {
+    for ( unsigned chunk( 0 ); chunk < numChunks(); chunk++ ) writeChunk( chunk );
+    return;
+  }
+
   unsigned numTokens( tokenPointerArray.size() );
   scoped_array< RtToken > tokenArray( new RtToken[ numTokens ] );
   scoped_array< RtPointer > pointerArray( new RtPointer[ numTokens ] );
@@ -1250,31 +1022,6 @@ void liqRibParticleData::write()
       }
       break;
 
-    case MPTMultiPoint:
-    case MPTPoints:
-
-#ifdef DELIGHT
-    case MPTSpheres:
-    case MPTSprites:
-#endif
-      {
-        RiPointsV( m_numValidParticles * m_multiCount, numTokens, tokenArray.get(), pointerArray.get() );
-      }
-      break;
-
-    case MPTMultiStreak:
-    case MPTStreak: 
-      {
-        unsigned nStreaks( m_numValidParticles * m_multiCount / 2 );
-        vector< RtInt > verts( nStreaks, 2 );
-        // Alternatively:
-        //   scoped_array< RtInt >verts( new RtInt[ nStreaks ] );
-        //   fill( verts.get(), verts.get() + nStreaks, ( RtInt )2 );
-        // Both ways are way faster than the frickin for() lop that was here before -- Moritz
-
-        RiCurvesV( "linear", nStreaks, &verts[ 0 ], "nonperiodic", numTokens, tokenArray.get(), pointerArray.get() );
-      }
-      break;
 #ifndef DELIGHT
     case MPTSpheres: 
       {
@@ -1490,6 +1237,10 @@ void liqRibParticleData::write()
     case MPTTube:
       // do nothing. These are not supported
       break;
+
+    default:
+      // points and streaks were written above
+      break;
   }
 }
 
@@ -1498,6 +1249,8 @@ unsigned liqRibParticleData::granularity() const
   switch ( particleType ) 
   {
     case MPTBlobbies:
+      return 1;
+
     case MPTMultiPoint:
     case MPTPoints:
 #ifdef DELIGHT
@@ -1506,7 +1259,7 @@ unsigned liqRibParticleData::granularity() const
 #endif
     case MPTMultiStreak:
     case MPTStreak:
-      return 1;
+      return numChunks();
 
 #ifndef DELIGHT
     case MPTSpheres:
@@ -1529,11 +1282,22 @@ bool liqRibParticleData::writeNextGrain()
 {
   LIQDEBUGPRINTF( "-> writing particles\n");
 
+  if ( !m_resolved ) resolveParticles( m_particleIds );
+
 #ifdef DEBUG
   RiArchiveRecord( RI_COMMENT, "Number of Particles: %d", m_numValidParticles );
   RiArchiveRecord( RI_COMMENT, "Number of Discarded Particles: %d", m_numParticles - m_numValidParticles );
 #endif
 
+  // one grain per chunk
+  if ( isChunked() ) 
+  {
+    writeChunk( grain );
+    if ( ++grain < numChunks() ) return true;
+    grain = 0;
+    return false;
+  }
+
   unsigned numTokens( tokenPointerArray.size() );
   scoped_array< RtToken > tokenArray( new RtToken[ numTokens ] );
   scoped_array< RtPointer > pointerArray( new RtPointer[ numTokens ] );
@@ -1556,31 +1320,6 @@ bool liqRibParticleData::writeNextGrain()
                    tokenArray.get(),
                    const_cast< RtPointer* >( pointerArray.get() ) );
 
-        grain = 0;
-        return false;
-      }
-    case MPTMultiPoint:
-    case MPTPoints:
-#ifdef DELIGHT
-    case MPTSpheres:
-    case MPTSprites:
-#endif
-    {
-      RiPointsV( m_numValidParticles*m_multiCount, numTokens, tokenArray.get(), pointerArray.get() );
-      grain = 0;
-      return false;
-    }
-    case MPTMultiStreak:
-    case MPTStreak: 
-      {
-        unsigned nStreaks( m_numValidParticles * m_multiCount / 2 );
-        vector< RtInt > verts( nStreaks, 2 );
-        // Alternatively:
-        //   fill( verts.get(), verts.get() + nStreaks, ( RtInt )2 );
-        //   scoped_array< RtInt >verts( new RtInt[ nStreaks ] );
-
-        RiCurvesV( "linear", nStreaks, &verts[ 0 ], "nonperiodic", numTokens, tokenArray.get(), pointerArray.get() );
-
         grain = 0;
         return false;
       }
@@ -1734,6 +1473,10 @@ bool liqRibParticleData::writeNextGrain()
     case MPTTube:
       // do nothing. These are not supported
       break;
+
+    default:
+      // points and streaks were written above
+      break;
   }
   return false;
 }
@@ -1761,7 +1504,6 @@ ObjectType liqRibParticleData::type() const
   LIQDEBUGPRINTF( "-> returning particle type\n");
   return MRT_Particles;
 }
-
 /** This replaces the standard method for attaching custom attributes to a
  *  particle set to be passed into the RIB stream for access in a RMan
  *  shader.
@@ -1786,7 +1528,7 @@ void liqRibParticleData::addAdditionalFloatParameters( MFnDependencyNode &nodeFn
 
   for ( int i = 0; i < foundAttributes.length(); i++ ) 
   {
-    liqTokenPointer floatParameter;
+    particleAttribute floatParameter;
     MString  currAttribute = foundAttributes[i];
     MString  cutString = currAttribute.substring(5, currAttribute.length());
 
@@ -1795,30 +1537,23 @@ void liqRibParticleData::addAdditionalFloatParameters( MFnDependencyNode &nodeFn
 
     status = fPlug.getValue( plugObj );
 
+    floatParameter.name = cutString.asChar();
+    floatParameter.type = rFloat;
+
     if ( plugObj.apiType() == MFn::kDoubleArrayData ) 
     {
       MFnDoubleArrayData attributeData( plugObj );
 
-      floatParameter.set( cutString.asChar(), rFloat, m_numValidParticles );
-      floatParameter.setDetailType(rVertex);
-
-      for ( unsigned part_num( 0 ); part_num < m_numValidParticles; part_num++ ) 
-        floatParameter.setTokenFloat( part_num, 
-																			attributeData[ m_validParticles[ part_num ] ] );
-      
+      floatParameter.perParticle = true;
+      liqToColumn( attributeData.array(), floatParameter.floats );
     } 
     else 
     {
-      float floatValue;
-
-      fPlug.getValue( floatValue );
-
-      floatParameter.set( cutString.asChar(), rFloat );
-      floatParameter.setDetailType( rConstant );
-      floatParameter.setTokenFloat( 0, floatValue );
+      floatParameter.perParticle = false;
+      fPlug.getValue( floatParameter.value[ 0 ] );
     }
 
-    tokenPointerArray.push_back( floatParameter );
+    m_additionalAttributes.push_back( floatParameter );
   }
 }
 
@@ -1829,7 +1564,7 @@ void liqRibParticleData::addAdditionalVectorParameters( MFnDependencyNode &nodeF
 
   for ( unsigned i( 0 ); i < foundAttributes.length(); i++ ) 
   {
-    liqTokenPointer vectorParameter;
+    particleAttribute vectorParameter;
     MString  currAttribute = foundAttributes[i];
     MString  cutString = currAttribute.substring(5, currAttribute.length());
 
@@ -1838,35 +1573,26 @@ void liqRibParticleData::addAdditionalVectorParameters( MFnDependencyNode &nodeF
 
     status = vPlug.getValue( plugObj );
 
+    vectorParameter.name = cutString.asChar();
+    vectorParameter.type = type;
+
     if ( plugObj.apiType() == MFn::kVectorArrayData ) 
     {
       MFnVectorArrayData  attributeData( plugObj );
 
-      vectorParameter.set( cutString.asChar(), type, m_numValidParticles );
-      vectorParameter.setDetailType( rVertex );
+      vectorParameter.perParticle = true;
+      liqToColumn( attributeData.array(), vectorParameter.vectors );
 
-      for ( unsigned part_num( 0 ); part_num < m_numValidParticles; part_num++ ) 
-      {
-        vectorParameter.setTokenFloat( part_num,
-                         attributeData[m_validParticles[part_num]].x,
-                         attributeData[m_validParticles[part_num]].y,
-                         attributeData[m_validParticles[part_num]].z );
-      }
-
-      tokenPointerArray.push_back( vectorParameter );
+      m_additionalAttributes.push_back( vectorParameter );
     } 
     else if ( plugObj.apiType() == MFn::kData3Double ) 
     {
-      float x, y, z;
-      vPlug.child(0).getValue( x );
-      vPlug.child(1).getValue( y );
-      vPlug.child(2).getValue( z );
-
-      vectorParameter.set( cutString.asChar(), type );
-      vectorParameter.setTokenFloat( 0, x, y, z );
-      vectorParameter.setDetailType( rConstant );
+      vectorParameter.perParticle = false;
+      vPlug.child(0).getValue( vectorParameter.value[ 0 ] );
+      vPlug.child(1).getValue( vectorParameter.value[ 1 ] );
+      vPlug.child(2).getValue( vectorParameter.value[ 2 ] );
 
-      tokenPointerArray.push_back( vectorParameter );
+      m_additionalAttributes.push_back( vectorParameter );
     }
     // else ignore this attribute
   }
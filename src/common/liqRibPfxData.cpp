@@ -55,6 +55,7 @@ extern "C" {
 #include <liqRibData.h>
 #include <liqRibPfxData.h>
 #include <liqRibNode.h>
+#include <liqRibCurveBatch.h>
 
 // Standard/Boost headers
 #include <cassert>
@@ -68,13 +69,12 @@ extern "C" {
 #define MAX_DETAIL 3
 
 extern int debugMode;
+extern bool liqglo_pfxDelayedArchives;
 
 /** Create a RIB compatible representation of a Maya Paint Effectrs object.
  */
 liqRibPfxData::liqRibPfxData( MObject pfxGeo, ObjectType type )
-  : grain( 0 ),
-    nverts(),
-    CVs()
+  : grain( 0 )
 {
 	LIQDEBUGPRINTF( "-> creating painteffects curves\n" );
 	MStatus status( MS::kSuccess );
@@ -150,27 +150,38 @@ liqRibPfxData::liqRibPfxData( MObject pfxGeo, ObjectType type )
 	if ( type == MRT_PfxLeaf ) setOn = 1;
 	if ( type == MRT_PfxPetal ) setOn = 2;
 
-	unsigned totalVertex( 0 );
-	unsigned totalVarying( 0 );
-	unsigned numLines( lines[ setOn ].length() );
+	const unsigned numLines( lines[ setOn ].length() );
+	const unsigned batchSize( liqCurveBatchSize( numLines ) );
 
-	for ( unsigned lineOn( 0 ); lineOn < numLines; lineOn++ )
+	for ( unsigned first( 0 ); first < numLines; first += batchSize )
 	{
-		MRenderLine pfxLine( lines[ setOn ].renderLine( lineOn, &status ) );
-		MVectorArray pfxVerts( pfxLine.getLine() );
-		totalVarying += pfxVerts.length();
-	}
-	totalVertex = totalVarying + ( 2 * numLines );
+		const unsigned last( min( first + batchSize, numLines ) );
 
-	if ( totalVarying )
-	{
-		hasFeature[ setOn ] = true;
+		unsigned totalVertex( 0 );
+		unsigned totalVarying( 0 );
+		unsigned batchLines( 0 );
+
+		for ( unsigned lineOn( first ); lineOn < last; lineOn++ )
+		{
+			MRenderLine pfxLine( lines[ setOn ].renderLine( lineOn, &status ) );
+			if ( MS::kSuccess != status ) continue;
+			MVectorArray pfxVerts( pfxLine.getLine() );
+			totalVarying += pfxVerts.length();
+			batchLines++;
+		}
+		totalVertex = totalVarying + ( 2 * batchLines );
+
+		if ( !totalVarying ) continue;
+
+		batches.push_back( liqCurveBatch() );
+		liqCurveBatch &batch( batches.back() );
+		batch.nverts.reserve( batchLines );
 
 		// read other attributes from the lines
-		CVs = shared_array< RtFloat >(              new RtFloat[ totalVertex * 3 ] );
+		shared_array< RtFloat > CVs(                new RtFloat[ totalVertex * 3 ] );
 		shared_array< RtFloat > curveTwist(         new RtFloat[ totalVarying * 3 ] );
-		shared_array< RtFloat > uniformCurveWidth(  new RtFloat[ numLines ] );
-		shared_array< RtFloat > curveID(						new RtFloat[ numLines ] );
+		shared_array< RtFloat > uniformCurveWidth(  new RtFloat[ batchLines ] );
+		shared_array< RtFloat > curveID(            new RtFloat[ batchLines ] );
 		shared_array< RtFloat > curveWidth(         new RtFloat[ totalVarying ] );
 		shared_array< RtFloat > curveFlatness(      new RtFloat[ totalVarying ] );
 		//shared_array< RtFloat > curveParameter(   new RtFloat[ totalVarying ] );
@@ -199,7 +210,7 @@ liqRibPfxData::liqRibPfxData( MObject pfxGeo, ObjectType type )
 		bool hasIncandescence( false );
 		bool hasOpacity( false );
 
-		for( unsigned lineOn( 0 ); lineOn < lines[ setOn ].length(); lineOn++ )
+		for( unsigned lineOn( first ); lineOn < last; lineOn++ )
 		{
 			MRenderLine pfxLine( lines[ setOn ].renderLine( lineOn, &status ) );
 			if ( MS::kSuccess == status )
@@ -247,7 +258,7 @@ liqRibPfxData::liqRibPfxData( MObject pfxGeo, ObjectType type )
 						hasFlatness = true;
 						*flatnessPtr++ = pfxFlatness[ pOn ];
 					}
-					
+				
 					/*if ( pfxParameter.length() )
 					{
 						hasParameter = true;
@@ -325,21 +336,18 @@ liqRibPfxData::liqRibPfxData( MObject pfxGeo, ObjectType type )
 				*cvPtr++ = tmpVertex.z;
 
 				// record number of vertices for this curve
-				nverts[ setOn ].push_back( pOn + 2 );
+				batch.nverts.push_back( pOn + 2 );
 			}
 		}
 
 		LIQDEBUGPRINTF( "-> number of pfx curve CVs: %u\n", totalVertex );
-		LIQDEBUGPRINTF( "-> number of pfx curves: %u\n", nverts[ setOn ].size() );
-		LIQDEBUGPRINTF( "-> allocating memory for pfx data\n" );
-
-		LIQDEBUGPRINTF( "-> flowerLine data created\n" );
+		LIQDEBUGPRINTF( "-> number of pfx curves: %u\n", batch.nverts.size() );
 
 		liqTokenPointer pointsPointerPair;
 		pointsPointerPair.set( "P", rPoint, totalVertex );
 		pointsPointerPair.setDetailType( rVertex );
 		pointsPointerPair.setTokenFloats( CVs );
-		pfxTokenPointerArrays[ setOn ].push_back( pointsPointerPair );
+		batch.tokens.push_back( pointsPointerPair );
 
 		if ( !camFacing[ setOn ] )
 		{
@@ -347,23 +355,23 @@ liqRibPfxData::liqRibPfxData( MObject pfxGeo, ObjectType type )
 			twistPointerPair.set( "N", rNormal, totalVarying );
 			twistPointerPair.setDetailType( rVarying );
 			twistPointerPair.setTokenFloats( curveTwist );
-			pfxTokenPointerArrays[ setOn ].push_back( twistPointerPair );
+			batch.tokens.push_back( twistPointerPair );
 		}
 		if ( hasCurveID )
 		{
 			liqTokenPointer curveIDPointerPair;
-			curveIDPointerPair.set( "curveID", rFloat, numLines );
+			curveIDPointerPair.set( "curveID", rFloat, batchLines );
 			curveIDPointerPair.setDetailType( rUniform );
 			curveIDPointerPair.setTokenFloats( curveID );
-			pfxTokenPointerArrays[ setOn ].push_back( curveIDPointerPair );
+			batch.tokens.push_back( curveIDPointerPair );
 		}
 		if ( hasUniformWidth )
 		{
 			liqTokenPointer uniformWidthPointerPair;
-			uniformWidthPointerPair.set( "width", rFloat, numLines );
+			uniformWidthPointerPair.set( "width", rFloat, batchLines );
 			uniformWidthPointerPair.setDetailType( rUniform );
 			uniformWidthPointerPair.setTokenFloats( uniformCurveWidth );
-			pfxTokenPointerArrays[ setOn ].push_back( uniformWidthPointerPair );
+			batch.tokens.push_back( uniformWidthPointerPair );
 		}
 		if ( hasWidth )
 		{
@@ -371,7 +379,7 @@ liqRibPfxData::liqRibPfxData( MObject pfxGeo, ObjectType type )
 			widthPointerPair.set( "width", rFloat, totalVarying );
 			widthPointerPair.setDetailType( rVarying );
 			widthPointerPair.setTokenFloats( curveWidth );
-			pfxTokenPointerArrays[ setOn ].push_back( widthPointerPair );
+			batch.tokens.push_back( widthPointerPair );
 		}
 		if ( hasColor )
 		{
@@ -379,7 +387,7 @@ liqRibPfxData::liqRibPfxData( MObject pfxGeo, ObjectType type )
 			colorPointerPair.set( "Cs", rColor, totalVarying );
 			colorPointerPair.setDetailType( rVarying );
 			colorPointerPair.setTokenFloats( curveColor );
-			pfxTokenPointerArrays[ setOn ].push_back( colorPointerPair );
+			batch.tokens.push_back( colorPointerPair );
 		}
 		if ( hasOpacity )
 		{
@@ -387,7 +395,7 @@ liqRibPfxData::liqRibPfxData( MObject pfxGeo, ObjectType type )
 			opacityPointerPair.set( "Os", rColor, totalVarying );
 			opacityPointerPair.setDetailType( rVarying );
 			opacityPointerPair.setTokenFloats( curveOpacity );
-			pfxTokenPointerArrays[ setOn ].push_back( opacityPointerPair );
+			batch.tokens.push_back( opacityPointerPair );
 		}
 
 		if ( hasFlatness )
@@ -396,16 +404,16 @@ liqRibPfxData::liqRibPfxData( MObject pfxGeo, ObjectType type )
 			flatnessPointerPair.set( "pfxflatness", rFloat, totalVarying );
 			flatnessPointerPair.setDetailType( rVarying );
 			flatnessPointerPair.setTokenFloats( curveFlatness );
-			pfxTokenPointerArrays[ setOn ].push_back( flatnessPointerPair );
+			batch.tokens.push_back( flatnessPointerPair );
 		}
-		
+	
 /*		if ( hasParameter )
 		{
 			liqTokenPointer parameterPointerPair;
 			parameterPointerPair.set( "t", rFloat, totalVarying );
 			parameterPointerPair.setDetailType( rVarying );
 			parameterPointerPair.setTokenFloats( curveParameter );
-			pfxTokenPointerArrays[ setOn ].push_back( parameterPointerPair );
+			batch.tokens.push_back( parameterPointerPair );
 		}
 */		
 		if ( hasIncandescence )
@@ -414,20 +422,26 @@ liqRibPfxData::liqRibPfxData( MObject pfxGeo, ObjectType type )
 			incandescencePointerPair.set( "pfxincandescence", rColor, totalVarying );
 			incandescencePointerPair.setDetailType( rVarying );
 			incandescencePointerPair.setTokenFloats( curveIncandescence );
-			pfxTokenPointerArrays[ setOn ].push_back( incandescencePointerPair );
+			batch.tokens.push_back( incandescencePointerPair );
 		}
 
 		liqTokenPointer elementPointerPair;
 		elementPointerPair.set( "pfxelement", rFloat );
 		elementPointerPair.setDetailType( rConstant );
 		elementPointerPair.setTokenFloat( 0, setOn );
-		pfxTokenPointerArrays[ setOn ].push_back( elementPointerPair );
-	}
-	else
-	{
-		hasFeature[ setOn ] = false;
+		batch.tokens.push_back( elementPointerPair );
+
+		if ( batches.size() == 1 ) firstCurve.assign( CVs.get(), CVs.get() + batch.nverts[ 0 ] * 3 );
+
+		// Out to its own archive: only the bound stays in memory
+		if ( liqglo_pfxDelayedArchives )
+		{
+			// tubes, leaves and petals of one node each get their own archives
+			const char* setNames[ 3 ] = { "_tube", "_leaf", "_petal" };
+			liqArchiveCurveBatch( batch, "cubic", liqTokenPointer::array(), pfx.fullPathName() + setNames[ setOn ], batches.size() - 1 );
+		}
 	}
-	
+
 	// free memory for lines arrays, are not freed by pfx destructor - Alf
 	lines[0].deleteArray();
 	lines[1].deleteArray();
@@ -441,48 +455,23 @@ void liqRibPfxData::write()
 {
 	LIQDEBUGPRINTF( "-> writing painteffects curves\n" );
 
-	unsigned setOn( 0 );
-	if ( pfxtype == MRT_PfxLeaf ) setOn = 1;
-	if ( pfxtype == MRT_PfxPetal ) setOn = 2;
-
-	if ( hasFeature[ setOn ] )
-	{
-		unsigned numTokens( pfxTokenPointerArrays[ setOn ].size() );
-		scoped_array< RtToken > tokenArray( new RtToken[ numTokens ] );
-		scoped_array< RtPointer > pointerArray( new RtPointer[ numTokens ] );
-		assignTokenArraysV( pfxTokenPointerArrays[ setOn ], tokenArray.get(), pointerArray.get() );
-
-		RiCurvesV( "cubic", nverts[ setOn ].size(), const_cast< RtInt* >( &nverts[ setOn ][ 0 ] ), 
-							 "nonperiodic", numTokens, tokenArray.get(), pointerArray.get() );
-	}
+	for ( unsigned i( 0 ); i < batches.size(); i++ )
+		liqWriteCurveBatch( batches[ i ], "cubic", liqTokenPointer::array() );
 }
 
 unsigned liqRibPfxData::granularity() const
 {
-	unsigned i( 0 );
-	unsigned setOn( 0 );
-	if ( pfxtype == MRT_PfxLeaf ) setOn = 1;
-	if ( pfxtype == MRT_PfxPetal ) setOn = 2;
-	if ( hasFeature[ setOn ] ) ++i;
-	return i;
+	return batches.size();
 }
 
 bool liqRibPfxData::writeNextGrain()
 {
 	LIQDEBUGPRINTF( "-> writing painteffects curves\n" );
 
-	if ( hasFeature[ grain ] )
-	{
-		unsigned numTokens( pfxTokenPointerArrays[ grain ].size() );
-		scoped_array< RtToken > tokenArray( new RtToken[ numTokens ] );
-		scoped_array< RtPointer > pointerArray( new RtPointer[ numTokens ] );
-		assignTokenArraysV( pfxTokenPointerArrays[ grain ], tokenArray.get(), pointerArray.get() );
+	if ( grain < batches.size() )
+		liqWriteCurveBatch( batches[ grain ], "cubic", liqTokenPointer::array() );
 
-		RiCurvesV( "cubic", nverts[ grain ].size(), const_cast< RtInt* >( &nverts[ grain ][ 0 ] ), 
-							 "nonperiodic", numTokens, tokenArray.get(), pointerArray.get() );
-	}
-
-	if ( 2 < ++grain )
+	if ( batches.size() <= ++grain )
 	{
 		grain = 0;
 		return false;
@@ -491,6 +480,13 @@ bool liqRibPfxData::writeNextGrain()
 		return true;
 }
 
+/** Archived batches are DelayedReadArchives, they can't be motion blurred.
+ */
+bool liqRibPfxData::isNextGrainAnimated() const
+{
+	return !liqglo_pfxDelayedArchives;
+}
+
 /** Compare this curve to the other for the purpose of determining
  *  if it is animated.
  */
@@ -498,21 +494,22 @@ bool liqRibPfxData::compare( const liqRibData & otherObj ) const
 {
 	LIQDEBUGPRINTF( "-> comparing painteffects curves\n");
 
-	if ( MRT_PfxTube != otherObj.type() && MRT_PfxLeaf != otherObj.type() && MRT_PfxPetal != otherObj.type()  )
+	if ( pfxtype != otherObj.type() )
 		return false;
 
 	const liqRibPfxData & other = ( liqRibPfxData& )otherObj;
 
-	unsigned setOn( 0 );
-	if ( pfxtype == MRT_PfxLeaf ) setOn = 1;
-	if ( pfxtype == MRT_PfxPetal ) setOn = 2;
-	if ( ( nverts[setOn][0] != other.nverts[setOn][0] ) ||
-		   ( nverts[setOn].size() != other.nverts[setOn].size() ) )
+	if ( batches.size() != other.batches.size() )
 		return false;
+	for ( unsigned i( 0 ); i < batches.size(); i++ )
+		if ( batches[ i ].nverts != other.batches[ i ].nverts )
+			return false;
 
-	// Check CVs
-	for ( unsigned i( 0 ); i < nverts[0][0] * 3; i++ )
-		if ( !equiv( CVs[i], other.CVs[i] ) )
+	// Check the CVs of the first curve
+	if ( firstCurve.size() != other.firstCurve.size() )
+		return false;
+	for ( unsigned i( 0 ); i < firstCurve.size(); i++ )
+		if ( !equiv( firstCurve[ i ], other.firstCurve[ i ] ) )
 			return false;
 	
 	return true;
@@ -58,17 +58,17 @@ extern "C" {
 #include <boost/scoped_array.hpp>
 
 extern int debugMode;
+extern bool liqglo_pfxDelayedArchives;
 
 
 /** Create a RIB compatible representation of a Maya pfxHair node as RiCurves.
+ *
+ *  The lines are converted a batch at a time (see liqRibCurveBatch), so
+ *  that a groom never needs one allocation for all its curves.
  */
 liqRibPfxHairData::liqRibPfxHairData( MObject pfxHair )
-  : nverts(),
-    CVs(),
-    normals(),
-    curveWidth(),
-    cvColor(),
-    cvOpacity()
+  : ncurves( 0 ),
+    grain( 0 )
 {
   LIQDEBUGPRINTF( "-> creating pfxHair curve\n" );
   MStatus status( MS::kSuccess );
@@ -80,7 +80,6 @@ liqRibPfxHairData::liqRibPfxHairData( MObject pfxHair )
     MRenderLineArray profileArray;
     MRenderLineArray creaseArray;
     MRenderLineArray intersectionArray;
-    MRenderLineArray copy;
 
     bool doLines          = true;
     bool doTwist          = true;
@@ -103,77 +102,54 @@ liqRibPfxHairData::liqRibPfxHairData( MObject pfxHair )
         info += pfxNode.name() + " : " + ncurves + " curves.";
         cout <<  info  <<  endl  <<  flush;
       }
-      unsigned totalNumberOfVertices( 0 ), totalNumberOfSpans( 0 );
-      if ( ncurves > 0 ) 
-			{
-        nverts = shared_array< RtInt >( new RtInt[ ncurves ] );
+
+      // Additional RMan* params, written with every batch
+      if ( ncurves > 0 ) addAdditionalSurfaceParameters( pfxHair );
+
+      const unsigned batchSize( liqCurveBatchSize( ncurves ) );
+
+      for ( unsigned first( 0 ); first < ( unsigned )ncurves; first += batchSize ) 
+      {
+        const unsigned last( min( first + batchSize, ( unsigned )ncurves ) );
+
+        batches.push_back( liqCurveBatch() );
+        liqCurveBatch &batch( batches.back() );
 
         // Calculate storage requirments.
-        // This is a lot more efficient than all those reallocs()
-        // (or resize()s if we used a vector) that were done before
-        // in the main loop below.
-        for ( unsigned i( 0 ); i < ncurves; i++ ) 
+        unsigned totalNumberOfVertices( 0 ), totalNumberOfSpans( 0 );
+        batch.nverts.reserve( last - first );
+        for ( unsigned i( first ); i < last; i++ ) 
 				{
           MRenderLine theLine( profileArray.renderLine( i, &status ) );
           if ( MS::kSuccess == status ) 
 					{
             const MVectorArray& vertex( theLine.getLine() );
+            if ( !vertex.length() ) continue;
+            batch.nverts.push_back( vertex.length() + 2 );
             totalNumberOfVertices += vertex.length() + 2;
+            totalNumberOfSpans    += vertex.length();
           }
         }
-        // Allocate memory
-        CVs = shared_array< RtFloat >( new RtFloat[ totalNumberOfVertices ] );
-        if ( !CVs ) 
-				{
-          MString err( "liqRibPfxHairData failed to allocate CV memory!" );
-          cout << err << endl << flush;
-          throw( err );
-          return;
-        }
-        normals = shared_array< RtFloat >( new RtFloat[ totalNumberOfVertices * 3 ] );
-        if ( !normals ) 
-				{
-          MString err( "liqRibPfxHairData failed to allocate normal memory!" );
-          cout << err << endl << flush;
-          throw( err );
-          return;
-        }
-
-        curveWidth = shared_array< RtFloat >( new RtFloat[ totalNumberOfSpans ] );
-        if ( !curveWidth ) 
-				{
-          MString err( "liqRibPfxHairData failed to allocate per vertex width memory!" );
-          cout << err << endl << flush;
-          throw( err );
-          return;
-        }
-
-        cvColor = shared_array< RtFloat >( new RtFloat[ totalNumberOfVertices * 3 ] );
-        if ( !cvColor ) 
-				{
-          MString err( "liqRibPfxHairData failed to allocate CV color memory!" );
-          cout << err << endl << flush;
-          throw( err );
-          return;
-        }
-
-        cvOpacity = shared_array< RtFloat >( new RtFloat[ totalNumberOfVertices * 3 ] );
-        if ( !cvOpacity ) 
-				{
-          MString err( "liqRibPfxHairData failed to allocate CV opacity memory !" );
-          cout << err << endl << flush;
-          throw( err );
-          return;
+        if ( !totalNumberOfVertices ) 
+        {
+          batches.pop_back();
+          continue;
         }
 
-        RtFloat* cvPtr;
-        RtFloat* normalPtr;
-        RtFloat* widthPtr;
-        RtFloat* colorPtr;
-        RtFloat* opacityPtr;
-
-        totalNumberOfVertices = 0;
-        for ( unsigned i( 0 ); i < ncurves; i++ ) 
+        // Allocate memory
+        shared_array< RtFloat > CVs(        new RtFloat[ totalNumberOfVertices * 3 ] );
+        shared_array< RtFloat > normals(    new RtFloat[ totalNumberOfSpans * 3 ] );
+        shared_array< RtFloat > curveWidth( new RtFloat[ totalNumberOfSpans ] );
+        shared_array< RtFloat > cvColor(    new RtFloat[ totalNumberOfVertices * 3 ] );
+        shared_array< RtFloat > cvOpacity(  new RtFloat[ totalNumberOfVertices * 3 ] );
+
+        RtFloat* cvPtr( CVs.get() );
+        RtFloat* normalPtr( normals.get() );
+        RtFloat* widthPtr( curveWidth.get() );
+        RtFloat* colorPtr( cvColor.get() );
+        RtFloat* opacityPtr( cvOpacity.get() );
+
+        for ( unsigned i( first ); i < last; i++ ) 
         {
           MRenderLine theLine( profileArray.renderLine( i, &status ) );
 
@@ -185,18 +161,9 @@ liqRibPfxHairData::liqRibPfxHairData( MObject pfxHair )
             const MVectorArray& vertexColor(        theLine.getColor() );
             const MVectorArray& vertexTransparency( theLine.getTransparency() );
 
-            nverts[ i ] = vertex.length() + 2;
-            totalNumberOfVertices += nverts[ i ];
-            totalNumberOfSpans += vertex.length();
+            if ( !vertex.length() ) continue;
             unsigned int vertIndex = 0;
 
-
-            cvPtr      = CVs.get()        + ( totalNumberOfVertices * 3 - nverts[ i ] * 3 );
-            normalPtr  = normals.get()    + ( totalNumberOfVertices * 3 - nverts[ i ] * 3 );
-            widthPtr   = curveWidth.get() + ( totalNumberOfSpans - vertex.length() );
-            colorPtr   = cvColor.get()    + ( totalNumberOfVertices * 3 - nverts[ i ] * 3 );
-            opacityPtr = cvOpacity.get()  + ( totalNumberOfVertices * 3 - nverts[ i ] * 3 );
-
             *cvPtr++      = ( RtFloat )vertex[ vertIndex ].x;
             *cvPtr++      = ( RtFloat )vertex[ vertIndex ].y;
             *cvPtr++      = ( RtFloat )vertex[ vertIndex ].z;
@@ -244,45 +211,52 @@ liqRibPfxHairData::liqRibPfxHairData( MObject pfxHair )
           }
         }
 
+        if ( batches.size() == 1 ) firstCurve.assign( CVs.get(), CVs.get() + batch.nverts[ 0 ] * 3 );
+
         // Store for CVs
         liqTokenPointer points_pointerPair;
-        points_pointerPair.set( "P", rPoint, true, false, totalNumberOfVertices );
+        points_pointerPair.set( "P", rPoint, totalNumberOfVertices );
         points_pointerPair.setDetailType( rVertex );
         points_pointerPair.setTokenFloats( CVs );
-        tokenPointerArray.push_back( points_pointerPair );
+        batch.tokens.push_back( points_pointerPair );
 
-         // Store normals
+        // Store normals, one per span end like the width
         liqTokenPointer normals_pointerPair;
-        normals_pointerPair.set( "N", rNormal, true, false, totalNumberOfVertices );
-        points_pointerPair.setDetailType( rVertex );
-        points_pointerPair.setTokenFloats( normals );
-        tokenPointerArray.push_back( normals_pointerPair );
+        normals_pointerPair.set( "N", rNormal, totalNumberOfSpans );
+        normals_pointerPair.setDetailType( rVarying );
+        normals_pointerPair.setTokenFloats( normals );
+        batch.tokens.push_back( normals_pointerPair );
 
         // Store width params
         liqTokenPointer width_pointerPair;
-        width_pointerPair.set( "width", rFloat, true, false, totalNumberOfSpans );
+        width_pointerPair.set( "width", rFloat, totalNumberOfSpans );
         width_pointerPair.setDetailType( rVarying );
         width_pointerPair.setTokenFloats( curveWidth );
-        tokenPointerArray.push_back( width_pointerPair );
+        batch.tokens.push_back( width_pointerPair );
 
         // Store color params
         liqTokenPointer color_pointerPair;
-        color_pointerPair.set( "Cs", rColor, true, false, totalNumberOfVertices );
+        color_pointerPair.set( "Cs", rColor, totalNumberOfVertices );
         color_pointerPair.setDetailType( rVertex );
         color_pointerPair.setTokenFloats( cvColor );
-        tokenPointerArray.push_back( color_pointerPair );
+        batch.tokens.push_back( color_pointerPair );
 
         // Store opacity params
         liqTokenPointer opacity_pointerPair;
-        opacity_pointerPair.set( "Os", rColor, true, false, totalNumberOfVertices );
+        opacity_pointerPair.set( "Os", rColor, totalNumberOfVertices );
         opacity_pointerPair.setDetailType( rVertex );
         opacity_pointerPair.setTokenFloats( cvOpacity );
-        tokenPointerArray.push_back( opacity_pointerPair );
+        batch.tokens.push_back( opacity_pointerPair );
 
-        // Additional RMan* params
-        addAdditionalSurfaceParameters( pfxHair );
+        // Out to its own archive: only the bound stays in memory
+        if ( liqglo_pfxDelayedArchives ) 
+          liqArchiveCurveBatch( batch, "cubic", tokenPointerArray, pfxhair.fullPathName(), batches.size() - 1 );
       }
     }
+    // free memory for lines arrays, are not freed by pfx destructor
+    profileArray.deleteArray();
+    creaseArray.deleteArray();
+    intersectionArray.deleteArray();
   }
 }
 
@@ -292,17 +266,37 @@ void liqRibPfxHairData::write()
 {
   LIQDEBUGPRINTF( "-> writing pfxHair curves\n" );
 
-  if ( ncurves > 0 ) 
-  {
-    unsigned numTokens( tokenPointerArray.size() );
-    scoped_array< RtToken > tokenArray( new RtToken[ numTokens ] );
-    scoped_array< RtPointer > pointerArray( new RtPointer[ numTokens ] );
-    assignTokenArraysV( tokenPointerArray, tokenArray.get(), pointerArray.get() );
+  if ( !batches.empty() ) 
+    for ( unsigned i( 0 ); i < batches.size(); i++ ) 
+      liqWriteCurveBatch( batches[ i ], "cubic", tokenPointerArray );
+  else 
+    RiIdentity(); // In case we're in a motion block!
+}
 
-    RiCurvesV( "cubic", ncurves, nverts.get(), "nonperiodic", numTokens, tokenArray.get(), pointerArray.get() );
-  } 
+unsigned liqRibPfxHairData::granularity() const
+{
+  return max( ( unsigned )batches.size(), 1u );
+}
+
+/** Write the RIB for this surface -- batch by batch.
+ */
+bool liqRibPfxHairData::writeNextGrain()
+{
+  if ( grain < batches.size() ) 
+    liqWriteCurveBatch( batches[ grain ], "cubic", tokenPointerArray );
   else 
     RiIdentity(); // In case we're in a motion block!
+
+  if ( ++grain < batches.size() ) return true;
+  grain = 0;
+  return false;
+}
+
+/** Archived batches are DelayedReadArchives, they can't be motion blurred.
+ */
+bool liqRibPfxHairData::isNextGrainAnimated() const
+{
+  return !liqglo_pfxDelayedArchives;
 }
 
 /** Compare this curve to the other for the purpose of determining
@@ -317,6 +311,14 @@ bool liqRibPfxHairData::compare( const liqRibData & otherObj ) const
   const liqRibPfxHairData & other = (liqRibPfxHairData&)otherObj;
 
   if ( ncurves != other.ncurves ) return false;
+  if ( batches.size() != other.batches.size() ) return false;
+  for ( unsigned i( 0 ); i < batches.size(); i++ ) 
+    if ( batches[ i ].nverts != other.batches[ i ].nverts ) return false;
+
+  // Check the CVs of the first curve
+  if ( firstCurve.size() != other.firstCurve.size() ) return false;
+  for ( unsigned i( 0 ); i < firstCurve.size(); i++ ) 
+    if ( !equiv( firstCurve[ i ], other.firstCurve[ i ] ) ) return false;
 
   return true;
 }
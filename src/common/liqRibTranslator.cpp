@@ -110,8 +110,12 @@ static const char *LIQUIDVERSION =
 #include <liqRibTranslator.h>
 #include <liqGlobalHelpers.h>
 #include <liqProcessLauncher.h>
+#include <liqRenderScheduler.h>
 #include <liqCustomNode.h>
 #include <liqShaderFactory.h>
+#include <liqHash.h>
+#include <liqBucketJournal.h>
+#include <liqMayaRenderView.h>
 
 using namespace boost;
 //using namespace std;
@@ -176,6 +180,12 @@ MString      liqglo_currentNodeName;
 MString      liqglo_currentNodeShortName;
 
 bool         liqglo_useMtorSubdiv;  // use mtor subdiv attributes
+bool         liqglo_useInstancerObjects;  // write particle instancer prototypes once with ObjectBegin
+bool         liqglo_instanceDagObjects;   // write instanced shapes once with ObjectBegin
+int          liqglo_pfxChunkSize;         // paint effects lines per RiCurves call, 0 for all
+bool         liqglo_pfxDelayedArchives;   // write paint effects batches to their own archives
+bool         liqglo_shareMaterials;       // write each shader once per RIB and reference it with ReadArchive
+int          liqglo_particleChunkSize;  // max particles per RiPoints/RiCurves call, 0 for no limit
 bool         liqglo_outputMayaPolyCreases;
 bool         liqglo_renderAllCurves;
 HiderType    liqglo_hider;
@@ -342,6 +352,14 @@ liqRibTranslator::liqRibTranslator()
   m_renderViewLocal   = true;
   m_renderViewPort    = 6667;
   m_renderViewTimeOut = 10;
+  m_renderViewEncoding = "";
+  m_renderViewAOVs    = false;
+  m_renderViewStatsFile = "";
+  m_renderViewResume  = false;
+  m_renderTiles       = 1;
+  m_renderTile        = -1;
+  m_renderSlots       = 0;
+  m_renderThreads     = 0;
 
   m_statistics        = 0;
   m_statisticsFile    = "";
@@ -437,6 +455,12 @@ liqRibTranslator::liqRibTranslator()
   liqglo_projectDir = m_systemTempDirectory;
   liqglo_expandShaderArrays = false;
   liqglo_useMtorSubdiv = false;
+  liqglo_useInstancerObjects = true;
+  liqglo_instanceDagObjects = true;
+  liqglo_pfxChunkSize = 0;
+  liqglo_pfxDelayedArchives = false;
+  liqglo_shareMaterials = false;
+  liqglo_particleChunkSize = 1000000;
   liqglo_outputMayaPolyCreases = false;
   liqglo_renderAllCurves = false;
   liqglo_hider = htHidden;
@@ -769,6 +793,7 @@ MString liqRibTranslator::generateFileName( fileGenMode mode, const structJob& j
 	  
 	  case fgm_shadow_rib:
 	  case fgm_shadow_archive:
+	  case fgm_scene_archive:
 	  case fgm_hero_rib:
 	    ss << liqglo_ribDir.asChar(); 
 	    break;
@@ -794,6 +819,12 @@ MString liqRibTranslator::generateFileName( fileGenMode mode, const structJob& j
       if ( liqglo_beautyRibHasCameraName )
 			  ss << "_" << sanitizeNodeName( job.name ).asChar();
       break;
+
+    case fgm_scene_archive:
+      ss << liqglo_sceneName.asChar() << "_"; 
+      if ( liqglo_beautyRibHasCameraName )
+			  ss << sanitizeNodeName( job.name ).asChar() << "_";
+      break;
 	}
 	
 	switch ( mode )
@@ -1043,6 +1074,220 @@ MStatus liqRibTranslator::ribOutput( long scanTime, MString ribName, bool world_
   liqglo_ribFP = NULL;
   return status;
 }
+/**
+ * The liqmaya display parameter asking the driver for its transport stats.
+ */
+MString liqRibTranslator::renderViewStatsParameter() const
+{
+  if ( m_renderViewStatsFile == "" ) return "";
+  return " \"string statsFile\" [\"" + m_renderViewStatsFile + "\"]";
+}
+/**
+ * The hero pass of a direct render view render can be resumed from the
+ * checkpoint liquidRenderView keeps: its RIB must read the same twice.
+ */
+bool liqRibTranslator::isResumable( const structJob &job ) const
+{
+  return m_renderViewResume && m_renderView && job.pass == rpHeroPass && !job.isStereoPass && !liqglo_rotateCamera && 
+         !useRenderScript && !m_deferredGen && !m_exportReadArchive && !liqglo_doBinary && !liqglo_doCompression && !isTiled( job );
+}
+/**
+ * scene.0001.rib -> scene.0001<suffix>, next to the RIB.
+ */
+MString liqRibTranslator::resumeFileName( const structJob &job, const MString &suffix ) const
+{
+  MString name( liquidGetRelativePath( false, job.ribFileName, liqglo_projectDir ) );
+  const int dot( name.rindex( '.' ) );
+  if ( dot > name.rindex( '/' ) ) name = name.substring( 0, dot - 1 );
+  return name + suffix;
+}
+/**
+ * The RIB text, comments (dates, user) left out.
+ */
+static MString ribHash( const MString &file )
+{
+  liqHash hash;
+  FILE *rib( fopen( file.asChar(), "r" ) );
+  if ( !rib ) return "";
+  char line[ 4096 ];
+  bool lineStart( true ), comment( false );
+  while ( fgets( line, sizeof( line ), rib ) ) 
+  {
+    if ( lineStart ) comment = line[ strspn( line, " \t" ) ] == '#';
+    const size_t length( strlen( line ) );
+    if ( !comment ) hash.add( line, length );
+    lineStart = length && line[ length - 1 ] == '\n';
+  }
+  fclose( rib );
+  return hash.str();
+}
+/**
+ * Before launching a resumable render: a checkpoint of the same RIB crops
+ * the render to what it misses, any other one is dropped. The hero RIB
+ * reads its CropWindow from a small archive written here.
+ */
+void liqRibTranslator::prepareResume()
+{
+  const structJob &job( liqglo_currentJob );
+  const MString checkpoint( resumeFileName( job, ".checkpoint" ) );
+  const double crop[ 4 ] = { m_cropX1, m_cropX2, m_cropY1, m_cropY2 };
+  int pixels[ 4 ];
+  liqRenderTiles::cropPixels( crop, job.width, job.height, pixels );
+  m_resumeHash = ribHash( job.ribFileName );
+
+  imageInfo info;
+  string hash;
+  vector< bucket::bucketInfo > areas;
+  bool resumed( false );
+  if ( m_resumeHash != "" && liqBucketJournal::read( checkpoint.asChar(), info, hash, areas ) && 
+       hash == m_resumeHash.asChar() && info.wo == job.width && info.ho == job.height && !areas.empty() ) 
+  {
+    // the bounding box of the pixels the checkpoint misses
+    vector< unsigned char > done;
+    liqBucketJournal::coverage( areas, job.width, job.height, done );
+    int missing[ 4 ] = { pixels[ 1 ], pixels[ 0 ], pixels[ 3 ], pixels[ 2 ] };
+    for ( int y( pixels[ 2 ] ); y < pixels[ 3 ]; y++ ) 
+      for ( int x( pixels[ 0 ] ); x < pixels[ 1 ]; x++ ) 
+        if ( !done[ ( size_t )y * job.width + x ] ) 
+        {
+          missing[ 0 ] = std::min( missing[ 0 ], x );
+          missing[ 1 ] = std::max( missing[ 1 ], x + 1 );
+          missing[ 2 ] = std::min( missing[ 2 ], y );
+          missing[ 3 ] = std::max( missing[ 3 ], y + 1 );
+        }
+    // a checkpoint with nothing missing belongs to a render that was shown already
+    if ( missing[ 0 ] < missing[ 1 ] ) 
+    {
+      memcpy( pixels, missing, sizeof( pixels ) );
+      resumed = true;
+      MString message( "    resuming '" + job.ribFileName + "' from " + checkpoint + ", " );
+      message += ( int )areas.size();
+      liquidMessage( message + " buckets done", messageInfo );
+    }
+  }
+  if ( !resumed ) remove( checkpoint.asChar() );
+
+  double window[ 4 ];
+  liqRenderTiles::cropWindow( pixels, job.width, job.height, window );
+  const MString archive( resumeFileName( job, ".resume.rib" ) );
+  FILE *rib( fopen( archive.asChar(), "w" ) );
+  if ( !rib ) 
+  {
+    liquidMessage( "Couldn't write '" + archive + "'", messageError );
+    return;
+  }
+  fprintf( rib, "##RenderMan RIB\n# crop window of the pixels '%s' still needs\nCropWindow %.9g %.9g %.9g %.9g\n", 
+           job.ribFileName.asChar(), window[ 0 ], window[ 1 ], window[ 2 ], window[ 3 ] );
+  fclose( rib );
+}
+/**
+ * The renderer's command flags, with its thread limit when renderThreads is
+ * set, so the jobs the scheduler runs side by side share the cores.
+ */
+MString liqRibTranslator::renderFlags() const
+{
+  MString flags( liquidRenderer.renderCmdFlags );
+  if ( m_renderThreads <= 0 ) 
+    return flags;
+  MString threads;
+  threads += m_renderThreads;
+  if ( liquidRenderer.renderName == MString("PRMan") ) 
+    flags += " -t:" + threads;
+  else if ( liquidRenderer.renderName == MString("3Delight") || liquidRenderer.renderName == MString("Pixie") ) 
+    flags += " -t " + threads;
+  return flags;
+}
+/**
+ * Only the hero pass of a direct local render is split in tiles, and only
+ * when the images of its tiles can be merged without losing anything.
+ */
+bool liqRibTranslator::isTiled( const structJob &job ) const
+{
+  if ( !( m_renderTiles > 1 && job.pass == rpHeroPass && !job.isStereoPass && !liqglo_rotateCamera &&
+          launchRender && !useRenderScript && !m_deferredGen && !m_exportReadArchive ) ) 
+    return false;
+  for ( vector< structDisplay >::const_iterator d( m_displays.begin() ); d != m_displays.end(); ++d ) 
+  {
+    if ( m_ignoreAOVDisplays && d > m_displays.begin() ) break;
+    if ( !d->enabled ) continue;
+    // the displays that stream to the render view
+    if ( m_renderView && ( d == m_displays.begin() || m_renderViewAOVs ) ) continue;
+    const MString type( ( d->type == "" )? MString( "framebuffer" ) : d->type );
+    if ( type == "framebuffer" || type == "it" || type == "liqmaya" ) continue;
+    // the tile images of a render view render aren't merged
+    if ( m_renderView || !liqRenderTiles::isMergeable( type, d->mode ) ) return false;
+  }
+  return true;
+}
+/**
+ * Write the current job as a split frame: the world block goes in an archive
+ * written once, and each tile gets a small RIB reading it with its own CropWindow.
+ */
+MStatus liqRibTranslator::tileOutput( long scanTime, bool out_lightBlock )
+{
+  const double crop[ 4 ] = { m_cropX1, m_cropX2, m_cropY1, m_cropY2 };
+  m_tiles = liqRenderTiles::split( liqglo_currentJob.width, liqglo_currentJob.height, m_renderTiles, crop );
+  m_tiledImages.clear();
+
+  MString worldArchive( generateFileName( fgm_scene_archive, liqglo_currentJob ) );
+  if ( ribOutput( scanTime, worldArchive, true, out_lightBlock, MString( "" ) ) != MS::kSuccess ) return MS::kFailure;
+  worldArchive = liquidGetRelativePath( liqglo_relativeFileNames, worldArchive, liqglo_ribDir );
+
+  MStatus status( MS::kSuccess );
+  for ( unsigned i( 0 ); i < m_tiles.size() && status == MS::kSuccess; i++ ) 
+  {
+    m_renderTile = i;
+    m_cropX1 = m_tiles[ i ].crop[ 0 ];
+    m_cropX2 = m_tiles[ i ].crop[ 1 ];
+    m_cropY1 = m_tiles[ i ].crop[ 2 ];
+    m_cropY2 = m_tiles[ i ].crop[ 3 ];
+    m_tiles[ i ].ribName = liqRenderTiles::tileName( liqglo_currentJob.ribFileName, i );
+    status = ribOutput( scanTime, m_tiles[ i ].ribName, false, out_lightBlock, worldArchive );
+  }
+  m_renderTile = -1;
+  m_cropX1 = crop[ 0 ];
+  m_cropX2 = crop[ 1 ];
+  m_cropY1 = crop[ 2 ];
+  m_cropY2 = crop[ 3 ];
+  return status;
+}
+/**
+ * Render the tiles of a split frame at once. In the renderView they stream to
+ * liquidRenderView, otherwise their images are merged once they are all done.
+ */
+void liqRibTranslator::renderTiles()
+{
+  MString message( "    + '" + liqglo_currentJob.ribFileName + "' in " );
+  message += (int)m_tiles.size();
+  liquidMessage( message + " tiles", messageInfo );
+  MStringArray arguments;
+  for ( unsigned i( 0 ); i < m_tiles.size(); i++ ) 
+#ifdef _WIN32
+    arguments.append( renderFlags() + " \"" + m_tiles[ i ].ribName + "\"" );
+#else
+    arguments.append( renderFlags() + " " + m_tiles[ i ].ribName );
+#endif
+  if ( m_renderView ) 
+  {
+    // liquidRenderView stops them when it is interrupted
+    for ( unsigned i( 0 ); i < arguments.length(); i++ ) 
+    {
+      liqProcessLauncher::process render( liqProcessLauncher::start( liquidRenderer.renderCommand, arguments[ i ], liqglo_projectDir, true ) );
+      if ( render ) liqMayaRenderCmd::m_nextRenders.push_back( render );
+    }
+    return;
+  }
+  if ( !liqProcessLauncher::executeAll( liquidRenderer.renderCommand, arguments, liqglo_projectDir ) ) 
+    liquidMessage( "Couldn't launch every tile of '" + liqglo_currentJob.ribFileName + "'", messageError );
+  for ( unsigned i( 0 ); i < m_tiledImages.length(); i++ ) 
+  {
+    MString error;
+    if ( liqRenderTiles::merge( m_tiledImages[ i ], m_tiles, liqglo_currentJob.width, liqglo_currentJob.height, error ) ) 
+      liquidMessage( "    merged '" + m_tiledImages[ i ] + "'", messageInfo );
+    else 
+      liquidMessage( error, messageError );
+  }
+}
 /**
  * This method actually does the renderman output.
  */
@@ -1196,10 +1441,13 @@ MStatus liqRibTranslator::doIt( const MArgList& args )
 
     int currentBlock( 0 );
     unsigned frameIndex( 0 );
+
+    // shaders are kept from one frame to the next, only dirty ones are rebuilt
+    liqShaderFactory::instance().clearShaders();
     
     for ( ; frameIndex < frameNumbers.size(); frameIndex++ ) 
     {
-      liqShaderFactory::instance().clearShaders();
+      liqShaderFactory::instance().refreshShaders();
         
       liqglo_lframe = frameNumbers[ frameIndex ];
 
@@ -1378,6 +1626,12 @@ MStatus liqRibTranslator::doIt( const MArgList& args )
             {
               for ( int msampleOn = 0; msampleOn < liqglo_motionSamples; msampleOn++ ) 
                 scanScene( liqglo_sampleTimes[ msampleOn ] , msampleOn );
+
+              // particle systems keep the ids they saw at each sample, only
+              // the ones alive at all samples get exported
+              if ( liqglo_doMotion || liqglo_doDef ) 
+                for ( RNMAP::iterator rniter( htable->RibNodeMap.begin() ); rniter != htable->RibNodeMap.end(); rniter++ ) 
+                  rniter->second->resolveParticleSamples();
             } 
             else 
             {
@@ -1433,7 +1687,12 @@ MStatus liqRibTranslator::doIt( const MArgList& args )
           
           out_lightBlock = (liqglo_currentJob.pass != rpShadowMap || ( liqglo_currentJob.pass == rpShadowMap && liqglo_currentJob.shadowType == stDeep && m_outputLightsInDeepShadows) );
           
-          if ( ribOutput( scanTime, liqglo_currentJob.ribFileName, false, out_lightBlock, archiveName ) != MS::kSuccess )
+          if ( isTiled( liqglo_currentJob ) ) 
+          {
+            if ( tileOutput( scanTime, out_lightBlock ) != MS::kSuccess ) 
+              break;
+          }
+          else if ( ribOutput( scanTime, liqglo_currentJob.ribFileName, false, out_lightBlock, archiveName ) != MS::kSuccess )
             break;
           
           if ( m_showProgress ) printProgress( 3, frameNumbers.size(), frameIndex );
@@ -1795,6 +2054,8 @@ MStatus liqRibTranslator::doIt( const MArgList& args )
     LIQDEBUGPRINTF( "-> spawning command.\n" );
     if ( launchRender ) 
     {
+      // false when the maps the hero pass needs failed to render
+      bool heroReady( true );
       if ( useRenderScript ) 
       {
         bool wait = false;
@@ -1841,25 +2102,25 @@ MStatus liqRibTranslator::doIt( const MArgList& args )
         // liquidMessage( "", messageInfo ); // emit a '\n'
         // int exitstat = 0; ???
         
+        liqRenderScheduler scheduler( liqglo_projectDir, liqRenderScheduler::slots( m_renderSlots, m_renderThreads ) );
         //
         // write out make texture pass
         //
+        vector< int > textures;
+        if ( txtList.size() ) liquidMessage( "Making textures... ", messageInfo );
         vector<structJob>::iterator iter = txtList.begin();
         while ( iter != txtList.end() ) 
         {
-          liquidMessage( "Making textures '" + iter->imageName + "'", messageInfo );
-          liqProcessLauncher::execute( iter->renderName, 
+          textures.push_back( scheduler.add( iter->imageName, iter->renderName, 
 #ifdef _WIN32
-          (" -progress \"" + iter->ribFileName + "\""), 
+          (" -progress \"" + iter->ribFileName + "\"") ) );
 #else
-          (" -progress " + iter->ribFileName), 
+          (" -progress " + iter->ribFileName) ) );
 #endif
-          liqglo_projectDir, true );
-          
           ++iter;
         }
         //
-        // write out shadows
+        // write out shadows, once the textures they may use are made
         //
         if ( liqglo_doShadows ) 
         {
@@ -1869,47 +2130,63 @@ MStatus liqRibTranslator::doIt( const MArgList& args )
           while ( iter != shadowList.end() ) 
           {
             if ( iter->skip ) 
-            {
               liquidMessage( "    - skipping '" + iter->ribFileName + "'", messageInfo );
-              ++iter;
-              continue;
-            }
-            liquidMessage( "    + '" + iter->ribFileName + "'", messageInfo );
-            
-            if ( !liqProcessLauncher::execute( liquidRenderer.renderCommand, liquidRenderer.renderCmdFlags + " " +
+            else 
+              scheduler.add( iter->ribFileName, liquidRenderer.renderCommand, renderFlags() + " " +
 #ifdef _WIN32
-            "\"" + iter->ribFileName + "\"", 
+              "\"" + iter->ribFileName + "\"", 
 #else
-            iter->ribFileName, 
+              iter->ribFileName, 
 #endif
-            liqglo_projectDir, true ) )  break;
+              textures );
             ++iter;
           } // while ( iter != shadowList.end() )
         }
+        heroReady = scheduler.run();
         //
         // write out hero pass
         //
         liquidMessage( "Rendering hero pass... ", messageInfo );
+        // the render view shows one render at a time, on one port
+        if ( m_renderView ) liqMayaRenderCmd::stopRender();
         cerr << "liquidBin = " << liquidBin << endl << flush; 
         
         if ( liqglo_currentJob.skip ) 
           liquidMessage( "    - skipping '" + liqglo_currentJob.ribFileName + "'", messageInfo );
+        else if ( !heroReady ) 
+          liquidMessage( "    not rendering '" + liqglo_currentJob.ribFileName + "', some texture or shadow jobs failed", messageError );
+        else if ( isTiled( liqglo_currentJob ) ) 
+          renderTiles();
         else 
         {
           liquidMessage( "    + '" + liqglo_currentJob.ribFileName + "'", messageInfo );
-          liqProcessLauncher::execute( liquidRenderer.renderCommand, liquidRenderer.renderCmdFlags + " " +
+          if ( isResumable( liqglo_currentJob ) ) prepareResume();
+          if ( m_renderView ) 
+          {
+            // liquidRenderView stops it when it is interrupted
+            liqProcessLauncher::process render( liqProcessLauncher::start( liquidRenderer.renderCommand, renderFlags() + " " +
 #ifdef _WIN32
-          "\"" + liqglo_currentJob.ribFileName + "\"", "\"" + liqglo_projectDir + "\"",
+            "\"" + liqglo_currentJob.ribFileName + "\"",
 #else
-           liqglo_currentJob.ribFileName, liqglo_projectDir,
+            liqglo_currentJob.ribFileName,
 #endif
-           false );
+            liqglo_projectDir, true ) );
+            if ( render ) liqMayaRenderCmd::m_nextRenders.push_back( render );
+          }
+          else 
+            liqProcessLauncher::execute( liquidRenderer.renderCommand, renderFlags() + " " +
+#ifdef _WIN32
+            "\"" + liqglo_currentJob.ribFileName + "\"", "\"" + liqglo_projectDir + "\"",
+#else
+             liqglo_currentJob.ribFileName, liqglo_projectDir,
+#endif
+             false );
         }
       } // if ( useRenderScript ) 
       //
       //  philippe: here we launch the liquidRenderView command which will listen to the liqmaya display driver
       //  to display buckets in the renderview.
-      if ( m_renderView ) 
+      if ( m_renderView && heroReady ) 
       {
         MString displayCmd = "liquidRenderView -c " + liqglo_renderCamera;
         displayCmd += " -l " + MString( ( m_renderViewLocal )? "1":"0" );
@@ -1918,8 +2195,16 @@ MStatus liqRibTranslator::doIt( const MArgList& args )
         displayCmd += " -timeout ";
         displayCmd += (int)m_renderViewTimeOut;
         if ( m_renderViewCrop ) displayCmd += " -doRegion";
+        if ( m_renderViewStatsFile != "" ) displayCmd += " -statsFile \"" + m_renderViewStatsFile + "\"";
+        if ( isResumable( liqglo_currentJob ) && !liqglo_currentJob.skip ) 
+          displayCmd += " -checkpoint \"" + resumeFileName( liqglo_currentJob, ".checkpoint" ) + "\" -checkpointHash " + m_resumeHash;
+        if ( !useRenderScript && isTiled( liqglo_currentJob ) ) 
+        {
+          displayCmd += " -connections ";
+          displayCmd += (int)m_tiles.size();
+        }
         
-        displayCmd += ";liquidSaveRenderViewImage();";
+        // it returns right away, the image is saved once the render is done
         MGlobal::executeCommand( displayCmd );
       } 
     } // if( launchRender )
@@ -3549,19 +3834,24 @@ MStatus liqRibTranslator::scanScene( float lframe, int sample )
       while ( !instancerIter.isDone() )
       {
         MDagPath path( instancerIter.path() );
-        MString instanceStr( MString( "|INSTANCE_" ) + 
-		                        instancerIter.instancerId() + MString( "_" ) +
-		                        instancerIter.particleId() + MString( "_" ) +
-		                        instancerIter.pathId() );
-        
         MMatrix instanceMatrix( instancerIter.matrix() );
         bool useSamples( ( sample > 0 ) && isObjectMotionBlur( path ) );
+
+        // the prototype is defined once, the instances are only transforms
+        if ( !liqglo_useInstancerObjects || 
+             !htable->insertInstance( path, instancerIter.instancerPath(), instancerIter.instancerId(), 
+                                      sample, useSamples, count++, instancerIter.particleId(), instanceMatrix ) ) 
+        {
+          MString instanceStr( MString( "|INSTANCE_" ) + 
+		                          instancerIter.instancerId() + MString( "_" ) +
+		                          instancerIter.particleId() + MString( "_" ) +
+		                          instancerIter.pathId() );
         
-        htable->insert( path, lframe, 
-												( useSamples )? sample : 0,
-											 	MRT_Unknown, count++, 
-											  &instanceMatrix, instanceStr, instancerIter.particleId() );
-        
+          htable->insert( path, lframe, 
+												  ( useSamples )? sample : 0,
+											 	  MRT_Unknown, count++, 
+											    &instanceMatrix, instanceStr, instancerIter.particleId() );
+        }
         instancerIter.next();
       }
 	  }
@@ -3603,19 +3893,24 @@ MStatus liqRibTranslator::scanScene( float lframe, int sample )
 	    while ( !instancerIter.isDone() )
 	    {
 		    MDagPath path( instancerIter.path() );
-		    MString instanceStr( MString( "|INSTANCE_" ) + 
-		                        instancerIter.instancerId() + MString( "_" ) +
-		                        instancerIter.particleId() + MString( "_" ) +
-		                        instancerIter.pathId() );
-
 		    MMatrix instanceMatrix( instancerIter.matrix() );
 		    bool useSamples( ( sample > 0 ) && isObjectMotionBlur( path ) );
 
-			  htable->insert( path, lframe, 
-											 ( useSamples )? sample :	0, 
-					 						 MRT_Unknown, count++, 
-											 &instanceMatrix, instanceStr, instancerIter.particleId() );
-			  
+		    // the prototype is defined once, the instances are only transforms
+		    if ( !liqglo_useInstancerObjects || 
+		         !htable->insertInstance( path, instancerIter.instancerPath(), instancerIter.instancerId(), 
+		                                  sample, useSamples, count++, instancerIter.particleId(), instanceMatrix ) ) 
+		    {
+		      MString instanceStr( MString( "|INSTANCE_" ) + 
+		                          instancerIter.instancerId() + MString( "_" ) +
+		                          instancerIter.particleId() + MString( "_" ) +
+		                          instancerIter.pathId() );
+
+			    htable->insert( path, lframe, 
+											   ( useSamples )? sample :	0, 
+					 						   MRT_Unknown, count++, 
+											   &instanceMatrix, instanceStr, instancerIter.particleId() );
+		    }
 		    instancerIter.next();
 	    }
     } //  if ( !m_renderSelected && !m_exportSpecificList )
@@ -4203,7 +4498,13 @@ MStatus liqRibTranslator::framePrologue( long lframe )
 				RiQuantize( RI_RGBA, 0, 0, 0, 0 );
 			if ( m_rgain != 1.0 || m_rgamma != 1.0 ) RiExposure( m_rgain, m_rgamma );
       
-      if ( ( m_cropX1 != 0.0 ) || ( m_cropY1 != 0.0 ) || ( m_cropX2 != 1.0 ) || ( m_cropY2 != 1.0 ) ) 
+      if ( isResumable( liqglo_currentJob ) ) 
+      {
+        // what a resumed render still misses is only known at launch time
+        MString archive( liquidGetRelativePath( liqglo_relativeFileNames, resumeFileName( liqglo_currentJob, ".resume.rib" ), liqglo_projectDir ) );
+        RiReadArchive( const_cast< RtToken >( archive.asChar() ), NULL, RI_NULL );
+      }
+      else if ( ( m_cropX1 != 0.0 ) || ( m_cropY1 != 0.0 ) || ( m_cropX2 != 1.0 ) || ( m_cropY2 != 1.0 ) ) 
       {
         // philippe : handle the rotated camera case
         if ( liqglo_rotateCamera == true ) RiCropWindow( m_cropY2, m_cropY1, 1 - m_cropX1, 1 - m_cropX2 );
@@ -4396,8 +4697,13 @@ MStatus liqRibTranslator::framePrologue( long lframe )
           //  MGlobal::executeCommand( "strip(system(\"echo $HOST\"));", host );
 
           RiArchiveRecord( RI_COMMENT, "Render To Maya renderView :" );
-          RiArchiveRecord( RI_VERBATIM, "Display \"%s\" \"%s\" \"%s\" \"int merge\" [0] \"int mayaDisplayPort\" [%d] \"string host\" [\"%s\"]\n", 
-          const_cast< char* >( imageName.str().c_str() ), "liqmaya", "rgba", m_renderViewPort, "localhost" );
+          // float, half, 16bit or 8bit, +lz to compress: bandwidth for remote renders
+          MString parameters( renderViewStatsParameter() );
+          if ( isResumable( liqglo_currentJob ) ) 
+            parameters += " \"string resumeFile\" [\"" + resumeFileName( liqglo_currentJob, ".checkpoint" ) + "\"]";
+          RiArchiveRecord( RI_VERBATIM, "Display \"%s\" \"%s\" \"%s\" \"int merge\" [0] \"int mayaDisplayPort\" [%d] \"string host\" [\"%s\"] \"string bucketEncoding\" [\"%s\"]%s\n", 
+          const_cast< char* >( imageName.str().c_str() ), "liqmaya", "rgba", m_renderViewPort, "localhost", m_renderViewEncoding.asChar(), 
+          parameters.asChar() );
 
           // in this case, override the launch render settings
           if ( launchRender == false ) 
@@ -4490,8 +4796,32 @@ MStatus liqRibTranslator::framePrologue( long lframe )
             parameterString << ( ((*m_displays_iterator).xtraParams.type[p] > 0)? "] " : "\"] ");
           }
           
+          // secondary displays can follow the primary one to maya's renderview,
+          // liquidRenderView keeps each of them in its own bucket file
+          if ( m_renderView && m_renderViewAOVs && m_displays_iterator > m_displays.begin() ) 
+          {
+            imageType = "liqmaya";
+            quantizer.str( "" );
+            quantizer << "\"float quantize[4]\" [ 0 0 0 0 ]";
+            dither.str( "" );
+            parameterString.str( "" );
+            parameterString << "\"int mayaDisplayPort\" [" << m_renderViewPort << "] \"string host\" [\"localhost\"] ";
+            parameterString << "\"string bucketEncoding\" [\"" << m_renderViewEncoding.asChar() << "\"]";
+            parameterString << renderViewStatsParameter().asChar();
+          }
+
+          // each tile of a split frame writes its own file, they are merged once the tiles are done
+          string displayName( imageName.str() );
+          if ( m_renderTile >= 0 && imageType != "liqmaya" && imageType != "framebuffer" && imageType != "it" ) 
+          {
+            const bool secondary( displayName[ 0 ] == '+' );
+            MString image( displayName.c_str() + ( secondary ? 1 : 0 ) );
+            if ( !m_renderTile ) m_tiledImages.append( image );
+            displayName = string( secondary ? "+" : "" ) + liqRenderTiles::tileName( image, m_renderTile ).asChar();
+          }
+
           // output call
-          RiArchiveRecord( RI_VERBATIM, "Display \"%s\" \"%s\" \"%s\" %s %s %s %s\n", const_cast< char* >( imageName.str().c_str() ), 
+          RiArchiveRecord( RI_VERBATIM, "Display \"%s\" \"%s\" \"%s\" %s %s %s %s\n", const_cast< char* >( displayName.c_str() ), 
           imageType.c_str(), 
           imageMode.c_str(), 
           quantizer.str().c_str(), 
@@ -4594,6 +4924,81 @@ MStatus liqRibTranslator::frameEpilogue( long )
   return (ribStatus == kRibBegin ? MS::kSuccess : MS::kFailure);
 }
 
+/**
+ * Whether the shape of this node can be written once with ObjectBegin and
+ * instanced for each of its DAG paths: plain geometry only (see
+ * liqRibObj::isInstanceable), and the instances must all be of the same type.
+ */
+static bool isInstanceableShape( liqRibNodePtr ribNode )
+{
+  if ( ribNode->instancer || ribNode->getInstanceStr() != "" ) return false;
+  if ( !ribNode->path().isInstanced() ) return false;
+  if ( !liqRibObj::isInstanceable( ribNode->object( 0 )->type ) ) return false;
+
+  liqRibObjPtr master( ribNode->instanceObject() );
+  return master && master->type == ribNode->object( 0 )->type;
+}
+
+/**
+ * Write an object's shader.
+ * With shareMaterials on, the first object using a shader in a RIB writes it
+ * once inside an inline archive and every object, that one included, reads
+ * the archive back. Switchers pick their shader per object and are always
+ * written inline.
+ */
+void liqRibTranslator::writeMaterial( liqGenericShader &shader )
+{
+  if ( !liqglo_shareMaterials || !shader.isShader() ) 
+  {
+    shader.write( liqglo_shortShaderNames, 0 );
+    return;
+  }
+  string archiveName( "liqMaterial_" + shader.name );
+  if ( m_writtenMaterials.find( archiveName ) == m_writtenMaterials.end() ) 
+  {
+    RiArchiveRecord( RI_VERBATIM, "ArchiveBegin \"%s\"\n", archiveName.c_str() );
+    shader.write( liqglo_shortShaderNames, 0 );
+    RiArchiveRecord( RI_VERBATIM, "ArchiveEnd\n" );
+    m_writtenMaterials.insert( archiveName );
+  }
+  RiReadArchive( const_cast< RtToken >( archiveName.c_str() ), NULL, RI_NULL );
+}
+
+/**
+ * Declare, at world level, the co-shaders of every object's shaders.
+ * Co-shaders with the same handle (same file and parameters) are written
+ * once and every object of the block references them.
+ */
+void liqRibTranslator::writeWorldCoShaders()
+{
+  set< string > &declared( liqShaderFactory::instance().worldCoShaders() );
+  set< string > exported;
+
+  for ( RNMAP::iterator rniter( htable->RibNodeMap.begin() ); rniter != htable->RibNodeMap.end(); rniter++ ) 
+  {
+    liqRibNodePtr ribNode( rniter->second );
+    if ( !ribNode || !ribNode->object( 0 ) ) continue;
+    if ( ribNode->object( 0 )->type == MRT_Light || ribNode->object( 0 )->type == MRT_Coord || ribNode->object( 0 )->type == MRT_ClipPlane ) continue;
+    if ( liqglo_currentJob.pass != rpShadowMap ? ribNode->object( 0 )->ignore : ribNode->object( 0 )->ignoreShadow ) continue;
+
+    MObject shaders[ 3 ] = { m_ignoreSurfaces ? MObject::kNullObj : ribNode->findShader(), 
+                             m_ignoreDisplacements ? MObject::kNullObj : ribNode->findDisp(), 
+                             m_ignoreVolumes ? MObject::kNullObj : ribNode->findVolume() };
+    for ( unsigned i( 0 ); i < 3; i++ ) 
+    {
+      if ( shaders[ i ].isNull() ) continue;
+      MFnDependencyNode shaderNode( shaders[ i ] );
+      if ( shaderNode.typeName() != "liquidSurface" && shaderNode.typeName() != "liquidDisplacement" && 
+           shaderNode.typeName() != "liquidVolume" ) continue;
+
+      liqGenericShader &shader( liqShaderFactory::instance().getShader( shaders[ i ], liqglo_exportAllShadersParams ) );
+      if ( shader.isShader() && !shader.hasErrors ) 
+        shader.asShader()->writeCoShaders( liqglo_shortShaderNames, 0, exported );
+    }
+  }
+  declared.insert( exported.begin(), exported.end() );
+}
+
 /**
  * Write out the body of the frame.
  * This is a dump of the DAG to RIB with flattened transforms (MtoR-style).
@@ -4642,6 +5047,24 @@ MStatus liqRibTranslator::objectBlock()
   MObject transform;
   MFnDagNode dagFn;
 
+  // object definitions only live as long as the RIB they are written to
+  for ( RNMAP::iterator rniter( htable->RibNodeMap.begin() ); rniter != htable->RibNodeMap.end(); rniter++ ) 
+    if ( rniter->second->object( 0 ) ) rniter->second->object( 0 )->setHandle( NULL );
+  // and so do material archives
+  m_writtenMaterials.clear();
+
+  // and world level co-shaders, that are also forgotten when the block ends
+  struct liqWorldCoShadersScope 
+  {
+    liqWorldCoShadersScope()  { liqShaderFactory::instance().worldCoShaders().clear(); }
+    ~liqWorldCoShadersScope() { liqShaderFactory::instance().worldCoShaders().clear(); }
+  } worldCoShadersScope;
+  bool shadersInPass( liqglo_currentJob.pass != rpShadowMap || 
+                      ( liqglo_currentJob.shadowType != stDeep && m_outputShadersInShadows ) || 
+                      ( liqglo_currentJob.shadowType == stDeep && m_outputShadersInDeepShadows ) );
+  if ( shadersInPass && !m_exportReadArchive ) 
+    writeWorldCoShaders();
+
   for ( RNMAP::iterator rniter( htable->RibNodeMap.begin() ); rniter != htable->RibNodeMap.end(); rniter++ ) 
   {
     LIQ_CHECK_CANCEL_REQUEST;
@@ -5373,7 +5796,7 @@ MStatus liqRibTranslator::objectBlock()
 				liqGenericShader& currentShader = liqShaderFactory::instance().getShader( ribNode->assignedVolume.object(), liqglo_exportAllShadersParams );
   			// per shader shadow pass override
   			if ( liqglo_currentJob.pass != rpShadowMap || currentShader.outputInShadow )
-  				currentShader.write(liqglo_shortShaderNames, 0);
+  				writeMaterial( currentShader );
   		}
 	    
       if ( !m_ignoreSurfaces )
@@ -5405,7 +5828,7 @@ MStatus liqRibTranslator::objectBlock()
 			      // per shader shadow pass override
   				  if ( liqglo_currentJob.pass != rpShadowMap || currentShader.outputInShadow )
   				  {
-  					  currentShader.write(liqglo_shortShaderNames, 0);
+  					  writeMaterial( currentShader );
   				  }
 		      }
 	      } 
@@ -5628,7 +6051,7 @@ MStatus liqRibTranslator::objectBlock()
       // per shader shadow pass override
   		if ( liqglo_currentJob.pass != rpShadowMap || currentShader.outputInShadow )
   		{
-  			currentShader.write(liqglo_shortShaderNames, 0);
+  			writeMaterial( currentShader );
   		}
     }
     if ( ribNode->rib.box != "" && ribNode->rib.box != "-" ) 
@@ -5700,7 +6123,34 @@ MStatus liqRibTranslator::objectBlock()
                     //( ribNode->object(0)->type != MRT_Locator ) &&
                     ( liqglo_currentJob.pass != rpShadowMap || liqglo_currentJob.shadowType == stDeep ) );
 
-      if ( doMotion )
+      if ( ribNode->instancer && liqRibObj::isInstanceable( ribNode->object( 0 )->type ) ) 
+      {
+        // particle instancer: define the prototype once and instance it
+        // for every particle, liqRibHT::insertInstance only makes them for
+        // plain geometry
+        bool instanceMotion( liqglo_doMotion &&
+                             ribNode->motion.transformationBlur &&
+                             ( liqglo_currentJob.pass != rpShadowMap || liqglo_currentJob.shadowType == stDeep ) );
+
+        RtObjectHandle handle( RiObjectBegin() );
+        ribNode->object( 0 )->writeObject();
+        RiObjectEnd();
+        ribNode->instancer->write( handle, instanceMotion );
+      } 
+      else if ( liqglo_instanceDagObjects && !doMotion && isInstanceableShape( ribNode ) )
+      {
+        // DAG instances of a shape share one definition per RIB
+        liqRibObjPtr master( ribNode->instanceObject() );
+        if ( !master->handle() ) 
+        {
+          RtObjectHandle handle( RiObjectBegin() );
+          ribNode->object( 0 )->writeObject();
+          RiObjectEnd();
+          master->setHandle( handle );
+        }
+        RiObjectInstance( master->handle() );
+      } 
+      else if ( doMotion )
       {
         // For each grain, open a new motion block...
         for ( unsigned i( 0 ); i < ribNode->object( 0 )->granularity(); i++ ) 
@@ -114,6 +114,13 @@ MSyntax liqRibTranslator::syntax()
   syntax.addFlag("rv",    "renderView");
   syntax.addFlag("rvl",   "renderViewlocal");
   syntax.addFlag("rvp",   "renderViewPort",  MSyntax::kLong);
+  syntax.addFlag("rven",  "renderViewEncoding", MSyntax::kString);
+  syntax.addFlag("rvao",  "renderViewAOVs");
+  syntax.addFlag("rvsf",  "renderViewStatsFile", MSyntax::kString);
+  syntax.addFlag("rvrs",  "renderViewResume");
+  syntax.addFlag("rtl",   "renderTiles",     MSyntax::kLong);
+  syntax.addFlag("rsl",   "renderSlots",     MSyntax::kLong);
+  syntax.addFlag("rth",   "renderThreads",   MSyntax::kLong);
   syntax.addFlag("shn",   "shotName",        MSyntax::kString);
   syntax.addFlag("shv",   "shotVersion",     MSyntax::kString);
   syntax.addFlag("lyr",   "layer",           MSyntax::kString);
@@ -225,6 +232,8 @@ MStatus liqRibTranslator::liquidDoArgs( MArgList args )
     else if ((arg == "-rgo") || (arg == "-ribGenOnly"))      m_justRib = true;
     else if ((arg == "-rv") || (arg == "-renderView"))       m_renderView = true;
     else if ((arg == "-rvl") || (arg == "-renderViewLocal")) m_renderViewLocal = true;
+    else if ((arg == "-rvao") || (arg == "-renderViewAOVs")) m_renderViewAOVs = true;
+    else if ((arg == "-rvrs") || (arg == "-renderViewResume")) m_renderViewResume = true;
     else if ((arg == "-nsfs") || (arg == "-noSingleFrameShadows"))   liqglo_noSingleFrameShadows = true;
     else if ((arg == "-sfso") || (arg == "-singleFrameShadowsOnly")) liqglo_singleFrameShadowsOnly = true;
     else if ((arg == "-n") || (arg == "-sequence")) 
@@ -452,6 +461,34 @@ MStatus liqRibTranslator::liquidDoArgs( MArgList args )
       m_renderViewPort = argValue.asInt();
       LIQCHECKSTATUS(status, err);
     } 
+    else if ((arg == "-rven") || (arg == "-renderViewEncoding")) 
+    {
+      m_renderViewEncoding = args.asString( ++i, &status );
+      LIQCHECKSTATUS(status, err);
+    } 
+    else if ((arg == "-rvsf") || (arg == "-renderViewStatsFile")) 
+    {
+      m_renderViewStatsFile = args.asString( ++i, &status );
+      LIQCHECKSTATUS(status, err);
+    } 
+    else if ((arg == "-rtl") || (arg == "-renderTiles")) 
+    {
+      argValue = args.asString( ++i, &status );
+      m_renderTiles = argValue.asInt();
+      LIQCHECKSTATUS(status, err);
+    } 
+    else if ((arg == "-rsl") || (arg == "-renderSlots")) 
+    {
+      argValue = args.asString( ++i, &status );
+      m_renderSlots = argValue.asInt();
+      LIQCHECKSTATUS(status, err);
+    } 
+    else if ((arg == "-rth") || (arg == "-renderThreads")) 
+    {
+      argValue = args.asString( ++i, &status );
+      m_renderThreads = argValue.asInt();
+      LIQCHECKSTATUS(status, err);
+    } 
     else if ((arg == "-cw") || (arg == "-cropWindow")) 
     {
       argValue = args.asString( ++i, &status );
@@ -67,6 +67,12 @@ extern MString      liqglo_currentNodeName;
 extern MString      liqglo_currentNodeShortName;
 
 extern bool         liqglo_useMtorSubdiv;  // use mtor subdiv attributes
+extern int          liqglo_particleChunkSize;
+extern bool         liqglo_useInstancerObjects;
+extern bool         liqglo_instanceDagObjects;
+extern int          liqglo_pfxChunkSize;
+extern bool         liqglo_pfxDelayedArchives;
+extern bool         liqglo_shareMaterials;
 extern bool         liqglo_outputMayaPolyCreases;
 extern bool         liqglo_renderAllCurves;
 extern HiderType    liqglo_hider;
@@ -315,6 +321,9 @@ void liqRibTranslator::liquidReadGlobals()
   // Script Job
   
   liquidGetPlugValue( rGlobalNode, "useRenderScript", useRenderScript, gStatus );
+  liquidGetPlugValue( rGlobalNode, "renderTiles", m_renderTiles, gStatus );
+  liquidGetPlugValue( rGlobalNode, "renderSlots", m_renderSlots, gStatus );
+  liquidGetPlugValue( rGlobalNode, "renderThreads", m_renderThreads, gStatus );
   liquidGetPlugValue( rGlobalNode, "renderJobName", renderJobName, gStatus );
   liquidGetPlugValue( rGlobalNode, "renderScriptFileName", m_userRenderScriptFileName, gStatus );
   liquidGetPlugValue( rGlobalNode, "renderScriptCommand", varVal, gStatus );
@@ -512,6 +521,14 @@ void liqRibTranslator::liquidReadGlobals()
   liquidGetPlugValue( rGlobalNode, "outputMayaPolyCreases", liqglo_outputMayaPolyCreases, gStatus ); 
   liquidGetPlugValue( rGlobalNode, "useMtorSubdiv", liqglo_useMtorSubdiv, gStatus ); 
   
+  // Particles
+  liquidGetPlugValue( rGlobalNode, "particleChunkSize", liqglo_particleChunkSize, gStatus ); 
+  liquidGetPlugValue( rGlobalNode, "useInstancerObjects", liqglo_useInstancerObjects, gStatus ); 
+  liquidGetPlugValue( rGlobalNode, "instanceDagObjects", liqglo_instanceDagObjects, gStatus ); 
+  liquidGetPlugValue( rGlobalNode, "pfxChunkSize", liqglo_pfxChunkSize, gStatus ); 
+  liquidGetPlugValue( rGlobalNode, "pfxDelayedArchives", liqglo_pfxDelayedArchives, gStatus ); 
+  liquidGetPlugValue( rGlobalNode, "shareMaterials", liqglo_shareMaterials, gStatus ); 
+
   // Curves
   liquidGetPlugValue( rGlobalNode, "renderAllCurves", m_renderAllCurves, gStatus );
  
@@ -522,6 +539,10 @@ void liqRibTranslator::liquidReadGlobals()
   liquidGetPlugValue( rGlobalNode, "renderViewLocal", m_renderViewLocal, gStatus );
   liquidGetPlugValue( rGlobalNode, "renderViewPort", m_renderViewPort, gStatus );
   liquidGetPlugValue( rGlobalNode, "renderViewTimeOut", m_renderViewTimeOut, gStatus );
+  liquidGetPlugValue( rGlobalNode, "renderViewEncoding", m_renderViewEncoding, gStatus );
+  liquidGetPlugValue( rGlobalNode, "renderViewAOVs", m_renderViewAOVs, gStatus );
+  liquidGetPlugValue( rGlobalNode, "renderViewStatsFile", m_renderViewStatsFile, gStatus );
+  liquidGetPlugValue( rGlobalNode, "renderViewResume", m_renderViewResume, gStatus );
   
   // Statistics
   liquidGetPlugValue( rGlobalNode, "statistics", m_statistics, gStatus );
@@ -26,6 +26,8 @@
 
 #include <ri.h>
 
+#include <cstring>
+
 #include <maya/MPlug.h>
 #include <maya/MDoubleArray.h>
 #include <maya/MFnDoubleArrayData.h>
@@ -38,12 +40,21 @@
 #include <liqGlobalHelpers.h>
 #include <liqMayaNodeIds.h>
 #include <liqShaderFactory.h>
+#include <liqHash.h>
 
 #include <boost/scoped_array.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 extern int debugMode;
 
+// liqGetSloInfo keeps its argument defaults until reset
+static void liqReleaseSloInfo( liqGetSloInfo *info )
+{
+	info->resetIt();
+	delete info;
+}
+
 liqShader::liqShader() : liqGenericShader()
 {
   //numTPV                = 0;
@@ -64,6 +75,7 @@ liqShader::liqShader() : liqGenericShader()
 //  shaderHandler         = liqShaderFactory::instance().getUniqueShaderHandler();
 //  m_outputAllParameters = false;
   m_previewGamma		= 1;
+  m_animatedColor       = false;
 }
 
 liqShader::liqShader( const liqShader& src ) : liqGenericShader( (const liqGenericShader&)src )
@@ -87,6 +99,11 @@ liqShader::liqShader( const liqShader& src ) : liqGenericShader( (const liqGener
 //  m_mObject            = src.m_mObject;
 //  m_outputAllParameters= src.m_outputAllParameters;
   m_previewGamma       = src.m_previewGamma;
+  m_tokenArgs          = src.m_tokenArgs;
+  m_animatedArgs       = src.m_animatedArgs;
+  m_coShaderArgs       = src.m_coShaderArgs;
+  m_animatedColor      = src.m_animatedColor;
+  m_shaderInfo         = src.m_shaderInfo;
 }
 
 liqShader & liqShader::operator=( const liqShader & src )
@@ -115,6 +132,14 @@ liqShader & liqShader::operator=( const liqShader & src )
   m_mObject             = src.m_mObject;
   m_outputAllParameters = src.m_outputAllParameters;
   m_previewGamma        = src.m_previewGamma;
+  m_tokenArgs           = src.m_tokenArgs;
+  m_animatedArgs        = src.m_animatedArgs;
+  m_coShaderArgs        = src.m_coShaderArgs;
+  m_animatedColor       = src.m_animatedColor;
+  m_shaderInfo          = src.m_shaderInfo;
+  // packed parameters point into the old tokenPointerArray
+  m_tokenArray.clear();
+  m_pointerArray.clear();
   return *this;
 }
 
@@ -135,6 +160,7 @@ liqShader::liqShader( MObject shaderObj, bool outputAllParameters ) : liqGeneric
 	hasDisplacementBound = false;
 	outputInShadow = false;
 	hasErrors = false;
+	m_animatedColor = false;
 	tokenPointerArray.push_back( liqTokenPointer() );
 
 	file = rmShaderStr.substring( 0, rmShaderStr.length() - 5 ).asChar();
@@ -146,7 +172,8 @@ liqShader::liqShader( MObject shaderObj, bool outputAllParameters ) : liqGeneric
 	rmOpacity[1]          = 1.0;
 	rmOpacity[2]          = 1.0;
 
-	liqGetSloInfo shaderInfo;
+	boost::shared_ptr< liqGetSloInfo > shaderInfoPtr( new liqGetSloInfo, liqReleaseSloInfo );
+	liqGetSloInfo &shaderInfo = *shaderInfoPtr;
 
 // commented out for it generates errors - Alf
 	int success = ( shaderInfo.setShaderNode( shaderNode ) );
@@ -170,24 +197,7 @@ liqShader::liqShader( MObject shaderObj, bool outputAllParameters ) : liqGeneric
 
 		shader_type = shaderInfo.getType();
 		// Set RiColor and RiOpacity
-		status.clear();
-		MPlug colorPlug = shaderNode.findPlug( "color" );
-		if ( MS::kSuccess == status )
-		{
-			colorPlug.child(0).getValue( rmColor[0] );
-			colorPlug.child(1).getValue( rmColor[1] );
-			colorPlug.child(2).getValue( rmColor[2] );
-		}
-
-		status.clear();
-		MPlug opacityPlug( shaderNode.findPlug( "opacity" ) );
-		// Moritz: changed opacity from float to color in MEL
-		if ( MS::kSuccess == status )
-		{
-		  opacityPlug.child(0).getValue( rmOpacity[0] );
-		  opacityPlug.child(1).getValue( rmOpacity[1] );
-		  opacityPlug.child(2).getValue( rmOpacity[2] );
-		}
+		m_animatedColor = readColor( shaderNode );
     int volumeType = volume_type; 
     liquidGetPlugValue( shaderNode, "volumeType", volumeType, status );
     if ( MS::kSuccess == status ) volume_type = (VOLUME_TYPE)volumeType;
@@ -203,201 +213,376 @@ liqShader::liqShader( MObject shaderObj, bool outputAllParameters ) : liqGeneric
 		numArgs = shaderInfo.getNumParam();
 		for ( unsigned int i( 0 ) ; i < numArgs ; i++ )
 		{
-			MString paramName = shaderInfo.getArgName(i);
-			int arraySize = shaderInfo.getArgArraySize(i);
-			SHADER_TYPE shaderParameterType = shaderInfo.getArgType(i);
-			SHADER_DETAIL shaderDetail = shaderInfo.getArgDetail(i);
-			MString shaderAccept = shaderInfo.getArgAccept(i);
-			if ( shaderParameterType == SHADER_TYPE_STRING )
+			if ( readParameter( shaderNode, shaderInfo, i, outputAllParameters ) )
 			{
-				// check if a string must be used as a shader
-				if ( shaderAccept != "" )
-				{
-					shaderParameterType = SHADER_TYPE_SHADER;
-				}
+				m_tokenArgs.push_back( i );
+				// create next token
+				tokenPointerArray.push_back( liqTokenPointer() );
+			}
+			if ( isCoShaderParameter( shaderInfo, i ) )
+			{
+				m_coShaderArgs.push_back( i );
+			}
+			else if ( isAnimatedParameter( shaderNode, shaderInfo, i ) )
+			{
+				m_animatedArgs.push_back( i );
 			}
+		}
+		// handles the co-shaders had when their names went in our parameters
+		for ( unsigned int i = 0; i < m_coShaderArray.size(); i++ )
+		{
+			m_coShaderHandles.push_back( liqShaderFactory::instance().getShaderId( m_coShaderArray[i] ) );
+		}
+		// the shader description is needed again to re-read parameters
+		if ( !m_animatedArgs.empty() || !m_coShaderArgs.empty() )
+		{
+			m_shaderInfo = shaderInfoPtr;
+		}
+		setContentHandler();
+	}
+}
+
+
+/** Read RiColor and RiOpacity from the node.
+ *  Returns true if either is connected, and may change from frame to frame.
+ */
+bool liqShader::readColor( MFnDependencyNode &shaderNode )
+{
+	MStatus status;
+	bool connected = false;
+	MPlug colorPlug = shaderNode.findPlug( "color", &status );
+	if ( MS::kSuccess == status )
+	{
+		colorPlug.child(0).getValue( rmColor[0] );
+		colorPlug.child(1).getValue( rmColor[1] );
+		colorPlug.child(2).getValue( rmColor[2] );
+		connected = colorPlug.isConnected() || colorPlug.numConnectedChildren();
+	}
+
+	status.clear();
+	MPlug opacityPlug( shaderNode.findPlug( "opacity", &status ) );
+	// Moritz: changed opacity from float to color in MEL
+	if ( MS::kSuccess == status )
+	{
+		opacityPlug.child(0).getValue( rmOpacity[0] );
+		opacityPlug.child(1).getValue( rmOpacity[1] );
+		opacityPlug.child(2).getValue( rmOpacity[2] );
+		connected = connected || opacityPlug.isConnected() || opacityPlug.numConnectedChildren();
+	}
+	return connected;
+}
+
+
+/** Co-shader arguments hold co-shader handles : they are read again when
+ *  one of the co-shaders was rebuilt under another handle.
+ */
+bool liqShader::isCoShaderParameter( liqGetSloInfo &shaderInfo, unsigned int i )
+{
+	SHADER_TYPE type = shaderInfo.getArgType( i );
+	return !shaderInfo.isOutputParameter( i ) && 
+	       ( type == SHADER_TYPE_SHADER || ( type == SHADER_TYPE_STRING && shaderInfo.getArgAccept( i ) != "" ) );
+}
+
 
-			bool skipToken = false;
-			if ( paramName == "liquidShadingRate" )
+/** True if the argument value can change without the node being edited :
+ *  its plug is driven by a connection (animation curve, expression, other
+ *  node), or it is a string with frame tokens and the shader is evaluated
+ *  at every frame.
+ */
+bool liqShader::isAnimatedParameter( MFnDependencyNode &shaderNode, liqGetSloInfo &shaderInfo, unsigned int i )
+{
+	if ( shaderInfo.isOutputParameter( i ) )
+	{
+		return false;
+	}
+	MStatus status;
+	MPlug plug = shaderNode.findPlug( shaderInfo.getArgName( i ), &status );
+	if ( status != MS::kSuccess )
+	{
+		return false;
+	}
+	if ( plug.isConnected() || plug.numConnectedChildren() || plug.numConnectedElements() )
+	{
+		return true;
+	}
+	if ( evaluateAtEveryFrame && shaderInfo.getArgType( i ) == SHADER_TYPE_STRING )
+	{
+		// tokens parseString replaces
+		if ( plug.isArray() )
+		{
+			for ( unsigned int j = 0; j < plug.numElements(); j++ )
 			{
-				// BUGFIX: Monday 6th August - fixed shading rate bug where it only accepted the default value
-				MPlug floatPlug = shaderNode.findPlug( paramName, &status );
-				if ( MS::kSuccess == status )
+				if ( strpbrk( plug.elementByPhysicalIndex( j ).asString().asChar(), "$@#%" ) )
 				{
-					float floatPlugVal;
-					floatPlug.getValue( floatPlugVal );
-					shadingRate = floatPlugVal;
+					return true;
 				}
-				else
-					shadingRate = shaderInfo.getArgFloatDefault( i, 0 );
-				
-				hasShadingRate = true;
-				continue;
 			}
-			
-			if ( shaderInfo.isOutputParameter(i) && !outputAllParameters )   // throw output parameters
+		}
+		else if ( strpbrk( plug.asString().asChar(), "$@#%" ) )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/** Bring the parameters up to date for a new frame without reading the
+ *  whole node again : only the animated arguments are read, and the
+ *  co-shader ones if a co-shader handle changed. The other tokens are kept.
+ *  Returns true if the shader changed.
+ */
+bool liqShader::refreshParameters()
+{
+	if ( hasErrors )
+	{
+		return false;
+	}
+	MFnDependencyNode shaderNode( m_mObject );
+	bool changed = false;
+	if ( m_animatedColor )
+	{
+		readColor( shaderNode );
+		changed = true;
+	}
+
+	bool coShadersChanged = false;
+	for ( unsigned int i = 0; i < m_coShaderArray.size() && i < m_coShaderHandles.size(); i++ )
+	{
+		if ( liqShaderFactory::instance().getShaderId( m_coShaderArray[i] ) != m_coShaderHandles[i] )
+		{
+			coShadersChanged = true;
+			break;
+		}
+	}
+	if ( !m_shaderInfo || ( m_animatedArgs.empty() && !coShadersChanged ) )
+	{
+		return changed;
+	}
+
+	set< unsigned int > reread( m_animatedArgs.begin(), m_animatedArgs.end() );
+	if ( coShadersChanged )
+	{
+		reread.insert( m_coShaderArgs.begin(), m_coShaderArgs.end() );
+		m_coShaderArray.clear();
+	}
+
+	// rebuild the token list in argument order, keeping the static tokens
+	vector< liqTokenPointer > oldTokens;
+	vector< unsigned int > oldArgs;
+	oldTokens.swap( tokenPointerArray );
+	oldArgs.swap( m_tokenArgs );
+	tokenPointerArray.push_back( liqTokenPointer() );
+	unsigned int k = 0;
+	for ( set< unsigned int >::const_iterator arg = reread.begin(); ; ++arg )
+	{
+		unsigned int next = ( arg == reread.end() ) ? m_shaderInfo->getNumParam() : *arg;
+		for ( ; k < oldArgs.size() && oldArgs[k] <= next; k++ )
+		{
+			if ( !reread.count( oldArgs[k] ) )
 			{
-				continue;		
+				*tokenPointerArray.rbegin() = oldTokens[k];
+				m_tokenArgs.push_back( oldArgs[k] );
+				tokenPointerArray.push_back( liqTokenPointer() );
 			}
-			else if ( shaderInfo.isOutputParameter(i) && outputAllParameters )
+		}
+		if ( arg == reread.end() )
+		{
+			break;
+		}
+		if ( readParameter( shaderNode, *m_shaderInfo, *arg, m_outputAllParameters ) )
+		{
+			m_tokenArgs.push_back( *arg );
+			tokenPointerArray.push_back( liqTokenPointer() );
+		}
+	}
+
+	if ( coShadersChanged )
+	{
+		m_coShaderHandles.clear();
+		for ( unsigned int i = 0; i < m_coShaderArray.size(); i++ )
+		{
+			m_coShaderHandles.push_back( liqShaderFactory::instance().getShaderId( m_coShaderArray[i] ) );
+		}
+	}
+	// the packed arrays point into the old tokens
+	m_tokenArray.clear();
+	m_pointerArray.clear();
+	setContentHandler();
+	return true;
+}
+
+
+/** Read the value of a shader argument into the last token.
+ *  Returns false when it is not written : default value, output or
+ *  shading rate parameter, or an error.
+ */
+bool liqShader::readParameter( MFnDependencyNode &shaderNode, liqGetSloInfo &shaderInfo, unsigned int i, bool outputAllParameters )
+{
+	MStatus status;
+	MString paramName = shaderInfo.getArgName(i);
+	int arraySize = shaderInfo.getArgArraySize(i);
+	SHADER_TYPE shaderParameterType = shaderInfo.getArgType(i);
+	SHADER_DETAIL shaderDetail = shaderInfo.getArgDetail(i);
+	MString shaderAccept = shaderInfo.getArgAccept(i);
+	if ( shaderParameterType == SHADER_TYPE_STRING )
+	{
+		// check if a string must be used as a shader
+		if ( shaderAccept != "" )
+		{
+			shaderParameterType = SHADER_TYPE_SHADER;
+		}
+	}
+
+	bool skipToken = false;
+	if ( paramName == "liquidShadingRate" )
+	{
+		// BUGFIX: Monday 6th August - fixed shading rate bug where it only accepted the default value
+		MPlug floatPlug = shaderNode.findPlug( paramName, &status );
+		if ( MS::kSuccess == status )
+		{
+			float floatPlugVal;
+			floatPlug.getValue( floatPlugVal );
+			shadingRate = floatPlugVal;
+		}
+		else
+			shadingRate = shaderInfo.getArgFloatDefault( i, 0 );
+		
+		hasShadingRate = true;
+		return false;
+	}
+	
+	if ( shaderInfo.isOutputParameter(i) && !outputAllParameters )   // throw output parameters
+	{
+		return false;
+	}
+	else if ( shaderInfo.isOutputParameter(i) && outputAllParameters )
+	{
+		if( arraySize == -1 )    // single value
+		{
+			switch ( shaderParameterType )
 			{
-				if( arraySize == -1 )    // single value
+				case SHADER_TYPE_SHADER:
+				{
+					printf ( "[liqShader] warning cannot write output shader parameters yet. skip param %s on %s\n", paramName.asChar(), shaderNode.name().asChar() );
+					return false;
+				}
+				case SHADER_TYPE_STRING:
 				{
-					switch ( shaderParameterType )
+					ParameterType parameterType = rString;
+					MString s = shaderInfo.getArgStringDefault( i, 0 );
+					tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType );
+					tokenPointerArray.rbegin()->setTokenString( 0, s.asChar() );
+					break;
+				}
+				case SHADER_TYPE_SCALAR:
+				{
+					ParameterType parameterType = rFloat;
+					float x = shaderInfo.getArgFloatDefault( i, 0 );
+					tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType );
+					tokenPointerArray.rbegin()->setTokenFloat( 0, x );
+					break;
+				}
+				case SHADER_TYPE_COLOR:
+				case SHADER_TYPE_POINT:
+				case SHADER_TYPE_VECTOR:
+				case SHADER_TYPE_NORMAL:
+				{
+					ParameterType parameterType;
+					if ( shaderParameterType == SHADER_TYPE_COLOR )
 					{
-						case SHADER_TYPE_SHADER:
-						{
-							printf ( "[liqShader] warning cannot write output shader parameters yet. skip param %s on %s\n", paramName.asChar(), shaderNode.name().asChar() );
-							continue;
-						}
-						case SHADER_TYPE_STRING:
-						{
-							ParameterType parameterType = rString;
-							MString s = shaderInfo.getArgStringDefault( i, 0 );
-							tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType );
-							tokenPointerArray.rbegin()->setTokenString( 0, s.asChar() );
-							break;
-						}
-						case SHADER_TYPE_SCALAR:
-						{
-							ParameterType parameterType = rFloat;
-							float x = shaderInfo.getArgFloatDefault( i, 0 );
-							tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType );
-							tokenPointerArray.rbegin()->setTokenFloat( 0, x );
-							break;
-						}
-						case SHADER_TYPE_COLOR:
-						case SHADER_TYPE_POINT:
-						case SHADER_TYPE_VECTOR:
-						case SHADER_TYPE_NORMAL:
-						{
-							ParameterType parameterType;
-							if ( shaderParameterType == SHADER_TYPE_COLOR )
-							{
-								parameterType = rColor;
-							}
-							else if ( shaderParameterType == SHADER_TYPE_POINT )
-							{
-								parameterType = rPoint;
-							}
-							else if ( shaderParameterType == SHADER_TYPE_VECTOR )
-							{
-								parameterType = rVector;
-							}
-							else if ( shaderParameterType == SHADER_TYPE_NORMAL )
-							{
-								parameterType = rNormal;
-							}
-							float x = shaderInfo.getArgFloatDefault( i, 0 );
-							float y = shaderInfo.getArgFloatDefault( i, 1 );
-							float z = shaderInfo.getArgFloatDefault( i, 2 );
-							tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType );
-							tokenPointerArray.rbegin()->setTokenFloat( 0, x, y, z );
-							break;
-						}
-						case SHADER_TYPE_MATRIX:
-						{
-							printf ( "[liqShader] warning cannot write output matrix parameters yet. skip param %s on %s\n", paramName.asChar(), shaderNode.name().asChar() );
-							continue;
-						}
-						default:
-						{
-							printf ( "[liqShader] warning unhandled parameters type. skip param %s on %s\n", paramName.asChar(), shaderNode.name().asChar() );
-							continue;
-						}
+						parameterType = rColor;
 					}
+					else if ( shaderParameterType == SHADER_TYPE_POINT )
+					{
+						parameterType = rPoint;
+					}
+					else if ( shaderParameterType == SHADER_TYPE_VECTOR )
+					{
+						parameterType = rVector;
+					}
+					else if ( shaderParameterType == SHADER_TYPE_NORMAL )
+					{
+						parameterType = rNormal;
+					}
+					float x = shaderInfo.getArgFloatDefault( i, 0 );
+					float y = shaderInfo.getArgFloatDefault( i, 1 );
+					float z = shaderInfo.getArgFloatDefault( i, 2 );
+					tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType );
+					tokenPointerArray.rbegin()->setTokenFloat( 0, x, y, z );
+					break;
 				}
-				else
+				case SHADER_TYPE_MATRIX:
+				{
+					printf ( "[liqShader] warning cannot write output matrix parameters yet. skip param %s on %s\n", paramName.asChar(), shaderNode.name().asChar() );
+					return false;
+				}
+				default:
 				{
-					printf ( "[liqShader] warning cannot write output array parameters yet. skip param %s on %s\n", paramName.asChar(), shaderNode.name().asChar() );
-					continue;
+					printf ( "[liqShader] warning unhandled parameters type. skip param %s on %s\n", paramName.asChar(), shaderNode.name().asChar() );
+					return false;
 				}
 			}
-			else
+		}
+		else
+		{
+			printf ( "[liqShader] warning cannot write output array parameters yet. skip param %s on %s\n", paramName.asChar(), shaderNode.name().asChar() );
+			return false;
+		}
+	}
+	else
+	{
+		switch ( shaderParameterType )
+		{
+			case SHADER_TYPE_SHADER:
 			{
-				switch ( shaderParameterType )
-				{
-					case SHADER_TYPE_SHADER:
-					{
-						ParameterType parameterType = rString;  // rShader
+				ParameterType parameterType = rString;  // rShader
 
-						MPlug coShaderPlug = shaderNode.findPlug( paramName, &status );
+				MPlug coShaderPlug = shaderNode.findPlug( paramName, &status );
 
-						if ( status != MS::kSuccess )
+				if ( status != MS::kSuccess )
+				{
+					skipToken = true;
+					printf ( "[liqShader] error while building shader param %s on %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
+				}
+				else
+				{
+					if ( arraySize == 0 )    // dynamic array
+					{
+						MIntArray indices;
+						coShaderPlug.getExistingArrayAttributeIndices(indices);
+						if( indices.length() == 0 )
 						{
 							skipToken = true;
-							printf ( "[liqShader] error while building shader param %s on %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
 						}
 						else
 						{
-							if ( arraySize == 0 )    // dynamic array
+							int maxIndex = 0;
+							for ( unsigned int kk( 0 ); kk<indices.length() ; kk++ )
 							{
-								MIntArray indices;
-								coShaderPlug.getExistingArrayAttributeIndices(indices);
-								if( indices.length() == 0 )
+								if ( indices[kk] > maxIndex )
 								{
-									skipToken = true;
+									maxIndex = indices[kk];
 								}
-								else
+							}
+							arraySize = maxIndex + 1;								
+							tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType, arraySize );
+							for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+							{
+								bool existingIndex = false;
+								for (unsigned int kkk( 0 ); kkk<indices.length(); kkk++)
 								{
-									int maxIndex = 0;
-									for ( unsigned int kk( 0 ); kk<indices.length() ; kk++ )
-									{
-										if ( indices[kk] > maxIndex )
-										{
-											maxIndex = indices[kk];
-										}
-									}
-									arraySize = maxIndex + 1;								
-									tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType, arraySize );
-									for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+									if ( kk == indices[kkk] )
 									{
-										bool existingIndex = false;
-										for (unsigned int kkk( 0 ); kkk<indices.length(); kkk++)
-										{
-											if ( kk == indices[kkk] )
-											{
-												existingIndex = true;
-												continue;
-											}
-										}
-										if ( existingIndex )  // get plug value
-										{
-											MPlug argNameElement = coShaderPlug.elementByLogicalIndex(kk);
-											MString coShaderHandler;
-											
-											if ( argNameElement.isConnected() )
-											{
-												bool asSrc = 0;
-												bool asDst = 1;
-												MPlugArray connectedPlugArray;
-												argNameElement.connectedTo( connectedPlugArray, asDst, asSrc );
-												
-												MObject coshader = connectedPlugArray[0].node();
-												appendCoShader(coshader, connectedPlugArray[0]);
-												coShaderHandler = liqShaderFactory::instance().getShaderId(coshader);
-											}
-											else
-											{
-												coShaderHandler = "";
-											}									
-											tokenPointerArray.rbegin()->setTokenString( kk, coShaderHandler.asChar() );
-										}
-										else  // don't mind about value
-										{
-											tokenPointerArray.rbegin()->setTokenString( kk, "" );
-										}
+										existingIndex = true;
+										continue;
 									}
 								}
-							}
-							else if ( arraySize > 0 )    // static array
-							{
-								vector<MString> coShaderHandlers;
-
-								for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+								if ( existingIndex )  // get plug value
 								{
 									MPlug argNameElement = coShaderPlug.elementByLogicalIndex(kk);
 									MString coShaderHandler;
+									
 									if ( argNameElement.isConnected() )
 									{
 										bool asSrc = 0;
@@ -412,598 +597,546 @@ liqShader::liqShader( MObject shaderObj, bool outputAllParameters ) : liqGeneric
 									else
 									{
 										coShaderHandler = "";
-									}
-									coShaderHandlers.push_back(coShaderHandler);
+									}									
+									tokenPointerArray.rbegin()->setTokenString( kk, coShaderHandler.asChar() );
 								}
-								
-								int isDefault = 1;
-								for( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+								else  // don't mind about value
 								{
-									if ( coShaderHandlers[kk] != "" )
-									{
-										isDefault = 0;
-										continue;
-									}
-								}
-								if ( isDefault && !outputAllParameters )  // skip default
-								{
-									skipToken = true;
-								}
-								else  // build non default param
-								{
-									tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType, arraySize );
-									for( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
-									{
-										tokenPointerArray.rbegin()->setTokenString( kk, coShaderHandlers[kk].asChar() );
-									}
+									tokenPointerArray.rbegin()->setTokenString( kk, "" );
 								}
 							}
-							else if ( arraySize == -1 )    // single value
+						}
+					}
+					else if ( arraySize > 0 )    // static array
+					{
+						vector<MString> coShaderHandlers;
+
+						for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+						{
+							MPlug argNameElement = coShaderPlug.elementByLogicalIndex(kk);
+							MString coShaderHandler;
+							if ( argNameElement.isConnected() )
 							{
-								MPlugArray connectionArray;
 								bool asSrc = 0;
 								bool asDst = 1;
-								coShaderPlug.connectedTo(connectionArray, asDst, asSrc);
-								if ( connectionArray.length() == 0 )
-								{
-									skipToken = true;
-								}
-								else
-								{
-									MPlug connectedPlug = connectionArray[0];
-									MObject coshader = connectedPlug.node();
-									appendCoShader(coshader, coShaderPlug);
-									MString coShaderId = liqShaderFactory::instance().getShaderId(coshader);
-									if ( coShaderId == "" )
-									{
-										skipToken = true;
-									}
-									else
-									{
-										tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType );
-										tokenPointerArray.rbegin()->setTokenString( 0, coShaderId.asChar() );
-									}
-								}
+								MPlugArray connectedPlugArray;
+								argNameElement.connectedTo( connectedPlugArray, asDst, asSrc );
+								
+								MObject coshader = connectedPlugArray[0].node();
+								appendCoShader(coshader, connectedPlugArray[0]);
+								coShaderHandler = liqShaderFactory::instance().getShaderId(coshader);
+							}
+							else
+							{
+								coShaderHandler = "";
+							}
+							coShaderHandlers.push_back(coShaderHandler);
+						}
+						
+						int isDefault = 1;
+						for( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+						{
+							if ( coShaderHandlers[kk] != "" )
+							{
+								isDefault = 0;
+								continue;
 							}
-							else    // unknown type
+						}
+						if ( isDefault && !outputAllParameters )  // skip default
+						{
+							skipToken = true;
+						}
+						else  // build non default param
+						{
+							tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType, arraySize );
+							for( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+							{
+								tokenPointerArray.rbegin()->setTokenString( kk, coShaderHandlers[kk].asChar() );
+							}
+						}
+					}
+					else if ( arraySize == -1 )    // single value
+					{
+						MPlugArray connectionArray;
+						bool asSrc = 0;
+						bool asDst = 1;
+						coShaderPlug.connectedTo(connectionArray, asDst, asSrc);
+						if ( connectionArray.length() == 0 )
+						{
+							skipToken = true;
+						}
+						else
+						{
+							MPlug connectedPlug = connectionArray[0];
+							MObject coshader = connectedPlug.node();
+							appendCoShader(coshader, coShaderPlug);
+							MString coShaderId = liqShaderFactory::instance().getShaderId(coshader);
+							if ( coShaderId == "" )
 							{
 								skipToken = true;
-								printf("[liqShader] error while building shader param %s on %s : undefined array size %d \n", paramName.asChar(), shaderNode.name().asChar(), arraySize );
+							}
+							else
+							{
+								tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType );
+								tokenPointerArray.rbegin()->setTokenString( 0, coShaderId.asChar() );
 							}
 						}
-						break;
 					}
-					case SHADER_TYPE_STRING:
+					else    // unknown type
 					{
-						MPlug stringPlug = shaderNode.findPlug( paramName, &status );
-						if ( status != MS::kSuccess )
+						skipToken = true;
+						printf("[liqShader] error while building shader param %s on %s : undefined array size %d \n", paramName.asChar(), shaderNode.name().asChar(), arraySize );
+					}
+				}
+				break;
+			}
+			case SHADER_TYPE_STRING:
+			{
+				MPlug stringPlug = shaderNode.findPlug( paramName, &status );
+				if ( status != MS::kSuccess )
+				{
+					skipToken = true;
+					printf("[liqShader] error while building string param %s on %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
+				}
+				else
+				{
+					if ( arraySize == 0 )    // dynamic array
+					{
+						MIntArray indices;
+						stringPlug.getExistingArrayAttributeIndices(indices);
+						if ( indices.length() == 0 )
 						{
 							skipToken = true;
-							printf("[liqShader] error while building string param %s on %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
 						}
 						else
 						{
-							if ( arraySize == 0 )    // dynamic array
+							int maxIndex = 0;
+							for ( unsigned int kk( 0 ); kk < indices.length(); kk++ )
 							{
-								MIntArray indices;
-								stringPlug.getExistingArrayAttributeIndices(indices);
-								if ( indices.length() == 0 )
+								if( indices[kk]>maxIndex )
 								{
-									skipToken = true;
-								}
-								else
-								{
-									int maxIndex = 0;
-									for ( unsigned int kk( 0 ); kk < indices.length(); kk++ )
-									{
-										if( indices[kk]>maxIndex )
-										{
-											maxIndex = indices[kk];
-										}
-									}
-									arraySize = maxIndex + 1;
-
-									tokenPointerArray.rbegin()->set( paramName.asChar(), rString, arraySize );
-									for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
-									{
-										bool existingIndex = false;
-										for ( unsigned int kkk( 0 ) ; kkk < indices.length() ; kkk++ )
-										{
-											if ( kk == indices[kkk] )
-											{
-												existingIndex = true;
-												continue;
-											}
-										}
-										if ( existingIndex )  // get plug value
-										{
-											MPlug argNameElement = stringPlug.elementByLogicalIndex(kk);
-											MString stringPlugVal;
-											argNameElement.getValue( stringPlugVal );
-											MString stringVal = parseString( stringPlugVal );
-											tokenPointerArray.rbegin()->setTokenString( kk, stringVal.asChar() );
-										}
-										else  // don't mind about value
-										{
-											tokenPointerArray.rbegin()->setTokenString( kk, "" );
-										}
-									}
+									maxIndex = indices[kk];
 								}
 							}
-							else if ( arraySize > 0 )    // static array
+							arraySize = maxIndex + 1;
+
+							tokenPointerArray.rbegin()->set( paramName.asChar(), rString, arraySize );
+							for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
 							{
-								bool isArrayAttr( stringPlug.isArray( &status ) );
-								if ( isArrayAttr )
+								bool existingIndex = false;
+								for ( unsigned int kkk( 0 ) ; kkk < indices.length() ; kkk++ )
 								{
-									MPlug plugObj;
-									// check default
-									int isDefault = 1;
-									for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
-									{
-										plugObj = stringPlug.elementByLogicalIndex( kk, &status );
-										MString stringDefault( shaderInfo.getArgStringDefault( i, kk ) );
-										if ( plugObj.asString() != stringDefault )
-										{
-											isDefault = 0;
-											continue;
-										}
-									}
-									if ( isDefault && !outputAllParameters )  // skip default
+									if ( kk == indices[kkk] )
 									{
-										skipToken = true;
-									}
-									else  // build non default param
-									{
-										tokenPointerArray.rbegin()->set( paramName.asChar(), rString, arraySize );
-										for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
-										{
-											plugObj = stringPlug.elementByLogicalIndex( kk, &status );
-											if ( MS::kSuccess == status )
-											{
-												MString stringPlugVal;
-												plugObj.getValue( stringPlugVal );
-												MString stringVal = parseString( stringPlugVal );
-												tokenPointerArray.rbegin()->setTokenString( kk, stringVal.asChar() );
-											}
-											else
-											{
-												printf("[liqShader] error while building param %d : %s \n", kk, stringPlug.name().asChar() );
-											}
-										}
+										existingIndex = true;
+										continue;
 									}
 								}
-								else
+								if ( existingIndex )  // get plug value
 								{
-									printf("[liqShader] error while building string param %s assumed as an array but wasn't...\n", stringPlug.name().asChar() );
+									MPlug argNameElement = stringPlug.elementByLogicalIndex(kk);
+									MString stringPlugVal;
+									argNameElement.getValue( stringPlugVal );
+									MString stringVal = parseString( stringPlugVal );
+									tokenPointerArray.rbegin()->setTokenString( kk, stringVal.asChar() );
 								}
-							}
-							else if ( arraySize == -1 )    // single value
-							{
-								MString stringPlugVal;
-								stringPlug.getValue( stringPlugVal );
-								MString stringDefault( shaderInfo.getArgStringDefault( i, 0 ) );
-								if ( stringPlugVal == stringDefault && !outputAllParameters )  // skip default
+								else  // don't mind about value
 								{
-									skipToken = true;
+									tokenPointerArray.rbegin()->setTokenString( kk, "" );
 								}
-								else  // build non default param
+							}
+						}
+					}
+					else if ( arraySize > 0 )    // static array
+					{
+						bool isArrayAttr( stringPlug.isArray( &status ) );
+						if ( isArrayAttr )
+						{
+							MPlug plugObj;
+							// check default
+							int isDefault = 1;
+							for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
+							{
+								plugObj = stringPlug.elementByLogicalIndex( kk, &status );
+								MString stringDefault( shaderInfo.getArgStringDefault( i, kk ) );
+								if ( plugObj.asString() != stringDefault )
 								{
-									MString stringVal( parseString( stringPlugVal ) );
-									LIQDEBUGPRINTF("[liqShader::liqShader] parsed string for param %s = %s \n", paramName.asChar(), stringVal.asChar() );
-									tokenPointerArray.rbegin()->set( paramName.asChar(), rString );
-									tokenPointerArray.rbegin()->setTokenString( 0, stringVal.asChar() );
+									isDefault = 0;
+									continue;
 								}
 							}
-							else    // unknown type
+							if ( isDefault && !outputAllParameters )  // skip default
 							{
 								skipToken = true;
-								printf("[liqShader] error while building string param %s on %s : undefined array size %d \n", paramName.asChar(), shaderNode.name().asChar(), arraySize );
 							}
+							else  // build non default param
+							{
+								tokenPointerArray.rbegin()->set( paramName.asChar(), rString, arraySize );
+								for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
+								{
+									plugObj = stringPlug.elementByLogicalIndex( kk, &status );
+									if ( MS::kSuccess == status )
+									{
+										MString stringPlugVal;
+										plugObj.getValue( stringPlugVal );
+										MString stringVal = parseString( stringPlugVal );
+										tokenPointerArray.rbegin()->setTokenString( kk, stringVal.asChar() );
+									}
+									else
+									{
+										printf("[liqShader] error while building param %d : %s \n", kk, stringPlug.name().asChar() );
+									}
+								}
+							}
+						}
+						else
+						{
+							printf("[liqShader] error while building string param %s assumed as an array but wasn't...\n", stringPlug.name().asChar() );
 						}
-						break;
 					}
-					case SHADER_TYPE_SCALAR:
+					else if ( arraySize == -1 )    // single value
 					{
-						MPlug floatPlug( shaderNode.findPlug( paramName, &status ) );
-						if ( status != MS::kSuccess )
+						MString stringPlugVal;
+						stringPlug.getValue( stringPlugVal );
+						MString stringDefault( shaderInfo.getArgStringDefault( i, 0 ) );
+						if ( stringPlugVal == stringDefault && !outputAllParameters )  // skip default
+						{
+							skipToken = true;
+						}
+						else  // build non default param
+						{
+							MString stringVal( parseString( stringPlugVal ) );
+							LIQDEBUGPRINTF("[liqShader::liqShader] parsed string for param %s = %s \n", paramName.asChar(), stringVal.asChar() );
+							tokenPointerArray.rbegin()->set( paramName.asChar(), rString );
+							tokenPointerArray.rbegin()->setTokenString( 0, stringVal.asChar() );
+						}
+					}
+					else    // unknown type
+					{
+						skipToken = true;
+						printf("[liqShader] error while building string param %s on %s : undefined array size %d \n", paramName.asChar(), shaderNode.name().asChar(), arraySize );
+					}
+				}
+				break;
+			}
+			case SHADER_TYPE_SCALAR:
+			{
+				MPlug floatPlug( shaderNode.findPlug( paramName, &status ) );
+				if ( status != MS::kSuccess )
+				{
+					skipToken = true;
+					printf("[liqShader] error while building float param %s on %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
+				}
+				else
+				{
+					if ( arraySize == 0 )    // dynamic array
+					{
+						MIntArray indices;
+						floatPlug.getExistingArrayAttributeIndices(indices);
+						if ( indices.length() == 0 )
 						{
 							skipToken = true;
-							printf("[liqShader] error while building float param %s on %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
 						}
 						else
 						{
-							if ( arraySize == 0 )    // dynamic array
+							int maxIndex = 0;
+							for ( unsigned int kk( 0 ) ; kk<indices.length() ; kk++ )
 							{
-								MIntArray indices;
-								floatPlug.getExistingArrayAttributeIndices(indices);
-								if ( indices.length() == 0 )
+								if ( indices[kk]>maxIndex )
 								{
-									skipToken = true;
-								}
-								else
-								{
-									int maxIndex = 0;
-									for ( unsigned int kk( 0 ) ; kk<indices.length() ; kk++ )
-									{
-										if ( indices[kk]>maxIndex )
-										{
-											maxIndex = indices[kk];
-										}
-									}
-									arraySize = maxIndex + 1;
-
-									tokenPointerArray.rbegin()->set( paramName.asChar(), rFloat, false, true, arraySize );
-									for ( unsigned int kk( 0  ); kk < (unsigned int)arraySize ; kk++ )
-									{
-										bool existingIndex = false;
-										for ( unsigned int kkk( 0 ) ; kkk<indices.length() ; kkk++ )
-										{
-											if ( kk == indices[kkk] )
-											{
-												existingIndex = true;
-												continue;
-											}
-										}
-										if ( existingIndex )  // get plug value
-										{
-											MPlug argNameElement = floatPlug.elementByLogicalIndex(kk);
-											float value = argNameElement.asFloat();
-											tokenPointerArray.rbegin()->setTokenFloat( kk, value );
-										}
-										else  // don't mind about value
-										{
-											tokenPointerArray.rbegin()->setTokenFloat( kk, 0 );
-										}
-									}
+									maxIndex = indices[kk];
 								}
 							}
-							else if ( arraySize > 0 )    // static array
+							arraySize = maxIndex + 1;
+
+							tokenPointerArray.rbegin()->set( paramName.asChar(), rFloat, false, true, arraySize );
+							for ( unsigned int kk( 0  ); kk < (unsigned int)arraySize ; kk++ )
 							{
-								bool isArrayAttr( floatPlug.isArray( &status ) );
-								if ( isArrayAttr )
+								bool existingIndex = false;
+								for ( unsigned int kkk( 0 ) ; kkk<indices.length() ; kkk++ )
 								{
-									MPlug plugObj;
-									// check default
-									int isDefault = 1;
-									for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
+									if ( kk == indices[kkk] )
 									{
-										plugObj = floatPlug.elementByLogicalIndex( kk, &status );
-										float floatDefault = shaderInfo.getArgFloatDefault( i, kk );
-										if ( plugObj.asFloat() != floatDefault )
-										{
-											isDefault = 0;
-											continue;
-										}
-									}
-									if ( isDefault && !outputAllParameters ) // skip default
-									{
-										skipToken = true;
-									}
-									else  // build non default param
-									{
-										tokenPointerArray.rbegin()->set( paramName.asChar(), rFloat, false, true, arraySize );
-										for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
-										{
-											plugObj = floatPlug.elementByLogicalIndex( kk, &status );
-											if ( MS::kSuccess == status )
-											{
-												float x;
-												plugObj.getValue( x );
-												tokenPointerArray.rbegin()->setTokenFloat( kk, x );
-											}
-										}
+										existingIndex = true;
+										continue;
 									}
 								}
-							}
-							else if ( arraySize == -1 )    // single value
-							{
-								float floatPlugVal;
-								floatPlug.getValue( floatPlugVal );
-								float floatDefault( shaderInfo.getArgFloatDefault( i, 0 ) );
-								if ( floatPlugVal == floatDefault && !outputAllParameters )  // skip default
+								if ( existingIndex )  // get plug value
+								{
+									MPlug argNameElement = floatPlug.elementByLogicalIndex(kk);
+									float value = argNameElement.asFloat();
+									tokenPointerArray.rbegin()->setTokenFloat( kk, value );
+								}
+								else  // don't mind about value
 								{
-									skipToken = true;
+									tokenPointerArray.rbegin()->setTokenFloat( kk, 0 );
 								}
-								else  // build non default param
+							}
+						}
+					}
+					else if ( arraySize > 0 )    // static array
+					{
+						bool isArrayAttr( floatPlug.isArray( &status ) );
+						if ( isArrayAttr )
+						{
+							MPlug plugObj;
+							// check default
+							int isDefault = 1;
+							for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
+							{
+								plugObj = floatPlug.elementByLogicalIndex( kk, &status );
+								float floatDefault = shaderInfo.getArgFloatDefault( i, kk );
+								if ( plugObj.asFloat() != floatDefault )
 								{
-									tokenPointerArray.rbegin()->set( paramName.asChar(), rFloat );
-									tokenPointerArray.rbegin()->setTokenFloat( 0, floatPlugVal );
+									isDefault = 0;
+									continue;
 								}
 							}
-							else    // unknown type
+							if ( isDefault && !outputAllParameters ) // skip default
 							{
 								skipToken = true;
-								printf("[liqShader] error while building float param %s on %s : undefined array size %d \n", paramName.asChar(), shaderNode.name().asChar(), arraySize );
+							}
+							else  // build non default param
+							{
+								tokenPointerArray.rbegin()->set( paramName.asChar(), rFloat, false, true, arraySize );
+								for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
+								{
+									plugObj = floatPlug.elementByLogicalIndex( kk, &status );
+									if ( MS::kSuccess == status )
+									{
+										float x;
+										plugObj.getValue( x );
+										tokenPointerArray.rbegin()->setTokenFloat( kk, x );
+									}
+								}
 							}
 						}
-						break;
 					}
-					case SHADER_TYPE_COLOR:
-					case SHADER_TYPE_POINT:
-					case SHADER_TYPE_VECTOR:
-					case SHADER_TYPE_NORMAL:
+					else if ( arraySize == -1 )    // single value
 					{
-						ParameterType parameterType;
-						if ( shaderParameterType == SHADER_TYPE_COLOR )
-						{
-							parameterType = rColor;
-						}
-						else if (shaderParameterType == SHADER_TYPE_POINT)
-						{
-							parameterType = rPoint;
-						}
-						else if (shaderParameterType == SHADER_TYPE_VECTOR)
+						float floatPlugVal;
+						floatPlug.getValue( floatPlugVal );
+						float floatDefault( shaderInfo.getArgFloatDefault( i, 0 ) );
+						if ( floatPlugVal == floatDefault && !outputAllParameters )  // skip default
 						{
-							parameterType = rVector;
+							skipToken = true;
 						}
-						else if (shaderParameterType == SHADER_TYPE_NORMAL)
+						else  // build non default param
 						{
-							parameterType = rNormal;
+							tokenPointerArray.rbegin()->set( paramName.asChar(), rFloat );
+							tokenPointerArray.rbegin()->setTokenFloat( 0, floatPlugVal );
 						}
-						MPlug triplePlug( shaderNode.findPlug( paramName, true, &status ) );
-						if ( status != MS::kSuccess )
+					}
+					else    // unknown type
+					{
+						skipToken = true;
+						printf("[liqShader] error while building float param %s on %s : undefined array size %d \n", paramName.asChar(), shaderNode.name().asChar(), arraySize );
+					}
+				}
+				break;
+			}
+			case SHADER_TYPE_COLOR:
+			case SHADER_TYPE_POINT:
+			case SHADER_TYPE_VECTOR:
+			case SHADER_TYPE_NORMAL:
+			{
+				ParameterType parameterType;
+				if ( shaderParameterType == SHADER_TYPE_COLOR )
+				{
+					parameterType = rColor;
+				}
+				else if (shaderParameterType == SHADER_TYPE_POINT)
+				{
+					parameterType = rPoint;
+				}
+				else if (shaderParameterType == SHADER_TYPE_VECTOR)
+				{
+					parameterType = rVector;
+				}
+				else if (shaderParameterType == SHADER_TYPE_NORMAL)
+				{
+					parameterType = rNormal;
+				}
+				MPlug triplePlug( shaderNode.findPlug( paramName, true, &status ) );
+				if ( status != MS::kSuccess )
+				{
+					skipToken = true;
+					printf("[liqShader] error while building float[3] param %s on %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
+				}
+				else
+				{
+					if ( arraySize == 0 )    // dynamic array
+					{
+						MIntArray indices;
+						triplePlug.getExistingArrayAttributeIndices(indices);
+						if ( indices.length() == 0 )
 						{
 							skipToken = true;
-							printf("[liqShader] error while building float[3] param %s on %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
 						}
 						else
 						{
-							if ( arraySize == 0 )    // dynamic array
+							int maxIndex = 0;
+							for ( unsigned int kk( 0 ) ; kk<indices.length( ); kk++ )
 							{
-								MIntArray indices;
-								triplePlug.getExistingArrayAttributeIndices(indices);
-								if ( indices.length() == 0 )
+								if ( indices[kk]>maxIndex )
 								{
-									skipToken = true;
+									maxIndex = indices[kk];
 								}
-								else
-								{
-									int maxIndex = 0;
-									for ( unsigned int kk( 0 ) ; kk<indices.length( ); kk++ )
-									{
-										if ( indices[kk]>maxIndex )
-										{
-											maxIndex = indices[kk];
-										}
-									}
-									arraySize = maxIndex + 1;
+							}
+							arraySize = maxIndex + 1;
 
-									tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType, false, true, arraySize );
-									for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
+							tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType, false, true, arraySize );
+							for ( unsigned int kk( 0 ) ; kk < (unsigned int)arraySize ; kk++ )
+							{
+								bool existingIndex = false;
+								for ( unsigned int kkk( 0 ) ; kkk<indices.length() ; kkk++ )
+								{
+									if ( kk == indices[kkk] )
 									{
-										bool existingIndex = false;
-										for ( unsigned int kkk( 0 ) ; kkk<indices.length() ; kkk++ )
-										{
-											if ( kk == indices[kkk] )
-											{
-												existingIndex = true;
-												continue;
-											}
-										}
-										if ( existingIndex )  // get plug value
-										{
-											MPlug argNameElement = triplePlug.elementByLogicalIndex(kk);
-											float x, y, z;
-											argNameElement.child( 0 ).getValue( x );
-											argNameElement.child( 1 ).getValue( y );
-											argNameElement.child( 2 ).getValue( z );
-											tokenPointerArray.rbegin()->setTokenFloat( kk, x, y, z );
-										}
-										else  // don't mind about value
-										{
-											tokenPointerArray.rbegin()->setTokenFloat( kk, 0, 0, 0 );
-										}
+										existingIndex = true;
+										continue;
 									}
 								}
-							}
-							else if ( arraySize > 0 )    // static array
-							{
-								// check default
-								int isDefault = 1;
-								for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+								if ( existingIndex )  // get plug value
 								{
-									MPlug argNameElement( triplePlug.elementByLogicalIndex( kk ) );
+									MPlug argNameElement = triplePlug.elementByLogicalIndex(kk);
 									float x, y, z;
 									argNameElement.child( 0 ).getValue( x );
 									argNameElement.child( 1 ).getValue( y );
 									argNameElement.child( 2 ).getValue( z );
-									float xDefault, yDefault, zDefault;
-									xDefault = shaderInfo.getArgFloatDefault(i, (kk*3)+0);
-									yDefault = shaderInfo.getArgFloatDefault(i, (kk*3)+1);
-									zDefault = shaderInfo.getArgFloatDefault(i, (kk*3)+2);
-									if ( x!=xDefault || y!=yDefault || z!=zDefault )
-									{
-										isDefault = 0;
-										continue;
-									}
-								}
-								if ( isDefault && !outputAllParameters ) // skip default
-								{
-									skipToken = true;
+									tokenPointerArray.rbegin()->setTokenFloat( kk, x, y, z );
 								}
-								else  // build non default param
+								else  // don't mind about value
 								{
-									tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType, false, true, arraySize );
-									for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
-									{
-										MPlug argNameElement( triplePlug.elementByLogicalIndex( kk ) );
-										float x, y, z;
-										argNameElement.child( 0 ).getValue( x );
-										argNameElement.child( 1 ).getValue( y );
-										argNameElement.child( 2 ).getValue( z );
-										tokenPointerArray.rbegin()->setTokenFloat( kk, x, y, z );
-									}
+									tokenPointerArray.rbegin()->setTokenFloat( kk, 0, 0, 0 );
 								}
 							}
-							else if ( arraySize == -1 )     // single value
+						}
+					}
+					else if ( arraySize > 0 )    // static array
+					{
+						// check default
+						int isDefault = 1;
+						for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+						{
+							MPlug argNameElement( triplePlug.elementByLogicalIndex( kk ) );
+							float x, y, z;
+							argNameElement.child( 0 ).getValue( x );
+							argNameElement.child( 1 ).getValue( y );
+							argNameElement.child( 2 ).getValue( z );
+							float xDefault, yDefault, zDefault;
+							xDefault = shaderInfo.getArgFloatDefault(i, (kk*3)+0);
+							yDefault = shaderInfo.getArgFloatDefault(i, (kk*3)+1);
+							zDefault = shaderInfo.getArgFloatDefault(i, (kk*3)+2);
+							if ( x!=xDefault || y!=yDefault || z!=zDefault )
 							{
-								// check default
-								float x, y, z;
-								triplePlug.child( 0 ).getValue( x );
-								triplePlug.child( 1 ).getValue( y );
-								triplePlug.child( 2 ).getValue( z );
-								float xDefault, yDefault, zDefault;
-								xDefault = shaderInfo.getArgFloatDefault(i, 0);
-								yDefault = shaderInfo.getArgFloatDefault(i, 1);
-								zDefault = shaderInfo.getArgFloatDefault(i, 2);
-
-								if ( ( x == xDefault && y == yDefault && z == zDefault) && !outputAllParameters ) // skip default
-								{
-									skipToken = true;
-								}
-								else  // build non default param
-								{
-									tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType );
-									tokenPointerArray.rbegin()->setTokenFloat( 0, x, y, z );
-								}
+								isDefault = 0;
+								continue;
 							}
-							else    // unknown type
+						}
+						if ( isDefault && !outputAllParameters ) // skip default
+						{
+							skipToken = true;
+						}
+						else  // build non default param
+						{
+							tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType, false, true, arraySize );
+							for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
 							{
-								skipToken = true;
-								printf ( "[liqShader] error while building float[3] param %s on %s : undefined array size %d \n", paramName.asChar(), shaderNode.name().asChar(), arraySize );
+								MPlug argNameElement( triplePlug.elementByLogicalIndex( kk ) );
+								float x, y, z;
+								argNameElement.child( 0 ).getValue( x );
+								argNameElement.child( 1 ).getValue( y );
+								argNameElement.child( 2 ).getValue( z );
+								tokenPointerArray.rbegin()->setTokenFloat( kk, x, y, z );
 							}
 						}
-						break;
 					}
-					case SHADER_TYPE_MATRIX:
+					else if ( arraySize == -1 )     // single value
+					{
+						// check default
+						float x, y, z;
+						triplePlug.child( 0 ).getValue( x );
+						triplePlug.child( 1 ).getValue( y );
+						triplePlug.child( 2 ).getValue( z );
+						float xDefault, yDefault, zDefault;
+						xDefault = shaderInfo.getArgFloatDefault(i, 0);
+						yDefault = shaderInfo.getArgFloatDefault(i, 1);
+						zDefault = shaderInfo.getArgFloatDefault(i, 2);
+
+						if ( ( x == xDefault && y == yDefault && z == zDefault) && !outputAllParameters ) // skip default
+						{
+							skipToken = true;
+						}
+						else  // build non default param
+						{
+							tokenPointerArray.rbegin()->set( paramName.asChar(), parameterType );
+							tokenPointerArray.rbegin()->setTokenFloat( 0, x, y, z );
+						}
+					}
+					else    // unknown type
+					{
+						skipToken = true;
+						printf ( "[liqShader] error while building float[3] param %s on %s : undefined array size %d \n", paramName.asChar(), shaderNode.name().asChar(), arraySize );
+					}
+				}
+				break;
+			}
+			case SHADER_TYPE_MATRIX:
+			{
+				MPlug matrixPlug( shaderNode.findPlug( paramName, &status ) );
+				if ( MS::kSuccess != status )
+				{
+					skipToken = true;
+					printf ( "[liqShader] error while building float[16] param %s on %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
+				}
+				else
+				{
+					if ( arraySize == 0 )    // dynamic array
 					{
-						MPlug matrixPlug( shaderNode.findPlug( paramName, &status ) );
-						if ( MS::kSuccess != status )
+						MIntArray indices;
+						matrixPlug.getExistingArrayAttributeIndices(indices);
+						if ( indices.length() == 0 )
 						{
 							skipToken = true;
-							printf ( "[liqShader] error while building float[16] param %s on %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
 						}
 						else
 						{
-							if ( arraySize == 0 )    // dynamic array
+							int maxIndex = 0;
+							for ( unsigned int kk( 0 ); kk < indices.length(); kk++ )
 							{
-								MIntArray indices;
-								matrixPlug.getExistingArrayAttributeIndices(indices);
-								if ( indices.length() == 0 )
+								if ( indices[kk] > maxIndex )
 								{
-									skipToken = true;
+									maxIndex = indices[kk];
 								}
-								else
-								{
-									int maxIndex = 0;
-									for ( unsigned int kk( 0 ); kk < indices.length(); kk++ )
-									{
-										if ( indices[kk] > maxIndex )
-										{
-											maxIndex = indices[kk];
-										}
-									}
-									arraySize = maxIndex + 1;
+							}
+							arraySize = maxIndex + 1;
 
-									tokenPointerArray.rbegin()->set( paramName.asChar(), rMatrix, false, true, arraySize );
-									for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+							tokenPointerArray.rbegin()->set( paramName.asChar(), rMatrix, false, true, arraySize );
+							for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+							{
+								bool existingIndex = false;
+								for ( unsigned int kkk( 0 ); kkk < indices.length(); kkk++ )
+								{
+									if ( kk == indices[kkk] )
 									{
-										bool existingIndex = false;
-										for ( unsigned int kkk( 0 ); kkk < indices.length(); kkk++ )
-										{
-											if ( kk == indices[kkk] )
-											{
-												existingIndex = true;
-												continue;
-											}
-										}
-										if ( existingIndex )  // get plug value
-										{
-											MPlug argNameElement = matrixPlug.elementByLogicalIndex(kk);
-											MObject matrixObject = argNameElement.asMObject(MDGContext::fsNormal, &status);
-											MFnMatrixData matrixData(matrixObject, &status);
-											if ( status != MS::kSuccess )
-											{
-												skipToken = true;
-												printf ( "[liqShader] error while initializing MFnMatrixData on param[?] %s on shader %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
-												continue;
-											}
-											else
-											{
-												MMatrix matrix = matrixData.matrix();
-												float x1, y1, z1, w1;
-												float x2, y2, z2, w2;
-												float x3, y3, z3, w3;
-												float x4, y4, z4, w4;
-												x1 = matrix(0, 0);
-												y1 = matrix(0, 1);
-												z1 = matrix(0, 2);
-												w1 = matrix(0, 3);
-												x2 = matrix(1, 0);
-												y2 = matrix(1, 1);
-												z2 = matrix(1, 2);
-												w2 = matrix(1, 3);
-												x3 = matrix(2, 0);
-												y3 = matrix(2, 1);
-												z3 = matrix(2, 2);
-												w3 = matrix(2, 3);
-												x4 = matrix(3, 0);
-												y4 = matrix(3, 1);
-												z4 = matrix(3, 2);
-												w4 = matrix(3, 3);
-												tokenPointerArray.rbegin()->setTokenFloat( kk, x1, y1, z1, w1, x2, y2, z2, w2, x3, y3, z3, w3, x4, y4, z4, w4 );
-											}
-										}
-										else  // don't mind about value
-										{
-											tokenPointerArray.rbegin()->setTokenFloat( kk, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 );
-										}
+										existingIndex = true;
+										continue;
 									}
 								}
-							}
-							else if ( arraySize > 0 )    // static array
-							{
-								// check default
-								int isDefault = 1;
-								for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+								if ( existingIndex )  // get plug value
 								{
-									MPlug argNameElement( matrixPlug.elementByLogicalIndex( kk ) );
+									MPlug argNameElement = matrixPlug.elementByLogicalIndex(kk);
 									MObject matrixObject = argNameElement.asMObject(MDGContext::fsNormal, &status);
 									MFnMatrixData matrixData(matrixObject, &status);
 									if ( status != MS::kSuccess )
 									{
 										skipToken = true;
-										printf ( "[liqShader] error while initializing MFnMatrixData on param[] %s on shader %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
+										printf ( "[liqShader] error while initializing MFnMatrixData on param[?] %s on shader %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
+										continue;
 									}
 									else
 									{
-										MMatrix matrix = matrixData.matrix();
-										MMatrix defaultMatrix;
-										defaultMatrix(0, 0) = shaderInfo.getArgFloatDefault(i, (kk*16)+0);
-										defaultMatrix(0, 1) = shaderInfo.getArgFloatDefault(i, (kk*16)+1);
-										defaultMatrix(0, 2) = shaderInfo.getArgFloatDefault(i, (kk*16)+2);
-										defaultMatrix(0, 3) = shaderInfo.getArgFloatDefault(i, (kk*16)+3);
-										defaultMatrix(1, 0) = shaderInfo.getArgFloatDefault(i, (kk*16)+4);
-										defaultMatrix(1, 1) = shaderInfo.getArgFloatDefault(i, (kk*16)+5);
-										defaultMatrix(1, 2) = shaderInfo.getArgFloatDefault(i, (kk*16)+6);
-										defaultMatrix(1, 3) = shaderInfo.getArgFloatDefault(i, (kk*16)+7);
-										defaultMatrix(2, 0) = shaderInfo.getArgFloatDefault(i, (kk*16)+8);
-										defaultMatrix(2, 1) = shaderInfo.getArgFloatDefault(i, (kk*16)+9);
-										defaultMatrix(2, 2) = shaderInfo.getArgFloatDefault(i, (kk*16)+10);
-										defaultMatrix(2, 3) = shaderInfo.getArgFloatDefault(i, (kk*16)+11);
-										defaultMatrix(3, 0) = shaderInfo.getArgFloatDefault(i, (kk*16)+12);
-										defaultMatrix(3, 1) = shaderInfo.getArgFloatDefault(i, (kk*16)+13);
-										defaultMatrix(3, 2) = shaderInfo.getArgFloatDefault(i, (kk*16)+14);
-										defaultMatrix(3, 3) = shaderInfo.getArgFloatDefault(i, (kk*16)+15);
-										if ( matrix != defaultMatrix )
-										{
-											isDefault = 0;
-											continue;
-										}
-									}
-								}
-								if ( isDefault && !outputAllParameters ) // skip default
-								{
-									skipToken = true;
-								}
-								else  // build non default param
-								{
-									tokenPointerArray.rbegin()->set( paramName.asChar(), rMatrix, false, true, arraySize );
-									for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
-									{
-										MPlug argNameElement( matrixPlug.elementByLogicalIndex( kk ) );
-										MObject matrixObject = argNameElement.asMObject(MDGContext::fsNormal, &status);
-										MFnMatrixData matrixData(matrixObject, &status);
 										MMatrix matrix = matrixData.matrix();
 										float x1, y1, z1, w1;
 										float x2, y2, z2, w2;
@@ -1028,119 +1161,227 @@ liqShader::liqShader( MObject shaderObj, bool outputAllParameters ) : liqGeneric
 										tokenPointerArray.rbegin()->setTokenFloat( kk, x1, y1, z1, w1, x2, y2, z2, w2, x3, y3, z3, w3, x4, y4, z4, w4 );
 									}
 								}
-							}
-							else if ( arraySize == -1 )    // single value
-							{
-								// check default
-								MObject matrixObject = matrixPlug.asMObject(MDGContext::fsNormal, &status);
-								MFnMatrixData matrixData(matrixObject, &status);
-								if ( status != MS::kSuccess )
+								else  // don't mind about value
 								{
-									skipToken = true;
-									printf("[liqShader] error while initializing MFnMatrixData on param %s on shader %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
+									tokenPointerArray.rbegin()->setTokenFloat( kk, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 );
 								}
-								else
+							}
+						}
+					}
+					else if ( arraySize > 0 )    // static array
+					{
+						// check default
+						int isDefault = 1;
+						for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
+						{
+							MPlug argNameElement( matrixPlug.elementByLogicalIndex( kk ) );
+							MObject matrixObject = argNameElement.asMObject(MDGContext::fsNormal, &status);
+							MFnMatrixData matrixData(matrixObject, &status);
+							if ( status != MS::kSuccess )
+							{
+								skipToken = true;
+								printf ( "[liqShader] error while initializing MFnMatrixData on param[] %s on shader %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
+							}
+							else
+							{
+								MMatrix matrix = matrixData.matrix();
+								MMatrix defaultMatrix;
+								defaultMatrix(0, 0) = shaderInfo.getArgFloatDefault(i, (kk*16)+0);
+								defaultMatrix(0, 1) = shaderInfo.getArgFloatDefault(i, (kk*16)+1);
+								defaultMatrix(0, 2) = shaderInfo.getArgFloatDefault(i, (kk*16)+2);
+								defaultMatrix(0, 3) = shaderInfo.getArgFloatDefault(i, (kk*16)+3);
+								defaultMatrix(1, 0) = shaderInfo.getArgFloatDefault(i, (kk*16)+4);
+								defaultMatrix(1, 1) = shaderInfo.getArgFloatDefault(i, (kk*16)+5);
+								defaultMatrix(1, 2) = shaderInfo.getArgFloatDefault(i, (kk*16)+6);
+								defaultMatrix(1, 3) = shaderInfo.getArgFloatDefault(i, (kk*16)+7);
+								defaultMatrix(2, 0) = shaderInfo.getArgFloatDefault(i, (kk*16)+8);
+								defaultMatrix(2, 1) = shaderInfo.getArgFloatDefault(i, (kk*16)+9);
+								defaultMatrix(2, 2) = shaderInfo.getArgFloatDefault(i, (kk*16)+10);
+								defaultMatrix(2, 3) = shaderInfo.getArgFloatDefault(i, (kk*16)+11);
+								defaultMatrix(3, 0) = shaderInfo.getArgFloatDefault(i, (kk*16)+12);
+								defaultMatrix(3, 1) = shaderInfo.getArgFloatDefault(i, (kk*16)+13);
+								defaultMatrix(3, 2) = shaderInfo.getArgFloatDefault(i, (kk*16)+14);
+								defaultMatrix(3, 3) = shaderInfo.getArgFloatDefault(i, (kk*16)+15);
+								if ( matrix != defaultMatrix )
 								{
-									MMatrix matrix = matrixData.matrix();
-									MMatrix defaultMatrix;
-									defaultMatrix(0, 0) = shaderInfo.getArgFloatDefault(i, 0);
-									defaultMatrix(0, 1) = shaderInfo.getArgFloatDefault(i, 1);
-									defaultMatrix(0, 2) = shaderInfo.getArgFloatDefault(i, 2);
-									defaultMatrix(0, 3) = shaderInfo.getArgFloatDefault(i, 3);
-									defaultMatrix(1, 0) = shaderInfo.getArgFloatDefault(i, 4);
-									defaultMatrix(1, 1) = shaderInfo.getArgFloatDefault(i, 5);
-									defaultMatrix(1, 2) = shaderInfo.getArgFloatDefault(i, 6);
-									defaultMatrix(1, 3) = shaderInfo.getArgFloatDefault(i, 7);
-									defaultMatrix(2, 0) = shaderInfo.getArgFloatDefault(i, 8);
-									defaultMatrix(2, 1) = shaderInfo.getArgFloatDefault(i, 9);
-									defaultMatrix(2, 2) = shaderInfo.getArgFloatDefault(i, 10);
-									defaultMatrix(2, 3) = shaderInfo.getArgFloatDefault(i, 11);
-									defaultMatrix(3, 0) = shaderInfo.getArgFloatDefault(i, 12);
-									defaultMatrix(3, 1) = shaderInfo.getArgFloatDefault(i, 13);
-									defaultMatrix(3, 2) = shaderInfo.getArgFloatDefault(i, 14);
-									defaultMatrix(3, 3) = shaderInfo.getArgFloatDefault(i, 15);
-									if ( matrix == defaultMatrix && !outputAllParameters )  // skip default
-									{
-										skipToken = true;
-									}
-									else  // build non default param
-									{
-										float x1, y1, z1, w1;
-										float x2, y2, z2, w2;
-										float x3, y3, z3, w3;
-										float x4, y4, z4, w4;
-										x1 = matrix(0, 0);
-										y1 = matrix(0, 1);
-										z1 = matrix(0, 2);
-										w1 = matrix(0, 3);
-										x2 = matrix(1, 0);
-										y2 = matrix(1, 1);
-										z2 = matrix(1, 2);
-										w2 = matrix(1, 3);
-										x3 = matrix(2, 0);
-										y3 = matrix(2, 1);
-										z3 = matrix(2, 2);
-										w3 = matrix(2, 3);
-										x4 = matrix(3, 0);
-										y4 = matrix(3, 1);
-										z4 = matrix(3, 2);
-										w4 = matrix(3, 3);
-										tokenPointerArray.rbegin()->set( paramName.asChar(), rMatrix );
-										//printf("SET MATRIX : \n %f %f %f %f \n %f %f %f %f \n %f %f %f %f \n %f %f %f %f \n", x1, y1, z1, w1, x2, y2, z2, w2, x3, y3, z3, w3, x4, y4, z4, w4);
-										tokenPointerArray.rbegin()->setTokenFloat( 0, x1, y1, z1, w1, x2, y2, z2, w2, x3, y3, z3, w3, x4, y4, z4, w4 );
-									}
+									isDefault = 0;
+									continue;
 								}
 							}
-							else    // unknown type
+						}
+						if ( isDefault && !outputAllParameters ) // skip default
+						{
+							skipToken = true;
+						}
+						else  // build non default param
+						{
+							tokenPointerArray.rbegin()->set( paramName.asChar(), rMatrix, false, true, arraySize );
+							for ( unsigned int kk( 0 ); kk < (unsigned int)arraySize; kk++ )
 							{
-								skipToken = true;
-								printf ( "[liqShader] error while building float[16] param %s on %s : undefined array size %d \n", paramName.asChar(), shaderNode.name().asChar(), arraySize );
+								MPlug argNameElement( matrixPlug.elementByLogicalIndex( kk ) );
+								MObject matrixObject = argNameElement.asMObject(MDGContext::fsNormal, &status);
+								MFnMatrixData matrixData(matrixObject, &status);
+								MMatrix matrix = matrixData.matrix();
+								float x1, y1, z1, w1;
+								float x2, y2, z2, w2;
+								float x3, y3, z3, w3;
+								float x4, y4, z4, w4;
+								x1 = matrix(0, 0);
+								y1 = matrix(0, 1);
+								z1 = matrix(0, 2);
+								w1 = matrix(0, 3);
+								x2 = matrix(1, 0);
+								y2 = matrix(1, 1);
+								z2 = matrix(1, 2);
+								w2 = matrix(1, 3);
+								x3 = matrix(2, 0);
+								y3 = matrix(2, 1);
+								z3 = matrix(2, 2);
+								w3 = matrix(2, 3);
+								x4 = matrix(3, 0);
+								y4 = matrix(3, 1);
+								z4 = matrix(3, 2);
+								w4 = matrix(3, 3);
+								tokenPointerArray.rbegin()->setTokenFloat( kk, x1, y1, z1, w1, x2, y2, z2, w2, x3, y3, z3, w3, x4, y4, z4, w4 );
 							}
-							break;
 						}
 					}
-					case SHADER_TYPE_UNKNOWN :
-					default:
-						liquidMessage ( "Unknown shader type", messageError );
-						skipToken = true;
-						break;
-				}
-			}
-			if ( !skipToken )
-			{
-				// set token type
-				switch ( shaderDetail )
-				{
-					case SHADER_DETAIL_UNIFORM:
+					else if ( arraySize == -1 )    // single value
 					{
-						tokenPointerArray.rbegin()->setDetailType( rUniform );
-						break;
+						// check default
+						MObject matrixObject = matrixPlug.asMObject(MDGContext::fsNormal, &status);
+						MFnMatrixData matrixData(matrixObject, &status);
+						if ( status != MS::kSuccess )
+						{
+							skipToken = true;
+							printf("[liqShader] error while initializing MFnMatrixData on param %s on shader %s ...\n", paramName.asChar(), shaderNode.name().asChar() );
+						}
+						else
+						{
+							MMatrix matrix = matrixData.matrix();
+							MMatrix defaultMatrix;
+							defaultMatrix(0, 0) = shaderInfo.getArgFloatDefault(i, 0);
+							defaultMatrix(0, 1) = shaderInfo.getArgFloatDefault(i, 1);
+							defaultMatrix(0, 2) = shaderInfo.getArgFloatDefault(i, 2);
+							defaultMatrix(0, 3) = shaderInfo.getArgFloatDefault(i, 3);
+							defaultMatrix(1, 0) = shaderInfo.getArgFloatDefault(i, 4);
+							defaultMatrix(1, 1) = shaderInfo.getArgFloatDefault(i, 5);
+							defaultMatrix(1, 2) = shaderInfo.getArgFloatDefault(i, 6);
+							defaultMatrix(1, 3) = shaderInfo.getArgFloatDefault(i, 7);
+							defaultMatrix(2, 0) = shaderInfo.getArgFloatDefault(i, 8);
+							defaultMatrix(2, 1) = shaderInfo.getArgFloatDefault(i, 9);
+							defaultMatrix(2, 2) = shaderInfo.getArgFloatDefault(i, 10);
+							defaultMatrix(2, 3) = shaderInfo.getArgFloatDefault(i, 11);
+							defaultMatrix(3, 0) = shaderInfo.getArgFloatDefault(i, 12);
+							defaultMatrix(3, 1) = shaderInfo.getArgFloatDefault(i, 13);
+							defaultMatrix(3, 2) = shaderInfo.getArgFloatDefault(i, 14);
+							defaultMatrix(3, 3) = shaderInfo.getArgFloatDefault(i, 15);
+							if ( matrix == defaultMatrix && !outputAllParameters )  // skip default
+							{
+								skipToken = true;
+							}
+							else  // build non default param
+							{
+								float x1, y1, z1, w1;
+								float x2, y2, z2, w2;
+								float x3, y3, z3, w3;
+								float x4, y4, z4, w4;
+								x1 = matrix(0, 0);
+								y1 = matrix(0, 1);
+								z1 = matrix(0, 2);
+								w1 = matrix(0, 3);
+								x2 = matrix(1, 0);
+								y2 = matrix(1, 1);
+								z2 = matrix(1, 2);
+								w2 = matrix(1, 3);
+								x3 = matrix(2, 0);
+								y3 = matrix(2, 1);
+								z3 = matrix(2, 2);
+								w3 = matrix(2, 3);
+								x4 = matrix(3, 0);
+								y4 = matrix(3, 1);
+								z4 = matrix(3, 2);
+								w4 = matrix(3, 3);
+								tokenPointerArray.rbegin()->set( paramName.asChar(), rMatrix );
+								//printf("SET MATRIX : \n %f %f %f %f \n %f %f %f %f \n %f %f %f %f \n %f %f %f %f \n", x1, y1, z1, w1, x2, y2, z2, w2, x3, y3, z3, w3, x4, y4, z4, w4);
+								tokenPointerArray.rbegin()->setTokenFloat( 0, x1, y1, z1, w1, x2, y2, z2, w2, x3, y3, z3, w3, x4, y4, z4, w4 );
+							}
+						}
 					}
-					case SHADER_DETAIL_VARYING:
+					else    // unknown type
 					{
-						tokenPointerArray.rbegin()->setDetailType( rVarying);
-						break;
+						skipToken = true;
+						printf ( "[liqShader] error while building float[16] param %s on %s : undefined array size %d \n", paramName.asChar(), shaderNode.name().asChar(), arraySize );
 					}
-					case SHADER_DETAIL_UNKNOWN:
-						tokenPointerArray.rbegin()->setDetailType( rUniform);
-						break;
+					break;
 				}
-				// create next token
-				tokenPointerArray.push_back( liqTokenPointer() );
 			}
-			else
+			case SHADER_TYPE_UNKNOWN :
+			default:
+				liquidMessage ( "Unknown shader type", messageError );
+				skipToken = true;
+				break;
+		}
+	}
+	if ( !skipToken )
+	{
+		// set token type
+		switch ( shaderDetail )
+		{
+			case SHADER_DETAIL_UNIFORM:
 			{
-				// skip parameter : parameter will not be written inside rib
-				if ( outputAllParameters )
-				{
-					char tmp[512];
-					sprintf ( tmp, "[liqShader] skipping shader parameter %s on %s (probably an empty dynamic array)\n", paramName.asChar(), shaderNode.name().asChar() );
-					liquidMessage( tmp, messageWarning );
-				}
+				tokenPointerArray.rbegin()->setDetailType( rUniform );
+				break;
+			}
+			case SHADER_DETAIL_VARYING:
+			{
+				tokenPointerArray.rbegin()->setDetailType( rVarying);
+				break;
 			}
+			case SHADER_DETAIL_UNKNOWN:
+				tokenPointerArray.rbegin()->setDetailType( rUniform);
+				break;
+		}
+	}
+	else
+	{
+		// skip parameter : parameter will not be written inside rib
+		if ( outputAllParameters )
+		{
+			char tmp[512];
+			sprintf ( tmp, "[liqShader] skipping shader parameter %s on %s (probably an empty dynamic array)\n", paramName.asChar(), shaderNode.name().asChar() );
+			liquidMessage( tmp, messageWarning );
+		}
+	}
+	return !skipToken;
+}
+
+
+/** Name the shader after what it writes : its file, space and parameter
+ *  values, co-shader handles included. Identical co-shaders, on any node,
+ *  get the same handle and are declared once.
+ */
+void liqShader::setContentHandler()
+{
+	liqHash hash;
+	hash.add( file );
+	hash.add( string( shaderSpace.asChar() ) );
+	// the last element is the empty one the next parameter would go in
+	for ( unsigned int i = 0; i + 1 < tokenPointerArray.size(); i++ )
+	{
+		liqTokenPointer &token = tokenPointerArray[i];
+		hash.add( token.getDetailedTokenName() );
+		if ( token.getTokenFloatArraySize() )
+		{
+			hash.add( token.getTokenFloatArray(), token.getTokenFloatArraySize() * sizeof( RtFloat ) );
+		}
+		const vector<string> &strings = token.getTokenStringArray();
+		for ( unsigned int j = 0; j < strings.size(); j++ )
+		{
+			hash.add( strings[j] );
 		}
 	}
-	shaderInfo.resetIt();
+	shaderHandler = MString( basename( const_cast<char *>( file.c_str() ) ) ) + "_" + hash.str();
 }
 
 
@@ -1181,7 +1422,7 @@ void liqShader::appendCoShader( MObject coshader, MPlug plug )
 
 void *liqShader::write( bool shortShaderNames, unsigned int indentLevel, SHADER_TYPE forceAs )
 {
-	vector<MString> yetExportedShaders;
+	set<string> yetExportedShaders;
 	return write(shortShaderNames, indentLevel, yetExportedShaders, forceAs);
 }
 
@@ -1252,35 +1493,12 @@ void liqShader::writeRibAttributes( MFnDependencyNode &node, SHADER_TYPE shaderT
 }
 
 
-void *liqShader::write(bool shortShaderNames, unsigned int indentLevel, vector<MString> &yetExportedShaders, SHADER_TYPE forceAs)
+/** Write the co-shaders a shader uses, and theirs, before it.
+ *  Those already in yetExportedShaders, or declared at world level, are skipped.
+ */
+void liqShader::writeCoShaders(bool shortShaderNames, unsigned int indentLevel, set<string> &yetExportedShaders)
 {
-	void *handle = NULL;
-	MStatus status;
-	MFnDependencyNode node(m_mObject);
-	if ( hasErrors )  // wasn't well initialized, abort
-	{
-		printf ( "[liqShader::write] Erros occured while initializing shader '%s', won't export shader", node.name().asChar() );
-		return NULL;
-	}
-	// check if shader was yet exported (we don't want to export co-shaders more than one time)
-	unsigned int i;
-	for ( i=0; i < yetExportedShaders.size(); i++ )
-	{
-		if ( yetExportedShaders[i] == shaderHandler )
-		{
-			return NULL; // won't export another time
-		}
-	}
-
-	// force type : permit to write a co-shader as a Surface/Displace/...
-	SHADER_TYPE shaderType = shader_type;
-	if ( forceAs != SHADER_TYPE_UNKNOWN )
-	{
-		shaderType = forceAs;
-	}
-
-	// write co-shaders before
-	for ( i=0; i<m_coShaderArray.size(); i++ )
+	for ( unsigned int i=0; i<m_coShaderArray.size(); i++ )
 	{
 		liqGenericShader &genShader = liqShaderFactory::instance().getShader(m_coShaderArray[i]);
 		if ( genShader.isShader() )
@@ -1294,7 +1512,6 @@ void *liqShader::write(bool shortShaderNames, unsigned int indentLevel, vector<M
 			}
 			else
 			{
-				//coShader.writeAsCoShader(shortShaderNames, indentLevel);
 				coShader.write ( shortShaderNames, indentLevel, yetExportedShaders, SHADER_TYPE_SHADER );
 			}
 		}
@@ -1305,14 +1522,53 @@ void *liqShader::write(bool shortShaderNames, unsigned int indentLevel, vector<M
 			liquidMessage ( errorMsg, messageError );
 		}
 	}
+}
+
+
+void *liqShader::write(bool shortShaderNames, unsigned int indentLevel, set<string> &yetExportedShaders, SHADER_TYPE forceAs)
+{
+	void *handle = NULL;
+	MStatus status;
+	MFnDependencyNode node(m_mObject);
+	if ( hasErrors )  // wasn't well initialized, abort
+	{
+		printf ( "[liqShader::write] Erros occured while initializing shader '%s', won't export shader", node.name().asChar() );
+		return NULL;
+	}
+
+	// force type : permit to write a co-shader as a Surface/Displace/...
+	SHADER_TYPE shaderType = shader_type;
+	if ( forceAs != SHADER_TYPE_UNKNOWN )
+	{
+		shaderType = forceAs;
+	}
+
+	// check if co-shader was yet exported (we don't want to export co-shaders more than one time)
+	string handler( shaderHandler.asChar() );
+	if ( shaderType == SHADER_TYPE_SHADER )
+	{
+		if ( yetExportedShaders.count( handler ) || liqShaderFactory::instance().worldCoShaders().count( handler ) )
+		{
+			return NULL; // won't export another time
+		}
+	}
+
+	// write co-shaders before
+	writeCoShaders( shortShaderNames, indentLevel, yetExportedShaders );
 
 	// write rib attributes (but not for coshaders)
 	writeRibAttributes ( node, shaderType );
 
 	// write shader
-	scoped_array< RtToken > tokenArray( new RtToken[ tokenPointerArray.size() ] );
-	scoped_array< RtPointer > pointerArray( new RtPointer[ tokenPointerArray.size() ] );
-	assignTokenArrays( tokenPointerArray.size(), &tokenPointerArray[ 0 ], tokenArray.get(), pointerArray.get() );
+	// the parameter list is packed on the first write only: the factory builds
+	// a new liqShader when the node changes, so it stays valid for the whole
+	// life of this one
+	if ( m_tokenArray.empty() )
+	{
+		m_tokenArray.resize( tokenPointerArray.size() );
+		m_pointerArray.resize( tokenPointerArray.size() );
+		assignTokenArrays( tokenPointerArray.size(), &tokenPointerArray[ 0 ], &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );
+	}
 	char* shaderFileName = shortShaderNames ? basename( const_cast<char *>(file.c_str())) : const_cast<char *>(file.c_str());
 	if ( shaderSpace != "" )
 	{
@@ -1328,17 +1584,17 @@ void *liqShader::write(bool shortShaderNames, unsigned int indentLevel, vector<M
   		outputIndentation( indentLevel );
   		if ( useVisiblePoints )
   		#ifdef GENERIC  ||  ( defined( PRMAN ) && defined( RI_VERSION ) &&  RI_VERSION >= 4 )
-        RiVPSurfaceV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() );
+        RiVPSurfaceV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );
       #else
-        RiSurfaceV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() );
+        RiSurfaceV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );
       #endif
       else
-        RiSurfaceV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() );
+        RiSurfaceV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );
   		break;
   		
   	case SHADER_TYPE_DISPLACEMENT :
   		outputIndentation( indentLevel );
-  		RiDisplacementV( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() );
+  		RiDisplacementV( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );
   		break;
   		
   	case SHADER_TYPE_VOLUME :
@@ -1348,52 +1604,52 @@ void *liqShader::write(bool shortShaderNames, unsigned int indentLevel, vector<M
         case VOLUME_TYPE_INTERIOR:
           if ( useVisiblePoints )
           #ifdef GENERIC  ||  ( defined( PRMAN ) && defined( RI_VERSION ) &&  RI_VERSION >= 4 )  
-            RiVPInteriorV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() ); 
+            RiVPInteriorV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] ); 
           #else
-            RiInteriorV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() );
+            RiInteriorV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );
           #endif
           else
-            RiInteriorV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() ); 
+            RiInteriorV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] ); 
           break;
         case VOLUME_TYPE_EXTERIOR:
           if ( useVisiblePoints )
           #ifdef GENERIC             
-            RiVPExteriorV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() );
+            RiVPExteriorV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );
           #else
             // Atleast Prman 16.x haven't this function
-            RiExteriorV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() );  
+            RiExteriorV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );  
           #endif  
           else
-            RiExteriorV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() ); 
+            RiExteriorV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] ); 
           break;
         case VOLUME_TYPE_ATMOSPHERE:
         default:
           if ( useVisiblePoints )
           #ifdef GENERIC  ||  ( defined( PRMAN ) && defined( RI_VERSION ) &&  RI_VERSION >= 4 )  
-            RiVPAtmosphereV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() ); 
+            RiVPAtmosphereV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] ); 
           #else
-            RiAtmosphereV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() );  
+            RiAtmosphereV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );  
           #endif
           else
-            RiAtmosphereV ( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() ); 
+            RiAtmosphereV ( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] ); 
           break;
   		}
       break;
   		
   	case SHADER_TYPE_SHADER :
   		outputIndentation( indentLevel );
-  		RiShaderV ( shaderFileName, const_cast<char*>(shaderHandler.asChar()), shaderParamCount, tokenArray.get(), pointerArray.get() );
+  		RiShaderV ( shaderFileName, const_cast<char*>(shaderHandler.asChar()), shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );
   		break;
   		
   	case SHADER_TYPE_LIGHT :
   		outputIndentation(indentLevel);
-  		handle = RiLightSourceV( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() );
+  		handle = RiLightSourceV( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );
   		/*
    			//!!!! In Generic libRib light handle is unsigned int 
         LIQDEBUGPRINTF( "-> RiLightSourceV shaderFileName = %s\n", shaderFileName );
         LIQDEBUGPRINTF( "-> RiLightSourceV shaderParamCount = %d\n", shaderParamCount );
         LIQDEBUGPRINTF( "-> RiLightSourceV handle = " );
-  	    RtLightHandle light_handle = RiLightSourceV( shaderFileName, shaderParamCount, tokenArray.get(), pointerArray.get() );
+  	    RtLightHandle light_handle = RiLightSourceV( shaderFileName, shaderParamCount, &m_tokenArray[ 0 ], &m_pointerArray[ 0 ] );
   	    if ( light_handle != NULL )
   	    {
           unsigned int handle = (unsigned int)(long)(const void *)light_handle;
@@ -1415,7 +1671,10 @@ void *liqShader::write(bool shortShaderNames, unsigned int indentLevel, vector<M
 		RiTransformEnd();
 	}
 
-	yetExportedShaders.push_back ( shaderHandler );
+	if ( shaderType == SHADER_TYPE_SHADER )
+	{
+		yetExportedShaders.insert( handler );
+	}
 	return handle;
 }
 
@@ -0,0 +1,544 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Shader Compiler Source
+** ______________________________________________________________________
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <list>
+#include <algorithm>
+
+#ifdef _WIN32
+#  include <windows.h>
+#  include <process.h>
+#  include <io.h>
+#  include <direct.h>
+#else
+#  include <unistd.h>
+#  include <dirent.h>
+#  include <sys/time.h>
+#  include <sys/wait.h>
+#endif
+
+// Maya's Headers
+#include <maya/MArgList.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MSyntax.h>
+#include <maya/MGlobal.h>
+
+#include <liquid.h>
+#include <liqGlobalHelpers.h>
+#include <liqRenderer.h>
+#include <liqShaderCompiler.h>
+
+using namespace std;
+
+extern int debugMode;
+extern liqRenderer liquidRenderer;
+
+static double liqCompilerClock()
+{
+#ifdef _WIN32
+  return GetTickCount() / 1000.0;
+#else
+  struct timeval tv;
+  gettimeofday( &tv, NULL );
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static bool liqCompilerStat( const string& file, time_t& mtime, bool& isDir )
+{
+  struct stat st;
+  if ( stat( file.c_str(), &st ) != 0 ) 
+    return false;
+  mtime = st.st_mtime;
+  isDir = ( st.st_mode & S_IFDIR ) != 0;
+  return true;
+}
+
+static string liqCompilerDirName( const string& file )
+{
+  string::size_type slash( file.find_last_of( "/\\" ) );
+  return ( slash == string::npos )? string( "." ) : file.substr( 0, slash );
+}
+
+static string liqCompilerBaseName( const string& file )
+{
+  string::size_type slash( file.find_last_of( "/\\" ) );
+  string base( ( slash == string::npos )? file : file.substr( slash + 1 ) );
+  string::size_type dot( base.rfind( '.' ) );
+  return ( dot == string::npos )? base : base.substr( 0, dot );
+}
+
+/** The path from the current directory, so it still holds once the
+ *  compiler runs in another one.
+ */
+static string liqCompilerAbsolute( const string& path )
+{
+  if ( !path.empty() && ( path[0] == '/' || path[0] == '\\' || ( path.size() > 1 && path[1] == ':' ) ) ) 
+    return path;
+  char cwd[ 4096 ];
+#ifdef _WIN32
+  if ( !_getcwd( cwd, sizeof( cwd ) ) ) 
+#else
+  if ( !getcwd( cwd, sizeof( cwd ) ) ) 
+#endif
+    return path;
+  return string( cwd ) + "/" + path;
+}
+
+static string liqCompilerQuote( const string& s )
+{
+  return "\"" + s + "\"";
+}
+
+/** A compiler process and the source it works on.
+ */
+struct liqCompileJob 
+{
+#ifdef _WIN32
+  intptr_t process;
+#else
+  pid_t    process;
+#endif
+  size_t   result;
+  double   start;
+};
+
+
+liqShaderCompiler::liqShaderCompiler()
+: m_jobs( 0 ), m_force( false )
+{
+  defaultCompiler( m_compiler, m_extension );
+}
+
+void liqShaderCompiler::setCompiler( const string& compiler, const string& extension )
+{
+  if ( compiler != "" ) 
+    m_compiler = compiler;
+  if ( extension != "" ) 
+    m_extension = extension;
+}
+
+void liqShaderCompiler::setOutputDir( const string& dir )
+{
+  m_outputDir = dir;
+}
+
+void liqShaderCompiler::addIncludePath( const string& path )
+{
+  m_includePaths.push_back( path );
+}
+
+void liqShaderCompiler::setJobs( unsigned jobs )
+{
+  m_jobs = jobs;
+}
+
+void liqShaderCompiler::setForce( bool force )
+{
+  m_force = force;
+}
+
+unsigned liqShaderCompiler::processorCount()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo( &info );
+  return info.dwNumberOfProcessors;
+#else
+  long n( sysconf( _SC_NPROCESSORS_ONLN ) );
+  return ( n > 0 )? (unsigned)n : 1;
+#endif
+}
+
+/** Compiler and compiled shader extension of the renderer liquid was built for.
+ */
+void liqShaderCompiler::defaultCompiler( string& compiler, string& extension )
+{
+#if defined( PRMAN )
+  compiler = "shader";   extension = "slo";
+#elif defined( DELIGHT )
+  compiler = "shaderdl"; extension = "sdl";
+#elif defined( AQSIS )
+  compiler = "aqsl";     extension = "slx";
+#elif defined( PIXIE )
+  compiler = "sdrc";     extension = "sdr";
+#elif defined( AIR )
+  compiler = "shaded";   extension = "slb";
+#else
+  compiler = "shader";   extension = "slo";
+#endif
+}
+
+/** Adds a source file, or every .sl file of a directory.
+ *  Returns the number of sources added.
+ */
+unsigned liqShaderCompiler::addSources( const string& path )
+{
+  time_t mtime;
+  bool isDir;
+  if ( !liqCompilerStat( path, mtime, isDir ) ) 
+  {
+    liquidMessage( "Shader source not found: " + MString( path.c_str() ), messageError );
+    return 0;
+  }
+  if ( !isDir ) 
+  {
+    m_sources.push_back( path );
+    return 1;
+  }
+
+  vector< string > found;
+#ifdef _WIN32
+  struct _finddata_t entry;
+  intptr_t h( _findfirst( ( path + "/*.sl" ).c_str(), &entry ) );
+  if ( h != -1 ) 
+  {
+    do found.push_back( path + "/" + entry.name );
+    while ( _findnext( h, &entry ) == 0 );
+    _findclose( h );
+  }
+#else
+  DIR *dir( opendir( path.c_str() ) );
+  if ( dir ) 
+  {
+    struct dirent *entry;
+    while ( ( entry = readdir( dir ) ) ) 
+    {
+      string name( entry->d_name );
+      if ( name.size() > 3 && name.compare( name.size() - 3, 3, ".sl" ) == 0 ) 
+        found.push_back( path + "/" + name );
+    }
+    closedir( dir );
+  }
+#endif
+  sort( found.begin(), found.end() );
+  m_sources.insert( m_sources.end(), found.begin(), found.end() );
+  return found.size();
+}
+
+/** Looks an include up like the compiler does : next to the file that
+ *  includes it, then along the include paths.
+ */
+string liqShaderCompiler::findInclude( const string& name, const string& fromDir ) const
+{
+  time_t mtime;
+  bool isDir;
+  if ( !name.empty() && ( name[0] == '/' || name[0] == '\\' || ( name.size() > 1 && name[1] == ':' ) ) ) 
+    return liqCompilerStat( name, mtime, isDir )? name : string();
+
+  string candidate( fromDir + "/" + name );
+  if ( liqCompilerStat( candidate, mtime, isDir ) ) 
+    return candidate;
+  for ( vector< string >::const_iterator p( m_includePaths.begin() ); p != m_includePaths.end(); ++p ) 
+  {
+    candidate = *p + "/" + name;
+    if ( liqCompilerStat( candidate, mtime, isDir ) ) 
+      return candidate;
+  }
+  return string();
+}
+
+/** Newest modification date of a file and everything it includes.
+ *  Headers are read once per run, however many shaders include them.
+ */
+time_t liqShaderCompiler::dependencyTime( const string& file )
+{
+  map< string, time_t >::const_iterator known( m_times.find( file ) );
+  if ( known != m_times.end() ) 
+    return known->second;
+
+  time_t newest( 0 );
+  bool isDir;
+  if ( !liqCompilerStat( file, newest, isDir ) ) 
+    return 0;
+  // recorded before the includes are read so a cycle ends here
+  m_times[ file ] = newest;
+
+  ifstream in( file.c_str() );
+  string line, dir( liqCompilerDirName( file ) );
+  while ( getline( in, line ) ) 
+  {
+    string::size_type i( line.find_first_not_of( " \t" ) );
+    if ( i == string::npos || line[i] != '#' ) 
+      continue;
+    i = line.find_first_not_of( " \t", i + 1 );
+    if ( i == string::npos || line.compare( i, 7, "include" ) != 0 ) 
+      continue;
+    i = line.find_first_of( "\"<", i + 7 );
+    if ( i == string::npos ) 
+      continue;
+    string::size_type end( line.find_first_of( "\">", i + 1 ) );
+    if ( end == string::npos ) 
+      continue;
+
+    string header( findInclude( line.substr( i + 1, end - i - 1 ), dir ) );
+    if ( header.empty() ) 
+      continue;  // system headers of the compiler
+    time_t t( dependencyTime( header ) );
+    if ( t > newest ) 
+      newest = t;
+  }
+  m_times[ file ] = newest;
+  return newest;
+}
+
+string liqShaderCompiler::outputFile( const string& source ) const
+{
+  string dir( m_outputDir.empty()? liqCompilerDirName( source ) : m_outputDir );
+  return dir + "/" + liqCompilerBaseName( source ) + "." + m_extension;
+}
+
+/** The compiler runs in the output directory, where it writes the shader,
+ *  so the source and include paths it gets are absolute.
+ */
+string liqShaderCompiler::commandLine( const string& source ) const
+{
+  string dir( m_outputDir.empty()? liqCompilerDirName( source ) : m_outputDir );
+  string cmd;
+#ifdef _WIN32
+  cmd = "cd /d " + liqCompilerQuote( dir ) + " && " + m_compiler;
+#else
+  cmd = "cd " + liqCompilerQuote( dir ) + " && " + m_compiler;
+#endif
+  for ( vector< string >::const_iterator p( m_includePaths.begin() ); p != m_includePaths.end(); ++p ) 
+    cmd += " -I" + liqCompilerQuote( liqCompilerAbsolute( *p ) );
+  cmd += " " + liqCompilerQuote( liqCompilerAbsolute( source ) );
+  return cmd;
+}
+
+/** Compiles the out of date sources, several at a time, and reports
+ *  how long each one took.
+ */
+bool liqShaderCompiler::run()
+{
+  double runStart( liqCompilerClock() );
+  m_results.clear();
+  m_times.clear();
+
+  list< size_t > pending;
+  for ( vector< string >::const_iterator s( m_sources.begin() ); s != m_sources.end(); ++s ) 
+  {
+    liqShaderCompileResult r;
+    r.source  = *s;
+    r.output  = outputFile( *s );
+    r.status  = liqShaderCompileResult::kUpToDate;
+    r.seconds = 0.0;
+
+    time_t outputTime;
+    bool isDir;
+    if ( m_force || !liqCompilerStat( r.output, outputTime, isDir ) || outputTime < dependencyTime( *s ) ) 
+      pending.push_back( m_results.size() );
+    else 
+      LIQDEBUGPRINTF( "-> shader up to date: %s\n", r.output.c_str() );
+    m_results.push_back( r );
+  }
+
+  unsigned jobs( m_jobs? m_jobs : processorCount() );
+  unsigned toCompile( pending.size() );
+  unsigned failed( 0 );
+
+#ifdef _WIN32
+  const char *shell( getenv( "COMSPEC" )? getenv( "COMSPEC" ) : "cmd.exe" );
+#endif
+  list< liqCompileJob > running;
+
+  while ( !pending.empty() || !running.empty() ) 
+  {
+    while ( !pending.empty() && running.size() < jobs ) 
+    {
+      liqCompileJob job;
+      job.result = pending.front();
+      pending.pop_front();
+      string cmd( commandLine( m_results[ job.result ].source ) );
+      LIQDEBUGPRINTF( "-> compiling: %s\n", cmd.c_str() );
+      job.start = liqCompilerClock();
+#ifdef _WIN32
+      job.process = _spawnl( _P_NOWAIT, shell, shell, "/s", "/c", liqCompilerQuote( cmd ).c_str(), NULL );
+      if ( job.process == -1 ) 
+#else
+      job.process = fork();
+      if ( job.process == 0 ) 
+      {
+        execl( "/bin/sh", "sh", "-c", cmd.c_str(), (char *)NULL );
+        _exit( 127 );
+      }
+      if ( job.process < 0 ) 
+#endif
+      {
+        m_results[ job.result ].status = liqShaderCompileResult::kFailed;
+        liquidMessage( "Could not start the shader compiler for " + MString( m_results[ job.result ].source.c_str() ), messageError );
+        ++failed;
+        continue;
+      }
+      running.push_back( job );
+    }
+
+    bool finished( false );
+    for ( list< liqCompileJob >::iterator j( running.begin() ); j != running.end(); ) 
+    {
+      bool ok;
+#ifdef _WIN32
+      if ( WaitForSingleObject( (HANDLE)j->process, 0 ) != WAIT_OBJECT_0 ) 
+      {
+        ++j;
+        continue;
+      }
+      DWORD code( 1 );
+      GetExitCodeProcess( (HANDLE)j->process, &code );
+      CloseHandle( (HANDLE)j->process );
+      ok = ( code == 0 );
+#else
+      int st;
+      if ( waitpid( j->process, &st, WNOHANG ) != j->process ) 
+      {
+        ++j;
+        continue;
+      }
+      ok = WIFEXITED( st ) && WEXITSTATUS( st ) == 0;
+#endif
+      liqShaderCompileResult &r( m_results[ j->result ] );
+      r.seconds = liqCompilerClock() - j->start;
+      r.status  = ok? liqShaderCompileResult::kCompiled : liqShaderCompileResult::kFailed;
+
+      char secs[32];
+      sprintf( secs, "%.2f", r.seconds );
+      if ( ok ) 
+        liquidMessage( "Compiled " + MString( r.source.c_str() ) + " in " + secs + "s", messageInfo );
+      else 
+      {
+        liquidMessage( "Failed to compile " + MString( r.source.c_str() ) + " (" + secs + "s)", messageError );
+        ++failed;
+      }
+      j = running.erase( j );
+      finished = true;
+    }
+    if ( !finished && !running.empty() ) 
+    {
+#ifdef _WIN32
+      Sleep( 20 );
+#else
+      usleep( 20000 );
+#endif
+    }
+  }
+
+  char summary[256];
+  sprintf( summary, "%u shaders compiled, %u failed, %u up to date in %.2fs (%u jobs)",
+           toCompile - failed, failed, (unsigned)m_results.size() - toCompile, liqCompilerClock() - runStart, jobs );
+  liquidMessage( summary, failed? messageWarning : messageInfo );
+  return failed == 0;
+}
+
+
+/* ______________________________________________________________________
+**
+** liquidCompileShaders command
+** ______________________________________________________________________
+*/
+
+void* liqCompileShaders::creator()
+{
+  return new liqCompileShaders();
+}
+
+MSyntax liqCompileShaders::syntax()
+{
+  MSyntax syn;
+
+  syn.addFlag( "j", "jobs",      MSyntax::kLong );
+  syn.addFlag( "I", "include",   MSyntax::kString );
+  syn.makeFlagMultiUse( "I" );
+  syn.addFlag( "o", "outputDir", MSyntax::kString );
+  syn.addFlag( "f", "force" );
+  syn.addFlag( "c", "compiler",  MSyntax::kString );
+  syn.addFlag( "e", "extension", MSyntax::kString );
+  syn.setObjectType( MSyntax::kStringObjects, 1 );
+
+  return syn;
+}
+
+MStatus liqCompileShaders::doIt( const MArgList& args )
+{
+  MStatus status;
+  MArgDatabase argData( syntax(), args, &status );
+  if ( !status ) 
+    return status;
+
+  liqShaderCompiler compiler;
+  compiler.setCompiler( liquidRenderer.shaderCompiler.asChar(), liquidRenderer.shaderExtension.asChar() );
+
+  MString s;
+  if ( argData.isFlagSet( "c" ) && argData.getFlagArgument( "c", 0, s ) == MS::kSuccess ) 
+    compiler.setCompiler( s.asChar(), "" );
+  if ( argData.isFlagSet( "e" ) && argData.getFlagArgument( "e", 0, s ) == MS::kSuccess ) 
+    compiler.setCompiler( "", s.asChar() );
+  if ( argData.isFlagSet( "o" ) && argData.getFlagArgument( "o", 0, s ) == MS::kSuccess ) 
+    compiler.setOutputDir( s.asChar() );
+  int jobs;
+  if ( argData.isFlagSet( "j" ) && argData.getFlagArgument( "j", 0, jobs ) == MS::kSuccess && jobs > 0 ) 
+    compiler.setJobs( jobs );
+  compiler.setForce( argData.isFlagSet( "f" ) );
+
+  for ( unsigned i( 0 ); i < argData.numberOfFlagUses( "I" ); ++i ) 
+  {
+    MArgList include;
+    if ( argData.getFlagArgumentList( "I", i, include ) == MS::kSuccess ) 
+      compiler.addIncludePath( include.asString( 0 ).asChar() );
+  }
+
+  MStringArray sources;
+  argData.getObjects( sources );
+  for ( unsigned i( 0 ); i < sources.length(); ++i ) 
+    compiler.addSources( sources[i].asChar() );
+
+  bool ok( compiler.run() );
+
+  MStringArray result;
+  const vector< liqShaderCompileResult > &results( compiler.results() );
+  for ( vector< liqShaderCompileResult >::const_iterator r( results.begin() ); r != results.end(); ++r ) 
+  {
+    const char *what( ( r->status == liqShaderCompileResult::kCompiled )? "compiled" : 
+                      ( r->status == liqShaderCompileResult::kFailed )? "failed" : "uptodate" );
+    char line[64];
+    sprintf( line, " %s %.2f", what, r->seconds );
+    result.append( MString( r->source.c_str() ) + line );
+  }
+  setResult( result );
+
+  return ok? MS::kSuccess : MS::kFailure;
+}
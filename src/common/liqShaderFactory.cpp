@@ -28,6 +28,7 @@
 #include <liqShaderFactory.h>
 
 #include <maya/MFnDependencyNode.h>
+#include <maya/MNodeMessage.h>
 #include <maya/MPlug.h>
 
 #include <liqShader.h>
@@ -47,6 +48,7 @@ liqShaderFactory * liqShaderFactory::_instance=NULL;
 liqShaderFactory::liqShaderFactory()
 {
 	shaderHandlerId = 0;
+	m_frame = 0;
 }
 
 
@@ -58,39 +60,68 @@ liqShaderFactory::~liqShaderFactory()
 
 void liqShaderFactory::clearShaders()
 {
-	vector<liqGenericShader*>::iterator iter;
-	vector<liqGenericShader*>::iterator end = m_shaders.end();
-	for( iter=m_shaders.begin(); iter!=end; iter++ )
+	refreshShaders();
+	while( !m_shaders.empty() )
 	{
-		if( *iter )
-		{
-			delete (*iter);
-		}
+		removeShader( m_shaders.begin() );
 	}
-	m_shaders.clear();
 	shaderHandlerId = 0;
 }
 
 
-liqGenericShader &liqShaderFactory::getShader( MObject shaderObj, bool withAllParameters )
+void liqShaderFactory::refreshShaders()
 {
-	MString rmShaderStr;
-	MFnDependencyNode shaderNode( shaderObj );
-	MPlug rmanShaderNamePlug = shaderNode.findPlug( MString( "rmanShaderLong" ) );
-	rmanShaderNamePlug.getValue( rmShaderStr );
-	LIQDEBUGPRINTF( "-> Using Renderman Shader %s\n",  rmShaderStr.asChar() );
-  
-	vector<liqGenericShader*>::iterator iter = m_shaders.begin();
-	while ( iter != m_shaders.end() )
+	m_frame++;
+
+	vector<liqGenericShader*>::iterator iter;
+	for( iter=m_oldShaders.begin(); iter!=m_oldShaders.end(); iter++ )
 	{
-		//string shaderNodeName = shaderNode.name().asChar();
-		if ( (*iter)->m_mObject == shaderObj )
+		delete (*iter);
+	}
+	m_oldShaders.clear();
+
+	// forget the deleted nodes
+	liqShaderMap::iterator entry = m_shaders.begin();
+	while ( entry != m_shaders.end() )
+	{
+		liqShaderMap::iterator current = entry++;
+		if ( !current->second.node.isValid() )
 		{
-			// Already got it : nothing to do
-			return **iter;
+			removeShader( current );
 		}
-		++iter;
 	}
+}
+
+
+void liqShaderFactory::removeShader( liqShaderMap::iterator entry )
+{
+	if ( entry->second.dirtyCallbackId )
+	{
+		MMessage::removeCallback( entry->second.dirtyCallbackId );
+	}
+	delete entry->second.shader;
+	m_shaders.erase( entry );
+}
+
+
+// edits and connection changes, not the evaluation of animated plugs :
+// animated parameters are read again by liqShader::refreshParameters()
+void liqShaderFactory::shaderChangedCallback( MNodeMessage::AttributeMessage msg, MPlug &plug, MPlug &otherPlug, void *clientData )
+{
+	if ( msg & ( MNodeMessage::kAttributeSet | MNodeMessage::kConnectionMade | MNodeMessage::kConnectionBroken |
+	             MNodeMessage::kAttributeArrayAdded | MNodeMessage::kAttributeArrayRemoved |
+	             MNodeMessage::kAttributeAdded | MNodeMessage::kAttributeRemoved ) )
+	{
+		( ( liqShaderEntry * )clientData )->dirty = true;
+	}
+}
+
+
+liqGenericShader *liqShaderFactory::newShader( MObject shaderObj, bool withAllParameters )
+{
+	MFnDependencyNode shaderNode( shaderObj );
+	LIQDEBUGPRINTF( "-> Using Renderman Shader %s\n", shaderNode.name().asChar() );
+
 	liqGenericShader *currentShader = NULL;
 
 	MTypeId typeId = shaderNode.typeId();
@@ -112,10 +143,62 @@ liqGenericShader &liqShaderFactory::getShader( MObject shaderObj, bool withAllPa
 	{
 		printf("[liqShaderFactory] error while creating liqObject for node '%s'\n", shaderNode.name().asChar() );
 	}
-	m_shaders.push_back( currentShader );
-	//fflush(stdout);
-	//fflush(stderr);
-	return *(m_shaders.back());
+	return currentShader;
+}
+
+
+liqGenericShader &liqShaderFactory::getShader( MObject shaderObj, bool withAllParameters )
+{
+	MObjectHandle handle( shaderObj );
+	unsigned int key = handle.hashCode();
+
+	pair< liqShaderMap::iterator, liqShaderMap::iterator > range = m_shaders.equal_range( key );
+	for ( liqShaderMap::iterator iter = range.first; iter != range.second; ++iter )
+	{
+		liqShaderEntry &entry = iter->second;
+		if ( entry.node.isValid() && entry.node.objectRef() == shaderObj )
+		{
+			if ( entry.frame != m_frame )
+			{
+				entry.frame = m_frame;
+				if ( entry.dirty )
+				{
+					// the old one may still be referenced : it goes at the next frame
+					m_oldShaders.push_back( entry.shader );
+					entry.shader = newShader( shaderObj, withAllParameters );
+					// without a callback, changes can't be tracked : rebuild it every frame
+					entry.dirty = ( entry.dirtyCallbackId == 0 );
+				}
+				else if ( entry.shader->isShader() )
+				{
+					// only the animated parameters
+					entry.shader->asShader()->refreshParameters();
+				}
+			}
+			return *entry.shader;
+		}
+	}
+
+	liqShaderEntry newEntry;
+	newEntry.node = handle;
+	newEntry.shader = newShader( shaderObj, withAllParameters );
+	newEntry.dirtyCallbackId = 0;
+	newEntry.dirty = false;
+	newEntry.frame = m_frame;
+	liqShaderMap::iterator inserted = m_shaders.insert( make_pair( key, newEntry ) );
+
+	// entries don't move in the map : it can be the callback client data
+	MStatus status;
+	MCallbackId callbackId = MNodeMessage::addAttributeChangedCallback( shaderObj, shaderChangedCallback, &inserted->second, &status );
+	if ( status == MS::kSuccess )
+	{
+		inserted->second.dirtyCallbackId = callbackId;
+	}
+	else
+	{
+		inserted->second.dirty = true;
+	}
+	return *inserted->second.shader;
 }
 
 
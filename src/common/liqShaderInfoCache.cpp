@@ -0,0 +1,495 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Shader Info Cache Source
+** ______________________________________________________________________
+*/
+
+// Renderer shader query libraries
+#if defined( PRMAN ) || defined( DELIGHT )
+extern "C" {
+#include <slo.h>
+}
+#elif defined( AQSIS )
+#include <slx.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <fstream>
+
+// Maya's Headers
+#include <maya/MGlobal.h>
+#include <maya/MEventMessage.h>
+
+#include <liquid.h>
+#include <liqGlobalHelpers.h>
+#include <liqShaderInfoCache.h>
+
+using namespace std;
+
+extern int debugMode;
+
+// bump it when liqShaderInfo changes
+static const int liqShaderInfoIndexVersion = 1;
+
+liqShaderInfoCache *liqShaderInfoCache::_instance = NULL;
+
+
+liqShaderInfoCache &liqShaderInfoCache::instance()
+{
+  if ( !_instance ) _instance = new liqShaderInfoCache();
+  return *_instance;
+}
+
+liqShaderInfoCache::liqShaderInfoCache() : dirty( false ), idleCallback( 0 ), workspaceCallback( 0 )
+{
+  MStatus status;
+  workspaceCallback = MEventMessage::addEventCallback( "workspaceChanged", workspaceChanged, this, &status );
+  if ( !status ) workspaceCallback = 0;
+}
+
+void liqShaderInfoCache::shutdown()
+{
+  if ( !_instance ) return;
+  _instance->flush();
+  if ( _instance->workspaceCallback ) MMessage::removeCallback( _instance->workspaceCallback );
+  delete _instance;
+  _instance = NULL;
+}
+
+void liqShaderInfoCache::flush()
+{
+  if ( idleCallback ) MMessage::removeCallback( idleCallback );
+  idleCallback = 0;
+  if ( dirty ) save();
+  dirty = false;
+}
+
+// a shader library scan runs in one go, Maya only idles once it is over
+void liqShaderInfoCache::idle( void *cache )
+{
+  ( ( liqShaderInfoCache* )cache )->flush();
+}
+
+void liqShaderInfoCache::workspaceChanged( void *cache )
+{
+  ( ( liqShaderInfoCache* )cache )->projectDir = "";
+}
+
+/** Modification time and size of the compiled shader, the cache key with its path.
+ */
+bool liqShaderInfoCache::stamp( const MString &shaderFile, double &mtime, double &size ) const
+{
+#ifdef _WIN32
+  struct _stat sbuf;
+  if ( _stat( shaderFile.asChar(), &sbuf ) ) return false;
+#else
+  struct stat sbuf;
+  if ( stat( shaderFile.asChar(), &sbuf ) ) return false;
+#endif
+  mtime = ( double )sbuf.st_mtime;
+  size  = ( double )sbuf.st_size;
+  return true;
+}
+
+bool liqShaderInfoCache::find( const MString &shaderFile, const MString &expectedType, liqShaderInfo &info )
+{
+  double mtime, size;
+  if ( !stamp( shaderFile, mtime, size ) ) return false;
+
+  load();
+  map< string, liqShaderInfo >::const_iterator it( infos.find( shaderFile.asChar() ) );
+  // the parsers give co-shaders the type the node expects : it's part of the key
+  if ( it != infos.end() && it->second.mtime == mtime && it->second.size == size && it->second.expectedType == expectedType ) 
+  {
+    info = it->second;
+    return true;
+  }
+  if ( readNative( shaderFile, expectedType, info ) ) 
+  {
+    store( shaderFile, expectedType, info );
+    return true;
+  }
+  return false;
+}
+
+void liqShaderInfoCache::store( const MString &shaderFile, const MString &expectedType, liqShaderInfo &info )
+{
+  if ( !stamp( shaderFile, info.mtime, info.size ) ) return;
+  info.expectedType = expectedType;
+
+  load();
+  infos[ shaderFile.asChar() ] = info;
+  dirty = true;
+  if ( !idleCallback ) 
+  {
+    MStatus status;
+    idleCallback = MEventMessage::addEventCallback( "idle", idle, this, &status );
+    if ( !status ) 
+    {
+      idleCallback = 0;
+      flush();
+    }
+  }
+}
+
+
+// Index file : a header line, then one block per shader. Strings are
+// written as "length text" so that they can hold any character.
+
+static void writeString( ostream &out, const MString &s )
+{
+  out << s.length() << " " << s.asChar() << "\n";
+}
+
+static bool readString( istream &in, MString &s )
+{
+  unsigned length;
+  if ( !( in >> length ) ) return false;
+  in.get();
+  string buffer( length, ' ' );
+  if ( length && !in.read( &buffer[ 0 ], length ) ) return false;
+  s = buffer.c_str();
+  return true;
+}
+
+static void writeStrings( ostream &out, const MStringArray &strings )
+{
+  out << strings.length() << "\n";
+  for ( unsigned i( 0 ); i < strings.length(); i++ ) writeString( out, strings[ i ] );
+}
+
+static bool readStrings( istream &in, MStringArray &strings )
+{
+  unsigned length;
+  if ( !( in >> length ) ) return false;
+  strings.setLength( length );
+  for ( unsigned i( 0 ); i < length; i++ ) 
+    if ( !readString( in, strings[ i ] ) ) return false;
+  return true;
+}
+
+static void writeInts( ostream &out, const MIntArray &ints )
+{
+  out << ints.length();
+  for ( unsigned i( 0 ); i < ints.length(); i++ ) out << " " << ints[ i ];
+  out << "\n";
+}
+
+static bool readInts( istream &in, MIntArray &ints )
+{
+  unsigned length;
+  if ( !( in >> length ) ) return false;
+  ints.setLength( length );
+  for ( unsigned i( 0 ); i < length; i++ ) 
+    if ( !( in >> ints[ i ] ) ) return false;
+  return true;
+}
+
+/** (Re)load the index of the current project, when the project changed.
+ */
+void liqShaderInfoCache::load()
+{
+  if ( projectDir == "" ) MGlobal::executeCommand( "workspace -q -rd", projectDir );
+  MString file( projectDir + ( projectDir.rindex( '/' ) == ( int )projectDir.length() - 1 ? "" : "/" ) + ".liquidShaderInfo" );
+  if ( file == indexFile ) return;
+
+  // what the previous project's index is missing
+  flush();
+  indexFile = file;
+  infos.clear();
+
+  ifstream in( indexFile.asChar(), ios::binary );
+  if ( !in ) return;
+
+  string header;
+  int version( 0 );
+  in >> header >> version;
+  if ( header != "liquidShaderInfo" || version != liqShaderInfoIndexVersion ) return;
+
+  MString shaderFile;
+  while ( readString( in, shaderFile ) ) 
+  {
+    liqShaderInfo info;
+    if ( !( readString( in, info.expectedType ) && ( in >> info.mtime >> info.size ) &&
+            readString( in, info.name ) && readString( in, info.type ) &&
+            readStrings( in, info.methods ) && readStrings( in, info.paramNames ) &&
+            readStrings( in, info.paramDetails ) && readStrings( in, info.paramTypes ) &&
+            readStrings( in, info.paramDefaults ) && readStrings( in, info.paramAccept ) &&
+            readInts( in, info.paramIsOutput ) && readInts( in, info.paramArraySizes ) ) ) 
+    {
+      liquidMessage( "[liqShaderInfoCache] " + indexFile + " is corrupted, ignoring the rest of it", messageWarning );
+      break;
+    }
+    infos[ shaderFile.asChar() ] = info;
+  }
+  LIQDEBUGPRINTF( "-> read %u shaders from %s\n", ( unsigned )infos.size(), indexFile.asChar() );
+}
+
+/** Write the whole index to a temporary file, then rename it over the old one.
+ */
+void liqShaderInfoCache::save() const
+{
+  MString tmpFile( indexFile + ".tmp" );
+  {
+    ofstream out( tmpFile.asChar(), ios::binary | ios::trunc );
+    if ( !out ) 
+    {
+      liquidMessage( "[liqShaderInfoCache] can't write " + tmpFile, messageWarning );
+      return;
+    }
+    out.precision( 17 );
+    out << "liquidShaderInfo " << liqShaderInfoIndexVersion << "\n";
+    for ( map< string, liqShaderInfo >::const_iterator it( infos.begin() ); it != infos.end(); ++it ) 
+    {
+      const liqShaderInfo &info( it->second );
+      writeString( out, it->first.c_str() );
+      writeString( out, info.expectedType );
+      out << info.mtime << " " << info.size << "\n";
+      writeString( out, info.name );
+      writeString( out, info.type );
+      writeStrings( out, info.methods );
+      writeStrings( out, info.paramNames );
+      writeStrings( out, info.paramDetails );
+      writeStrings( out, info.paramTypes );
+      writeStrings( out, info.paramDefaults );
+      writeStrings( out, info.paramAccept );
+      writeInts( out, info.paramIsOutput );
+      writeInts( out, info.paramArraySizes );
+    }
+  }
+  remove( indexFile.asChar() );
+  rename( tmpFile.asChar(), indexFile.asChar() );
+}
+
+
+// mel string literal
+static MString melQuote( const MString &s )
+{
+  MString quoted( "\"" );
+  const char *c( s.asChar() );
+  for ( ; *c; c++ ) 
+  {
+    if ( *c == '"' || *c == '\\' ) quoted += "\\";
+    if ( *c == '\n' ) quoted += "\\n";
+    else 
+    {
+      char ch[ 2 ] = { *c, 0 };
+      quoted += ch;
+    }
+  }
+  return quoted + "\"";
+}
+
+static MString melArray( const MString &type, const MString &global, const MStringArray &values, bool quote )
+{
+  MString cmd( "global " + type + " " + global + "[]; clear " + global + ";" );
+  if ( !values.length() ) return cmd;
+  cmd += " " + global + " = {";
+  for ( unsigned i( 0 ); i < values.length(); i++ ) 
+    cmd += ( i ? ", " : " " ) + ( quote ? melQuote( values[ i ] ) : values[ i ] );
+  return cmd + " };";
+}
+
+static MStringArray toStrings( const MIntArray &ints )
+{
+  MStringArray strings;
+  for ( unsigned i( 0 ); i < ints.length(); i++ ) strings.append( MString() + ints[ i ] );
+  return strings;
+}
+
+MStatus liqShaderInfoCache::setMelGlobals( const liqShaderInfo &info )
+{
+  MString cmd;
+  cmd += "global string $gLiquidSlShaderName; $gLiquidSlShaderName = " + melQuote( info.name ) + ";\n";
+  cmd += "global string $gLiquidSlShaderType; $gLiquidSlShaderType = " + melQuote( info.type ) + ";\n";
+  cmd += "global int $gLiquidSlNumMethods; $gLiquidSlNumMethods = " + MString() + ( int )info.methods.length() + ";\n";
+  cmd += melArray( "string", "$gLiquidSlMethods", info.methods, true ) + "\n";
+  cmd += "global int $gLiquidSlNumParams; $gLiquidSlNumParams = " + MString() + ( int )info.paramNames.length() + ";\n";
+  cmd += melArray( "string", "$gLiquidSlParamNames", info.paramNames, true ) + "\n";
+  cmd += melArray( "string", "$gLiquidSlParamDetails", info.paramDetails, true ) + "\n";
+  cmd += melArray( "string", "$gLiquidSlParamTypes", info.paramTypes, true ) + "\n";
+  cmd += melArray( "string", "$gLiquidSlParamDefaults", info.paramDefaults, true ) + "\n";
+  cmd += melArray( "string", "$gLiquidSlParamAccept", info.paramAccept, true ) + "\n";
+  cmd += melArray( "int", "$gLiquidSlParamIsOutput", toStrings( info.paramIsOutput ), false ) + "\n";
+  cmd += melArray( "int", "$gLiquidSlParamArraySizes", toStrings( info.paramArraySizes ), false ) + "\n";
+  return MGlobal::executeCommand( cmd );
+}
+
+// the parsers don't all fill every array : pad them like mel would read them
+template < class T, class V > static void padArray( T &values, unsigned length, const V &value )
+{
+  while ( values.length() < length ) values.append( value );
+}
+
+MStatus liqShaderInfoCache::getMelGlobals( liqShaderInfo &info )
+{
+  MStatus status;
+  int numParams( 0 );
+  status = MGlobal::executeCommand( "liquidSlShaderName()", info.name );
+  if ( status == MS::kSuccess ) status = MGlobal::executeCommand( "liquidSlShaderType()", info.type );
+  if ( status == MS::kSuccess ) status = MGlobal::executeCommand( "liquidSlNumParams()", numParams );
+  if ( status == MS::kSuccess ) status = MGlobal::executeCommand( "liquidSlAllMethods()", info.methods );
+  if ( status == MS::kSuccess ) status = MGlobal::executeCommand( "liquidSlAllParamNames()", info.paramNames );
+  if ( status == MS::kSuccess ) status = MGlobal::executeCommand( "liquidSlAllParamDetails()", info.paramDetails );
+  if ( status == MS::kSuccess ) status = MGlobal::executeCommand( "liquidSlAllParamTypes()", info.paramTypes );
+  if ( status == MS::kSuccess ) status = MGlobal::executeCommand( "liquidSlAllParamDefaults()", info.paramDefaults );
+  if ( status == MS::kSuccess ) status = MGlobal::executeCommand( "liquidSlAllParamAccept()", info.paramAccept );
+  if ( status == MS::kSuccess ) status = MGlobal::executeCommand( "liquidSlAllParamIsOutput()", info.paramIsOutput );
+  if ( status == MS::kSuccess ) status = MGlobal::executeCommand( "liquidSlAllParamArraySizes()", info.paramArraySizes );
+  if ( status != MS::kSuccess || numParams < 0 || info.paramNames.length() != ( unsigned )numParams ) return MS::kFailure;
+
+  padArray( info.paramDetails,    numParams, MString() );
+  padArray( info.paramTypes,      numParams, MString() );
+  padArray( info.paramDefaults,   numParams, MString() );
+  padArray( info.paramAccept,     numParams, MString() );
+  padArray( info.paramIsOutput,   numParams, 0 );
+  padArray( info.paramArraySizes, numParams, 0 );
+  return MS::kSuccess;
+}
+
+
+#if defined( PRMAN ) || defined( DELIGHT ) || defined( AQSIS )
+
+#if defined( AQSIS )
+#define LIQ_SL( f )         SLX_##f
+#define LIQ_SL_T( t )       SLX_##t
+#define LIQ_SL_FIRST_ARG    0
+#define LIQ_SL_EXTENSION    "slx"
+typedef SLX_VISSYMDEF       liqSlSymbol;
+#else
+#define LIQ_SL( f )         Slo_##f
+#define LIQ_SL_T( t )       SLO_##t
+#define LIQ_SL_FIRST_ARG    1
+#if defined( DELIGHT )
+#define LIQ_SL_EXTENSION    "sdl"
+#else
+#define LIQ_SL_EXTENSION    "slo"
+#endif
+typedef SLO_VISSYMDEF       liqSlSymbol;
+#endif
+
+// float in the liquidSl_getParamDefaultF notation
+static MString slFloat( float f )
+{
+  char buffer[ 64 ];
+  sprintf( buffer, "%g", f );
+  MString s( buffer );
+  if ( s.index( '.' ) < 0 && s.index( 'e' ) < 0 && s.index( 'n' ) < 0 ) s += ".0";
+  return s;
+}
+
+static MString slDefault( const liqSlSymbol *symbol, const MString &type )
+{
+  bool valid( symbol->svd_valisvalid && symbol->svd_default.scalarval );
+  if ( type == "float" ) 
+    return valid ? slFloat( *symbol->svd_default.scalarval ) : MString( "0.0" );
+  if ( type == "string" || type == "shader" ) 
+    return ( valid && type == "string" && symbol->svd_default.stringval )? melQuote( symbol->svd_default.stringval ) : MString( "\"\"" );
+  if ( type == "matrix" ) 
+  {
+    MString s;
+    for ( unsigned i( 0 ); i < 16; i++ ) s += ( i ? ", " : "" ) + ( valid ? slFloat( symbol->svd_default.matrixval[ i ] ) : MString( "0" ) );
+    return s;
+  }
+  if ( !valid ) return "<<0,0,0>>";
+  return "<<" + slFloat( symbol->svd_default.pointval->xval ) + ", " + slFloat( symbol->svd_default.pointval->yval ) + ", " + slFloat( symbol->svd_default.pointval->zval ) + ">>";
+}
+
+/** In-process read through the renderer's shader query library.
+ */
+bool liqShaderInfoCache::readNative( const MString &shaderFile, const MString &expectedType, liqShaderInfo &info ) const
+{
+  MString extension( shaderFile.substring( shaderFile.rindex( '.' ) + 1, shaderFile.length() - 1 ) );
+  if ( extension != LIQ_SL_EXTENSION ) return false;
+
+  // the query libraries want the shader without its extension
+  MString shaderName( shaderFile.substring( 0, shaderFile.rindex( '.' ) - 1 ) );
+  if ( LIQ_SL( SetShader )( const_cast< char* >( shaderName.asChar() ) ) ) return false;
+
+  bool ok( true );
+  info = liqShaderInfo();
+  info.name = LIQ_SL( GetName )();
+  info.type = LIQ_SL( TypetoStr )( LIQ_SL( GetType )() );
+
+  // co-shaders get their type from their methods, that the query
+  // libraries don't all give : leave them to the mel parsers.
+  if ( info.type == "shader" ) ok = false;
+
+  int numArgs( LIQ_SL( GetNArgs )() );
+  for ( int i( 0 ); ok && i < numArgs; i++ ) 
+  {
+    liqSlSymbol *symbol( LIQ_SL( GetArgById )( i + LIQ_SL_FIRST_ARG ) );
+    if ( !symbol ) 
+    {
+      ok = false;
+      break;
+    }
+    MString type( LIQ_SL( TypetoStr )( symbol->svd_type ) );
+    int arraySize( symbol->svd_arraylen > 0 ? ( int )symbol->svd_arraylen : -1 );
+
+    MString defaults;
+    if ( arraySize > 0 ) 
+    {
+      for ( int e( 0 ); e < arraySize; e++ ) 
+      {
+        liqSlSymbol *element( LIQ_SL( GetArrayArgElement )( symbol, e ) );
+        defaults += ( e ? ", " : "" ) + ( element ? slDefault( element, type ) : MString( "0.0" ) );
+      }
+    } 
+    else 
+      defaults = slDefault( symbol, type );
+    if ( arraySize > 0 || type == "matrix" ) defaults = "{" + defaults + "}";
+
+    info.paramNames.append( symbol->svd_name );
+    info.paramDetails.append( symbol->svd_detail == LIQ_SL_T( DETAIL_UNIFORM ) ? "uniform" : "varying" );
+    info.paramTypes.append( type );
+    info.paramDefaults.append( defaults );
+    info.paramAccept.append( type == "shader" ? "*" : "" );
+    info.paramIsOutput.append( symbol->svd_storage == LIQ_SL_T( STOR_OUTPUTPARAMETER ) ? 1 : 0 );
+    info.paramArraySizes.append( arraySize );
+  }
+  LIQ_SL( EndShader )();
+
+  LIQDEBUGPRINTF( "-> read shader info of %s in-process : %s\n", shaderFile.asChar(), ok ? "ok" : "failed" );
+  return ok;
+}
+
+#else
+
+bool liqShaderInfoCache::readNative( const MString &shaderFile, const MString &expectedType, liqShaderInfo &info ) const
+{
+  // no shader query library in this build
+  return false;
+}
+
+#endif
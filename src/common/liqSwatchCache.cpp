@@ -0,0 +1,315 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Swatch Cache Source
+** ______________________________________________________________________
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+// Maya's Headers
+#include <maya/MSelectionList.h>
+#include <maya/MFnDependencyNode.h>
+
+#include <liquid.h>
+#include <liqGlobalHelpers.h>
+#include <liqShader.h>
+#include <liqHash.h>
+#include <liqSwatchCache.h>
+
+extern int debugMode;
+
+static const char liqSwatchMagic[ 4 ] = { 'L', 'S', 'W', '1' };
+
+/**
+ * Hash a shader node: its file, its parameter values and its co-shaders.
+ * String parameters naming files (mostly textures) add their dates.
+ */
+static bool hashShader( liqHash& hash, MObject shaderObj, int depth )
+{
+  if ( depth > 8 ) return true; // co-shader cycle
+  MStatus status;
+  MFnDependencyNode node( shaderObj );
+  MString shaderFile;
+  liquidGetPlugValue( node, "rmanShaderLong", shaderFile, status );
+  hash.addFile( shaderFile.asChar() );
+
+  liqShader shader( shaderObj );
+  if ( shader.hasErrors ) return false;
+
+  hash.add( ( int )shader.shader_type );
+  hash.add( shader.m_previewGamma );
+  hash.add( shader.rmColor, sizeof( RtColor ) );
+  hash.add( shader.rmOpacity, sizeof( RtColor ) );
+  hash.add( string( shader.shaderSpace.asChar() ) );
+
+  // the last element is the empty one the next parameter would go in
+  for ( unsigned i( 0 ); i + 1 < shader.tokenPointerArray.size(); i++ ) 
+  {
+    liqTokenPointer& token( shader.tokenPointerArray[ i ] );
+    hash.add( token.getDetailedTokenName() );
+    if ( token.getTokenFloatArraySize() ) 
+      hash.add( token.getTokenFloatArray(), token.getTokenFloatArraySize() * sizeof( RtFloat ) );
+    const vector< string >& strings( token.getTokenStringArray() );
+    for ( unsigned j( 0 ); j < strings.size(); j++ ) 
+    {
+      if ( fileExists( strings[ j ].c_str() ) ) hash.addFile( strings[ j ] );
+      else                                      hash.add( strings[ j ] );
+    }
+  }
+  for ( unsigned i( 0 ); i < shader.m_coShaderArray.size(); i++ ) 
+    if ( !hashShader( hash, shader.m_coShaderArray[ i ], depth + 1 ) ) return false;
+  return true;
+}
+
+liqSwatchCache& liqSwatchCache::instance()
+{
+  static liqSwatchCache cache;
+  return cache;
+}
+
+liqSwatchCache::liqSwatchCache()
+{
+  m_directory = getEnvironment( "LIQUIDSWATCHCACHE" );
+  if ( m_directory.empty() ) 
+  {
+    string home( getEnvironment( "HOME" ) );
+#ifdef _WIN32
+    if ( home.empty() ) home = getEnvironment( "TEMP" );
+#endif
+    if ( !home.empty() ) m_directory = liquidSanitizePath( home ) + "/.liquid/swatches";
+  }
+  string limit( getEnvironment( "LIQUIDSWATCHCACHESIZE" ) );
+  m_limit = ( limit.empty() ? 256. : atof( limit.c_str() ) ) * 1024. * 1024.;
+  m_size = -1.;
+}
+
+/**
+ * Compute the key of a preview, and remember it for the node so the swatch
+ * finds the image once it is rendered.
+ * Returns, and remembers, an empty string when the shader can't be read.
+ */
+MString liqSwatchCache::key( const liqPreviewShaderOptions& options )
+{
+  liqHash hash;
+  if ( options.fullShaderPath ) 
+  {
+    hash.addFile( options.shaderNodeName );
+    hash.add( options.type );
+  } 
+  else 
+  {
+    MSelectionList list;
+    MObject shaderObj;
+    list.add( options.shaderNodeName.c_str() );
+    list.getDependNode( 0, shaderObj );
+    if ( shaderObj.isNull() || !hashShader( hash, shaderObj, 0 ) ) 
+    {
+      m_nodeKeys[ options.shaderNodeName ] = MString();
+      return MString();
+    }
+  }
+  hash.add( options.primitiveType );
+  hash.add( options.displaySize );
+  hash.add( options.pixelSamples );
+  hash.add( options.objectScale );
+  hash.add( options.shadingRate );
+  hash.add( options.previewIntensity );
+  hash.add( ( int )options.backPlane );
+  hash.add( options.backPlaneShader );
+  hash.addFile( options.customRibFile );
+  hash.addFile( options.customBackplane );
+  hash.add( options.renderCommand );
+
+  MString key( hash.str() );
+  m_nodeKeys[ options.shaderNodeName ] = key;
+  return key;
+}
+
+/**
+ * The key remembered for the node, false if there is none yet.
+ * The key is empty when the node has no cacheable preview.
+ */
+bool liqSwatchCache::keyOf( const MString& node, MString& key ) const
+{
+  map< string, MString >::const_iterator it( m_nodeKeys.find( node.asChar() ) );
+  if ( it == m_nodeKeys.end() ) return false;
+  key = it->second;
+  return true;
+}
+
+void liqSwatchCache::setKeyOf( const MString& node, const MString& key )
+{
+  m_nodeKeys[ node.asChar() ] = key;
+}
+
+string liqSwatchCache::path( const MString& key ) const
+{
+  return m_directory + "/" + key.asChar() + ".lsw";
+}
+
+bool liqSwatchCache::contains( const MString& key ) const
+{
+  if ( m_directory.empty() || key == "" ) return false;
+  return fileExists( path( key ).c_str() );
+}
+
+/**
+ * Read a swatch, and mark it as used.
+ */
+bool liqSwatchCache::find( const MString& key, MImage& image )
+{
+  if ( m_directory.empty() || key == "" ) return false;
+  string file( path( key ) );
+  FILE* fp( fopen( file.c_str(), "rb" ) );
+  if ( !fp ) return false;
+
+  char magic[ 4 ];
+  unsigned size[ 2 ];
+  bool ok( fread( magic, 4, 1, fp ) == 1 && !memcmp( magic, liqSwatchMagic, 4 )
+        && fread( size, sizeof( unsigned ), 2, fp ) == 2 && size[ 0 ] && size[ 1 ] && size[ 0 ] <= 4096 && size[ 1 ] <= 4096 );
+  if ( ok ) 
+  {
+    image.create( size[ 0 ], size[ 1 ], 4, MImage::kByte );
+    ok = fread( image.pixels(), 4 * size[ 0 ], size[ 1 ], fp ) == size[ 1 ];
+  }
+  fclose( fp );
+  if ( ok ) utime( file.c_str(), NULL );
+  LIQDEBUGPRINTF( "-> swatch cache: %s %s\n", ok ? "hit" : "bad entry", file.c_str() );
+  return ok;
+}
+
+void liqSwatchCache::store( const MString& key, MImage& image )
+{
+  if ( m_directory.empty() || key == "" ) return;
+  unsigned size[ 2 ];
+  if ( !image.getSize( size[ 0 ], size[ 1 ] ) || !image.pixels() ) return;
+
+  makeFullPath( m_directory, 0755 );
+  // written aside and renamed: other sessions share the directory
+  char suffix[ 32 ];
+  sprintf( suffix, ".%d.tmp", ( int )getpid() );
+  string file( path( key ) ), tmp( file + suffix );
+  FILE* fp( fopen( tmp.c_str(), "wb" ) );
+  if ( !fp ) return;
+  bool ok( fwrite( liqSwatchMagic, 4, 1, fp ) == 1 
+        && fwrite( size, sizeof( unsigned ), 2, fp ) == 2 
+        && fwrite( image.pixels(), 4 * size[ 0 ], size[ 1 ], fp ) == size[ 1 ] );
+  fclose( fp );
+#ifdef _WIN32
+  remove( file.c_str() );
+#endif
+  if ( !ok || rename( tmp.c_str(), file.c_str() ) ) 
+  {
+    remove( tmp.c_str() );
+    return;
+  }
+  if ( m_size >= 0. ) m_size += 12. + 4. * size[ 0 ] * size[ 1 ];
+  if ( m_size < 0. || m_size > m_limit ) evict();
+}
+
+struct liqSwatchFile
+{
+  string name;
+  time_t used;
+  double size;
+  bool operator<( const liqSwatchFile& other ) const { return used < other.used; }
+};
+
+/**
+ * Measure the directory and remove the least recently used swatches until
+ * it is back under 3/4 of the limit.
+ */
+void liqSwatchCache::evict()
+{
+  vector< liqSwatchFile > files;
+#ifdef _WIN32
+  struct _finddata_t data;
+  intptr_t handle( _findfirst( ( m_directory + "/*.lsw" ).c_str(), &data ) );
+  if ( handle != -1 ) 
+  {
+    do 
+    {
+      liqSwatchFile f;
+      f.name = m_directory + "/" + data.name;
+      f.used = data.time_write;
+      f.size = ( double )data.size;
+      files.push_back( f );
+    } 
+    while ( !_findnext( handle, &data ) );
+    _findclose( handle );
+  }
+#else
+  DIR* dir( opendir( m_directory.c_str() ) );
+  if ( dir ) 
+  {
+    struct dirent* entry;
+    while ( ( entry = readdir( dir ) ) ) 
+    {
+      string name( entry->d_name );
+      if ( name.length() < 5 || name.substr( name.length() - 4 ) != ".lsw" ) continue;
+      liqSwatchFile f;
+      f.name = m_directory + "/" + name;
+      struct stat sbuf;
+      if ( stat( f.name.c_str(), &sbuf ) ) continue;
+      f.used = sbuf.st_mtime;
+      f.size = ( double )sbuf.st_size;
+      files.push_back( f );
+    }
+    closedir( dir );
+  }
+#endif
+  m_size = 0.;
+  for ( unsigned i( 0 ); i < files.size(); i++ ) m_size += files[ i ].size;
+  if ( m_size <= m_limit ) return;
+
+  sort( files.begin(), files.end() );
+  for ( unsigned i( 0 ); i < files.size() && m_size > .75 * m_limit; i++ ) 
+  {
+    if ( remove( files[ i ].name.c_str() ) ) continue;
+    m_size -= files[ i ].size;
+  }
+  LIQDEBUGPRINTF( "-> swatch cache: evicted down to %.0f bytes\n", m_size );
+}
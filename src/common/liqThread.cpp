@@ -0,0 +1,136 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version 1.1 (the
+** "License"); you may not use this file except in compliance with the License. You may
+** obtain a copy of the License at http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis, WITHOUT
+** WARRANTY OF ANY KIND, either express or implied. See the License for the specific
+** language governing rights and limitations under the License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions created by
+** Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid Thread Source
+** ______________________________________________________________________
+*/
+
+#include <liqThread.h>
+
+#ifdef _WIN32
+
+liqMutex::liqMutex()
+{
+  InitializeCriticalSection( &m_section );
+}
+
+liqMutex::~liqMutex()
+{
+  DeleteCriticalSection( &m_section );
+}
+
+void liqMutex::lock()
+{
+  EnterCriticalSection( &m_section );
+}
+
+void liqMutex::unlock()
+{
+  LeaveCriticalSection( &m_section );
+}
+
+liqThread::liqThread()
+: m_handle( NULL ), m_run( NULL ), m_data( NULL ), m_running( false )
+{
+}
+
+DWORD WINAPI liqThread::run( LPVOID thread )
+{
+  liqThread *self = ( liqThread* )thread;
+  self->m_run( self->m_data );
+  return 0;
+}
+
+bool liqThread::start( function run, void *data )
+{
+  join();
+  m_run  = run;
+  m_data = data;
+  m_handle = CreateThread( NULL, 0, liqThread::run, this, 0, NULL );
+  m_running = ( m_handle != NULL );
+  return m_running;
+}
+
+void liqThread::join()
+{
+  if ( !m_running )
+    return;
+  WaitForSingleObject( m_handle, INFINITE );
+  CloseHandle( m_handle );
+  m_handle = NULL;
+  m_running = false;
+}
+
+#else // _WIN32
+
+liqMutex::liqMutex()
+{
+  pthread_mutex_init( &m_mutex, NULL );
+}
+
+liqMutex::~liqMutex()
+{
+  pthread_mutex_destroy( &m_mutex );
+}
+
+void liqMutex::lock()
+{
+  pthread_mutex_lock( &m_mutex );
+}
+
+void liqMutex::unlock()
+{
+  pthread_mutex_unlock( &m_mutex );
+}
+
+liqThread::liqThread()
+: m_running( false )
+{
+}
+
+bool liqThread::start( function run, void *data )
+{
+  join();
+  m_running = ( pthread_create( &m_thread, NULL, run, data ) == 0 );
+  return m_running;
+}
+
+void liqThread::join()
+{
+  if ( !m_running )
+    return;
+  pthread_join( m_thread, NULL );
+  m_running = false;
+}
+
+#endif // _WIN32
+
+liqThread::~liqThread()
+{
+  join();
+}
@@ -406,6 +406,16 @@ string liqTokenPointer::getTokenString() const
   return m_tokenString[0];
 }
 
+unsigned liqTokenPointer::getTokenFloatArraySize() const
+{
+  return m_tokenFloats ? m_tokenSize : 0;
+}
+
+const vector< string >& liqTokenPointer::getTokenStringArray() const
+{
+  return m_tokenString;
+}
+
 void liqTokenPointer::setTokenString( unsigned int i, const string& str )
 {
   assert( i >= m_arraySize );
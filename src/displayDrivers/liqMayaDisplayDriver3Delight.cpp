@@ -43,11 +43,8 @@ using std::endl;
 using namespace std;
 #define HERE  cout<<"at "<<__LINE__<<" in "<<__FUNCTION__<<endl;
 #define INFO(EXPR,ENDL) cout<<#EXPR<<" "<<EXPR<<" ";if(ENDL)cout<<endl;
-int timeout = 30;
 static int recoverFlag=0;
-static int socketId = -1;
 
-int sendSockData(int s,char * data,int n);
 
 // User parameters
 const void* GetParameter(
@@ -104,8 +101,8 @@ DspyImageOpen(PtDspyImageHandle *pvImage,
               PtFlagStuff *flagstuff) {
 	int i,origin[2],originalSize[2],rc;
 
-	int status =0;
 	int port = 6667;
+	int timeout = 30;
 
 	if (0 == width)
 		width = 640;
@@ -145,30 +142,31 @@ DspyImageOpen(PtDspyImageHandle *pvImage,
 	port = _port ? *_port: 6667;
 	timeout = _timeout ? *_timeout : 30;
 
-	imageInfo *imgSpecs = new imageInfo;
-	imgSpecs->channels = formatCount;
-	imgSpecs->width      = width;
-	imgSpecs->height      = height;
-	imgSpecs->xo = origin[0];
-	imgSpecs->yo = origin[1];
-	imgSpecs->wo = originalSize[0];
-	imgSpecs->ho = originalSize[1];
-
-	*pvImage = imgSpecs;
-	socketId = openSocket(hostname, port);
-	if(socketId == false)
-		return PkDspyErrorNoResource;
-
-	if(!waitSocket(socketId,timeout,false))	{
-		cerr<<"[d_liqmaya] Error: timeout"<<endl;
-		return PkDspyErrorNoResource;
-	}
-	status = sendSockData(socketId,(char*)imgSpecs,sizeof(imageInfo));
-	if(status == false){
-		perror("[d_liqmaya] Error: write(socketId,wh,2*sizeof(int))");
+	char **_encoding = (char **)GetParameter( "bucketEncoding", paramCount, parameters );
+	char **_statsFile = (char **)GetParameter( "statsFile", paramCount, parameters );
+	char **_resumeFile = (char **)GetParameter( "resumeFile", paramCount, parameters );
+
+	liqMayaDisplayDriverImage *image = new liqMayaDisplayDriverImage;
+	image->info.channels = formatCount;
+	image->info.width    = width;
+	image->info.height   = height;
+	image->info.xo = origin[0];
+	image->info.yo = origin[1];
+	image->info.wo = originalSize[0];
+	image->info.ho = originalSize[1];
+	image->info.encoding = liqBucketCodec::parse(_encoding ? *_encoding : NULL);
+	image->setName(filename);
+	image->setStatsFile(_statsFile ? *_statsFile : NULL);
+	image->setResumeFile(_resumeFile ? *_resumeFile : NULL);
+	for(i=0;i<formatCount;i++)
+		image->addChannel(format[i].name);
+
+	if(!image->connect(hostname, port, timeout))
+	{
+		delete image;
 		return PkDspyErrorNoResource;
 	}
-
+	*pvImage = image;
 	return PkDspyErrorNone;
 }
 
@@ -217,70 +215,20 @@ PtDspyError DspyImageData(PtDspyImageHandle pvImage,
                           int entrysize,
                           const unsigned char *data) {
 
-	// if(recoverFlag && (ymin<image->recoverLine))return PkDspyErrorNone;
-
-	imageInfo *spec = (imageInfo*)pvImage;
-	PtDspyError status = sendData(socketId,xmin,xmax_plusone,ymin,ymax_plusone,entrysize,spec->channels,(BUCKETDATATYPE*)data);
-	if(status != PkDspyErrorNone)
-		DspyImageClose(pvImage);
-	return status;
-
-}
-
-PtDspyError DspyImageClose(PtDspyImageHandle pvImage) {
-	bucket::bucketInfo binfo;
-#ifdef _WIN32
-	memset(&binfo,0,sizeof(bucket::bucketInfo));
-#else
-	bzero(&binfo,sizeof(bucket::bucketInfo));
-#endif
-    sendSockData(socketId, (char*) &binfo,sizeof(bucket::bucketInfo));
-
-	closesocket(socketId);
-	return PkDspyErrorNone;
-}
-
-PtDspyError sendData(const int socket,
-			 const int xmin,
-			 const int xmax_plusone,
-			 const int ymin,
-			 const int ymax_plusone,
-			 const int entrysize,
-			 const int numChannels,
-			 const BUCKETDATATYPE *data) {
-	int status =0;
-	int size = (xmax_plusone-xmin)*(ymax_plusone-ymin)*numChannels*sizeof(BUCKETDATATYPE);
-	bucket::bucketInfo binfo;
-	binfo.left      = xmin;
-	binfo.right     = xmax_plusone;
-	binfo.bottom    = ymin;
-	binfo.top       = ymax_plusone;
-	binfo.channels  = numChannels;
-
-	if(!waitSocket(socket,timeout,false)){
-		cerr<<"[d_liqmaya] Error: timeout reached, data cannot be sent"<<endl;
-		return PkDspyErrorUndefined;
-	}
-
-	status = sendSockData(socket, (char*)&binfo,sizeof(bucket::bucketInfo));
-	if(status == false){
-		perror("[d_liqmaya] Error: write(socket,bucketInfo)");
-		return PkDspyErrorNoResource;
-	}
-	if(!waitSocket(socket,timeout,false)){
-		cerr<<"[d_liqmaya] Error: timeout reached, data cannot be sent"<<endl;
-		return PkDspyErrorUndefined;
-	}
-	status = sendSockData(socket, (char*)data,size);
-	if(status == false){
-		perror("[d_liqmaya] Error: write(socket,data)");
+	liqMayaDisplayDriverImage *image = (liqMayaDisplayDriverImage*)pvImage;
+	if(!image->sendBucket(xmin,xmax_plusone,ymin,ymax_plusone,(const BUCKETDATATYPE*)data))
+	{
+		image->close();
 		return PkDspyErrorNoResource;
 	}
 	return PkDspyErrorNone;
 
 }
-  
 
+PtDspyError DspyImageClose(PtDspyImageHandle pvImage) {
+	delete (liqMayaDisplayDriverImage*)pvImage;
+	return PkDspyErrorNone;
+}
 
 int openSocket(const char *host, const int port)
 {
@@ -350,3 +298,19 @@ int sendSockData(int s,char * data,int n){
 	}
 	return true;
 }
+
+int readSockData(int s,char * data,int n){
+	int i;
+	while(n > 0)
+  {
+		i = recv(s,data,n,0);
+		if (i <= 0)
+    {
+			perror("[d_liqmaya] Connection broken (receiving)");
+			return false;
+		}
+		data += i;
+		n -= i;
+	}
+	return true;
+}
@@ -168,14 +168,6 @@ EXPORT PtDspyError DspyImageDelayClose(PtDspyImageHandle image);
 #include "liqBucket.h"
 
 int openSocket(const char *host, const int port) ;
-PtDspyError sendData(const int socket,
-			 const int xmin,
-			 const int xmax_plusone,
-			 const int ymin,
-			 const int ymax_plusone,
-			 const int entrysize,
-			 const int channels,
-			 const BUCKETDATATYPE *data) ;
 
 
 //check if socket is ready for a connection
@@ -202,6 +194,8 @@ int waitSocket(const int fd,const int seconds, const bool check_readable = true)
   return FD_ISSET(fd,&fds) ? 1 : 0;
 }
 
+#include "liqMayaDisplayDriverImage.h"
+
 //#pragma options align=reset
 
 #endif        //  #if !defined(__D_LIQMAYA_H__)
@@ -43,11 +43,8 @@ using std::endl;
 using namespace std;
 #define HERE  cout<<"at "<<__LINE__<<" in "<<__FUNCTION__<<endl;
 #define INFO(EXPR,ENDL) cout<<#EXPR<<" "<<EXPR<<" ";if(ENDL)cout<<endl;
-int timeout = 30;
 static int recoverFlag=0;
-static int socketId = -1;
 
-int sendSockData(int s,char * data,int n);
 
 
 #ifndef _WIN32
@@ -251,7 +248,7 @@ DspyImageOpen(PtDspyImageHandle *pvImage,
 {
 	int i,origin[2],originalSize[2],rc;
 
-	int status =0;
+	int timeout = 30;
 	int port = 6667;
 
 	if (0 == width)
@@ -313,46 +310,42 @@ DspyImageOpen(PtDspyImageHandle *pvImage,
 		timeout = 30;
 //	printf( "[d_liqmaya] timeout = %d\n", timeout );
 
-	imageInfo *imgSpecs = new imageInfo;
-	imgSpecs->channels = formatCount;
-	imgSpecs->width      = width;
-	imgSpecs->height     = height;
-	imgSpecs->xo = origin[0];
-	imgSpecs->yo = origin[1];
-	imgSpecs->wo = originalSize[0];
-	imgSpecs->ho = originalSize[1];
-//  printf("[d_liqmaya] pvImage = %lu\n", (unsigned long)(void *)pvImage );
-	*pvImage = imgSpecs;
-	socketId = openSocket(hostname, port);
-	if(socketId == -1)
+	char *encoding = NULL;
+	if(PkDspyErrorNone!=DspyFindStringInParamList("bucketEncoding",&encoding,paramCount,parameters))
+		encoding = NULL;
+
+	char *statsFile = NULL;
+	if(PkDspyErrorNone!=DspyFindStringInParamList("statsFile",&statsFile,paramCount,parameters))
+		statsFile = NULL;
+
+	char *resumeFile = NULL;
+	if(PkDspyErrorNone!=DspyFindStringInParamList("resumeFile",&resumeFile,paramCount,parameters))
+		resumeFile = NULL;
+
+	liqMayaDisplayDriverImage *image = new liqMayaDisplayDriverImage;
+	image->info.channels = formatCount;
+	image->info.width    = width;
+	image->info.height   = height;
+	image->info.xo = origin[0];
+	image->info.yo = origin[1];
+	image->info.wo = originalSize[0];
+	image->info.ho = originalSize[1];
+	image->info.encoding = liqBucketCodec::parse(encoding);
+	image->setName(filename);
+	image->setStatsFile(statsFile);
+	image->setResumeFile(resumeFile);
+	for(i=0;i<formatCount;i++)
+		image->addChannel(format[i].name);
+
+	if(!image->connect(hostname, port, timeout))
 	{
 		#ifdef _WIN32
 			WSACleanup();
 		#endif
-		delete imgSpecs;
-		return PkDspyErrorNoResource;
-	}
-
-	if(!waitSocket(socketId,timeout,false))	
-	{
-		#ifdef _WIN32
-			WSACleanup();
-		#endif
-		cerr<<"[d_liqmaya] Error: timeout"<<endl;
-		delete imgSpecs;
-		return PkDspyErrorNoResource;
-	}
-	status = sendSockData(socketId,(char*)imgSpecs,sizeof(imageInfo));
-
-	if(status == false)
-  {
-		#ifdef _WIN32
-			WSACleanup();
-		#endif
-		perror("[d_liqmaya] Error: write(socketId,wh,2*sizeof(int))");
-		delete imgSpecs;
+		delete image;
 		return PkDspyErrorNoResource;
 	}
+	*pvImage = image;
 	return PkDspyErrorNone;
 }
 
@@ -430,25 +423,18 @@ PtDspyError DspyImageData(PtDspyImageHandle pvImage,
                           int entrysize,
                           const unsigned char *data) 
 {
-	// if(recoverFlag && (ymin<image->recoverLine))return PkDspyErrorNone;
-
-	imageInfo *spec = (imageInfo*)pvImage;
-	PtDspyError status = sendData(socketId,xmin,xmax_plusone,ymin,ymax_plusone,entrysize,spec->channels,(BUCKETDATATYPE*)data);
-	if(status != PkDspyErrorNone)
-		DspyImageClose(pvImage);
-	return status;
+	liqMayaDisplayDriverImage *image = (liqMayaDisplayDriverImage*)pvImage;
+	if(!image->sendBucket(xmin,xmax_plusone,ymin,ymax_plusone,(const BUCKETDATATYPE*)data))
+	{
+		image->close();
+		return PkDspyErrorNoResource;
+	}
+	return PkDspyErrorNone;
 }
 
 PtDspyError DspyImageClose(PtDspyImageHandle pvImage) 
 {
-	bucket::bucketInfo binfo;
-#ifdef _WIN32
-	memset(&binfo,0,sizeof(bucket::bucketInfo));
-#else
-	bzero(&binfo,sizeof(bucket::bucketInfo));
-#endif
-  sendSockData(socketId, (char*) &binfo,sizeof(bucket::bucketInfo));
-	closesocket(socketId);
+	delete (liqMayaDisplayDriverImage*)pvImage;
 #ifdef _WIN32
 	WSACleanup();
 #endif
@@ -457,48 +443,6 @@ PtDspyError DspyImageClose(PtDspyImageHandle pvImage)
 }
 
 
-PtDspyError sendData(const int socket,
-                     const int xmin,
-                     const int xmax_plusone,
-                     const int ymin,
-                     const int ymax_plusone,
-                     const int entrysize,
-                     const int numChannels,
-                     const BUCKETDATATYPE *data) 
-{
-	int status =0;
-	int size = (xmax_plusone-xmin)*(ymax_plusone-ymin)*numChannels*sizeof(BUCKETDATATYPE);
-	bucket::bucketInfo binfo;
-	binfo.left      = xmin;
-	binfo.right     = xmax_plusone;
-	binfo.bottom    = ymin;
-	binfo.top       = ymax_plusone;
-	binfo.channels  = numChannels;
-
-	if(!waitSocket(socket,timeout,false)){
-		cerr<<"[d_liqmaya] Error: timeout reached, data cannot be sent"<<endl;
-		return PkDspyErrorUndefined;
-	}
-
-	status = sendSockData(socket, (char*)&binfo,sizeof(bucket::bucketInfo));
-	if(status == false){
-		perror("[d_liqmaya] Error: write(socket,bucketInfo)");
-		return PkDspyErrorNoResource;
-	}
-	if(!waitSocket(socket,timeout,false)){
-		cerr<<"[d_liqmaya] Error: timeout reached, data cannot be sent"<<endl;
-		return PkDspyErrorUndefined;
-	}
-	status = sendSockData(socket, (char*)data,size);
-	if(status == false){
-		perror("[d_liqmaya] Error: write(socket,data)");
-		return PkDspyErrorNoResource;
-	}
-	return PkDspyErrorNone;
-
-}
-
-
 int openSocket(const char *host, const int port)
 {
 	struct hostent *hostPtr = NULL;
@@ -568,3 +512,19 @@ int sendSockData(int s,char * data,int n){
 	}
 	return true;
 }
+
+int readSockData(int s,char * data,int n){
+	int i;
+	while(n > 0)
+  {
+		i = recv(s,data,n,0);
+		if (i <= 0)
+    {
+			perror("[d_liqmaya] Connection broken (receiving)");
+			return false;
+		}
+		data += i;
+		n -= i;
+	}
+	return true;
+}
@@ -0,0 +1,260 @@
+/*
+**
+** The contents of this file are subject to the Mozilla Public License Version
+** 1.1 (the "License"); you may not use this file except in compliance with
+** the License. You may obtain a copy of the License at
+** http://www.mozilla.org/MPL/
+**
+** Software distributed under the License is distributed on an "AS IS" basis,
+** WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+** for the specific language governing rights and limitations under the
+** License.
+**
+** The Original Code is the Liquid Rendering Toolkit.
+**
+** The Initial Developer of the Original Code is Colin Doncaster. Portions
+** created by Colin Doncaster are Copyright (C) 2002. All Rights Reserved.
+**
+** Contributor(s): Berj Bannayan.
+**
+**
+** The RenderMan (R) Interface Procedures and Protocol are:
+** Copyright 1988, 1989, Pixar
+** All Rights Reserved
+**
+**
+** RenderMan (R) is a registered trademark of Pixar
+*/
+
+/* ______________________________________________________________________
+**
+** Liquid display driver for the maya render view : one opened image
+** ______________________________________________________________________
+*/
+
+#if !defined(__D_LIQMAYA_IMAGE_H__)
+#define __D_LIQMAYA_IMAGE_H__
+
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "liqBucket.h"
+#include "liqBucketCodec.h"
+#include "liqSharedFramebuffer.h"
+#include "liqRenderStats.h"
+#include "liqBucketJournal.h"
+
+// defined by each display driver
+int openSocket(const char *host, const int port);
+int sendSockData(int s,char * data,int n);
+int readSockData(int s,char * data,int n);
+
+/**
+ * Everything one Display line of the liqmaya driver owns: the handle the
+ * renderer passes back is one of these, so several images (AOVs, stereo
+ * eyes) can be sent to the render view from the same render.
+ */
+class liqMayaDisplayDriverImage
+{
+public:
+  imageInfo info;
+
+  liqMayaDisplayDriverImage() : m_socket( -1 ), m_timeout( 30 ), m_encoding( liqBucketCodec::kFloat )
+  {
+    memset( &info, 0, sizeof( imageInfo ) );
+  }
+  ~liqMayaDisplayDriverImage() { close(); }
+
+  /** The image name and channel set identify the image to the receiver. */
+  void setName( const char *name )
+  {
+    if ( name ) strncpy( info.name, name, sizeof( info.name ) - 1 );
+  }
+  void addChannel( const char *name )
+  {
+    size_t length( strlen( info.channelNames ) );
+    if ( !name || length + strlen( name ) + 2 > sizeof( info.channelNames ) ) return;
+    if ( length ) strcat( info.channelNames, "," );
+    strcat( info.channelNames, name );
+  }
+  /** Append what this image measured to a CSV trace when it is closed. */
+  void setStatsFile( const char *file )
+  {
+    if ( file ) m_statsFile = file;
+  }
+  /**
+   * The checkpoint journal liquidRenderView keeps for this image: buckets
+   * it already holds from an interrupted render are not sent again.
+   * info must be filled in.
+   */
+  void setResumeFile( const char *file )
+  {
+    imageInfo journaled;
+    std::string hash;
+    std::vector< bucket::bucketInfo > areas;
+    if ( !file || !*file || !liqBucketJournal::read( file, journaled, hash, areas ) || areas.empty() ) return;
+    if ( strcmp( journaled.name, info.name ) || journaled.wo != info.wo || journaled.ho != info.ho ) return;
+    liqBucketJournal::coverage( areas, info.wo, info.ho, m_done );
+  }
+  /** The first row of the image the renderer has to start from. */
+  int resumeRow() const
+  {
+    for ( int y( 0 ); y < info.height; y++ ) 
+      if ( !isDone( 0, info.width, y, y + 1 ) ) return y;
+    return info.height;
+  }
+
+  /** Connect and agree on the bucket transport, info must be filled in. */
+  bool connect( const char *host, const int port, const int timeout )
+  {
+    m_timeout = timeout;
+    m_stats.reset();
+    m_socket = openSocket( host, port );
+    if ( m_socket == -1 ) return false;
+
+    info.encoding |= liqBucketCodec::kSharedMemory;
+    if ( !waitSocket( m_socket, m_timeout, false ) ) 
+    {
+      std::cerr << "[d_liqmaya] Error: timeout" << std::endl;
+      return false;
+    }
+    if ( !sendSockData( m_socket, ( char* )&info, sizeof( imageInfo ) ) ) 
+    {
+      perror( "[d_liqmaya] Error: write(socket,imageInfo)" );
+      return false;
+    }
+    // the receiver answers with the bucket encoding it accepts
+    if ( !waitSocket( m_socket, m_timeout, true ) || !readSockData( m_socket, ( char* )&m_encoding, sizeof( int ) ) ) 
+    {
+      std::cerr << "[d_liqmaya] Error: no bucket encoding received" << std::endl;
+      return false;
+    }
+    if ( m_encoding & liqBucketCodec::kSharedMemory ) 
+    {
+      // local render: buckets go through a framebuffer mapped by the receiver
+      char name[ liqSharedFramebuffer::kNameSize ];
+      int mapped( readSockData( m_socket, name, sizeof( name ) ) );
+      name[ sizeof( name ) - 1 ] = 0;
+      mapped = mapped && m_framebuffer.open( name );
+      if ( !sendSockData( m_socket, ( char* )&mapped, sizeof( int ) ) ) return false;
+      m_encoding = liqBucketCodec::kFloat;
+    }
+    else 
+      m_encoding = liqBucketCodec::accept( m_encoding );
+    return true;
+  }
+
+  bool sendBucket( const int xmin, const int xmax_plusone, const int ymin, const int ymax_plusone, const BUCKETDATATYPE *data )
+  {
+    bucket::bucketInfo binfo;
+    binfo.left     = xmin;
+    binfo.right    = xmax_plusone;
+    binfo.bottom   = ymin;
+    binfo.top      = ymax_plusone;
+    binfo.channels = info.channels;
+    if ( isDone( xmin, xmax_plusone, ymin, ymax_plusone ) ) return true;
+
+    const unsigned pixels( ( xmax_plusone - xmin ) * ( ymax_plusone - ymin ) );
+    const double start( liqRenderStats::now() );
+    if ( m_framebuffer.isOpen() ) 
+    {
+      if ( m_framebuffer.write( binfo, data, m_timeout ) ) 
+      {
+        m_stats.addBucket( pixels * info.channels * sizeof( BUCKETDATATYPE ), liqRenderStats::now() - start, 0 );
+        return true;
+      }
+      std::cerr << "[d_liqmaya] Error: bucket cannot be written to the shared framebuffer" << std::endl;
+      return false;
+    }
+    if ( !waitSocket( m_socket, m_timeout, false ) ) 
+    {
+      std::cerr << "[d_liqmaya] Error: timeout reached, data cannot be sent" << std::endl;
+      return false;
+    }
+    if ( !sendSockData( m_socket, ( char* )&binfo, sizeof( bucket::bucketInfo ) ) ) 
+    {
+      perror( "[d_liqmaya] Error: write(socket,bucketInfo)" );
+      return false;
+    }
+    if ( !waitSocket( m_socket, m_timeout, false ) ) 
+    {
+      std::cerr << "[d_liqmaya] Error: timeout reached, data cannot be sent" << std::endl;
+      return false;
+    }
+    bool status;
+    double coded( 0 ), size( sizeof( bucket::bucketInfo ) );
+    if ( m_encoding != liqBucketCodec::kFloat ) 
+    {
+      liqBucketCodec::payload header;
+      const double encoding( liqRenderStats::now() );
+      liqBucketCodec::encode( m_encoding, pixels, info.channels, data, m_encoded, header, m_scratch );
+      coded = liqRenderStats::now() - encoding;
+      size += sizeof( liqBucketCodec::payload ) + header.size;
+      status = sendSockData( m_socket, ( char* )&header, sizeof( liqBucketCodec::payload ) );
+      if ( status && header.size ) 
+        status = sendSockData( m_socket, ( char* )&m_encoded[ 0 ], header.size );
+    }
+    else 
+    {
+      size += pixels * info.channels * sizeof( BUCKETDATATYPE );
+      status = sendSockData( m_socket, ( char* )data, pixels * info.channels * sizeof( BUCKETDATATYPE ) );
+    }
+    if ( !status ) perror( "[d_liqmaya] Error: write(socket,data)" );
+    else m_stats.addBucket( size, liqRenderStats::now() - start - coded, coded );
+    return status;
+  }
+
+  /** Tell the receiver the image is done and disconnect. */
+  void close()
+  {
+    if ( m_socket == -1 ) return;
+    if ( m_framebuffer.isOpen() ) 
+    {
+      m_framebuffer.finish();
+      m_framebuffer.close();
+    }
+    else 
+    {
+      bucket::bucketInfo binfo;
+      memset( &binfo, 0, sizeof( bucket::bucketInfo ) );
+      sendSockData( m_socket, ( char* )&binfo, sizeof( bucket::bucketInfo ) );
+    }
+#ifdef _WIN32
+    closesocket( m_socket );
+#else
+    ::close( m_socket );
+#endif
+    m_socket = -1;
+    m_stats.finish();
+    if ( !m_statsFile.empty() && !m_stats.append( m_statsFile.c_str(), "driver", info.name ) ) 
+      std::cerr << "[d_liqmaya] Error: cannot write the stats to " << m_statsFile << std::endl;
+  }
+
+private:
+  /** Pixels of the data window the checkpoint already has. */
+  bool isDone( const int xmin, const int xmax_plusone, const int ymin, const int ymax_plusone ) const
+  {
+    if ( m_done.empty() ) return false;
+    for ( int y( ymin + info.yo ); y < ymax_plusone + info.yo; y++ ) 
+      for ( int x( xmin + info.xo ); x < xmax_plusone + info.xo; x++ ) 
+        if ( x < 0 || y < 0 || x >= info.wo || y >= info.ho || !m_done[ ( size_t )y * info.wo + x ] ) return false;
+    return true;
+  }
+
+  int                           m_socket;
+  int                           m_timeout;
+  int                           m_encoding;
+  std::vector< unsigned char >  m_encoded;
+  std::vector< unsigned char >  m_scratch;
+  liqSharedFramebuffer          m_framebuffer;
+  liqRenderStats                m_stats;
+  std::string                   m_statsFile;
+  std::vector< unsigned char >  m_done;
+
+  liqMayaDisplayDriverImage( const liqMayaDisplayDriverImage& );
+  liqMayaDisplayDriverImage& operator=( const liqMayaDisplayDriverImage& );
+};
+
+#endif
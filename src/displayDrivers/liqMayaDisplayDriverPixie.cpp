@@ -45,11 +45,8 @@ using std::endl;
 using namespace std;
 #define HERE  cout<<"at "<<__LINE__<<" in "<<__FUNCTION__<<endl;
 #define INFO(EXPR,ENDL) cout<<#EXPR<<" "<<EXPR<<" ";if(ENDL)cout<<endl;
-static int timeout = 30;
 static int recoverFlag=0;
-static int socketId = -1;
 
-int sendSockData(int s,char * data,int n);
 
 #ifndef _WIN32
 #define closesocket close
@@ -66,8 +63,8 @@ void	*displayStart( const char *name,int width,int height,int numSamples,const c
 	int i,rc;
   int origin[2];
   int originalSize[2];
-	int status = 0;
 	int port = 6667;
+	int timeout = 30;
 	
 #ifdef _WIN32
 	WSADATA wsaData;
@@ -116,61 +113,45 @@ void	*displayStart( const char *name,int width,int height,int numSamples,const c
 	}
 */
 
-	imageInfo *imgSpecs = new imageInfo;
-	imgSpecs->channels = numSamples;
-	imgSpecs->width      = width;
-	imgSpecs->height      = height;
-	imgSpecs->xo = origin[0];
-	imgSpecs->yo = origin[1];
-	imgSpecs->wo = width;//originalSize[0];
-	imgSpecs->ho = height;//originalSize[1];
-
-	socketId = openSocket(hostname, port);
-  printf("[d_liqmaya] openSocket = %d host = %s port = %d\n", socketId, hostname, port);
-	if(socketId == -1)
-  {
-		#ifdef _WIN32
-			WSACleanup();
-		#endif
-
-		delete imgSpecs;
-		return NULL;//PkDspyErrorNoResource;
-	}
-
-	if(!waitSocket(socketId,timeout,false))	
+	char *encoding = (char *) findParameter("bucketEncoding",STRING_PARAMETER,1);
+	char *statsFile = (char *) findParameter("statsFile",STRING_PARAMETER,1);
+	char *resumeFile = (char *) findParameter("resumeFile",STRING_PARAMETER,1);
+
+	liqMayaDisplayDriverImage *image = new liqMayaDisplayDriverImage;
+	image->info.channels = numSamples;
+	image->info.width    = width;
+	image->info.height   = height;
+	image->info.xo = origin[0];
+	image->info.yo = origin[1];
+	image->info.wo = width;//originalSize[0];
+	image->info.ho = height;//originalSize[1];
+	image->info.encoding = liqBucketCodec::parse(encoding);
+	image->setName(name);
+	image->setStatsFile(statsFile);
+	image->setResumeFile(resumeFile);
+	image->addChannel(samples);
+
+	if(!image->connect(hostname, port, timeout))
   {
 		#ifdef _WIN32
 			WSACleanup();
 		#endif
 
-		cerr<<"[d_liqmaya] Error: timeout"<<endl;
-		delete imgSpecs;
+		delete image;
 		return NULL;//PkDspyErrorNoResource;
 	}
-	status = sendSockData(socketId,(char*)imgSpecs,sizeof(imageInfo));
-	if(!status)
-  {
-		#ifdef _WIN32
-			WSACleanup();
-		#endif
-
-		perror("[d_liqmaya] Error: write(socketId,wh,2*sizeof(int))");
-		delete imgSpecs;
-		return NULL;//PkDspyErrorNoResource;
-	}
-
-	return (void*)imgSpecs;//PkDspyErrorNone;
+	return (void*)image;//PkDspyErrorNone;
 }
 
 int	displayData(void *im,int x,int y,int w,int h,float *data) 
 {
-	imageInfo *spec = (imageInfo*)im;
-	PtDspyError status = sendData(socketId,x,x+w,y,y+h,spec->channels*sizeof(float),spec->channels,(BUCKETDATATYPE*)data);
-	if(!status)
+	liqMayaDisplayDriverImage *image = (liqMayaDisplayDriverImage*)im;
+	if(!image->sendBucket(x,x+w,y,y+h,(const BUCKETDATATYPE*)data))
   {
-		displayFinish(im);
+		image->close();
+		return false;
 	}
-	return status;
+	return true;
 
 }
 
@@ -216,69 +197,10 @@ int sendSockData(int s,char * data,int n)
 
 void	displayFinish(void *im) 
 {
-	bucket::bucketInfo binfo;
-#ifdef _WIN32
-	memset(&binfo,0,sizeof(bucket::bucketInfo));
-#else
-	bzero(&binfo,sizeof(bucket::bucketInfo));
-#endif
-	sendSockData(socketId, (char*) &binfo,sizeof(bucket::bucketInfo));
-
+	delete (liqMayaDisplayDriverImage*)im;
 #ifdef _WIN32
 	WSACleanup();
 #endif
-	closesocket(socketId);
-}
-
-
-PtDspyError sendData(const int socket,
-			 const int xmin,
-			 const int xmax_plusone,
-			 const int ymin,
-			 const int ymax_plusone,
-			 const int entrysize,
-			 const int numChannels,
-			 const BUCKETDATATYPE *data) 
-{
-	int status =0;
-	int size = (xmax_plusone-xmin)*(ymax_plusone-ymin)*numChannels*sizeof(BUCKETDATATYPE);
-	bucket::bucketInfo binfo;
-	binfo.left      = xmin;
-	binfo.right     = xmax_plusone;
-	binfo.bottom    = ymin;
-	binfo.top       = ymax_plusone;
-	binfo.channels  = numChannels;
-  
-  printf( "[d_liqmaya] bucketInfo: %d %d %d %d (%d)\n", binfo.left,binfo.right,binfo.bottom,binfo.top, binfo.channels ); 
-  printf( "[d_liqmaya] send bucket size = %d \n", size ); 
-  
-
-	if(!waitSocket(socket,timeout,false))
-  {
-		cerr<<"[d_liqmaya] Error: timeout reached, data cannot be sent"<<endl;
-		return false;
-	}
-
-	status = sendSockData(socket, (char*)&binfo,sizeof(bucket::bucketInfo));
-	if(!status)
-  {
-		perror("[d_liqmaya] Error: write(socket,bucketInfo)");
-		return false;
-	}
-	
-	if(!waitSocket(socket,timeout,false))
-  {
-		cerr<<"[d_liqmaya] Error: timeout reached, data cannot be sent"<<endl;
-		return false;
-	}
-	status = sendSockData(socket, (char*)data,size);
-	if(!status)
-  {
-		perror("[d_liqmaya] Error: write(socket,data)");
-		return false;
-	}
-	return true;
-
 }
 
 
@@ -340,4 +262,18 @@ int openSocket(const char *host, const int port)
 	return clientSocket;
 }
 
-
+int readSockData(int s,char * data,int n){
+	int i;
+	while(n > 0)
+  {
+		i = recv(s,data,n,0);
+		if (i <= 0)
+    {
+			perror("[d_liqmaya] Connection broken (receiving)");
+			return false;
+		}
+		data += i;
+		n -= i;
+	}
+	return true;
+}
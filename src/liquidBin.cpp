@@ -50,6 +50,8 @@ extern "C" {
 #include <liquid.h>
 #include <liqRibTranslator.h>
 #include <liqGlobalHelpers.h>
+#include <liqShaderCompiler.h>
+#include <liqShaderInfoCache.h>
 
 #if defined(_WIN32)/* && !defined(DEFINED_LIQUIDVERSION)*/
 // unix build gets this from the Makefile
@@ -140,11 +142,27 @@ Job\n\
 \t-rgc    -ribgenCommand <string> \n\
 \t-rgo    -ribGenOnly\n\
 \t-rs     -renderScript\n\
+\t-rtl    -renderTiles <n>\n\
+\t-rsl    -renderSlots <n>\n\
+\t-rth    -renderThreads <n>\n\
 \n\
 RenderView\n\
 \t-rv     -renderView\n\
 \t-rvl    -renderViewLocal\n\
 \t-rvp    -renderViewPort <n>\n\
+\t-rven   -renderViewEncoding <float|half|16bit|8bit>[+lz]\n\
+\t-rvao   -renderViewAOVs\n\
+\t-rvsf   -renderViewStatsFile <file>\n\
+\t-rvrs   -renderViewResume\n\
+\n\
+Shaders (no Maya scene, must be the first flag)\n\
+\t-csh    -compileShaders [flags] <files or directories>\n\
+\t          -j <n>          parallel compiles, one per processor by default\n\
+\t          -I <path>       include path, may be repeated\n\
+\t          -o <path>       output directory, next to the sources by default\n\
+\t          -c <compiler>   shader compiler\n\
+\t          -e <ext>        compiled shader extension\n\
+\t          -f              compile up to date shaders too\n\
 \n\
 Please see the Liquid Wiki for command line options.\n\
 The options match the liquid MEL command parameters.\n";
@@ -170,6 +188,43 @@ static bool isHelpArg(const char *arg)
   );
 }
 
+/** Rebuilds out of date shaders without starting Maya.
+ */
+static int compileShaders( int argc, char **argv )
+{
+  liqShaderCompiler compiler;
+  unsigned sources( 0 );
+
+  for ( int i( 0 ); i < argc; ++i ) 
+  {
+    string arg( argv[i] );
+    bool hasValue( i + 1 < argc );
+    if ( ( arg == "-j" || arg == "-jobs" ) && hasValue ) 
+      compiler.setJobs( atoi( argv[++i] ) );
+    else if ( ( arg == "-I" || arg == "-include" ) && hasValue ) 
+      compiler.addIncludePath( argv[++i] );
+    else if ( ( arg == "-o" || arg == "-outputDir" ) && hasValue ) 
+      compiler.setOutputDir( argv[++i] );
+    else if ( ( arg == "-c" || arg == "-compiler" ) && hasValue ) 
+      compiler.setCompiler( argv[++i], "" );
+    else if ( ( arg == "-e" || arg == "-extension" ) && hasValue ) 
+      compiler.setCompiler( "", argv[++i] );
+    else if ( arg == "-f" || arg == "-force" ) 
+      compiler.setForce( true );
+    else if ( arg.size() > 2 && arg.compare( 0, 2, "-I" ) == 0 ) 
+      compiler.addIncludePath( arg.substr( 2 ) );
+    else 
+      sources += compiler.addSources( arg );
+  }
+
+  if ( !sources ) 
+  {
+    liquidMessage( "no shader sources to compile", messageError );
+    return 1;
+  }
+  return compiler.run()? 0 : 1;
+}
+
 int main(int argc, char **argv)
 //
 //  Description:
@@ -185,6 +240,10 @@ int main(int argc, char **argv)
   
   liquidMessage( LIQUIDVERSION, messageInfo );
   
+  // shader compilation does not need Maya
+  if ( argc > 1 && ( !strcmp( argv[1], "-compileShaders" ) || !strcmp( argv[1], "-csh" ) ) ) 
+    return compileShaders( argc - 2, argv + 2 );
+
   // cerr << "liquidBin = " << liquidBin << endl << flush; 
   
   char *maya_location = getenv( "MAYA_LOCATION" );
@@ -284,6 +343,8 @@ int main(int argc, char **argv)
   else 
     printf( "ALF_EXIT_STATUS 1\n" );
 
+  // no idle events out here to save the shaders it read
+  liqShaderInfoCache::shutdown();
   MLibrary::cleanup( 0 );
   return (0);
 }
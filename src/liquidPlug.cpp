@@ -59,6 +59,7 @@ extern "C" {
 #include <liqGetAttr.h>
 #include <liqAttachPrefAttribute.h>
 #include <liqPreviewShader.h>
+#include <liqPreviewServer.h>
 #include <liqWriteArchive.h>
 #include <liqNodeSwatch.h>
 #include <liqSurfaceNode.h>
@@ -73,6 +74,7 @@ extern "C" {
 #include <liqMayaRenderView.h>
 #include <liqGlobalsNode.h>
 #include <liqJobList.h>
+#include <liqShaderCompiler.h>
 #include <liqRiCommands.h>
 #include <liqBoundingBoxLocator.h>
 #include <liqCoShaderNode.h>
@@ -81,6 +83,8 @@ extern "C" {
 #include <liqSurfaceSwitcherNode.h>
 #include <liqDisplacementSwitcherNode.h>
 #include <liqParseString.h>
+#include <liqProcessLauncher.h>
+#include <liqShaderInfoCache.h>
 
 #define LIQVENDOR "http://liquidmaya.sourceforge.net/"
 
@@ -139,6 +143,10 @@ LIQUID_EXPORT MStatus initializePlugin(MObject obj)
   status = plugin.registerCommand( "liquidJobList", liqJobList::creator ,liqJobList::syntax);
   LIQCHECKSTATUS( status, "Can't register liquidJobList command" );
 
+  // register the liquidCompileShaders command
+  status = plugin.registerCommand( "liquidCompileShaders", liqCompileShaders::creator, liqCompileShaders::syntax );
+  LIQCHECKSTATUS( status, "Can't register liquidCompileShaders command" );
+
 #ifndef NO_RICMD
   // register the RIArchiveBegin command
   status = plugin.registerCommand( "RIArchiveBegin", RIArchiveBegin::creator, RIArchiveBegin::newSyntax );
@@ -523,15 +531,21 @@ LIQUID_EXPORT MStatus uninitializePlugin(MObject obj)
   MStatus status;
   MFnPlugin plugin(obj);
 
+  // their output is read by threads of the plugin, and so are the render view's buckets
+  liqMayaRenderCmd::stopRender();
+  liqProcessLauncher::cancel();
+
   status = plugin.deregisterCommand("liquid");
   LIQCHECKSTATUS( status, "Can't deregister liquid command" );
 
   status = plugin.deregisterCommand("liquidAttachPrefAttribute");
   LIQCHECKSTATUS( status, "Can't deregister liquidAttachPrefAttribute command" );
 
+  liqPreviewServer::instance().stop();
   status = plugin.deregisterCommand("liquidPreviewShader");
   LIQCHECKSTATUS( status, "Can't deregister liquidPreviewShader command" );
 
+  liqShaderInfoCache::shutdown();
   status = plugin.deregisterCommand("liquidGetSloInfo");
   LIQCHECKSTATUS( status, "Can't deregister liquidGetSloInfo command" );
 
@@ -547,6 +561,9 @@ LIQUID_EXPORT MStatus uninitializePlugin(MObject obj)
   status = plugin.deregisterCommand("liquidJobList");
   LIQCHECKSTATUS( status, "Can't deregister liquidJobList command" );
 
+  status = plugin.deregisterCommand("liquidCompileShaders");
+  LIQCHECKSTATUS( status, "Can't deregister liquidCompileShaders command" );
+
 #ifndef NO_RICMD
   status = plugin.deregisterCommand("RIArchiveBegin");
   LIQCHECKSTATUS( status, "Can't deregister RIArchiveBegin command" );